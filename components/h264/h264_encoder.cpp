@@ -17,6 +17,7 @@
 
 // ✅ CORRECTION : Inclure le header au lieu de redéclarer
 #include "../mipi_dsi_cam/mipi_dsi_cam_video_devices.h"
+#include "../mipi_dsi_cam/mipi_dsi_cam_v4l2_adapter.h"
 
 namespace esphome {
 namespace h264 {
@@ -51,6 +52,8 @@ void H264Encoder::setup() {
     return;
   }
   
+  this->consumer_id_ = this->camera_->register_consumer("h264");
+  
   ESP_LOGI(TAG, "✅ H.264 encoder ready (bitrate=%u, GOP=%u)", 
            this->bitrate_, this->gop_size_);
 }
@@ -99,6 +102,18 @@ esp_err_t H264Encoder::init_internal_() {
     return ESP_OK;
   }
 
+  // Entrée = format natif de la caméra ; YUV420 est le format natif de l'encodeur (aucune conversion)
+  const mipi_dsi_cam::PixelFormat input_format = this->camera_->get_processed_format();
+  if (input_format == mipi_dsi_cam::PixelFormat::PIXEL_FORMAT_RAW8) {
+    ESP_LOGE(TAG, "H.264 encoder needs RGB565/YUV input, camera outputs %s",
+             mipi_dsi_cam::pixel_format_to_string(input_format));
+    return ESP_ERR_NOT_SUPPORTED;
+  }
+  if (input_format != mipi_dsi_cam::PixelFormat::PIXEL_FORMAT_YUV420) {
+    ESP_LOGW(TAG, "Camera outputs %s: pixel_format YUV420 avoids the encoder-side conversion",
+             mipi_dsi_cam::pixel_format_to_string(input_format));
+  }
+
   // ✅ AJOUT : Initialiser le système vidéo
   ESP_LOGI(TAG, "Initializing video subsystem...");
   esp_err_t ret = mipi_dsi_cam_video_init();
@@ -113,10 +128,7 @@ esp_err_t H264Encoder::init_internal_() {
     ESP_LOGW(TAG, "Failed to create H.264 device: 0x%x (may already exist)", ret);
   }
 
-  // Petit délai pour laisser le device se stabiliser
-  delay(50);
-
-  // Ouvrir le device H264
+  // Ouvrir le device H264 (enregistrement synchrone : pas d'attente de stabilisation)
   this->h264_fd_ = open(ESP_VIDEO_H264_DEVICE_NAME, O_RDWR | O_NONBLOCK);
   if (this->h264_fd_ < 0) {
     ESP_LOGE(TAG, "Failed to open H264 device %s (errno=%d)", 
@@ -132,10 +144,11 @@ esp_err_t H264Encoder::init_internal_() {
   // Buffers applicatifs
   struct esp_video_buffer_info buffer_info = {
     .count = 3,
-    .size = w * h * 2, // RGB565
+    .size = static_cast<uint32_t>(mipi_dsi_cam::pixel_format_frame_size(input_format, w, h)),
     .align_size = 64,
     .caps = (MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT),
-    .memory_type = V4L2_MEMORY_USERPTR
+    // Alloués ici (MMAP côté esp_video_buffer), passés au device en USERPTR
+    .memory_type = V4L2_MEMORY_MMAP
   };
   
   this->input_buffer_ = esp_video_buffer_create(&buffer_info);
@@ -166,7 +179,8 @@ esp_err_t H264Encoder::init_internal_() {
 
   // Config format input
   in_fmt.type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
-  in_fmt.fmt.pix.pixelformat = V4L2_PIX_FMT_RGB565;
+  in_fmt.fmt.pix.pixelformat =
+      mipi_dsi_cam::pixel_format_to_v4l2(input_format, this->camera_->get_bayer_pattern());
   in_fmt.fmt.pix.width = w;
   in_fmt.fmt.pix.height = h;
   in_fmt.fmt.pix.field = V4L2_FIELD_NONE;
@@ -292,9 +306,38 @@ esp_err_t H264Encoder::encode_frame(
   return this->encode_internal_(rgb_or_yuv_data, in_size, h264_data, h264_size, is_keyframe);
 }
 
+esp_err_t H264Encoder::encode_frame(
+  const mipi_dsi_cam::FrameLease &frame,
+  uint8_t **h264_data, size_t *h264_size, bool *is_keyframe) {
+  if (!this->initialized_) {
+    ESP_LOGE(TAG, "Encoder not initialized");
+    return ESP_FAIL;
+  }
+  if (!frame || !h264_data || !h264_size) return ESP_ERR_INVALID_ARG;
+  // Frame Bayer brute (caméra basculée en mode RAW) : rien à encoder
+  if (frame.metadata().pixel_format == static_cast<uint8_t>(mipi_dsi_cam::PixelFormat::PIXEL_FORMAT_RAW8)) {
+    return ESP_ERR_NOT_SUPPORTED;
+  }
+  // Le bail garde le slot épinglé pendant tout l'encodage synchrone
+  return this->encode_internal_(frame.data(), frame.size(), h264_data, h264_size, is_keyframe, true,
+                                &frame.metadata());
+}
+
+esp_err_t H264Encoder::encode_next_frame(
+  uint8_t **h264_data, size_t *h264_size, bool *is_keyframe, uint32_t timeout_ms) {
+  if (!this->initialized_) {
+    ESP_LOGE(TAG, "Encoder not initialized");
+    return ESP_FAIL;
+  }
+  mipi_dsi_cam::FrameLease frame = this->camera_->wait_and_acquire(this->consumer_id_, timeout_ms);
+  if (!frame) return ESP_ERR_NOT_FOUND;
+  return this->encode_frame(frame, h264_data, h264_size, is_keyframe);
+}
+
 esp_err_t H264Encoder::encode_internal_(
   const uint8_t *src, size_t src_size,
-  uint8_t **dst, size_t *dst_size, bool *is_keyframe) {
+  uint8_t **dst, size_t *dst_size, bool *is_keyframe, bool zero_copy,
+  const mipi_dsi_cam::FrameMetadata *meta) {
 
   // Input: USERPTR
   struct esp_video_buffer_element *in_elem = nullptr;
@@ -307,16 +350,27 @@ esp_err_t H264Encoder::encode_internal_(
   }
   if (!in_elem) return ESP_ERR_NO_MEM;
 
-  std::memcpy(in_elem->buffer, src, std::min(src_size, (size_t)this->input_buffer_->info.size));
+  const uint8_t *in_ptr = src;
+  if (!zero_copy) {
+    std::memcpy(in_elem->buffer, src, std::min(src_size, (size_t)this->input_buffer_->info.size));
+    in_ptr = in_elem->buffer;
+  }
   in_elem->valid_size = src_size;
 
   struct v4l2_buffer obuf = {};
   obuf.type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
   obuf.memory = V4L2_MEMORY_USERPTR;
   obuf.index = in_elem->index;
-  obuf.m.userptr = reinterpret_cast<unsigned long>(in_elem->buffer);
+  obuf.m.userptr = reinterpret_cast<unsigned long>(in_ptr);
   obuf.length = this->input_buffer_->info.size;
   obuf.bytesused = in_elem->valid_size;
+  if (meta != nullptr) {
+    // Horodatage de capture transmis au buffer de sortie (M2M)
+    obuf.flags = V4L2_BUF_FLAG_TIMESTAMP_COPY;
+    obuf.timestamp.tv_sec = meta->capture_us / 1000000;
+    obuf.timestamp.tv_usec = meta->capture_us % 1000000;
+    obuf.sequence = meta->sequence;
+  }
 
   if (!xioctl(this->h264_fd_, VIDIOC_QBUF, &obuf)) {
     ELEMENT_SET_FREE(in_elem);
@@ -392,6 +446,9 @@ esp_err_t H264Encoder::encode_internal_(
   *dst = out_elem->buffer;
   *dst_size = cbuf.bytesused;
   out_elem->valid_size = cbuf.bytesused;
+  if (meta != nullptr) {
+    this->last_metadata_ = *meta;
+  }
 
   ELEMENT_SET_FREE(in_elem);
 
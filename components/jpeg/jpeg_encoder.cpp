@@ -17,6 +17,7 @@
 
 // ✅ CORRECTION : Inclure le header au lieu de redéclarer
 #include "../mipi_dsi_cam/mipi_dsi_cam_video_devices.h"
+#include "../mipi_dsi_cam/mipi_dsi_cam_v4l2_adapter.h"
 
 namespace esphome {
 namespace jpeg {
@@ -51,6 +52,8 @@ void JPEGEncoder::setup() {
     return;
   }
   
+  this->consumer_id_ = this->camera_->register_consumer("jpeg");
+  
   ESP_LOGI(TAG, "✅ JPEG encoder ready (quality=%u)", this->quality_);
 }
 
@@ -83,6 +86,14 @@ esp_err_t JPEGEncoder::init_internal_() {
     return ESP_OK;
   }
 
+  // Entrée = format natif de la caméra ; une mosaïque Bayer n'est pas encodable
+  const mipi_dsi_cam::PixelFormat input_format = this->camera_->get_processed_format();
+  if (input_format == mipi_dsi_cam::PixelFormat::PIXEL_FORMAT_RAW8) {
+    ESP_LOGE(TAG, "JPEG encoder needs RGB565/YUV input, camera outputs %s",
+             mipi_dsi_cam::pixel_format_to_string(input_format));
+    return ESP_ERR_NOT_SUPPORTED;
+  }
+
   // ✅ AJOUT : Initialiser le système vidéo
   ESP_LOGI(TAG, "Initializing video subsystem...");
   esp_err_t ret = mipi_dsi_cam_video_init();
@@ -97,10 +108,7 @@ esp_err_t JPEGEncoder::init_internal_() {
     ESP_LOGW(TAG, "Failed to create JPEG device: 0x%x (may already exist)", ret);
   }
 
-  // Petit délai pour laisser le device se stabiliser
-  delay(50);
-
-  // Ouvrir le device JPEG
+  // Ouvrir le device JPEG (enregistrement synchrone : pas d'attente de stabilisation)
   this->jpeg_fd_ = open(ESP_VIDEO_JPEG_DEVICE_NAME, O_RDWR | O_NONBLOCK);
   if (this->jpeg_fd_ < 0) {
     ESP_LOGE(TAG, "Failed to open JPEG device %s (errno=%d)", 
@@ -115,10 +123,11 @@ esp_err_t JPEGEncoder::init_internal_() {
 
   struct esp_video_buffer_info buffer_info = {
     .count = 3,
-    .size = w * h * 2,
+    .size = static_cast<uint32_t>(mipi_dsi_cam::pixel_format_frame_size(input_format, w, h)),
     .align_size = 64,
     .caps = (MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT),
-    .memory_type = V4L2_MEMORY_USERPTR
+    // Alloués ici (MMAP côté esp_video_buffer), passés au device en USERPTR
+    .memory_type = V4L2_MEMORY_MMAP
   };
   
   this->input_buffer_ = esp_video_buffer_create(&buffer_info);
@@ -151,7 +160,8 @@ esp_err_t JPEGEncoder::init_internal_() {
   in_fmt.type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
   in_fmt.fmt.pix.width = w;
   in_fmt.fmt.pix.height = h;
-  in_fmt.fmt.pix.pixelformat = V4L2_PIX_FMT_RGB565;
+  in_fmt.fmt.pix.pixelformat =
+      mipi_dsi_cam::pixel_format_to_v4l2(input_format, this->camera_->get_bayer_pattern());
   in_fmt.fmt.pix.field = V4L2_FIELD_NONE;
   if (!xioctl(this->jpeg_fd_, VIDIOC_S_FMT, &in_fmt)) {
     ESP_LOGE(TAG, "VIDIOC_S_FMT input failed");
@@ -269,8 +279,34 @@ esp_err_t JPEGEncoder::encode_frame(
   return this->encode_internal_(rgb_data, rgb_size, jpeg_data, jpeg_size);
 }
 
+esp_err_t JPEGEncoder::encode_frame(
+  const mipi_dsi_cam::FrameLease &frame, uint8_t **jpeg_data, size_t *jpeg_size) {
+  if (!this->initialized_) {
+    ESP_LOGE(TAG, "Encoder not initialized");
+    return ESP_FAIL;
+  }
+  if (!frame || !jpeg_data || !jpeg_size) return ESP_ERR_INVALID_ARG;
+  // Frame Bayer brute (caméra basculée en mode RAW) : rien à encoder
+  if (frame.metadata().pixel_format == static_cast<uint8_t>(mipi_dsi_cam::PixelFormat::PIXEL_FORMAT_RAW8)) {
+    return ESP_ERR_NOT_SUPPORTED;
+  }
+  // Le bail garde le slot épinglé pendant tout l'encodage synchrone
+  return this->encode_internal_(frame.data(), frame.size(), jpeg_data, jpeg_size, true, &frame.metadata());
+}
+
+esp_err_t JPEGEncoder::encode_next_frame(uint8_t **jpeg_data, size_t *jpeg_size, uint32_t timeout_ms) {
+  if (!this->initialized_) {
+    ESP_LOGE(TAG, "Encoder not initialized");
+    return ESP_FAIL;
+  }
+  mipi_dsi_cam::FrameLease frame = this->camera_->wait_and_acquire(this->consumer_id_, timeout_ms);
+  if (!frame) return ESP_ERR_NOT_FOUND;
+  return this->encode_frame(frame, jpeg_data, jpeg_size);
+}
+
 esp_err_t JPEGEncoder::encode_internal_(
-  const uint8_t *src, size_t src_size, uint8_t **dst, size_t *dst_size) {
+  const uint8_t *src, size_t src_size, uint8_t **dst, size_t *dst_size, bool zero_copy,
+  const mipi_dsi_cam::FrameMetadata *meta) {
 
   // Input: USERPTR
   struct esp_video_buffer_element *in_elem = nullptr;
@@ -286,16 +322,27 @@ esp_err_t JPEGEncoder::encode_internal_(
     return ESP_ERR_NO_MEM;
   }
   
-  std::memcpy(in_elem->buffer, src, std::min(src_size, (size_t)this->input_buffer_->info.size));
+  const uint8_t *in_ptr = src;
+  if (!zero_copy) {
+    std::memcpy(in_elem->buffer, src, std::min(src_size, (size_t)this->input_buffer_->info.size));
+    in_ptr = in_elem->buffer;
+  }
   in_elem->valid_size = src_size;
 
   struct v4l2_buffer in_buf = {};
   in_buf.type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
   in_buf.memory = V4L2_MEMORY_USERPTR;
   in_buf.index = in_elem->index;
-  in_buf.m.userptr = reinterpret_cast<unsigned long>(in_elem->buffer);
+  in_buf.m.userptr = reinterpret_cast<unsigned long>(in_ptr);
   in_buf.length = this->input_buffer_->info.size;
   in_buf.bytesused = in_elem->valid_size;
+  if (meta != nullptr) {
+    // Horodatage de capture transmis au buffer de sortie (M2M)
+    in_buf.flags = V4L2_BUF_FLAG_TIMESTAMP_COPY;
+    in_buf.timestamp.tv_sec = meta->capture_us / 1000000;
+    in_buf.timestamp.tv_usec = meta->capture_us % 1000000;
+    in_buf.sequence = meta->sequence;
+  }
 
   if (!xioctl(this->jpeg_fd_, VIDIOC_QBUF, &in_buf)) {
     ELEMENT_SET_FREE(in_elem);
@@ -366,6 +413,9 @@ esp_err_t JPEGEncoder::encode_internal_(
   *dst = out_elem->buffer;
   *dst_size = out_buf.bytesused;
   out_elem->valid_size = out_buf.bytesused;
+  if (meta != nullptr) {
+    this->last_metadata_ = *meta;
+  }
 
   ELEMENT_SET_FREE(in_elem);
 
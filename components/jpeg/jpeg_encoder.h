@@ -5,6 +5,7 @@
 #include <fcntl.h>
 #include "../lvgl_camera_display/ioctl.h"
 #include "../mipi_dsi_cam/videodev2.h"
+#include "../mipi_dsi_cam/mipi_dsi_cam_frame_ring.h"
 
 #ifdef USE_ESP32_VARIANT_ESP32P4
 
@@ -12,6 +13,7 @@
 namespace esphome {
 namespace mipi_dsi_cam {
 class MipiDsiCam;
+class FrameLease;
 }
 }
 
@@ -62,6 +64,30 @@ class JPEGEncoder : public Component {
                          uint8_t **jpeg_data, 
                          size_t *jpeg_size);
   
+  /**
+   * @brief Encode une frame tenue par un bail (zéro copie)
+   *
+   * Le buffer DMA de la caméra est passé tel quel en USERPTR à l'encodeur.
+   */
+  esp_err_t encode_frame(const mipi_dsi_cam::FrameLease &frame,
+                         uint8_t **jpeg_data,
+                         size_t *jpeg_size);
+  
+  /**
+   * @brief Encode la prochaine frame de la caméra (curseur propre à l'encodeur)
+   *
+   * @param timeout_ms Attente maximale d'une nouvelle frame (0 = pas d'attente)
+   * @return ESP_ERR_NOT_FOUND si aucune nouvelle frame n'est disponible
+   */
+  esp_err_t encode_next_frame(uint8_t **jpeg_data, size_t *jpeg_size, uint32_t timeout_ms = 0);
+  
+  /**
+   * @brief Métadonnées de la dernière frame encodée via un bail
+   *
+   * Horodatage de capture, séquence, exposition... (base des timestamps RTP)
+   */
+  const mipi_dsi_cam::FrameMetadata &get_last_frame_metadata() const { return this->last_metadata_; }
+  
   /**
    * @brief Vérifie si l'encodeur est initialisé
    */
@@ -69,6 +95,8 @@ class JPEGEncoder : public Component {
   
  protected:
   mipi_dsi_cam::MipiDsiCam *camera_{nullptr};
+  uint8_t consumer_id_{0xFF};
+  mipi_dsi_cam::FrameMetadata last_metadata_{};
   int jpeg_fd_{-1};
   bool initialized_{false};
   uint8_t quality_{80};
@@ -83,7 +111,9 @@ class JPEGEncoder : public Component {
   esp_err_t init_internal_();
   esp_err_t deinit_internal_();
   esp_err_t encode_internal_(const uint8_t *src, size_t src_size,
-                             uint8_t **dst, size_t *dst_size);
+                             uint8_t **dst, size_t *dst_size,
+                             bool zero_copy = false,
+                             const mipi_dsi_cam::FrameMetadata *meta = nullptr);
 };
 
 } // namespace jpeg
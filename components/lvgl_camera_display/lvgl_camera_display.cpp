@@ -7,6 +7,11 @@ namespace lvgl_camera_display {
 
 static const char *const TAG = "lvgl_camera_display";
 
+#ifdef USE_ESP32_VARIANT_ESP32P4
+// Attente maximale de la première frame au démarrage
+static constexpr uint32_t FIRST_FRAME_TIMEOUT_MS = 500;
+#endif
+
 void LVGLCameraDisplay::setup() {
   ESP_LOGCONFIG(TAG, "🎥 LVGL Camera Display (V4L2 Mode)");
 
@@ -36,11 +41,12 @@ void LVGLCameraDisplay::setup() {
   if (!this->camera_->get_v4l2_adapter()) {
     ESP_LOGI(TAG, "Enabling V4L2 adapter...");
     this->camera_->enable_v4l2_adapter();
-    delay(100);
   }
 
-  // Attendre stabilisation
-  delay(200);
+  // Attendre la première frame plutôt qu'un délai fixe
+  if (!this->camera_->wait_frame(0, FIRST_FRAME_TIMEOUT_MS)) {
+    ESP_LOGW(TAG, "No camera frame after %u ms, continuing", FIRST_FRAME_TIMEOUT_MS);
+  }
 
   // Ouvrir le device V4L2 (comme M5Stack)
   if (!this->open_v4l2_device_()) {
@@ -70,8 +76,8 @@ void LVGLCameraDisplay::setup() {
     return;
   }
 
-  // Initialiser PPA si transformations nécessaires
-  if (this->rotation_ != ROTATION_0 || this->mirror_x_ || this->mirror_y_) {
+  // Initialiser PPA si transformations ou conversion de couleur nécessaires
+  if (this->needs_ppa_()) {
     if (!this->init_ppa_()) {
       ESP_LOGE(TAG, "❌ Failed to initialize PPA");
       this->mark_failed();
@@ -87,7 +93,7 @@ void LVGLCameraDisplay::setup() {
   ESP_LOGI(TAG, "   Resolution: %ux%u", this->width_, this->height_);
   ESP_LOGI(TAG, "   Target FPS: %.1f", 1000.0f / this->update_interval_);
   ESP_LOGI(TAG, "   Buffers: %d x %u bytes", VIDEO_BUFFER_COUNT, this->buffer_length_);
-  ESP_LOGI(TAG, "   PPA: %s", (this->rotation_ != ROTATION_0 || this->mirror_x_ || this->mirror_y_) ? "ENABLED" : "DISABLED");
+  ESP_LOGI(TAG, "   PPA: %s", this->needs_ppa_() ? "ENABLED" : "DISABLED");
 #else
   ESP_LOGE(TAG, "❌ V4L2 pipeline requires ESP32-P4");
   this->mark_failed();
@@ -99,8 +105,8 @@ void LVGLCameraDisplay::setup() {
 bool LVGLCameraDisplay::open_v4l2_device_() {
   ESP_LOGI(TAG, "Opening V4L2 device: %s", this->video_device_);
   
-  // Ouvrir le device video (comme M5Stack: O_RDONLY)
-  this->video_fd_ = open(this->video_device_, O_RDONLY);
+  // Non bloquant : DQBUF est appelé depuis loop(), qui ne doit pas dormir en attendant une frame
+  this->video_fd_ = open(this->video_device_, O_RDONLY | O_NONBLOCK);
   if (this->video_fd_ < 0) {
     ESP_LOGE(TAG, "Failed to open %s: errno=%d", this->video_device_, errno);
     return false;
@@ -143,7 +149,24 @@ bool LVGLCameraDisplay::open_v4l2_device_() {
 }
 
 bool LVGLCameraDisplay::setup_v4l2_format_() {
-  ESP_LOGI(TAG, "Setting V4L2 format: %ux%u RGB565", this->width_, this->height_);
+  // Le capteur ne sort que son format natif : RGB565 direct, YUV420 converti par le PPA
+  if (this->camera_ != nullptr) {
+    switch (this->camera_->get_processed_format()) {
+      case mipi_dsi_cam::PixelFormat::PIXEL_FORMAT_RGB565:
+        this->input_pixelformat_ = V4L2_PIX_FMT_RGB565;
+        break;
+      case mipi_dsi_cam::PixelFormat::PIXEL_FORMAT_YUV420:
+        this->input_pixelformat_ = V4L2_PIX_FMT_YUV420;
+        break;
+      default:
+        ESP_LOGE(TAG, "Camera pixel format %s cannot be displayed (RGB565 or YUV420 required)",
+                 mipi_dsi_cam::pixel_format_to_string(this->camera_->get_processed_format()));
+        return false;
+    }
+  }
+
+  ESP_LOGI(TAG, "Setting V4L2 format: %ux%u %s", this->width_, this->height_,
+           this->input_pixelformat_ == V4L2_PIX_FMT_YUV420 ? "YUV420" : "RGB565");
 
   // D'abord récupérer le format actuel
   struct v4l2_format fmt = {};
@@ -156,15 +179,15 @@ bool LVGLCameraDisplay::setup_v4l2_format_() {
 
   ESP_LOGI(TAG, "Current format: %ux%u", fmt.fmt.pix.width, fmt.fmt.pix.height);
 
-  // Si le format n'est pas déjà RGB565, le configurer
-  if (fmt.fmt.pix.pixelformat != V4L2_PIX_FMT_RGB565 ||
+  // Si le format n'est pas déjà le format natif, le configurer
+  if (fmt.fmt.pix.pixelformat != this->input_pixelformat_ ||
       fmt.fmt.pix.width != this->width_ ||
       fmt.fmt.pix.height != this->height_) {
     
     fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
     fmt.fmt.pix.width = this->width_;
     fmt.fmt.pix.height = this->height_;
-    fmt.fmt.pix.pixelformat = V4L2_PIX_FMT_RGB565;
+    fmt.fmt.pix.pixelformat = this->input_pixelformat_;
     fmt.fmt.pix.field = V4L2_FIELD_NONE;
 
     if (ioctl(this->video_fd_, VIDIOC_S_FMT, &fmt) < 0) {
@@ -281,6 +304,12 @@ bool LVGLCameraDisplay::capture_v4l2_frame_(uint8_t **frame_data) {
     return false;
   }
 
+  // Frames jamais vues par l'affichage (capturées pendant qu'il tenait ses buffers)
+  if (this->last_sequence_ != 0 && buf.sequence - this->last_sequence_ > 1) {
+    this->drop_count_ += buf.sequence - this->last_sequence_ - 1;
+  }
+  this->last_sequence_ = buf.sequence;
+
   // Récupérer le pointeur vers les données
   *frame_data = this->mmap_buffers_[buf.index];
   this->current_buffer_index_ = buf.index;
@@ -394,7 +423,8 @@ bool LVGLCameraDisplay::transform_frame_(const uint8_t *src, uint8_t *dst) {
   srm_config.in.block_h = this->height_;
   srm_config.in.block_offset_x = 0;
   srm_config.in.block_offset_y = 0;
-  srm_config.in.srm_cm = PPA_SRM_COLOR_MODE_RGB565;
+  srm_config.in.srm_cm = this->input_pixelformat_ == V4L2_PIX_FMT_YUV420 ? PPA_SRM_COLOR_MODE_YUV420
+                                                                         : PPA_SRM_COLOR_MODE_RGB565;
   
   uint16_t out_w = (this->rotation_ == ROTATION_90 || this->rotation_ == ROTATION_270) 
                    ? this->height_ : this->width_;
@@ -441,14 +471,13 @@ void LVGLCameraDisplay::loop() {
   if (now - this->last_update_time_ < this->update_interval_) {
     return;
   }
-  this->last_update_time_ = now;
 
-  // Capturer une frame via V4L2 (comme M5Stack)
+  // Capturer une frame via V4L2 (comme M5Stack) ; pas encore de frame : nouvel essai au prochain loop()
   uint8_t *frame_data = nullptr;
   if (!this->capture_v4l2_frame_(&frame_data)) {
-    this->drop_count_++;
     return;
   }
+  this->last_update_time_ = now;
 
   if (!frame_data) {
     return;
@@ -61,6 +61,8 @@ class LVGLCameraDisplay : public Component {
   ppa_client_handle_t ppa_handle_{nullptr};
   uint8_t *transform_buffer_{nullptr};
   size_t transform_buffer_size_{0};
+  // Format natif du flux ; LVGL affiche du RGB565, le YUV420 est converti par le PPA
+  uint32_t input_pixelformat_{V4L2_PIX_FMT_RGB565};
   
   // Méthodes V4L2
   bool open_v4l2_device_();
@@ -75,6 +77,10 @@ class LVGLCameraDisplay : public Component {
   bool init_ppa_();
   void deinit_ppa_();
   bool transform_frame_(const uint8_t *src, uint8_t *dst);
+  bool needs_ppa_() const {
+    return this->rotation_ != ROTATION_0 || this->mirror_x_ || this->mirror_y_ ||
+           this->input_pixelformat_ != V4L2_PIX_FMT_RGB565;
+  }
 #endif
 
   lv_obj_t *canvas_obj_{nullptr};
@@ -88,6 +94,7 @@ class LVGLCameraDisplay : public Component {
   
   uint32_t frame_count_{0};
   uint32_t drop_count_{0};
+  uint32_t last_sequence_{0};  // Séquence V4L2 de la dernière frame affichée (pertes = trous)
   uint32_t last_update_time_{0};
   uint32_t last_fps_time_{0};
   bool first_update_{true};
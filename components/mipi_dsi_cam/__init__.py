@@ -1,20 +1,26 @@
 import esphome.codegen as cg
 import esphome.config_validation as cv
 from esphome.components import i2c
+from esphome.components.esp32 import add_idf_sdkconfig_option
 from esphome.const import (
     CONF_ID,
     CONF_NAME,
     CONF_FREQUENCY,
     CONF_ADDRESS,
+    PLATFORM_ESP32,
+    PLATFORM_HOST,
 )
-from esphome import pins
+from esphome.core import CORE
+from esphome import automation, pins
 
 CODEOWNERS = ["@youkorr"]
-DEPENDENCIES = ["i2c", "esp32"]
+# i2c n'est requis que sur ESP32 (voir validate_platform) : le build host n'a pas de bus
+DEPENDENCIES = []
 MULTI_CONF = True
 
 mipi_dsi_cam_ns = cg.esphome_ns.namespace("mipi_dsi_cam")
 MipiDsiCam = mipi_dsi_cam_ns.class_("MipiDsiCam", cg.Component, i2c.I2CDevice)
+DumpTelemetryAction = mipi_dsi_cam_ns.class_("DumpTelemetryAction", automation.Action)
 
 CONF_EXTERNAL_CLOCK_PIN = "external_clock_pin"
 CONF_RESET_PIN = "reset_pin"
@@ -25,6 +31,14 @@ CONF_RESOLUTION = "resolution"
 CONF_PIXEL_FORMAT = "pixel_format"
 CONF_FRAMERATE = "framerate"
 CONF_JPEG_QUALITY = "jpeg_quality"
+CONF_FRAME_BUFFER_COUNT = "frame_buffer_count"
+CONF_SIMULATION_FILE = "simulation_file"
+CONF_INPLACE_WHITE_BALANCE = "inplace_white_balance"
+CONF_STATS_ZONES_X = "stats_zones_x"
+CONF_STATS_ZONES_Y = "stats_zones_y"
+CONF_STATS_STRIDE = "stats_stride"
+CONF_3A_TASK_CORE = "3a_task_core"
+CONF_3A_TASK_PRIORITY = "3a_task_priority"
 CONF_ENABLE_V4L2 = "enable_v4l2"
 CONF_ENABLE_ISP_PIPELINE = "enable_isp_pipeline"
 
@@ -40,6 +54,7 @@ PIXEL_FORMAT_OPTIONS = {
     "RGB565": "RGB565",
     "YUV422": "YUV422",
     "RAW8": "RAW8",
+    "YUV420": "YUV420",
 }
 
 # ✅ Mapping vers les noms réels de l'enum C++
@@ -47,6 +62,7 @@ PIXEL_FORMAT_MAPPING = {
     "RGB565": "PIXEL_FORMAT_RGB565",
     "YUV422": "PIXEL_FORMAT_YUV422",
     "RAW8": "PIXEL_FORMAT_RAW8",
+    "YUV420": "PIXEL_FORMAT_YUV420",
 }
 
 RESOLUTIONS = {
@@ -58,6 +74,20 @@ RESOLUTIONS = {
 
 AVAILABLE_SENSORS = {}
 
+# Capteur simulé (SimSensorDriver + SimFrameSource) : pas de code généré
+SIM_SENSOR_INFO = {
+    'name': 'sim',
+    'manufacturer': 'ESPHome',
+    'pid': 0xeb52,
+    'i2c_address': 0x36,
+    'lane_count': 1,
+    'bayer_pattern': 0,
+    'lane_bitrate_mbps': 576,
+    'width': 1280,
+    'height': 720,
+    'fps': 30,
+}
+
 def load_sensors():
     import logging
     logger = logging.getLogger(__name__)
@@ -74,7 +104,12 @@ def load_sensors():
     except Exception as e:
         logger.error(f"Error loading SC202CS: {e}")
     
-    if not AVAILABLE_SENSORS:
+    AVAILABLE_SENSORS['sim'] = {
+        'info': SIM_SENSOR_INFO,
+        'driver': None
+    }
+    
+    if len(AVAILABLE_SENSORS) == 1:
         raise cv.Invalid(
             "Aucun sensor MIPI disponible. "
             "Assurez-vous que les fichiers sensor_mipi_csi_*.py sont dans components/mipi_dsi_cam/"
@@ -124,7 +159,7 @@ def validate_external_clock_pin(value):
         return cv.int_range(min=0, max=50)(value)
     return pins.internal_gpio_output_pin_schema(value)
 
-CONFIG_SCHEMA = cv.Schema(
+BASE_SCHEMA = cv.Schema(
     {
         cv.GenerateID(): cv.declare_id(MipiDsiCam),
         cv.Optional(CONF_NAME, default="MIPI Camera"): cv.string,
@@ -138,19 +173,47 @@ CONFIG_SCHEMA = cv.Schema(
         cv.Optional(CONF_PIXEL_FORMAT, default="RGB565"): cv.enum(PIXEL_FORMAT_OPTIONS, upper=True),
         cv.Optional(CONF_FRAMERATE): cv.int_range(min=1, max=60),
         cv.Optional(CONF_JPEG_QUALITY, default=10): cv.int_range(min=1, max=63),
+        cv.Optional(CONF_FRAME_BUFFER_COUNT, default=3): cv.int_range(min=2, max=8),
+        cv.Optional(CONF_SIMULATION_FILE): cv.string,
+        cv.Optional(CONF_INPLACE_WHITE_BALANCE, default=False): cv.boolean,
+        cv.Optional(CONF_STATS_ZONES_X, default=16): cv.int_range(min=1, max=16),
+        cv.Optional(CONF_STATS_ZONES_Y, default=16): cv.int_range(min=1, max=16),
+        cv.Optional(CONF_STATS_STRIDE, default=8): cv.int_range(min=1, max=64),
+        # Tâche AE/AWB : -1 = pas d'affinité de coeur
+        cv.Optional(CONF_3A_TASK_CORE, default=-1): cv.int_range(min=-1, max=1),
+        cv.Optional(CONF_3A_TASK_PRIORITY, default=5): cv.int_range(min=1, max=24),
         cv.Optional(CONF_ENABLE_V4L2, default=True): cv.boolean,
         cv.Optional(CONF_ENABLE_ISP_PIPELINE, default=True): cv.boolean,
         # ✅ Nouveaux paramètres
         cv.Optional(CONF_ENABLE_JPEG_ENCODER, default=False): cv.boolean,
         cv.Optional(CONF_ENABLE_H264_ENCODER, default=False): cv.boolean,
     }
-).extend(cv.COMPONENT_SCHEMA).extend(i2c.i2c_device_schema(0x36))
+).extend(cv.COMPONENT_SCHEMA)
+
+ESP32_SCHEMA = BASE_SCHEMA.extend(i2c.i2c_device_schema(0x36))
+
+
+def validate_platform(config):
+    # Plateforme host (USE_HOST) : capteur simulé uniquement, sans I2C ni CSI
+    if not CORE.is_host:
+        return ESP32_SCHEMA(config)
+    config = BASE_SCHEMA(config)
+    if config[CONF_SENSOR] != "sim":
+        raise cv.Invalid("Seul le capteur 'sim' est disponible sur la plateforme host")
+    return config
+
+
+CONFIG_SCHEMA = cv.All(
+    cv.only_on([PLATFORM_ESP32, PLATFORM_HOST]),
+    validate_platform,
+)
 
 
 async def to_code(config):
     var = cg.new_Pvariable(config[CONF_ID])
     await cg.register_component(var, config)
-    await i2c.register_i2c_device(var, config)
+    if not CORE.is_host:
+        await i2c.register_i2c_device(var, config)
     
     cg.add(var.set_name(config[CONF_NAME]))
     
@@ -205,6 +268,13 @@ async def to_code(config):
     
     cg.add(var.set_jpeg_quality(config[CONF_JPEG_QUALITY]))
     cg.add(var.set_framerate(framerate))
+    cg.add(var.set_frame_buffer_count(config[CONF_FRAME_BUFFER_COUNT]))
+    cg.add(var.set_inplace_white_balance(config[CONF_INPLACE_WHITE_BALANCE]))
+    cg.add(var.set_stats_config(config[CONF_STATS_ZONES_X], config[CONF_STATS_ZONES_Y], config[CONF_STATS_STRIDE]))
+    cg.add(var.set_3a_task_core(config[CONF_3A_TASK_CORE]))
+    cg.add(var.set_3a_task_priority(config[CONF_3A_TASK_PRIORITY]))
+    if CONF_SIMULATION_FILE in config:
+        cg.add(var.set_simulation_file(config[CONF_SIMULATION_FILE]))
     
     if CONF_RESET_PIN in config:
         reset_pin = await cg.gpio_pin_expression(config[CONF_RESET_PIN])
@@ -239,6 +309,8 @@ async def to_code(config):
     
     for sensor_id, sensor_data in AVAILABLE_SENSORS.items():
         driver_code_func = sensor_data['driver']
+        if driver_code_func is None:
+            continue
         all_drivers_code += driver_code_func() + "\n\n"
     
     factory_code = f'''
@@ -248,7 +320,9 @@ namespace mipi_dsi_cam {{
 inline ISensorDriver* create_sensor_driver(const std::string& sensor_type, i2c::I2CDevice* i2c) {{
 '''
     
-    for sensor_id in AVAILABLE_SENSORS.keys():
+    for sensor_id, sensor_data in AVAILABLE_SENSORS.items():
+        if sensor_data['driver'] is None:
+            continue
         sensor_upper = sensor_id.upper()
         factory_code += f'''
     if (sensor_type == "{sensor_id}") {{
@@ -276,9 +350,12 @@ inline ISensorDriver* create_sensor_driver(const std::string& sensor_type, i2c::
         f.write(complete_code)
         f.write("\n#endif\n")
     
-    cg.add_build_flag("-DBOARD_HAS_PSRAM")
-    cg.add_build_flag("-DCONFIG_CAMERA_CORE0=1")
-    cg.add_build_flag("-DUSE_ESP32_VARIANT_ESP32P4")
+    if not CORE.is_host:
+        cg.add_build_flag("-DBOARD_HAS_PSRAM")
+        cg.add_build_flag("-DCONFIG_CAMERA_CORE0=1")
+        cg.add_build_flag("-DUSE_ESP32_VARIANT_ESP32P4")
+        # Index de notification 1 réservé aux attentes de frames / DQBUF (CAMERA_NOTIFY_INDEX)
+        add_idf_sdkconfig_option("CONFIG_FREERTOS_TASK_NOTIFICATION_ARRAY_ENTRIES", 2)
     
     # Message de log pour la configuration
     has_ext_clock = CONF_EXTERNAL_CLOCK_PIN in config and config[CONF_EXTERNAL_CLOCK_PIN] != NO_CLOCK
@@ -296,6 +373,7 @@ inline ISensorDriver* create_sensor_driver(const std::string& sensor_type, i2c::
         ESP_LOGI("compile", "  Address: 0x{sensor_address:02X}");
         ESP_LOGI("compile", "  Format: {config[CONF_PIXEL_FORMAT]}");
         ESP_LOGI("compile", "  FPS: {framerate}");
+        ESP_LOGI("compile", "  Frame buffers: {config[CONF_FRAME_BUFFER_COUNT]}");
         ESP_LOGI("compile", "  External Clock: {ext_clock_msg}");
         ESP_LOGI("compile", "  V4L2 Interface: {v4l2_msg}");
         ESP_LOGI("compile", "  ISP Pipeline: {isp_msg}");
@@ -303,3 +381,12 @@ inline ISensorDriver* create_sensor_driver(const std::string& sensor_type, i2c::
         ESP_LOGI("compile", "  H264 Encoder: {h264_msg}");
     '''))
 
+
+@automation.register_action(
+    "mipi_dsi_cam.dump_telemetry",
+    DumpTelemetryAction,
+    cv.Schema({cv.GenerateID(): cv.use_id(MipiDsiCam)}),
+)
+async def dump_telemetry_to_code(config, action_id, template_arg, args):
+    camera = await cg.get_variable(config[CONF_ID])
+    return cg.new_Pvariable(action_id, template_arg, camera)
@@ -4,6 +4,8 @@
  * SPDX-License-Identifier: ESPRESSIF MIT
  */
 
+#ifdef USE_ESP32_VARIANT_ESP32P4
+
 #include <stdio.h>
 #include <string.h>
 #include <sys/lock.h>
@@ -150,3 +152,5 @@ void esp_video_buffer_reset(struct esp_video_buffer *buffer)
         buffer->element[i].valid_size = 0;
     }
 }
+
+#endif // USE_ESP32_VARIANT_ESP32P4
@@ -1,15 +1,35 @@
+#ifdef USE_ESP32_VARIANT_ESP32P4
+
 #include "esp_video_init.h"
 #include "esp_log.h"
 #include "esp_vfs.h"
+#include "esp_attr.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
 #include <fcntl.h>
 #include "../lvgl_camera_display/ioctl.h"
 #include <errno.h>
+#include <atomic>
+#include <cstdlib>
 #include <cstring>
 
 static const char *TAG = "esp_video_init";
 
 #define MAX_VIDEO_DEVICES 32
 #define MAX_OPEN_FDS 64
+// Tâches bloquées simultanément dans VIDIOC_DQBUF sur un même device
+#define MAX_DQBUF_WAITERS 4
+// select() simultanés sur les devices vidéo
+#define MAX_VIDEO_SELECTS 8
+// DQBUF bloquant : nouvel essai périodique même sans notification du driver
+#define DQBUF_RECHECK_MS 1000
+// Index de notification des DQBUF bloquants : le même que MipiDsiCam (CAMERA_NOTIFY_INDEX), jamais l'index 0
+#define DQBUF_NOTIFY_INDEX 1
+static_assert(DQBUF_NOTIFY_INDEX < configTASK_NOTIFICATION_ARRAY_ENTRIES,
+              "CONFIG_FREERTOS_TASK_NOTIFICATION_ARRAY_ENTRIES must be at least 2");
+// Buffers exportés simultanément (VIDIOC_EXPBUF), tous devices confondus
+#define MAX_SHARED_BUFFERS 16
 
 // Structure pour le device vidéo
 typedef struct {
@@ -17,6 +37,9 @@ typedef struct {
     void *user_ctx;
     const void *ops;
     int ref_count;
+    // Sérialise les ioctl côté application (files QBUF/DQBUF SPSC), relâché pendant l'attente de DQBUF
+    SemaphoreHandle_t lock;
+    std::atomic<TaskHandle_t> dqbuf_waiters[MAX_DQBUF_WAITERS];  // Réveillées par esp_video_notify_ready_from_isr()
 } esp_video_vfs_t;
 
 // Structure pour mapper fd VFS → device_num
@@ -24,9 +47,19 @@ typedef struct {
     int vfs_fd;          // Le fd système complet
     int local_fd;        // L'index dans notre table
     int device_num;
+    int flags;           // Flags d'open() / F_SETFL (O_NONBLOCK)
     bool in_use;
 } fd_mapping_t;
 
+// Buffer exporté : handle = génération * MAX_SHARED_BUFFERS + entrée
+typedef struct {
+    void *owner;          // Device exportateur, nullptr = entrée libre
+    uint8_t *buffer;
+    uint32_t size;
+    uint32_t generation;  // Incrémentée à la révocation : un ancien handle ne résout plus
+    uint32_t imports;     // Références tenues par les devices importateurs
+} shared_buffer_t;
+
 static esp_video_vfs_t s_video_devices[MAX_VIDEO_DEVICES] = {0};
 static fd_mapping_t s_fd_mappings[MAX_OPEN_FDS] = {0};
 static bool s_vfs_registered = false;
@@ -191,6 +224,12 @@ static int video_close(int fd);
 static ssize_t video_read(int fd, void *dst, size_t size);
 static ssize_t video_write(int fd, const void *src, size_t size);
 static int video_ioctl(int fd, int cmd, va_list args);
+static int video_fcntl(int fd, int cmd, int arg);
+#ifdef CONFIG_VFS_SUPPORT_SELECT
+static esp_err_t video_start_select(int nfds, fd_set *readfds, fd_set *writefds, fd_set *exceptfds,
+                                    esp_vfs_select_sem_t select_sem, void **end_select_args);
+static esp_err_t video_end_select(void *end_select_args);
+#endif
 
 // Table des opérations VFS
 static esp_vfs_t video_vfs;
@@ -203,6 +242,300 @@ static void init_video_vfs() {
     video_vfs.close = &video_close;
     video_vfs.read = &video_read;
     video_vfs.ioctl = &video_ioctl;
+    video_vfs.fcntl = &video_fcntl;
+#ifdef CONFIG_VFS_SUPPORT_SELECT
+    video_vfs.start_select = &video_start_select;
+    video_vfs.end_select = &video_end_select;
+#endif
+}
+
+// ===== Attente d'un buffer : DQBUF bloquant et select() =====
+
+#ifdef CONFIG_VFS_SUPPORT_SELECT
+// Un select() en cours : fds vidéo surveillés en lecture, ensemble rendu à l'appelant
+typedef struct {
+    esp_vfs_select_sem_t select_sem;
+    fd_set *readfds;
+    fd_set readfds_orig;
+} video_select_args_t;
+
+static video_select_args_t *s_selects[MAX_VIDEO_SELECTS];
+static portMUX_TYPE s_select_lock = portMUX_INITIALIZER_UNLOCKED;
+#endif
+
+// Réveille les attentes d'un device (DQBUF bloquant, select) ; vrai si une tâche plus prioritaire est réveillée
+static bool IRAM_ATTR wake_device_waiters(int device_num, bool from_isr) {
+    BaseType_t task_woken = pdFALSE;
+    
+    for (auto &waiter : s_video_devices[device_num].dqbuf_waiters) {
+        TaskHandle_t task = waiter.load(std::memory_order_acquire);
+        if (task == nullptr) {
+            continue;
+        }
+        if (from_isr) {
+            vTaskNotifyGiveIndexedFromISR(task, DQBUF_NOTIFY_INDEX, &task_woken);
+        } else {
+            xTaskNotifyGiveIndexed(task, DQBUF_NOTIFY_INDEX);
+        }
+    }
+    
+#ifdef CONFIG_VFS_SUPPORT_SELECT
+    if (from_isr) {
+        portENTER_CRITICAL_ISR(&s_select_lock);
+    } else {
+        portENTER_CRITICAL(&s_select_lock);
+    }
+    for (video_select_args_t *args : s_selects) {
+        if (args == nullptr) {
+            continue;
+        }
+        bool ready = false;
+        for (int fd = 0; fd < MAX_OPEN_FDS; fd++) {
+            if (FD_ISSET(fd, &args->readfds_orig) && s_fd_mappings[fd].in_use &&
+                s_fd_mappings[fd].device_num == device_num) {
+                FD_SET(fd, args->readfds);
+                ready = true;
+            }
+        }
+        if (!ready) {
+            continue;
+        }
+        if (from_isr) {
+            esp_vfs_select_triggered_isr(args->select_sem, &task_woken);
+        } else {
+            esp_vfs_select_triggered(args->select_sem);
+        }
+    }
+    if (from_isr) {
+        portEXIT_CRITICAL_ISR(&s_select_lock);
+    } else {
+        portEXIT_CRITICAL(&s_select_lock);
+    }
+#endif
+    
+    return task_woken == pdTRUE;
+}
+
+extern "C" bool IRAM_ATTR esp_video_notify_ready_from_isr(void *video_device) {
+    for (int i = 0; i < MAX_VIDEO_DEVICES; i++) {
+        if (s_video_devices[i].video_device == video_device) {
+            // Contexte tâche quand le capteur "sim" remplace le DMA CSI
+            return wake_device_waiters(i, xPortInIsrContext());
+        }
+    }
+    return false;
+}
+
+// DQBUF immédiat, ou sommeil jusqu'au prochain buffer rempli si le fd est bloquant.
+// Appelé verrou du device pris ; le verrou est rendu pendant le sommeil.
+static esp_err_t video_dqbuf(esp_video_vfs_t *vfs_dev, const esp_video_ops *ops, void *arg, bool blocking) {
+    esp_err_t ret = ops->dqbuf(vfs_dev->video_device, arg);
+    if (ret != ESP_ERR_NOT_FOUND || !blocking) {
+        return ret;
+    }
+    
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    std::atomic<TaskHandle_t> *registration = nullptr;
+    for (auto &waiter : vfs_dev->dqbuf_waiters) {
+        TaskHandle_t expected = nullptr;
+        if (waiter.compare_exchange_strong(expected, self, std::memory_order_acq_rel)) {
+            registration = &waiter;
+            break;
+        }
+    }
+    if (registration == nullptr) {
+        ESP_LOGW(TAG, "Too many tasks blocked in DQBUF (max %d)", MAX_DQBUF_WAITERS);
+        return ret;
+    }
+    
+    // Nouvel essai après inscription : un buffer rempli entre-temps ne doit pas être manqué
+    while ((ret = ops->dqbuf(vfs_dev->video_device, arg)) == ESP_ERR_NOT_FOUND) {
+        xSemaphoreGive(vfs_dev->lock);
+        ulTaskNotifyTakeIndexed(DQBUF_NOTIFY_INDEX, pdTRUE, pdMS_TO_TICKS(DQBUF_RECHECK_MS));
+        xSemaphoreTake(vfs_dev->lock, portMAX_DELAY);
+    }
+    
+    registration->store(nullptr, std::memory_order_release);
+    return ret;
+}
+
+static bool video_fd_ready(int local_fd) {
+    const int device_num = get_device_num_from_local_fd(local_fd);
+    if (device_num < 0 || device_num >= MAX_VIDEO_DEVICES) {
+        return false;
+    }
+    const esp_video_ops *ops = (const esp_video_ops*)s_video_devices[device_num].ops;
+    return ops && ops->poll && ops->poll(s_video_devices[device_num].video_device) == ESP_OK;
+}
+
+#ifdef CONFIG_VFS_SUPPORT_SELECT
+static esp_err_t video_start_select(int nfds, fd_set *readfds, fd_set *writefds, fd_set *exceptfds,
+                                    esp_vfs_select_sem_t select_sem, void **end_select_args) {
+    video_select_args_t *args = (video_select_args_t*)calloc(1, sizeof(video_select_args_t));
+    if (!args) {
+        return ESP_ERR_NO_MEM;
+    }
+    args->select_sem = select_sem;
+    args->readfds = readfds;
+    args->readfds_orig = *readfds;
+    
+    // Seule la lecture (buffer à dépiler) est signalée ; le reste est rendu vide
+    FD_ZERO(readfds);
+    FD_ZERO(writefds);
+    FD_ZERO(exceptfds);
+    
+    portENTER_CRITICAL(&s_select_lock);
+    bool registered = false;
+    for (auto &entry : s_selects) {
+        if (entry == nullptr) {
+            entry = args;
+            registered = true;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&s_select_lock);
+    if (!registered) {
+        free(args);
+        ESP_LOGW(TAG, "Too many concurrent select() on video devices (max %d)", MAX_VIDEO_SELECTS);
+        return ESP_ERR_NO_MEM;
+    }
+    
+    // Inscrit avant ce test : un buffer rempli entre-temps est signalé par l'ISR
+    bool ready = false;
+    for (int fd = 0; fd < nfds && fd < MAX_OPEN_FDS; fd++) {
+        if (FD_ISSET(fd, &args->readfds_orig) && video_fd_ready(fd)) {
+            portENTER_CRITICAL(&s_select_lock);
+            FD_SET(fd, readfds);
+            portEXIT_CRITICAL(&s_select_lock);
+            ready = true;
+        }
+    }
+    if (ready) {
+        esp_vfs_select_triggered(select_sem);
+    }
+    
+    *end_select_args = args;
+    return ESP_OK;
+}
+
+static esp_err_t video_end_select(void *end_select_args) {
+    video_select_args_t *args = (video_select_args_t*)end_select_args;
+    
+    portENTER_CRITICAL(&s_select_lock);
+    for (auto &entry : s_selects) {
+        if (entry == args) {
+            entry = nullptr;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&s_select_lock);
+    
+    free(args);
+    return ESP_OK;
+}
+#endif  // CONFIG_VFS_SUPPORT_SELECT
+
+// ===== Buffers partagés entre devices (VIDIOC_EXPBUF / V4L2_MEMORY_DMABUF) =====
+
+static shared_buffer_t s_shared_buffers[MAX_SHARED_BUFFERS];
+static portMUX_TYPE s_shared_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// À appeler sous s_shared_lock
+static shared_buffer_t *shared_buffer_from_handle(int handle) {
+    if (handle < 0) {
+        return nullptr;
+    }
+    shared_buffer_t *entry = &s_shared_buffers[handle % MAX_SHARED_BUFFERS];
+    if (entry->owner == nullptr || entry->generation != (uint32_t)handle / MAX_SHARED_BUFFERS) {
+        return nullptr;
+    }
+    return entry;
+}
+
+extern "C" int esp_video_export_buffer(void *owner, uint8_t *buffer, uint32_t size) {
+    int handle = -1;
+    
+    portENTER_CRITICAL(&s_shared_lock);
+    int free_index = -1;
+    for (int i = 0; i < MAX_SHARED_BUFFERS; i++) {
+        shared_buffer_t *entry = &s_shared_buffers[i];
+        if (entry->owner == owner && entry->buffer == buffer) {
+            free_index = i;
+            break;
+        }
+        if (entry->owner == nullptr && free_index < 0) {
+            free_index = i;
+        }
+    }
+    if (free_index >= 0) {
+        shared_buffer_t *entry = &s_shared_buffers[free_index];
+        if (entry->owner == nullptr) {
+            entry->owner = owner;
+            entry->buffer = buffer;
+            entry->size = size;
+            entry->imports = 0;
+            // Génération 0 exclue : un m.fd laissé à zéro ne résout jamais
+            if (entry->generation == 0) {
+                entry->generation = 1;
+            }
+        }
+        handle = (int)(entry->generation * MAX_SHARED_BUFFERS + free_index);
+    }
+    portEXIT_CRITICAL(&s_shared_lock);
+    
+    if (handle < 0) {
+        ESP_LOGW(TAG, "Too many exported buffers (max %d)", MAX_SHARED_BUFFERS);
+    }
+    return handle;
+}
+
+extern "C" esp_err_t esp_video_import_buffer(int handle, uint8_t **buffer, uint32_t *size) {
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+    
+    portENTER_CRITICAL(&s_shared_lock);
+    shared_buffer_t *entry = shared_buffer_from_handle(handle);
+    if (entry != nullptr) {
+        entry->imports++;
+        *buffer = entry->buffer;
+        *size = entry->size;
+        ret = ESP_OK;
+    }
+    portEXIT_CRITICAL(&s_shared_lock);
+    
+    return ret;
+}
+
+extern "C" void esp_video_release_buffer(int handle) {
+    portENTER_CRITICAL(&s_shared_lock);
+    shared_buffer_t *entry = shared_buffer_from_handle(handle);
+    if (entry != nullptr && entry->imports > 0) {
+        entry->imports--;
+    }
+    portEXIT_CRITICAL(&s_shared_lock);
+}
+
+extern "C" esp_err_t esp_video_revoke_buffers(void *owner) {
+    bool busy = false;
+    
+    portENTER_CRITICAL(&s_shared_lock);
+    for (auto &entry : s_shared_buffers) {
+        if (entry.owner == owner && entry.imports > 0) {
+            busy = true;
+        }
+    }
+    if (!busy) {
+        for (auto &entry : s_shared_buffers) {
+            if (entry.owner == owner) {
+                entry.owner = nullptr;
+                entry.buffer = nullptr;
+                entry.size = 0;
+                entry.generation++;
+            }
+        }
+    }
+    portEXIT_CRITICAL(&s_shared_lock);
+    
+    return busy ? ESP_ERR_INVALID_STATE : ESP_OK;
 }
 
 static int video_open(const char *path, int flags, int mode) {
@@ -231,6 +564,7 @@ static int video_open(const char *path, int flags, int mode) {
                 
                 // Créer le mapping
                 allocate_fd_mapping(device_num, local_fd);
+                s_fd_mappings[local_fd].flags = flags;
                 
                 s_video_devices[device_num].ref_count++;
                 
@@ -271,6 +605,25 @@ static int video_close(int local_fd) {
     return -1;
 }
 
+static int video_fcntl(int local_fd, int cmd, int arg) {
+    if (get_device_num_from_local_fd(local_fd) < 0) {
+        errno = EBADF;
+        return -1;
+    }
+    
+    if (cmd == F_GETFL) {
+        return s_fd_mappings[local_fd].flags;
+    }
+    if (cmd == F_SETFL) {
+        // Seul O_NONBLOCK est modifiable après open()
+        s_fd_mappings[local_fd].flags = (s_fd_mappings[local_fd].flags & ~O_NONBLOCK) | (arg & O_NONBLOCK);
+        return 0;
+    }
+    
+    errno = ENOSYS;
+    return -1;
+}
+
 static ssize_t video_read(int fd, void *dst, size_t size) {
     errno = EINVAL;
     return -1;
@@ -312,6 +665,7 @@ static int video_ioctl(int local_fd, int cmd, va_list args) {
     
     esp_err_t ret = ESP_OK;
     
+    xSemaphoreTake(vfs_dev->lock, portMAX_DELAY);
     if (ioctl_match(cmd, 'V', 0)) {
         if (ops && ops->querycap) {
             ret = ops->querycap(vfs_dev->video_device, arg);
@@ -336,9 +690,13 @@ static int video_ioctl(int local_fd, int cmd, va_list args) {
         if (ops && ops->qbuf) {
             ret = ops->qbuf(vfs_dev->video_device, arg);
         }
+    } else if (ioctl_match(cmd, 'V', 16)) {
+        // Pas de handle fictif : un device sans export échoue
+        ret = (ops && ops->expbuf) ? ops->expbuf(vfs_dev->video_device, arg) : ESP_ERR_NOT_SUPPORTED;
     } else if (ioctl_match(cmd, 'V', 17)) {
         if (ops && ops->dqbuf) {
-            ret = ops->dqbuf(vfs_dev->video_device, arg);
+            const bool blocking = !(s_fd_mappings[local_fd].flags & O_NONBLOCK);
+            ret = video_dqbuf(vfs_dev, ops, arg, blocking);
         }
     } else if (ioctl_match(cmd, 'V', 18)) {
         if (ops && ops->start) {
@@ -349,14 +707,32 @@ static int video_ioctl(int local_fd, int cmd, va_list args) {
         if (ops && ops->stop) {
             uint32_t type = *(uint32_t*)arg;
             ret = ops->stop(vfs_dev->video_device, type);
+            // DQBUF bloqués et select() ressortent : DQBUF échoue désormais immédiatement
+            wake_device_waiters(device_num, false);
         }
+    } else if (ioctl_match(cmd, 'V', 27)) {
+        // Contrôle inconnu du device : EINVAL, comme sous Linux
+        ret = (ops && ops->g_ctrl) ? ops->g_ctrl(vfs_dev->video_device, arg) : ESP_ERR_INVALID_ARG;
     } else if (ioctl_match(cmd, 'V', 28)) {
-        // VIDIOC_S_CTRL - ignorer silencieusement
-        ret = ESP_OK;
+        if (ops && ops->s_ctrl) {
+            ret = ops->s_ctrl(vfs_dev->video_device, arg);
+        } else {
+            // Device sans table de contrôles (encodeurs) : accepté sans effet, comme auparavant
+            ESP_LOGD(TAG, "VIDIOC_S_CTRL ignored: /dev/video%d has no controls", device_num);
+        }
+    } else if (ioctl_match(cmd, 'V', 36)) {
+        ret = (ops && ops->queryctrl) ? ops->queryctrl(vfs_dev->video_device, arg) : ESP_ERR_INVALID_ARG;
+    } else if (ioctl_match(cmd, 'V', 71)) {
+        ret = (ops && ops->g_ext_ctrls) ? ops->g_ext_ctrls(vfs_dev->video_device, arg) : ESP_ERR_INVALID_ARG;
+    } else if (ioctl_match(cmd, 'V', 72) || ioctl_match(cmd, 'V', 73)) {
+        // VIDIOC_TRY_EXT_CTRLS (73) : même validation, rien n'est appliqué
+        const bool try_only = ioctl_match(cmd, 'V', 73);
+        ret = (ops && ops->s_ext_ctrls) ? ops->s_ext_ctrls(vfs_dev->video_device, arg, try_only)
+                                        : ESP_ERR_INVALID_ARG;
     } else {
         ESP_LOGV(TAG, "Unhandled ioctl cmd=0x%08x", cmd);
-        return 0;
     }
+    xSemaphoreGive(vfs_dev->lock);
     
     if (ret != ESP_OK) {
         if (ret == ESP_ERR_NOT_FOUND) {
@@ -365,6 +741,8 @@ static int video_ioctl(int local_fd, int cmd, va_list args) {
             errno = EIO;
         } else if (ret == ESP_ERR_INVALID_ARG) {
             errno = EINVAL;
+        } else if (ret == ESP_ERR_INVALID_SIZE) {
+            errno = ENOSPC;  // G_EXT_CTRLS : charge utile plus grande que le buffer fourni
         } else {
             errno = EIO;
         }
@@ -399,6 +777,15 @@ extern "C" esp_err_t esp_video_register_device(int device_id, void *video_device
         ESP_LOGI(TAG, "✅ Video VFS registered at /dev");
     }
     
+    // Conservé par esp_video_deinit() : une tâche peut encore le tenir
+    if (s_video_devices[device_id].lock == nullptr) {
+        s_video_devices[device_id].lock = xSemaphoreCreateMutex();
+        if (s_video_devices[device_id].lock == nullptr) {
+            ESP_LOGE(TAG, "❌ Failed to create lock for /dev/video%d", device_id);
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    
     s_video_devices[device_id].video_device = video_device;
     s_video_devices[device_id].user_ctx = user_ctx;
     s_video_devices[device_id].ops = ops;
@@ -469,6 +856,12 @@ extern "C" esp_err_t esp_video_deinit(void)
     
     s_vfs_base_fd = -1;
     
+    for (auto &entry : s_shared_buffers) {
+        entry.owner = nullptr;
+        entry.buffer = nullptr;
+        entry.imports = 0;
+    }
+    
     if (s_vfs_registered) {
         esp_vfs_unregister("/dev");
         s_vfs_registered = false;
@@ -476,3 +869,5 @@ extern "C" esp_err_t esp_video_deinit(void)
     
     return ESP_OK;
 }
+
+#endif // USE_ESP32_VARIANT_ESP32P4
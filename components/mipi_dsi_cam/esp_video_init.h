@@ -103,6 +103,14 @@ typedef struct esp_video_init_config {
    esp_err_t (*qbuf)(void *video, void *buffer);
    esp_err_t (*dqbuf)(void *video, void *buffer);
    esp_err_t (*querycap)(void *video, void *cap);
+   esp_err_t (*poll)(void *video);  // ESP_OK si DQBUF n'attendrait pas, ESP_ERR_NOT_FOUND sinon
+   esp_err_t (*expbuf)(void *video, void *exportbuffer);  // VIDIOC_EXPBUF : handle partagé (esp_video_export_buffer)
+  // Contrôles : VIDIOC_S_CTRL / S_EXT_CTRLS validés en entier avant d'appliquer quoi que ce soit
+  esp_err_t (*queryctrl)(void *video, void *queryctrl);
+  esp_err_t (*g_ctrl)(void *video, void *control);
+  esp_err_t (*s_ctrl)(void *video, void *control);
+  esp_err_t (*g_ext_ctrls)(void *video, void *ext_controls);
+  esp_err_t (*s_ext_ctrls)(void *video, void *ext_controls, bool try_only);
 };
 
 /**
@@ -127,6 +135,53 @@ esp_err_t esp_video_deinit(void);
 esp_err_t esp_video_register_device(int device_id, void *video_device, 
                                     void *user_ctx, const void *ops);
 
+/**
+ * @brief Signal that a video device has a buffer ready to dequeue (ISR-safe)
+ *
+ * Wakes the tasks blocked in VIDIOC_DQBUF and the select() calls watching
+ * this device.
+ *
+ * @param video_device Device context given to esp_video_register_device()
+ * @return true if a higher priority task was woken (yield before leaving the ISR)
+ */
+bool esp_video_notify_ready_from_isr(void *video_device);
+
+/**
+ * @brief Share a device buffer with the other video devices (VIDIOC_EXPBUF)
+ *
+ * DMABUF-like: the returned handle is what an importer passes in m.fd with
+ * V4L2_MEMORY_DMABUF. Exporting the same buffer again returns the same handle.
+ *
+ * @param owner  Exporting device context
+ * @param buffer Buffer start, must stay allocated until esp_video_revoke_buffers(owner)
+ * @param size   Buffer size in bytes
+ * @return Handle (>= 0), or -1 if the share table is full
+ */
+int esp_video_export_buffer(void *owner, uint8_t *buffer, uint32_t size);
+
+/**
+ * @brief Resolve a shared handle and take a reference on its buffer
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_NOT_FOUND if the handle is unknown or was revoked
+ */
+esp_err_t esp_video_import_buffer(int handle, uint8_t **buffer, uint32_t *size);
+
+/**
+ * @brief Drop a reference taken by esp_video_import_buffer()
+ */
+void esp_video_release_buffer(int handle);
+
+/**
+ * @brief Invalidate every handle exported by a device, before it frees its buffers
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_STATE if one of them is still imported (nothing is revoked)
+ */
+esp_err_t esp_video_revoke_buffers(void *owner);
+
 #ifdef __cplusplus
 }
 #endif
@@ -1,29 +1,54 @@
 #include "mipi_dsi_cam.h"
+#include "mipi_dsi_cam_sim.h"
 #include "esphome/core/log.h"
 #include "esphome/core/application.h"
-#include "mipi_dsi_cam_video_devices.h"
 
+#include <algorithm>
+#include <cmath>
+
+#ifndef USE_HOST
+#include "mipi_dsi_cam_video_devices.h"
 #include "mipi_dsi_cam_drivers_generated.h"
+#endif
 
-#ifdef MIPI_DSI_CAM_ENABLE_V4L2
+#if defined(MIPI_DSI_CAM_ENABLE_V4L2) && !defined(USE_HOST)
 #include "mipi_dsi_cam_v4l2_adapter.h"
 #endif
 
-#ifdef MIPI_DSI_CAM_ENABLE_ISP_PIPELINE
+#if defined(MIPI_DSI_CAM_ENABLE_ISP_PIPELINE) && !defined(USE_HOST)
 #include "mipi_dsi_cam_isp_pipeline.h"
 #endif
 
-#ifdef USE_ESP32_VARIANT_ESP32P4
+#if defined(USE_ESP32_VARIANT_ESP32P4) || defined(USE_HOST)
 
+#ifndef USE_HOST
 #include "driver/ledc.h"
+#include "esp_cpu.h"
+#include "esp_timer.h"
+#endif
 
 namespace esphome {
 namespace mipi_dsi_cam {
 
 static const char *const TAG = "mipi_dsi_cam";
 
+// Attente maximale de la sortie de standby du capteur après start_stream()
+static constexpr uint32_t STREAM_READY_TIMEOUT_MS = 100;
+// Attente maximale des lecteurs d'un buffer prêté avant qu'il soit rendu à son propriétaire
+static constexpr uint32_t EXTERNAL_RELEASE_TIMEOUT_MS = 100;
+// Attente maximale d'une balance des blancs en place menée par un autre lecteur
+static constexpr uint32_t WB_APPLY_TIMEOUT_MS = 100;
+
 void MipiDsiCam::setup() {
+  this->boot_start_us_ = esp_timer_get_time();
   ESP_LOGI(TAG, "Init MIPI Camera");
+  
+  this->controls_lock_ = xSemaphoreCreateMutex();
+  if (this->controls_lock_ == nullptr) {
+    ESP_LOGE(TAG, "Controls lock allocation failed");
+    this->mark_failed();
+    return;
+  }
   ESP_LOGI(TAG, "  Sensor type: %s", this->sensor_type_.c_str());
   
   if (this->reset_pin_ != nullptr) {
@@ -45,39 +70,52 @@ void MipiDsiCam::setup() {
     this->mark_failed();
     return;
   }
+  this->boot_sensor_ready_ms_ = (esp_timer_get_time() - this->boot_start_us_) / 1000;
   
-  if (this->has_external_clock()) {
-    if (!this->init_external_clock_()) {
-      ESP_LOGE(TAG, "External clock init failed");
+  if (this->is_simulated()) {
+    ESP_LOGI(TAG, "Simulated sensor - clock, LDO, CSI and ISP skipped");
+  } else {
+    if (this->has_external_clock()) {
+      if (!this->init_external_clock_()) {
+        ESP_LOGE(TAG, "External clock init failed");
+        this->mark_failed();
+        return;
+      }
+    } else {
+      ESP_LOGI(TAG, "No external clock configured - sensor must use internal clock");
+    }
+    
+    if (!this->init_ldo_()) {
+      ESP_LOGE(TAG, "LDO init failed");
+      this->mark_failed();
+      return;
+    }
+    
+    if (!this->init_csi_()) {
+      ESP_LOGE(TAG, "CSI init failed");
+      this->mark_failed();
+      return;
+    }
+    
+    // En RAW8 le CSI écrit le Bayer tel quel : l'ISP n'est pas démarré
+    if (!this->is_raw_capture() && !this->init_isp_()) {
+      ESP_LOGE(TAG, "ISP init failed");
       this->mark_failed();
       return;
     }
-  } else {
-    ESP_LOGI(TAG, "No external clock configured - sensor must use internal clock");
-  }
-  
-  if (!this->init_ldo_()) {
-    ESP_LOGE(TAG, "LDO init failed");
-    this->mark_failed();
-    return;
   }
   
-  if (!this->init_csi_()) {
-    ESP_LOGE(TAG, "CSI init failed");
+  if (!this->allocate_buffer_()) {
+    ESP_LOGE(TAG, "Buffer alloc failed");
     this->mark_failed();
     return;
   }
   
-  if (!this->init_isp_()) {
-    ESP_LOGE(TAG, "ISP init failed");
-    this->mark_failed();
-    return;
-  }
+  this->stats_consumer_id_ = this->register_consumer("stats");
   
-  if (!this->allocate_buffer_()) {
-    ESP_LOGE(TAG, "Buffer alloc failed");
-    this->mark_failed();
-    return;
+  // AE/AWB hors main loop ; à défaut, loop() s'en charge
+  if (!this->three_a_task_.start(this, this->three_a_task_core_, this->three_a_task_priority_)) {
+    ESP_LOGW(TAG, "3A task unavailable - AE/AWB run from the main loop");
   }
   
   this->initialized_ = true;
@@ -99,7 +137,26 @@ void MipiDsiCam::setup() {
 bool MipiDsiCam::create_sensor_driver_() {
   ESP_LOGI(TAG, "Creating driver for: %s", this->sensor_type_.c_str());
   
+#ifdef USE_HOST
+  // Sur machine de build, seul le capteur simulé existe
+  this->sensor_type_ = "sim";
+#endif
+  
+  if (this->sensor_type_ == "sim") {
+    SimSensorDriver *sim_sensor = new SimSensorDriver(this->width_, this->height_, this->framerate_);
+    this->sim_source_ = new SimFrameSource(this->pixel_format_, this->width_, this->height_);
+    this->sim_source_->set_sensor(sim_sensor);
+    if (!this->simulation_file_.empty() && !this->sim_source_->load_file(this->simulation_file_)) {
+      ESP_LOGW(TAG, "Simulation file unusable, falling back to test pattern");
+    }
+    this->sensor_driver_ = sim_sensor;
+    ESP_LOGI(TAG, "Driver created for: %s", this->sensor_driver_->get_name());
+    return true;
+  }
+  
+#ifndef USE_HOST
   this->sensor_driver_ = create_sensor_driver(this->sensor_type_, this);
+#endif
   
   if (this->sensor_driver_ == nullptr) {
     ESP_LOGE(TAG, "Unknown or unavailable sensor: %s", this->sensor_type_.c_str());
@@ -152,12 +209,22 @@ bool MipiDsiCam::init_sensor_() {
   
   ESP_LOGI(TAG, "Sensor initialized");
   
-  delay(200);
-  ESP_LOGI(TAG, "Sensor stabilized");
+  // Point de départ connu pour l'AE et les métadonnées de frame
+  this->ae_controller_.configure(this->sensor_driver_, AE_EXPOSURE_MIN, AE_EXPOSURE_MAX);
+  this->sensor_queue_.set_sensor(this->sensor_driver_);
+  this->sensor_queue_.queue_exposure(this->current_exposure_);
+  this->sensor_queue_.queue_gain(this->current_gain_index_);
+  if (!this->flush_sensor_commands_()) {
+    ESP_LOGW(TAG, "Initial exposure/gain write failed");
+  }
+  this->staged_settings_ = this->capture_settings_ = this->written_settings_.load();
+  this->ae_controller_.reset(this->current_exposure_, this->current_gain_index_);
   
+  // Pas d'attente fixe : start_streaming() interroge le capteur, les consommateurs attendent la première frame
   return true;
 }
 
+#ifndef USE_HOST
 bool MipiDsiCam::init_external_clock_() {
   ESP_LOGI(TAG, "Init external clock on GPIO%d @ %u Hz", 
            this->external_clock_pin_, this->external_clock_frequency_);
@@ -212,8 +279,35 @@ bool MipiDsiCam::init_ldo_() {
   return true;
 }
 
+// Le format configuré pilote la conversion couleur du CSI et la sortie de l'ISP (sauf RAW8 : ISP contourné)
+static cam_ctlr_color_t csi_output_color_type(PixelFormat format) {
+  switch (format) {
+    case PixelFormat::PIXEL_FORMAT_YUV422:
+      return CAM_CTLR_COLOR_YUV422;
+    case PixelFormat::PIXEL_FORMAT_YUV420:
+      return CAM_CTLR_COLOR_YUV420;
+    case PixelFormat::PIXEL_FORMAT_RAW8:
+      return CAM_CTLR_COLOR_RAW8;
+    case PixelFormat::PIXEL_FORMAT_RGB565:
+    default:
+      return CAM_CTLR_COLOR_RGB565;
+  }
+}
+
+static isp_color_t isp_output_color_type(PixelFormat format) {
+  switch (format) {
+    case PixelFormat::PIXEL_FORMAT_YUV422:
+      return ISP_COLOR_YUV422;
+    case PixelFormat::PIXEL_FORMAT_YUV420:
+      return ISP_COLOR_YUV420;
+    case PixelFormat::PIXEL_FORMAT_RGB565:
+    default:
+      return ISP_COLOR_RGB565;
+  }
+}
+
 bool MipiDsiCam::init_csi_() {
-  ESP_LOGI(TAG, "Init MIPI-CSI");
+  ESP_LOGI(TAG, "Init MIPI-CSI (%s)", pixel_format_to_string(this->pixel_format_));
   
   esp_cam_ctlr_csi_config_t csi_config = {};
   csi_config.ctlr_id = 0;
@@ -222,7 +316,7 @@ bool MipiDsiCam::init_csi_() {
   csi_config.v_res = this->height_;
   csi_config.lane_bit_rate_mbps = this->lane_bitrate_mbps_;
   csi_config.input_data_color_type = CAM_CTLR_COLOR_RAW8;
-  csi_config.output_data_color_type = CAM_CTLR_COLOR_RGB565;
+  csi_config.output_data_color_type = csi_output_color_type(this->pixel_format_);
   csi_config.data_lane_num = this->lane_count_;
   csi_config.byte_swap_en = false;
   csi_config.queue_items = 10;
@@ -263,7 +357,7 @@ bool MipiDsiCam::init_isp_() {
   isp_config.clk_src = ISP_CLK_SRC_DEFAULT;
   isp_config.input_data_source = ISP_INPUT_DATA_SOURCE_CSI;
   isp_config.input_data_color_type = ISP_COLOR_RAW8;
-  isp_config.output_data_color_type = ISP_COLOR_RGB565;
+  isp_config.output_data_color_type = isp_output_color_type(this->pixel_format_);
   isp_config.h_res = this->width_;
   isp_config.v_res = this->height_;
   isp_config.has_line_start_packet = false;
@@ -285,8 +379,10 @@ bool MipiDsiCam::init_isp_() {
     return false;
   }
   
-  // Configure AWB si supporté par le capteur
-  this->configure_white_balance_();
+  // Configure AWB si supporté par le capteur (le pipeline ISP, s'il existe, a le sien)
+  if (this->isp_pipeline_ == nullptr) {
+    this->configure_white_balance_();
+  }
   
   ESP_LOGI(TAG, "ISP OK");
   return true;
@@ -322,54 +418,159 @@ void MipiDsiCam::configure_white_balance_() {
   }
 }
 
-bool MipiDsiCam::allocate_buffer_() {
-  this->frame_buffer_size_ = this->width_ * this->height_ * 2;
+void MipiDsiCam::release_capture_pipeline_() {
+  if (this->awb_ctlr_ != nullptr) {
+    esp_isp_awb_controller_disable(this->awb_ctlr_);
+    esp_isp_del_awb_controller(this->awb_ctlr_);
+    this->awb_ctlr_ = nullptr;
+  }
   
-  this->frame_buffers_[0] = (uint8_t*)heap_caps_aligned_alloc(
-    64, this->frame_buffer_size_, MALLOC_CAP_SPIRAM
-  );
+  if (this->isp_handle_ != nullptr) {
+    esp_isp_disable(this->isp_handle_);
+    esp_isp_del_processor(this->isp_handle_);
+    this->isp_handle_ = nullptr;
+  }
   
-  this->frame_buffers_[1] = (uint8_t*)heap_caps_aligned_alloc(
-    64, this->frame_buffer_size_, MALLOC_CAP_SPIRAM
-  );
+  if (this->csi_handle_ != nullptr) {
+    esp_cam_ctlr_disable(this->csi_handle_);
+    esp_cam_ctlr_del(this->csi_handle_);
+    this->csi_handle_ = nullptr;
+  }
+}
+#else
+// Pas de matériel caméra sur l'hôte : seul le backend simulé est utilisable
+bool MipiDsiCam::init_external_clock_() { return false; }
+bool MipiDsiCam::init_ldo_() { return false; }
+bool MipiDsiCam::init_csi_() { return false; }
+bool MipiDsiCam::init_isp_() { return false; }
+void MipiDsiCam::configure_white_balance_() {}
+void MipiDsiCam::release_capture_pipeline_() {}
+#endif  // USE_HOST
+
+bool MipiDsiCam::allocate_buffer_() {
+  this->frame_buffer_size_ = pixel_format_frame_size(this->pixel_format_, this->width_, this->height_);
   
-  if (!this->frame_buffers_[0] || !this->frame_buffers_[1]) {
-    ESP_LOGE(TAG, "Buffer alloc failed");
+  if (!this->frame_ring_.allocate(this->frame_buffer_count_, this->frame_buffer_size_)) {
+    ESP_LOGE(TAG, "Buffer alloc failed (%u x %u bytes)",
+             this->frame_buffer_count_, (unsigned) this->frame_buffer_size_);
     return false;
   }
   
-  this->current_frame_buffer_ = this->frame_buffers_[0];
+  this->current_frame_buffer_ = this->frame_ring_.get_slot(0)->buffer;
   
-  ESP_LOGI(TAG, "Buffers: 2x%u bytes", this->frame_buffer_size_);
+  ESP_LOGI(TAG, "Buffers: %ux%u bytes (ring, %s)", this->frame_buffer_count_, (unsigned) this->frame_buffer_size_,
+           pixel_format_to_string(this->pixel_format_));
   return true;
 }
 
 bool IRAM_ATTR MipiDsiCam::on_csi_new_frame_(
-  esp_cam_ctlr_handle_t handle,
+  esp_cam_ctlr_handle_t /*handle*/,
   esp_cam_ctlr_trans_t *trans,
   void *user_data
 ) {
   MipiDsiCam *cam = (MipiDsiCam*)user_data;
-  trans->buffer = cam->frame_buffers_[cam->buffer_index_];
-  trans->buflen = cam->frame_buffer_size_;
+  
+  // Début de frame : le capteur prend en compte ce qui a été écrit pendant la frame précédente
+  cam->capture_settings_ = cam->staged_settings_;
+  cam->staged_settings_ = cam->written_settings_.load(std::memory_order_relaxed);
+  
+  // Zéro copie : le DMA écrit directement dans le prochain buffer mis en file par le consommateur
+  FrameSlot *slot = nullptr;
+  const size_t frame_size = cam->get_image_size();
+  const CaptureBufferSource *source = cam->capture_source_.load(std::memory_order_acquire);
+  if (source != nullptr) {
+    uint8_t *external = source->take(source->ctx, frame_size);
+    if (external != nullptr) {
+      slot = cam->frame_ring_.claim_for_capture(external);
+      if (slot == nullptr) {
+        source->cancel(source->ctx, external);
+      }
+    }
+  }
+  
+  // Seul un slot sans lecteur est donné au DMA ; sinon le driver utilise son buffer de secours
+  if (slot == nullptr) {
+    slot = cam->frame_ring_.claim_for_capture();
+  }
+  if (slot == nullptr) {
+    trans->buffer = nullptr;
+    trans->buflen = 0;
+    return false;
+  }
+  
+  trans->buffer = slot->buffer;
+  trans->buflen = slot->is_external() ? frame_size : cam->frame_buffer_size_;
   return false;
 }
 
 bool IRAM_ATTR MipiDsiCam::on_csi_frame_done_(
-  esp_cam_ctlr_handle_t handle,
+  esp_cam_ctlr_handle_t /*handle*/,
   esp_cam_ctlr_trans_t *trans,
   void *user_data
 ) {
   MipiDsiCam *cam = (MipiDsiCam*)user_data;
   
-  if (trans->received_size > 0) {
-    cam->frame_ready_ = true;
-    cam->frame_sequence_++;  // ✅ NOUVEAU : Incrémenter la séquence
-    cam->buffer_index_ = (cam->buffer_index_ + 1) % 2;
-    cam->total_frames_received_++;
+  FrameSlot *slot = cam->frame_ring_.find_by_buffer(trans->buffer);
+  if (slot == nullptr) {
+    return false;
   }
   
-  return false;
+  const CaptureBufferSource *source = cam->capture_source_.load(std::memory_order_acquire);
+  if (trans->received_size == 0) {
+    if (slot->is_external() && source != nullptr) {
+      source->cancel(source->ctx, slot->buffer);
+    }
+    cam->frame_ring_.abort_capture(slot);
+    return false;
+  }
+  
+  // Métadonnées figées au moment exact de la fin du DMA
+  FrameMetadata meta;
+  meta.capture_us = esp_timer_get_time();
+  meta.sequence = ++cam->frame_sequence_;
+  meta.exposure = cam->capture_settings_ & 0xFFFFFF;
+  meta.gain_index = cam->capture_settings_ >> 24;
+  meta.wb_red_gain = cam->wb_red_gain_fixed_;
+  meta.wb_green_gain = cam->wb_green_gain_fixed_;
+  meta.wb_blue_gain = cam->wb_blue_gain_fixed_;
+  uint32_t skips = cam->frame_ring_.get_skip_count();
+  meta.dropped_before = skips - cam->skips_at_last_commit_;
+  meta.pixel_format = static_cast<uint8_t>(cam->pixel_format_);
+  cam->skips_at_last_commit_ = skips;
+  
+  if (cam->boot_to_first_frame_ms_.load(std::memory_order_relaxed) == 0) {
+    cam->boot_to_first_frame_ms_.store(std::max<int64_t>(1, (meta.capture_us - cam->boot_start_us_) / 1000),
+                                       std::memory_order_relaxed);
+  }
+  
+  cam->frame_ring_.commit_capture(slot, trans->received_size, meta);
+  bool source_woken = false;
+  if (slot->is_external() && source != nullptr) {
+    source_woken = source->done(source->ctx, slot->buffer, trans->received_size, meta);
+  }
+  cam->frame_ready_ = true;
+  cam->total_frames_received_++;
+  
+  // Réveiller les tâches bloquées dans wait_frame()
+  BaseType_t task_woken = pdFALSE;
+  for (auto &waiter : cam->frame_waiters_) {
+    TaskHandle_t task = waiter.load(std::memory_order_acquire);
+    if (task == nullptr) {
+      continue;
+    }
+#ifdef USE_HOST
+    vTaskNotifyGiveIndexedFromISR(task, CAMERA_NOTIFY_INDEX, &task_woken);
+#else
+    // Sur cible, le capteur "sim" livre ses frames depuis une tâche, pas depuis l'ISR CSI
+    if (xPortInIsrContext()) {
+      vTaskNotifyGiveIndexedFromISR(task, CAMERA_NOTIFY_INDEX, &task_woken);
+    } else {
+      xTaskNotifyGiveIndexed(task, CAMERA_NOTIFY_INDEX);
+    }
+#endif
+  }
+  
+  return task_woken == pdTRUE || source_woken;
 }
 
 bool MipiDsiCam::start_streaming() {
@@ -388,12 +589,20 @@ bool MipiDsiCam::start_streaming() {
       ESP_LOGE(TAG, "Sensor start failed: %d", ret);
       return false;
     }
-    delay(100);
+    this->sensor_queue_.invalidate_shadow();
+    
+    // Sortie de standby interrogée au lieu d'une attente fixe
+    const uint32_t start = millis();
+    while (!this->sensor_driver_->is_stream_active()) {
+      if (millis() - start >= STREAM_READY_TIMEOUT_MS) {
+        ESP_LOGW(TAG, "Sensor not reporting stream-on after %u ms", STREAM_READY_TIMEOUT_MS);
+        break;
+      }
+      delay(1);
+    }
   }
   
-  esp_err_t ret = esp_cam_ctlr_start(this->csi_handle_);
-  if (ret != ESP_OK) {
-    ESP_LOGE(TAG, "CSI start failed: %d", ret);
+  if (!this->start_capture_()) {
     return false;
   }
   
@@ -407,7 +616,7 @@ bool MipiDsiCam::stop_streaming() {
     return true;
   }
   
-  esp_cam_ctlr_stop(this->csi_handle_);
+  this->stop_capture_();
   
   if (this->sensor_driver_) {
     this->sensor_driver_->stop_stream();
@@ -418,6 +627,114 @@ bool MipiDsiCam::stop_streaming() {
   return true;
 }
 
+bool MipiDsiCam::start_capture_() {
+  // Buffers prêtés dont la capture a été interrompue par l'arrêt du DMA : de nouveau en file
+  const CaptureBufferSource *source = this->capture_source_.load(std::memory_order_acquire);
+  for (uint8_t i = 0; source != nullptr && i < this->frame_ring_.get_slot_count(); i++) {
+    FrameSlot *slot = this->frame_ring_.get_slot(i);
+    if (slot->is_external() && (slot->state.load(std::memory_order_acquire) & FrameRing::CAPTURING)) {
+      source->cancel(source->ctx, slot->buffer);
+    }
+  }
+  
+  // Le DMA est arrêté : l'anneau repart de zéro, les lecteurs gardent leurs slots
+  this->frame_ring_.reset();
+  this->skips_at_last_commit_ = 0;
+  
+  if (this->is_simulated()) {
+    if (!this->sim_source_->start(this, this->framerate_)) {
+      ESP_LOGE(TAG, "Simulated CSI start failed");
+      return false;
+    }
+    return true;
+  }
+  
+#ifndef USE_HOST
+  esp_err_t ret = esp_cam_ctlr_start(this->csi_handle_);
+  if (ret != ESP_OK) {
+    ESP_LOGE(TAG, "CSI start failed: %d", ret);
+    return false;
+  }
+#endif
+  return true;
+}
+
+void MipiDsiCam::stop_capture_() {
+  if (this->is_simulated()) {
+    this->sim_source_->stop();
+    return;
+  }
+  
+#ifndef USE_HOST
+  esp_cam_ctlr_stop(this->csi_handle_);
+#endif
+}
+
+bool MipiDsiCam::set_capture_format(PixelFormat format) {
+  if (!this->initialized_) {
+    return false;
+  }
+  if (format != this->processed_format_ && format != PixelFormat::PIXEL_FORMAT_RAW8) {
+    ESP_LOGE(TAG, "Capture format %s unavailable (configured: %s, or RAW8)",
+             pixel_format_to_string(format), pixel_format_to_string(this->processed_format_));
+    return false;
+  }
+  if (format == this->pixel_format_) {
+    return true;
+  }
+  
+  const PixelFormat previous = this->pixel_format_;
+  const bool was_streaming = this->streaming_;
+  if (was_streaming) {
+    this->stop_capture_();
+  }
+  
+  this->pixel_format_ = format;
+  bool ok = true;
+  if (this->is_simulated()) {
+    this->sim_source_->set_format(format);
+  } else {
+#ifndef USE_HOST
+    // Blocs et contrôleurs de statistiques du pipeline vivent dans le processeur ISP détruit ci-dessous
+    if (this->isp_pipeline_ != nullptr) {
+      this->isp_pipeline_->deinit();
+    }
+#endif
+    this->release_capture_pipeline_();
+    ok = this->init_csi_() && (this->is_raw_capture() || this->init_isp_());
+    if (!ok) {
+      // Retour au format précédent pour ne pas laisser la caméra sans pipeline
+      ESP_LOGE(TAG, "Capture pipeline reconfiguration to %s failed", pixel_format_to_string(format));
+      this->pixel_format_ = previous;
+      this->release_capture_pipeline_();
+      if (!this->init_csi_() || (!this->is_raw_capture() && !this->init_isp_())) {
+        ESP_LOGE(TAG, "Capture pipeline lost");
+        this->streaming_ = false;
+        this->mark_failed();
+        return false;
+      }
+    }
+#ifndef USE_HOST
+    if (this->isp_pipeline_ != nullptr && !this->is_raw_capture() &&
+        (this->isp_pipeline_->init() != ESP_OK || this->isp_pipeline_->start() != ESP_OK)) {
+      ESP_LOGW(TAG, "ISP pipeline restart failed - white balance and statistics fall back to CPU");
+    }
+#endif
+    this->route_white_balance_();
+  }
+  
+  if (was_streaming && !this->start_capture_()) {
+    this->streaming_ = false;
+    return false;
+  }
+  
+  if (ok) {
+    ESP_LOGI(TAG, "Capture format: %s (%s)", pixel_format_to_string(format),
+             this->is_raw_capture() ? "ISP bypassed" : "ISP");
+  }
+  return ok;
+}
+
 bool MipiDsiCam::capture_frame() {
   if (!this->streaming_) {
     return false;
@@ -426,54 +743,341 @@ bool MipiDsiCam::capture_frame() {
   bool was_ready = this->frame_ready_;
   if (was_ready) {
     this->frame_ready_ = false;
-    uint8_t last_buffer = (this->buffer_index_ + 1) % 2;
-    this->current_frame_buffer_ = this->frame_buffers_[last_buffer];
+    FrameSlot *slot = this->frame_ring_.peek_latest();
+    if (slot != nullptr) {
+      this->current_frame_buffer_ = slot->buffer;
+    }
   }
   
   return was_ready;
 }
-bool MipiDsiCam::acquire_frame(uint32_t last_served_sequence) {
-  // Vérifier s'il y a une nouvelle frame disponible
-  if (!this->streaming_) {
-    return false;
+uint8_t MipiDsiCam::register_consumer(const char *name) {
+  if (this->consumer_count_ >= MAX_FRAME_CONSUMERS) {
+    ESP_LOGE(TAG, "Too many frame consumers (max %u), '%s' rejected", MAX_FRAME_CONSUMERS, name);
+    return INVALID_CONSUMER_ID;
+  }
+  
+  uint8_t id = this->consumer_count_++;
+  this->consumers_[id].name = name;
+  this->consumers_[id].cursor.store(0, std::memory_order_relaxed);
+  this->consumers_[id].frames.store(0, std::memory_order_relaxed);
+  this->consumers_[id].drops.store(0, std::memory_order_relaxed);
+  this->consumers_[id].capture_to_acquire.reset();
+  this->consumers_[id].hold_time.reset();
+  
+  ESP_LOGD(TAG, "Frame consumer #%u: %s", id, name);
+  return id;
+}
+
+FrameLease MipiDsiCam::acquire(uint8_t consumer_id) {
+  if (consumer_id >= this->consumer_count_) {
+    return FrameLease();
+  }
+  return this->acquire(consumer_id, this->consumers_[consumer_id].cursor.load(std::memory_order_relaxed));
+}
+
+FrameLease MipiDsiCam::acquire(uint8_t consumer_id, uint32_t last_seq) {
+  if (!this->streaming_ || consumer_id >= this->consumer_count_) {
+    return FrameLease();
+  }
+  
+  // ✅ Épingler la dernière frame complète : le CSI ne pourra plus écrire dans ce slot
+  FrameSlot *slot = this->frame_ring_.pin_latest(last_seq);
+  if (slot == nullptr) {
+    return FrameLease();
+  }
+  
+  if (this->inplace_white_balance_) {
+    this->apply_white_balance_in_place_(slot);
+  }
+  
+  const int64_t now = esp_timer_get_time();
+  FrameConsumer &consumer = this->consumers_[consumer_id];
+  consumer.capture_to_acquire.record(now - slot->meta.capture_us);
+  uint32_t sequence = slot->meta.sequence;
+  if (last_seq != 0 && sequence - last_seq > 1) {
+    consumer.drops.fetch_add(sequence - last_seq - 1, std::memory_order_relaxed);
+  }
+  consumer.cursor.store(sequence, std::memory_order_relaxed);
+  consumer.frames.fetch_add(1, std::memory_order_relaxed);
+  
+  ESP_LOGV(TAG, "Frame acquired by %s: seq=%u slot=%u (was: %u)",
+           consumer.name, sequence, slot->index, last_seq);
+  
+  return FrameLease(this, slot, consumer_id, now);
+}
+
+void MipiDsiCam::apply_white_balance_in_place_(FrameSlot *slot) {
+  if (slot->meta.pixel_format != static_cast<uint8_t>(PixelFormat::PIXEL_FORMAT_RGB565)) {
+    return;
+  }
+  
+  // Le premier consommateur corrige le slot (épinglé : le DMA n'y écrit plus), les autres attendent
+  uint8_t expected = FrameSlot::WB_RAW;
+  if (slot->wb_state.compare_exchange_strong(expected, FrameSlot::WB_APPLYING, std::memory_order_acquire)) {
+    // LUT neutre : gains déjà appliqués par la CCM de l'ISP (métadonnées posées par l'ISR)
+    const WhiteBalanceLut::Lease wb = this->wb_lut_.acquire();
+    if (!wb.is_identity()) {
+      this->apply_wb_lut_(wb, slot->buffer, slot->buffer, slot->valid_size);
+      slot->meta.wb_red_gain = wb.get_red_gain();
+      slot->meta.wb_green_gain = wb.get_green_gain();
+      slot->meta.wb_blue_gain = wb.get_blue_gain();
+    }
+    // seq_cst des deux côtés : un lecteur inscrit après ce balayage voit forcément WB_APPLIED
+    slot->wb_state.store(FrameSlot::WB_APPLIED, std::memory_order_seq_cst);
+    for (auto &waiter : this->wb_waiters_) {
+      TaskHandle_t task = waiter.load(std::memory_order_seq_cst);
+      if (task != nullptr) {
+        xTaskNotifyGiveIndexed(task, CAMERA_NOTIFY_INDEX);
+      }
+    }
+    return;
+  }
+  
+  // Sommeil jusqu'à la notification du correcteur, borné : s'il ne termine pas, la frame est
+  // rendue telle quelle et le bail le signale (FrameLease::white_balanced() reste faux)
+  auto applied = [slot]() { return slot->wb_state.load(std::memory_order_seq_cst) == FrameSlot::WB_APPLIED; };
+  if (applied()) {
+    return;
+  }
+  TaskHandle_t self = xTaskGetCurrentTaskHandle();
+  std::atomic<TaskHandle_t> *registration = nullptr;
+  for (auto &waiter : this->wb_waiters_) {
+    TaskHandle_t none = nullptr;
+    if (waiter.compare_exchange_strong(none, self, std::memory_order_seq_cst)) {
+      registration = &waiter;
+      break;
+    }
+  }
+  if (registration == nullptr) {
+    ESP_LOGW(TAG, "Too many tasks waiting for white balance (max %u)", MAX_FRAME_WAITERS);
+    return;
+  }
+  
+  // Re-tester après inscription : une correction terminée entre-temps ne doit pas être attendue
+  const TickType_t start = xTaskGetTickCount();
+  const TickType_t timeout = pdMS_TO_TICKS(WB_APPLY_TIMEOUT_MS);
+  while (!applied()) {
+    const TickType_t elapsed = xTaskGetTickCount() - start;
+    if (elapsed >= timeout) {
+      ESP_LOGW(TAG, "Frame %u: in-place white balance still running after %u ms", slot->meta.sequence,
+               WB_APPLY_TIMEOUT_MS);
+      break;
+    }
+    ulTaskNotifyTakeIndexed(CAMERA_NOTIFY_INDEX, pdTRUE, timeout - elapsed);
+  }
+  registration->store(nullptr, std::memory_order_release);
+}
+
+void MipiDsiCam::apply_wb_lut_(const WhiteBalanceLut::Lease &wb, const uint8_t *src, uint8_t *dst, size_t size) {
+  // Compteur 32 bits du cœur courant : une passe tient largement dans un tour (~12 s à 360 MHz).
+  // Une préemption pendant la passe y ajoute les cycles de l'autre tâche (visible surtout sur le max)
+  const uint32_t start = esp_cpu_get_cycle_count();
+  wb.apply(src, dst, size);
+  const uint32_t cycles = esp_cpu_get_cycle_count() - start;
+  
+  this->wb_apply_frames_.fetch_add(1, std::memory_order_relaxed);
+  this->wb_apply_cycles_.fetch_add(cycles, std::memory_order_relaxed);
+  this->wb_apply_pixels_.store(size / 2, std::memory_order_relaxed);
+  uint32_t max = this->wb_apply_max_cycles_.load(std::memory_order_relaxed);
+  while (cycles > max && !this->wb_apply_max_cycles_.compare_exchange_weak(max, cycles, std::memory_order_relaxed)) {
+  }
+}
+
+void MipiDsiCam::set_capture_buffer_source(const CaptureBufferSource *source) {
+  this->capture_source_.store(source, std::memory_order_release);
+  if (source != nullptr) {
+    return;
+  }
+  
+  // Les buffers prêtés vont être libérés : plus aucun slot ne doit les publier
+  const uint32_t start = millis();
+  while (!this->frame_ring_.release_external()) {
+    if (millis() - start >= EXTERNAL_RELEASE_TIMEOUT_MS) {
+      ESP_LOGW(TAG, "Borrowed capture buffer still pinned after %u ms", EXTERNAL_RELEASE_TIMEOUT_MS);
+      break;
+    }
+    delay(1);
+  }
+}
+
+void MipiDsiCam::complete_external_frame(uint8_t consumer_id, uint8_t *buffer, size_t size, FrameMetadata &meta) {
+  if (this->inplace_white_balance_) {
+    FrameSlot *slot = this->frame_ring_.pin_buffer(buffer, meta.sequence);
+    if (slot != nullptr) {
+      // Encore publié : correction partagée avec les autres lecteurs du slot
+      this->apply_white_balance_in_place_(slot);
+      meta = slot->meta;
+      this->frame_ring_.unpin(slot);
+    } else if (meta.pixel_format == static_cast<uint8_t>(PixelFormat::PIXEL_FORMAT_RGB565)) {
+      // Slot recyclé avant toute correction en place (FrameRing::try_recycle_) : buffer jamais corrigé
+      const WhiteBalanceLut::Lease wb = this->wb_lut_.acquire();
+      if (!wb.is_identity()) {
+        this->apply_wb_lut_(wb, buffer, buffer, size);
+        meta.wb_red_gain = wb.get_red_gain();
+        meta.wb_green_gain = wb.get_green_gain();
+        meta.wb_blue_gain = wb.get_blue_gain();
+      }
+    }
+  }
+  
+  if (consumer_id >= this->consumer_count_) {
+    return;
   }
+  FrameConsumer &consumer = this->consumers_[consumer_id];
+  consumer.capture_to_acquire.record(esp_timer_get_time() - meta.capture_us);
+  const uint32_t cursor = consumer.cursor.load(std::memory_order_relaxed);
+  if (cursor != 0 && meta.sequence - cursor > 1) {
+    consumer.drops.fetch_add(meta.sequence - cursor - 1, std::memory_order_relaxed);
+  }
+  consumer.cursor.store(meta.sequence, std::memory_order_relaxed);
+  consumer.frames.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool MipiDsiCam::wait_frame(uint32_t last_seq, uint32_t timeout_ms) {
+  auto is_new = [this, last_seq]() {
+    return static_cast<int32_t>(this->frame_ring_.get_latest_sequence() - last_seq) > 0;
+  };
   
-  // Attendre qu'une frame soit prête ET que ce soit une nouvelle
-  if (!this->frame_ready_) {
+  if (is_new()) {
+    return true;
+  }
+  if (!this->streaming_ || timeout_ms == 0) {
     return false;
   }
   
-  // ✅ VÉRIFICATION CRITIQUE : nouvelle séquence ?
-  if (this->frame_sequence_ <= last_served_sequence) {
-    ESP_LOGV(TAG, "Same sequence: current=%u, last_served=%u", 
-             this->frame_sequence_, last_served_sequence);
+  // S'inscrire comme tâche en attente
+  TaskHandle_t self = xTaskGetCurrentTaskHandle();
+  std::atomic<TaskHandle_t> *registration = nullptr;
+  for (auto &waiter : this->frame_waiters_) {
+    TaskHandle_t expected = nullptr;
+    if (waiter.compare_exchange_strong(expected, self, std::memory_order_acq_rel)) {
+      registration = &waiter;
+      break;
+    }
+  }
+  if (registration == nullptr) {
+    ESP_LOGW(TAG, "Too many tasks waiting for frames (max %u)", MAX_FRAME_WAITERS);
     return false;
   }
   
+  const TickType_t start = xTaskGetTickCount();
+  const TickType_t timeout = timeout_ms == UINT32_MAX ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms);
+  bool ready = false;
+  
+  // Re-tester après inscription : une frame terminée entre-temps ne doit pas être perdue
+  while (!(ready = is_new())) {
+    TickType_t elapsed = xTaskGetTickCount() - start;
+    if (elapsed >= timeout) {
+      break;
+    }
+    ulTaskNotifyTakeIndexed(CAMERA_NOTIFY_INDEX, pdTRUE, timeout - elapsed);
+  }
+  
+  registration->store(nullptr, std::memory_order_release);
+  return ready;
+}
+
+FrameLease MipiDsiCam::wait_and_acquire(uint8_t consumer_id, uint32_t timeout_ms) {
+  if (consumer_id >= this->consumer_count_) {
+    return FrameLease();
+  }
+  
+  const uint32_t cursor = this->consumers_[consumer_id].cursor.load(std::memory_order_relaxed);
+  if (!this->wait_frame(cursor, timeout_ms)) {
+    return FrameLease();
+  }
+  return this->acquire(consumer_id, cursor);
+}
+
+void MipiDsiCam::release_lease_(FrameSlot *slot, uint8_t consumer_id, int64_t acquired_us) {
+  if (consumer_id < this->consumer_count_) {
+    this->consumers_[consumer_id].hold_time.record(esp_timer_get_time() - acquired_us);
+  }
+  this->frame_ring_.unpin(slot);
+}
+
+uint8_t MipiDsiCam::find_consumer(const std::string &name) const {
+  for (uint8_t i = 0; i < this->consumer_count_; i++) {
+    if (name == this->consumers_[i].name) {
+      return i;
+    }
+  }
+  return INVALID_CONSUMER_ID;
+}
+
+void MipiDsiCam::dump_telemetry() {
+  ESP_LOGI(TAG, "📊 Frame telemetry: seq=%u overruns=%u skips=%u",
+           this->frame_sequence_, this->frame_ring_.get_overrun_count(),
+           this->frame_ring_.get_skip_count());
+  
+  const uint32_t wb_frames = this->wb_apply_frames_.load(std::memory_order_relaxed);
+  if (wb_frames > 0) {
+    const uint32_t mean = static_cast<uint32_t>(this->wb_apply_cycles_.load(std::memory_order_relaxed) / wb_frames);
+    const uint32_t pixels = this->wb_apply_pixels_.load(std::memory_order_relaxed);
+    ESP_LOGI(TAG, "  WB LUT (%s): passes=%u mean=%u cycles/frame (%.2f cycles/px) max=%u",
+             WhiteBalanceLut::get_kernel_name(), wb_frames, mean, pixels > 0 ? (float) mean / pixels : 0.0f,
+             this->wb_apply_max_cycles_.load(std::memory_order_relaxed));
+  }
+  
+  for (uint8_t i = 0; i < this->consumer_count_; i++) {
+    const FrameConsumer &consumer = this->consumers_[i];
+    const LatencySnapshot latency = consumer.capture_to_acquire.snapshot();
+    const LatencySnapshot hold = consumer.hold_time.snapshot();
+    
+    ESP_LOGI(TAG, "  [%u] %s: frames=%u drops=%u", i, consumer.name,
+             consumer.frames.load(std::memory_order_relaxed), consumer.drops.load(std::memory_order_relaxed));
+    ESP_LOGI(TAG, "      capture->acquire: mean=%.2fms p50=%.2fms p95=%.2fms max=%.2fms",
+             latency.mean_ms(), latency.percentile_ms(50), latency.percentile_ms(95),
+             latency.max_us / 1000.0f);
+    ESP_LOGI(TAG, "      acquire->release: mean=%.2fms p50=%.2fms p95=%.2fms max=%.2fms",
+             hold.mean_ms(), hold.percentile_ms(50), hold.percentile_ms(95), hold.max_us / 1000.0f);
+    
+    char line[LATENCY_BUCKET_COUNT * 12 + 1];
+    size_t pos = 0;
+    for (uint8_t b = 0; b < LATENCY_BUCKET_COUNT; b++) {
+      pos += snprintf(line + pos, sizeof(line) - pos, " %u", latency.counts[b]);
+    }
+    ESP_LOGD(TAG, "      capture->acquire buckets (128us, x2 each):%s", line);
+  }
+}
+
+const FrameMetadata FrameLease::EMPTY_METADATA{};
+
+void FrameLease::release() {
+  if (this->slot_ != nullptr && this->camera_ != nullptr) {
+    this->camera_->release_lease_(this->slot_, this->consumer_id_, this->acquired_us_);
+  }
+  this->camera_ = nullptr;
+  this->slot_ = nullptr;
+}
+
+bool MipiDsiCam::acquire_frame(uint32_t last_served_sequence) {
   // Vérifier qu'aucune frame n'est déjà verrouillée
-  if (this->frame_locked_) {
+  if (this->legacy_lease_) {
     ESP_LOGW(TAG, "Frame already locked (seq=%u)", this->locked_sequence_);
     return false;
   }
   
-  // Verrouiller la frame actuelle
-  this->frame_ready_ = false;
-  this->frame_locked_ = true;
-  this->locked_sequence_ = this->frame_sequence_;
-  
-  // Pointer vers le dernier buffer écrit
-  uint8_t last_buffer = (this->buffer_index_ + 1) % 2;
-  this->current_frame_buffer_ = this->frame_buffers_[last_buffer];
+  if (this->legacy_consumer_id_ == INVALID_CONSUMER_ID) {
+    this->legacy_consumer_id_ = this->register_consumer("legacy");
+  }
   
-  ESP_LOGV(TAG, "Frame acquired: seq=%u (was: %u)", 
-           this->locked_sequence_, last_served_sequence);
+  FrameLease lease = this->acquire(this->legacy_consumer_id_, last_served_sequence);
+  if (!lease) {
+    return false;
+  }
   
+  this->frame_ready_ = false;
+  this->locked_sequence_ = lease.sequence();
+  this->current_frame_buffer_ = const_cast<uint8_t *>(lease.data());
+  this->legacy_lease_ = std::move(lease);
   return true;
 }
 
 void MipiDsiCam::release_frame() {
-  if (this->frame_locked_) {
-    this->frame_locked_ = false;
+  if (this->legacy_lease_) {
+    this->legacy_lease_.release();
     ESP_LOGV(TAG, "Frame released: seq=%u", this->locked_sequence_);
   }
 }
@@ -481,6 +1085,10 @@ size_t MipiDsiCam::copy_frame_rgb565(uint8_t *dest, size_t max_size, bool apply_
   if (dest == nullptr || this->current_frame_buffer_ == nullptr) {
     return 0;
   }
+  if (this->pixel_format_ != PixelFormat::PIXEL_FORMAT_RGB565) {
+    ESP_LOGW(TAG, "copy_frame_rgb565: camera outputs %s", pixel_format_to_string(this->pixel_format_));
+    return 0;
+  }
 
   size_t copy_size = std::min(max_size, this->frame_buffer_size_);
   copy_size &= ~static_cast<size_t>(1);
@@ -490,117 +1098,91 @@ size_t MipiDsiCam::copy_frame_rgb565(uint8_t *dest, size_t max_size, bool apply_
 
   const uint8_t *src = this->current_frame_buffer_;
 
-  if (!apply_white_balance) {
-    std::memcpy(dest, src, copy_size);
-    return copy_size;
-  }
-
-  const uint16_t red_gain = this->wb_red_gain_fixed_;
-  const uint16_t green_gain = this->wb_green_gain_fixed_;
-  const uint16_t blue_gain = this->wb_blue_gain_fixed_;
-
-  if (red_gain == 256 && green_gain == 256 && blue_gain == 256) {
+  // Slot déjà corrigé en place : ne pas appliquer les gains deux fois
+  FrameSlot *slot = this->frame_ring_.find_by_buffer(src);
+  const bool already_balanced =
+    slot != nullptr && slot->wb_state.load(std::memory_order_acquire) == FrameSlot::WB_APPLIED;
+  
+  const WhiteBalanceLut::Lease wb = this->wb_lut_.acquire();
+  if (!apply_white_balance || already_balanced || wb.is_identity()) {
     std::memcpy(dest, src, copy_size);
     return copy_size;
   }
 
-  auto apply_gain = [](uint16_t value, uint16_t gain) -> uint16_t {
-    uint32_t scaled = (static_cast<uint32_t>(value) * gain + 128) >> 8;
-    if (scaled > 255) {
-      scaled = 255;
-    }
-    return static_cast<uint16_t>(scaled);
-  };
-
-  for (size_t offset = 0; offset < copy_size; offset += 2) {
-    uint16_t pixel = static_cast<uint16_t>(src[offset]) |
-                     (static_cast<uint16_t>(src[offset + 1]) << 8);
-
-    uint8_t r5 = (pixel >> 11) & 0x1F;
-    uint8_t g6 = (pixel >> 5) & 0x3F;
-    uint8_t b5 = pixel & 0x1F;
-
-    uint16_t r8 = (static_cast<uint16_t>(r5) << 3) | (r5 >> 2);
-    uint16_t g8 = (static_cast<uint16_t>(g6) << 2) | (g6 >> 4);
-    uint16_t b8 = (static_cast<uint16_t>(b5) << 3) | (b5 >> 2);
-
-    r8 = apply_gain(r8, red_gain);
-    g8 = apply_gain(g8, green_gain);
-    b8 = apply_gain(b8, blue_gain);
-
-    uint16_t corrected = (static_cast<uint16_t>(r8 >> 3) << 11) |
-                         (static_cast<uint16_t>(g8 >> 2) << 5) |
-                         static_cast<uint16_t>(b8 >> 3);
-
-    dest[offset] = static_cast<uint8_t>(corrected & 0xFF);
-    dest[offset + 1] = static_cast<uint8_t>(corrected >> 8);
-  }
-
+  // Noyau LUT (SIMD sur host, par mots sur l'ESP32-P4), bit-exact avec l'ancienne boucle pixel par pixel
+  this->apply_wb_lut_(wb, src, dest, copy_size);
   return copy_size;
 }
 
 void MipiDsiCam::set_auto_white_balance(bool enable) {
-  this->auto_white_balance_enabled_ = enable;
-  this->last_awb_update_ = millis();
+  this->three_a_params_.modify([enable](ThreeAParams &p) { p.awb_enabled = enable; });
   ESP_LOGI(TAG, "Software auto white balance: %s", enable ? "ENABLED" : "DISABLED");
 }
 
-void MipiDsiCam::update_auto_white_balance_() {
-  if (!this->auto_white_balance_enabled_ || this->current_frame_buffer_ == nullptr) {
-    return;
+bool MipiDsiCam::update_auto_white_balance_(const ThreeAParams &params, ThreeAState &state) {
+  if (!params.awb_enabled) {
+    return false;
   }
 
   uint32_t now = millis();
   if (now - this->last_awb_update_ < 400) {
-    return;
+    return false;
   }
   this->last_awb_update_ = now;
 
-  if (this->width_ == 0 || this->height_ == 0) {
-    return;
+  const FrameStats &stats = this->frame_stats_;
+  if (!stats.valid) {
+    return false;
   }
 
-  const size_t step_x = std::max<uint16_t>(4, this->width_ / 16);
-  const size_t step_y = std::max<uint16_t>(4, this->height_ / 16);
-  const uint8_t *buffer = this->current_frame_buffer_;
-
-  uint32_t sum_r = 0;
-  uint32_t sum_g = 0;
-  uint32_t sum_b = 0;
-  uint32_t samples = 0;
-
-  for (size_t y = step_y; y < this->height_ - step_y; y += step_y) {
-    for (size_t x = step_x; x < this->width_ - step_x; x += step_x) {
-      size_t index = (y * this->width_ + x) * 2;
-      if (index + 1 >= this->frame_buffer_size_) {
-        continue;
+  float avg_r;
+  float avg_g;
+  float avg_b;
+  if (stats.white_patches > 0) {
+    // White patches de l'ISP
+    avg_r = stats.mean_r;
+    avg_g = stats.mean_g;
+    avg_b = stats.mean_b;
+  } else {
+    // Gray world sur les zones de la passe de statistiques, zones saturées exclues
+    uint32_t sum_r = 0;
+    uint32_t sum_g = 0;
+    uint32_t sum_b = 0;
+    uint32_t samples = 0;
+
+    for (uint8_t y = 0; y < stats.zones_y; y++) {
+      for (uint8_t x = 0; x < stats.zones_x; x++) {
+        const StatsZone &zone = stats.zone(x, y);
+        if (zone.clipped > 0 || zone.luma <= STATS_CLIP_LOW) {
+          continue;
+        }
+        sum_r += zone.r;
+        sum_g += zone.g;
+        sum_b += zone.b;
+        samples++;
       }
+    }
 
-      uint16_t pixel = static_cast<uint16_t>(buffer[index]) |
-                       (static_cast<uint16_t>(buffer[index + 1]) << 8);
-
-      uint8_t r5 = (pixel >> 11) & 0x1F;
-      uint8_t g6 = (pixel >> 5) & 0x3F;
-      uint8_t b5 = pixel & 0x1F;
-
-      sum_r += (static_cast<uint16_t>(r5) << 3) | (r5 >> 2);
-      sum_g += (static_cast<uint16_t>(g6) << 2) | (g6 >> 4);
-      sum_b += (static_cast<uint16_t>(b5) << 3) | (b5 >> 2);
-      samples++;
+    if (samples == 0) {
+      return false;
     }
-  }
 
-  if (samples == 0) {
-    return;
+    avg_r = static_cast<float>(sum_r) / static_cast<float>(samples);
+    avg_g = static_cast<float>(sum_g) / static_cast<float>(samples);
+    avg_b = static_cast<float>(sum_b) / static_cast<float>(samples);
+  }
+  
+  // Mesures prises avant les gains (LUT CPU hors place, RAW) : ramenées dans le domaine corrigé,
+  // sinon current * reference / avg ne converge pas et les gains partent en butée
+  if (!stats.wb_after_gains) {
+    avg_r *= params.wb_red;
+    avg_g *= params.wb_green;
+    avg_b *= params.wb_blue;
   }
-
-  float avg_r = static_cast<float>(sum_r) / static_cast<float>(samples);
-  float avg_g = static_cast<float>(sum_g) / static_cast<float>(samples);
-  float avg_b = static_cast<float>(sum_b) / static_cast<float>(samples);
 
   float target = (avg_r + avg_g + avg_b) / 3.0f;
   if (target < 1.0f) {
-    return;
+    return false;
   }
 
   auto adjust_gain = [](float current, float channel_avg, float reference) -> float {
@@ -613,117 +1195,260 @@ void MipiDsiCam::update_auto_white_balance_() {
     return current * (1.0f - smoothing) + desired * smoothing;
   };
 
-  float new_red = adjust_gain(this->wb_red_gain_, avg_r, target);
-  float new_green = adjust_gain(this->wb_green_gain_, avg_g, target);
-  float new_blue = adjust_gain(this->wb_blue_gain_, avg_b, target);
+  float new_red = adjust_gain(params.wb_red, avg_r, target);
+  float new_green = adjust_gain(params.wb_green, avg_g, target);
+  float new_blue = adjust_gain(params.wb_blue, avg_b, target);
 
-  if (std::fabs(new_red - this->wb_red_gain_) < 0.01f &&
-      std::fabs(new_green - this->wb_green_gain_) < 0.01f &&
-      std::fabs(new_blue - this->wb_blue_gain_) < 0.01f) {
-    return;
+  if (std::fabs(new_red - params.wb_red) < 0.01f &&
+      std::fabs(new_green - params.wb_green) < 0.01f &&
+      std::fabs(new_blue - params.wb_blue) < 0.01f) {
+    return false;
   }
 
-  this->set_white_balance_gains(new_red, new_green, new_blue, true);
+  // Publié dans l'état 3A : la LUT est reconstruite par la main loop (set_white_balance_gains)
+  state.wb_red = new_red;
+  state.wb_green = new_green;
+  state.wb_blue = new_blue;
+  state.awb_generation++;
+  return true;
 }
-void MipiDsiCam::update_auto_exposure_() {
-  if (!this->auto_exposure_enabled_ || !this->sensor_driver_) {
-    return;
+bool MipiDsiCam::run_3a_cycle_(uint32_t timeout_ms) {
+  const bool new_frame = this->wait_frame(this->three_a_sequence_, timeout_ms);
+  
+  // Demandes manuelles appliquées même sans frame (flux arrêté)
+  const ThreeAParams params = this->three_a_params_.load();
+  this->apply_manual_settings_(params);
+  
+  if (!new_frame) {
+    this->flush_sensor_commands_();
+    return false;
   }
+  this->three_a_sequence_ = this->frame_ring_.get_latest_sequence();
   
-  uint32_t now = millis();
-  if (now - this->last_ae_update_ < 100) {
-    return;
+  // Statistiques de la nouvelle frame, puis AE/AWB sur ces mêmes mesures
+  if (!this->update_frame_stats_()) {
+    this->flush_sensor_commands_();
+    return false;
   }
-  this->last_ae_update_ = now;
   
-  uint32_t avg_brightness = this->calculate_brightness_();
+  ThreeAState state = this->three_a_state_.load();
+  this->update_auto_exposure_(params);
+  this->update_auto_white_balance_(params, state);
   
-  int32_t brightness_error = (int32_t)this->ae_target_brightness_ - (int32_t)avg_brightness;
+  // Un seul flush par frame : les décisions AE et manuelles de ce cycle partent ensemble
+  this->flush_sensor_commands_();
   
-  if (abs(brightness_error) > 10) {
-    
-    if (brightness_error > 0) {
-      // Image trop sombre
-      if (this->current_exposure_ < 0xF00) {
-        this->current_exposure_ += 0x40;
-      } else if (this->current_gain_index_ < 120) {
-        this->current_gain_index_ += 2;
-      }
-    } else {
-      // Image trop lumineuse
-      if (this->current_exposure_ > 0x200) {
-        this->current_exposure_ -= 0x40;
-      } else if (this->current_gain_index_ > 0) {
-        this->current_gain_index_ -= 2;
-      }
+  state.sequence = this->frame_stats_.sequence;
+  state.exposure = this->current_exposure_;
+  state.gain_index = this->current_gain_index_;
+  state.luma = this->frame_stats_.center_weighted_luma();
+  state.ae_converged = this->ae_controller_.is_converged();
+  state.ae_convergence_frames = this->ae_controller_.get_last_convergence_frames();
+  state.ae_convergence_ms = this->ae_controller_.get_last_convergence_ms();
+  this->three_a_state_.store(state);
+  return true;
+}
+
+void MipiDsiCam::apply_manual_settings_(const ThreeAParams &params) {
+  const bool exposure_changed = params.exposure_generation != this->applied_exposure_generation_;
+  const bool gain_changed = params.gain_generation != this->applied_gain_generation_;
+  if (!exposure_changed && !gain_changed) {
+    return;
+  }
+  this->applied_exposure_generation_ = params.exposure_generation;
+  this->applied_gain_generation_ = params.gain_generation;
+  
+  if (!this->sensor_driver_) {
+    return;
+  }
+  this->stage_sensor_settings_(exposure_changed ? params.manual_exposure : this->current_exposure_,
+                               gain_changed ? params.manual_gain_index : this->current_gain_index_);
+  this->ae_controller_.reset(this->current_exposure_, this->current_gain_index_);
+}
+
+bool MipiDsiCam::queue_sensor_settings_(bool has_exposure, uint16_t exposure, bool has_gain, uint8_t gain_index) {
+  if (!this->three_a_task_.is_running()) {
+    return false;
+  }
+  this->three_a_params_.modify([=](ThreeAParams &p) {
+    if (has_exposure) {
+      p.manual_exposure = exposure;
+      p.exposure_generation++;
     }
-    
-    this->sensor_driver_->set_exposure(this->current_exposure_);
-    this->sensor_driver_->set_gain(this->current_gain_index_);
-    
-    ESP_LOGV(TAG, "🔆 AE: brightness=%u target=%u → exp=0x%04X gain=%u",
-             avg_brightness, this->ae_target_brightness_,
+    if (has_gain) {
+      p.manual_gain_index = gain_index;
+      p.gain_generation++;
+    }
+  });
+  return true;
+}
+
+void MipiDsiCam::update_auto_exposure_(const ThreeAParams &params) {
+  if (!params.ae_enabled || !this->sensor_driver_) {
+    return;
+  }
+  
+  this->ae_controller_.set_target(params.ae_target);
+  
+  // Métadonnées de la frame mesurée : le régulateur ignore les frames antérieures à sa dernière écriture
+  const FrameMetadata &meta = this->stats_metadata_;
+  bool was_converged = this->ae_controller_.is_converged();
+  AutoExposureController::Decision decision;
+  if (this->ae_controller_.process(this->frame_stats_, meta.exposure, meta.gain_index, meta.capture_us, decision)) {
+    this->stage_sensor_settings_(decision.exposure, decision.gain_index);
+    ESP_LOGV(TAG, "🔆 AE: luma=%u target=%u → exp=0x%04X gain=%u",
+             this->frame_stats_.center_weighted_luma(), this->ae_controller_.get_target(),
              this->current_exposure_, this->current_gain_index_);
+  } else if (!was_converged && this->ae_controller_.is_converged()) {
+    ESP_LOGD(TAG, "🔆 AE converged in %u frames (%u ms): exp=0x%04X gain=%u",
+             this->ae_controller_.get_last_convergence_frames(), this->ae_controller_.get_last_convergence_ms(),
+             this->current_exposure_, this->current_gain_index_);
+  }
+}
+
+void MipiDsiCam::stage_sensor_settings_(uint16_t exposure, uint8_t gain_index) {
+  // Seule la dernière demande de la frame survit ; le bus n'est touché qu'au flush
+  if (exposure != this->current_exposure_) {
+    this->sensor_queue_.queue_exposure(exposure);
+    this->current_exposure_ = exposure;
+  }
+  if (gain_index != this->current_gain_index_) {
+    this->sensor_queue_.queue_gain(gain_index);
+    this->current_gain_index_ = gain_index;
+  }
+}
+
+bool MipiDsiCam::flush_sensor_commands_() {
+  if (!this->sensor_queue_.has_pending()) {
+    return true;
+  }
+  if (this->sensor_queue_.flush() != ESP_OK) {
+    return false;
   }
+  
+  // Publié pour l'ISR de début de frame, qui en déduit les réglages réels de chaque frame
+  this->written_settings_.store((this->sensor_queue_.get_gain_index() << 24) | this->sensor_queue_.get_exposure(),
+                                std::memory_order_relaxed);
+  return true;
+}
+
+bool MipiDsiCam::write_sensor_settings_(uint16_t exposure, uint8_t gain_index) {
+  this->stage_sensor_settings_(exposure, gain_index);
+  return this->flush_sensor_commands_();
 }
 
 uint32_t MipiDsiCam::calculate_brightness_() {
-  if (!this->current_frame_buffer_) {
+  if (!this->frame_stats_.valid) {
     return 128;
   }
+  return this->frame_stats_.center_weighted_luma();
+}
+
+bool MipiDsiCam::update_frame_stats_() {
+  if (this->stats_consumer_id_ == INVALID_CONSUMER_ID) {
+    return false;
+  }
   
-  uint32_t sum = 0;
-  uint32_t sample_count = 0;
-  
-  uint32_t center_offset = (this->height_ / 2) * this->width_ * 2 + (this->width_ / 2) * 2;
+  // Une seule passe par nouvelle séquence, partagée par AE/AWB
+  FrameLease lease = this->acquire(this->stats_consumer_id_);
+  if (!lease) {
+    return false;
+  }
   
-  for (int i = 0; i < 100; i++) {
-    uint32_t offset = center_offset + (i * 200);
-    if (offset + 1 < this->frame_buffer_size_) {
-      uint16_t pixel = (this->current_frame_buffer_[offset + 1] << 8) | 
-                       this->current_frame_buffer_[offset];
-      
-      uint8_t r = (pixel >> 11) & 0x1F;
-      uint8_t g = (pixel >> 5) & 0x3F;
-      uint8_t b = pixel & 0x1F;
-      
-      uint32_t brightness = (r * 8 * 299 + g * 4 * 587 + b * 8 * 114) / 1000;
-      
-      sum += brightness;
-      sample_count++;
+  // Statistiques ISP : aucun pixel relu, le bail ne sert qu'aux réglages capteur de la frame
+  if (this->isp_stats_ring_.is_active()) {
+    IspStatsRecord record;
+    if (this->isp_stats_ring_.pop_latest(record) && isp_stats_to_frame_stats(record, this->frame_stats_)) {
+      this->isp_stats_misses_ = 0;
+      this->frame_stats_.sequence = lease.sequence();
+      this->stats_metadata_ = lease.metadata();
+      return true;
+    }
+    // Mesure en retard : on attend ; passe CPU seulement si l'ISP ne publie plus
+    if (this->isp_stats_misses_ < ISP_STATS_MAX_MISSES) {
+      if (++this->isp_stats_misses_ == ISP_STATS_MAX_MISSES) {
+        ESP_LOGW(TAG, "No ISP statistics for %u frames - CPU statistics pass", ISP_STATS_MAX_MISSES);
+      }
+      return false;
     }
   }
   
-  return sample_count > 0 ? (sum / sample_count) : 128;
+  if (!this->stats_engine_.compute(lease.data(), lease.size(), this->width_, this->height_,
+                                   static_cast<PixelFormat>(lease.metadata().pixel_format), this->bayer_pattern_,
+                                   this->frame_stats_)) {
+    return false;
+  }
+  // Pixels déjà corrigés : en place par la LUT, ou par la CCM de l'ISP (LUT neutre, hors RAW)
+  this->frame_stats_.wb_after_gains =
+    lease.white_balanced() ||
+    (lease.metadata().pixel_format != static_cast<uint8_t>(PixelFormat::PIXEL_FORMAT_RAW8) &&
+     this->wb_lut_.is_identity());
+  this->frame_stats_.sequence = lease.sequence();
+  this->stats_metadata_ = lease.metadata();
+  return true;
 }
 
 void MipiDsiCam::loop() {
+  if (!this->boot_time_logged_ && this->get_boot_to_first_frame_ms() > 0) {
+    this->boot_time_logged_ = true;
+    ESP_LOGI(TAG, "⏱️ Boot to first frame: %u ms (sensor ready at %u ms)",
+             this->get_boot_to_first_frame_ms(), this->boot_sensor_ready_ms_);
+  }
+  
+  // Tables WB différées tant qu'un lecteur tenait la table de réserve
+  this->wb_lut_.publish_pending();
+  
   if (this->streaming_) {
-    // Mise à jour Auto Exposure
-    this->update_auto_exposure_();
+    // Sans tâche 3A (création impossible), AE/AWB restent sur la main loop
+    if (!this->three_a_task_.is_running()) {
+      this->run_3a_cycle_(0);
+    }
     
-    static uint32_t ready_count = 0;
-    static uint32_t not_ready_count = 0;
+    // Nouveaux gains AWB : LUT et métadonnées mises à jour ici, hors tâche 3A
+    const ThreeAState state = this->three_a_state_.load();
+    if (state.awb_generation != this->applied_awb_generation_) {
+      this->applied_awb_generation_ = state.awb_generation;
+      this->set_white_balance_gains(state.wb_red, state.wb_green, state.wb_blue, true);
+    }
+    
+    // Frontière de frame : contrôles et réglages ISP accumulés depuis la frame précédente, appliqués en une fois
+    if (this->frame_sequence_ != this->isp_applied_sequence_) {
+      this->isp_applied_sequence_ = this->frame_sequence_;
+      if (this->controls_pending_.exchange(false, std::memory_order_acquire)) {
+        this->apply_controls_();
+      }
+#ifndef USE_HOST
+      if (this->isp_pipeline_ != nullptr && this->isp_pipeline_->has_pending_update()) {
+        this->sync_isp_controls_();
+        this->isp_pipeline_->apply_pending();
+      }
+#endif
+    }
     
     if (this->frame_ready_) {
-      ready_count++;
+      this->loop_ready_count_++;
     } else {
-      not_ready_count++;
+      this->loop_not_ready_count_++;
     }
     
     uint32_t now = millis();
     if (now - this->last_frame_log_time_ >= 3000) {
       float sensor_fps = this->total_frames_received_ / 3.0f;
-      float ready_rate = (float)ready_count / (float)(ready_count + not_ready_count) * 100.0f;
+      float ready_rate = (float)this->loop_ready_count_ /
+                         (float)(this->loop_ready_count_ + this->loop_not_ready_count_) * 100.0f;
       
-      ESP_LOGI(TAG, "📸 FPS: %.1f | frame_ready: %.1f%% | exp:0x%04X gain:%u", 
-               sensor_fps, ready_rate, this->current_exposure_, this->current_gain_index_);
+      ESP_LOGI(TAG, "📸 FPS: %.1f | frame_ready: %.1f%% | exp:0x%04X gain:%u | overruns:%u skips:%u", 
+               sensor_fps, ready_rate, state.exposure, state.gain_index,
+               this->frame_ring_.get_overrun_count(), this->frame_ring_.get_skip_count());
       
       this->total_frames_received_ = 0;
       this->last_frame_log_time_ = now;
-      ready_count = 0;
-      not_ready_count = 0;
+      this->loop_ready_count_ = 0;
+      this->loop_not_ready_count_ = 0;
     }
+  } else if (this->controls_pending_.exchange(false, std::memory_order_acquire)) {
+    // Hors flux, aucune frame à protéger : le lot part tout de suite
+    this->apply_controls_();
   }
 }
 
@@ -736,9 +1461,13 @@ void MipiDsiCam::dump_config() {
     ESP_LOGCONFIG(TAG, "  Sensor: %s (driver not loaded)", this->sensor_type_.c_str());
   }
   ESP_LOGCONFIG(TAG, "  Resolution: %ux%u", this->width_, this->height_);
-  ESP_LOGCONFIG(TAG, "  Format: RGB565");
+  ESP_LOGCONFIG(TAG, "  Format: %s", pixel_format_to_string(this->pixel_format_));
   ESP_LOGCONFIG(TAG, "  Lanes: %u", this->lane_count_);
   ESP_LOGCONFIG(TAG, "  Bayer: %u", this->bayer_pattern_);
+  ESP_LOGCONFIG(TAG, "  Frame buffers: %u", this->frame_buffer_count_);
+  ESP_LOGCONFIG(TAG, "  In-place WB: %s", this->inplace_white_balance_ ? "YES" : "NO");
+  ESP_LOGCONFIG(TAG, "  Stats: %ux%u zones, stride %u", this->stats_engine_.get_zones_x(),
+                this->stats_engine_.get_zones_y(), this->stats_engine_.get_stride());
   
   if (this->has_external_clock()) {
     ESP_LOGCONFIG(TAG, "  External Clock: GPIO%d @ %u Hz", 
@@ -747,36 +1476,54 @@ void MipiDsiCam::dump_config() {
     ESP_LOGCONFIG(TAG, "  External Clock: None (using internal clock)");
   }
   
-  ESP_LOGCONFIG(TAG, "  Auto Exposure: %s", this->auto_exposure_enabled_ ? "ON" : "OFF");
-  ESP_LOGCONFIG(TAG, "  AE Target: %u", this->ae_target_brightness_);
+  const ThreeAParams params = this->three_a_params_.load();
+  ESP_LOGCONFIG(TAG, "  Auto Exposure: %s", params.ae_enabled ? "ON" : "OFF");
+  ESP_LOGCONFIG(TAG, "  AE Target: %u", params.ae_target);
+  if (this->three_a_task_.is_running()) {
+    ESP_LOGCONFIG(TAG, "  3A task: core %d, priority %u", this->three_a_task_core_, this->three_a_task_priority_);
+  } else {
+    ESP_LOGCONFIG(TAG, "  3A task: not running (main loop)");
+  }
   ESP_LOGCONFIG(TAG, "  Streaming: %s", this->streaming_ ? "YES" : "NO");
 }
 
 // Méthodes publiques pour contrôle
 void MipiDsiCam::set_auto_exposure(bool enabled) {
-  this->auto_exposure_enabled_ = enabled;
+  this->three_a_params_.modify([enabled](ThreeAParams &p) { p.ae_enabled = enabled; });
   ESP_LOGI(TAG, "Auto Exposure: %s", enabled ? "ENABLED" : "DISABLED");
 }
 
 void MipiDsiCam::set_ae_target_brightness(uint8_t target) {
-  this->ae_target_brightness_ = target;
+  this->three_a_params_.modify([target](ThreeAParams &p) { p.ae_target = target; });
   ESP_LOGI(TAG, "AE target brightness: %u", target);
 }
 
 void MipiDsiCam::set_manual_exposure(uint16_t exposure) {
-  this->current_exposure_ = exposure;
-  if (this->sensor_driver_) {
-    this->sensor_driver_->set_exposure(exposure);
-    ESP_LOGI(TAG, "Manual exposure: 0x%04X", exposure);
+  if (!this->sensor_driver_) {
+    this->current_exposure_ = exposure;
+    return;
   }
+  if (this->queue_sensor_settings_(true, exposure, false, 0)) {
+    ESP_LOGI(TAG, "Manual exposure: 0x%04X (next frame)", exposure);
+    return;
+  }
+  this->write_sensor_settings_(exposure, this->current_gain_index_);
+  this->ae_controller_.reset(this->current_exposure_, this->current_gain_index_);
+  ESP_LOGI(TAG, "Manual exposure: 0x%04X", exposure);
 }
 
 void MipiDsiCam::set_manual_gain(uint8_t gain_index) {
-  this->current_gain_index_ = gain_index;
-  if (this->sensor_driver_) {
-    this->sensor_driver_->set_gain(gain_index);
-    ESP_LOGI(TAG, "Manual gain: %u", gain_index);
+  if (!this->sensor_driver_) {
+    this->current_gain_index_ = gain_index;
+    return;
+  }
+  if (this->queue_sensor_settings_(false, 0, true, gain_index)) {
+    ESP_LOGI(TAG, "Manual gain: %u (next frame)", gain_index);
+    return;
   }
+  this->write_sensor_settings_(this->current_exposure_, gain_index);
+  this->ae_controller_.reset(this->current_exposure_, this->current_gain_index_);
+  ESP_LOGI(TAG, "Manual gain: %u", gain_index);
 }
 
 void MipiDsiCam::set_white_balance_gains(float red, float green, float blue, bool update_fixed) {
@@ -788,8 +1535,16 @@ void MipiDsiCam::set_white_balance_gains(float red, float green, float blue, boo
     this->wb_red_gain_fixed_ = static_cast<uint16_t>(red * 256.0f);
     this->wb_green_gain_fixed_ = static_cast<uint16_t>(green * 256.0f);
     this->wb_blue_gain_fixed_ = static_cast<uint16_t>(blue * 256.0f);
+    this->route_white_balance_();
   }
   
+  // Point de départ de l'AWB dans la tâche 3A
+  this->three_a_params_.modify([red, green, blue](ThreeAParams &p) {
+    p.wb_red = red;
+    p.wb_green = green;
+    p.wb_blue = blue;
+  });
+  
   // Pour les capteurs supportant la balance des blancs au niveau registre
   if (this->sensor_driver_ && (this->sensor_type_ == "sc202cs" || this->sensor_type_ == "sc2336")) {
     ESP_LOGI(TAG, "WB gains: R=%.2f G=%.2f B=%.2f (logiciel uniquement)", red, green, blue);
@@ -798,6 +1553,167 @@ void MipiDsiCam::set_white_balance_gains(float red, float green, float blue, boo
   }
 }
 
+void MipiDsiCam::submit_controls(const ControlBatch &batch) {
+  if (batch.fields == 0) {
+    return;
+  }
+  this->modify_controls_([&batch](ControlBatch &c) { c.merge(batch); });
+  this->controls_pending_.store(true, std::memory_order_release);
+}
+
+ControlBatch MipiDsiCam::get_controls() const {
+  ControlBatch controls = this->controls_.load();
+  const uint32_t pending = controls.fields;
+  
+  // Hors lot en attente : valeurs en vigueur, y compris celles réglées hors V4L2 (actions, AE, AWB)
+  const ThreeAParams params = this->three_a_params_.load();
+  const ThreeAState state = this->three_a_state_.load();
+  if (!(pending & ControlBatch::FIELD_AE)) {
+    controls.ae_enabled = params.ae_enabled;
+  }
+  if (!(pending & ControlBatch::FIELD_EXPOSURE)) {
+    controls.exposure = state.sequence != 0 ? state.exposure : this->current_exposure_;
+  }
+  if (!(pending & ControlBatch::FIELD_GAIN)) {
+    controls.gain_index = state.sequence != 0 ? state.gain_index : this->current_gain_index_;
+  }
+  if (!(pending & ControlBatch::FIELD_AWB)) {
+    controls.awb_enabled = params.awb_enabled;
+  }
+  if (!(pending & ControlBatch::FIELD_WB_GAINS)) {
+    controls.wb_red = params.wb_red;
+    controls.wb_blue = params.wb_blue;
+  }
+  return controls;
+}
+
+void MipiDsiCam::apply_controls_() {
+  ControlBatch batch;
+  this->modify_controls_([&batch](ControlBatch &c) {
+    batch = c;
+    c.fields = 0;
+  });
+  const uint32_t fields = batch.fields;
+  if (fields == 0) {
+    return;
+  }
+  
+#ifndef USE_HOST
+  // Une seule transaction : tous les blocs du lot arrivent dans l'ISP sur la même frame
+  MipiDsiCamISPPipeline *isp = this->isp_pipeline_;
+  if (isp != nullptr) {
+    isp->begin_update();
+    if (fields & ControlBatch::FIELD_BF) {
+      isp->enable_bayer_filter(batch.isp.bf.enabled);
+      isp->set_denoising_level(batch.isp.bf.denoising_level);
+      isp->set_bayer_filter_kernel(batch.isp.bf.kernel);
+    }
+    if (fields & ControlBatch::FIELD_DEMOSAIC) {
+      isp->enable_demosaic(batch.isp.demosaic.enabled);
+      isp->set_demosaic_gradient_ratio(batch.isp.demosaic.gradient_ratio);
+    }
+    if (fields & ControlBatch::FIELD_CCM) {
+      isp->enable_ccm(batch.isp.ccm.enabled);
+      isp->set_ccm_matrix(batch.isp.ccm.matrix);
+    }
+    if (fields & ControlBatch::FIELD_GAMMA) {
+      isp->enable_gamma(batch.isp.gamma.enabled);
+      isp->set_gamma_curve(batch.isp.gamma.gamma);
+    }
+    if (fields & ControlBatch::FIELD_SHARPEN) {
+      const IspSharpenParams &sharpen = batch.isp.sharpen;
+      isp->enable_sharpen(sharpen.enabled);
+      isp->set_sharpen_params(sharpen.h_thresh, sharpen.l_thresh, sharpen.h_coeff, sharpen.m_coeff);
+      isp->set_sharpen_kernel(sharpen.kernel);
+    }
+    if (fields & ControlBatch::FIELD_COLOR) {
+      isp->set_brightness(batch.isp.color.brightness);
+      isp->set_contrast(batch.isp.color.contrast);
+      isp->set_saturation(batch.isp.color.saturation);
+      isp->set_hue(batch.isp.color.hue);
+    }
+  }
+#endif
+  
+  // Dans la même transaction : la CCM porte les gains quand l'ISP gère la balance des blancs
+  if (fields & ControlBatch::FIELD_AWB) {
+    this->set_auto_white_balance(batch.awb_enabled);
+  }
+  if (fields & ControlBatch::FIELD_WB_GAINS) {
+    this->set_white_balance_gains(batch.wb_red, this->wb_green_gain_, batch.wb_blue, true);
+  }
+  
+#ifndef USE_HOST
+  if (isp != nullptr) {
+    isp->commit();
+    this->sync_isp_controls_();
+  }
+#endif
+  
+  if (fields & ControlBatch::SENSOR_FIELDS) {
+    this->apply_sensor_controls_(batch);
+  }
+  
+  ESP_LOGD(TAG, "Controls applied at frame %u (fields=0x%03X)", this->frame_sequence_, fields);
+}
+
+void MipiDsiCam::apply_sensor_controls_(const ControlBatch &batch) {
+  const uint32_t fields = batch.fields;
+  const bool has_exposure = fields & ControlBatch::FIELD_EXPOSURE;
+  const bool has_gain = fields & ControlBatch::FIELD_GAIN;
+  
+  if (this->three_a_task_.is_running()) {
+    // Une seule écriture des consignes : la tâche 3A voit AE, exposition et gain ensemble (un seul flush)
+    this->three_a_params_.modify([&](ThreeAParams &p) {
+      if (fields & ControlBatch::FIELD_AE) {
+        p.ae_enabled = batch.ae_enabled;
+      }
+      if (has_exposure) {
+        p.manual_exposure = batch.exposure;
+        p.exposure_generation++;
+      }
+      if (has_gain) {
+        p.manual_gain_index = batch.gain_index;
+        p.gain_generation++;
+      }
+    });
+    return;
+  }
+  
+  if (fields & ControlBatch::FIELD_AE) {
+    this->three_a_params_.modify([&batch](ThreeAParams &p) { p.ae_enabled = batch.ae_enabled; });
+  }
+  if (!has_exposure && !has_gain) {
+    return;
+  }
+  const uint16_t exposure = has_exposure ? batch.exposure : this->current_exposure_;
+  const uint8_t gain_index = has_gain ? batch.gain_index : this->current_gain_index_;
+  if (!this->sensor_driver_) {
+    this->current_exposure_ = exposure;
+    this->current_gain_index_ = gain_index;
+    return;
+  }
+  this->write_sensor_settings_(exposure, gain_index);
+  this->ae_controller_.reset(this->current_exposure_, this->current_gain_index_);
+}
+
+void MipiDsiCam::sync_isp_controls_() {
+#ifndef USE_HOST
+  if (this->isp_pipeline_ == nullptr) {
+    return;
+  }
+  // Réglages du pipeline (lots V4L2 comme actions) ; un lot encore en attente garde ses valeurs
+  ControlBatch current;
+  current.isp = this->isp_pipeline_->get_pending_params();
+  this->modify_controls_([&current](ControlBatch &c) {
+    const uint32_t pending = c.fields;
+    current.fields = ControlBatch::ISP_FIELDS & ~pending;
+    c.merge(current);
+    c.fields = pending;
+  });
+#endif
+}
+
 void MipiDsiCam::adjust_exposure(uint16_t exposure_value) {
   if (!this->sensor_driver_) {
     ESP_LOGE(TAG, "No sensor driver");
@@ -805,10 +1721,11 @@ void MipiDsiCam::adjust_exposure(uint16_t exposure_value) {
   }
   
   ESP_LOGI(TAG, "Adjusting exposure to: 0x%04X", exposure_value);
-  esp_err_t ret = this->sensor_driver_->set_exposure(exposure_value);
   
-  if (ret == ESP_OK) {
-    this->current_exposure_ = exposure_value;
+  if (this->queue_sensor_settings_(true, exposure_value, false, 0)) {
+    ESP_LOGI(TAG, "✅ Exposure queued for the next frame");
+  } else if (this->write_sensor_settings_(exposure_value, this->current_gain_index_)) {
+    this->ae_controller_.reset(this->current_exposure_, this->current_gain_index_);
     ESP_LOGI(TAG, "✅ Exposure adjusted successfully");
   } else {
     ESP_LOGE(TAG, "❌ Failed to adjust exposure");
@@ -822,10 +1739,11 @@ void MipiDsiCam::adjust_gain(uint8_t gain_index) {
   }
   
   ESP_LOGI(TAG, "Adjusting gain to index: %u", gain_index);
-  esp_err_t ret = this->sensor_driver_->set_gain(gain_index);
   
-  if (ret == ESP_OK) {
-    this->current_gain_index_ = gain_index;
+  if (this->queue_sensor_settings_(false, 0, true, gain_index)) {
+    ESP_LOGI(TAG, "✅ Gain queued for the next frame");
+  } else if (this->write_sensor_settings_(this->current_exposure_, gain_index)) {
+    this->ae_controller_.reset(this->current_exposure_, this->current_gain_index_);
     ESP_LOGI(TAG, "✅ Gain adjusted successfully");
   } else {
     ESP_LOGE(TAG, "❌ Failed to adjust gain");
@@ -841,9 +1759,11 @@ void MipiDsiCam::set_brightness_level(uint8_t level) {
   ESP_LOGI(TAG, "🔆 Setting brightness level %u: exposure=0x%04X, gain=%u", 
            level, exposure, gain);
   
-  adjust_exposure(exposure);
-  delay(50);
-  adjust_gain(gain);
+  // Exposition et gain appliqués ensemble par la tâche 3A, sans bloquer l'appelant
+  if (!this->queue_sensor_settings_(true, exposure, true, gain)) {
+    adjust_exposure(exposure);
+    adjust_gain(gain);
+  }
 }
 
 void MipiDsiCam::enable_v4l2_adapter() {
@@ -852,6 +1772,9 @@ void MipiDsiCam::enable_v4l2_adapter() {
     return;
   }
   
+#ifdef USE_HOST
+  ESP_LOGW(TAG, "V4L2 adapter not available on host builds");
+#else
   ESP_LOGI(TAG, "Enabling V4L2 adapter...");
   this->v4l2_adapter_ = new MipiDsiCamV4L2Adapter(this);
   
@@ -863,6 +1786,7 @@ void MipiDsiCam::enable_v4l2_adapter() {
   } else {
     ESP_LOGI(TAG, "✅ V4L2 adapter enabled");
   }
+#endif
 }
 
 void MipiDsiCam::enable_isp_pipeline() {
@@ -871,7 +1795,18 @@ void MipiDsiCam::enable_isp_pipeline() {
     return;
   }
   
+#ifdef USE_HOST
+  ESP_LOGW(TAG, "ISP pipeline not available on host builds");
+#else
   ESP_LOGI(TAG, "Enabling ISP pipeline...");
+  
+  // Un seul contrôleur AWB par ISP : celui du pipeline remplace celui de configure_white_balance_()
+  if (this->awb_ctlr_ != nullptr) {
+    esp_isp_awb_controller_disable(this->awb_ctlr_);
+    esp_isp_del_awb_controller(this->awb_ctlr_);
+    this->awb_ctlr_ = nullptr;
+  }
+  
   this->isp_pipeline_ = new MipiDsiCamISPPipeline(this);
   
   esp_err_t ret = this->isp_pipeline_->init();
@@ -879,13 +1814,41 @@ void MipiDsiCam::enable_isp_pipeline() {
     ESP_LOGE(TAG, "Failed to initialize ISP pipeline: 0x%x", ret);
     delete this->isp_pipeline_;
     this->isp_pipeline_ = nullptr;
-  } else {
-    ESP_LOGI(TAG, "✅ ISP pipeline enabled");
+    return;
   }
+  
+  // En capture RAW, les blocs seront programmés au retour vers un format traité
+  if (!this->is_raw_capture()) {
+    ret = this->isp_pipeline_->start();
+    if (ret != ESP_OK) {
+      ESP_LOGW(TAG, "ISP pipeline start failed: 0x%x", ret);
+    }
+  }
+  this->route_white_balance_();
+  this->sync_isp_controls_();
+  ESP_LOGI(TAG, "✅ ISP pipeline enabled%s",
+           this->isp_pipeline_->handles_white_balance() ? " (white balance on ISP)" : "");
+#endif
+}
+
+void MipiDsiCam::route_white_balance_() {
+#ifndef USE_HOST
+  if (!this->is_raw_capture() && this->isp_pipeline_ != nullptr && this->isp_pipeline_->handles_white_balance()) {
+    const float red = this->wb_red_gain_fixed_ / 256.0f;
+    const float green = this->wb_green_gain_fixed_ / 256.0f;
+    const float blue = this->wb_blue_gain_fixed_ / 256.0f;
+    if (this->isp_pipeline_->set_white_balance(red, green, blue) == ESP_OK) {
+      this->wb_lut_.update(256, 256, 256);
+      return;
+    }
+    ESP_LOGW(TAG, "ISP white balance update failed - using CPU path");
+  }
+#endif
+  this->wb_lut_.update(this->wb_red_gain_fixed_, this->wb_green_gain_fixed_, this->wb_blue_gain_fixed_);
 }
 
 }  // namespace mipi_dsi_cam
 }  // namespace esphome
 
-#endif  // USE_ESP32_VARIANT_ESP32P4
+#endif  // USE_ESP32_VARIANT_ESP32P4 || USE_HOST
 
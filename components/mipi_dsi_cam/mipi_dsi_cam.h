@@ -1,8 +1,22 @@
 #pragma once
 
 #include "esphome/core/component.h"
+#include "esphome/core/automation.h"
 #include "esphome/core/hal.h"
+#include "mipi_dsi_cam_frame_ring.h"
+#include "mipi_dsi_cam_telemetry.h"
+#include "mipi_dsi_cam_wb.h"
+#include "mipi_dsi_cam_isp_stats.h"
+#include "mipi_dsi_cam_stats.h"
+#include "mipi_dsi_cam_ae.h"
+#include "mipi_dsi_cam_3a.h"
+#include "mipi_dsi_cam_command_queue.h"
+
+#ifdef USE_HOST
+#include "mipi_dsi_cam_host.h"
+#else
 #include "esphome/components/i2c/i2c.h"
+#endif
 
 #ifdef USE_ESP32_VARIANT_ESP32P4
 
@@ -12,8 +26,16 @@ extern "C" {
   #include "esp_cam_ctlr_csi.h"
   #include "esp_ldo_regulator.h"
   #include "esp_heap_caps.h"
+  #include "freertos/FreeRTOS.h"
+  #include "freertos/task.h"
+  #include "freertos/semphr.h"
 }
 
+#endif  // USE_ESP32_VARIANT_ESP32P4
+
+#if defined(USE_ESP32_VARIANT_ESP32P4) || defined(USE_HOST)
+
+#include <atomic>
 #include <string>
 
 namespace esphome {
@@ -22,6 +44,107 @@ namespace mipi_dsi_cam {
 // Forward declarations
 class MipiDsiCamV4L2Adapter;
 class MipiDsiCamISPPipeline;
+class MipiDsiCam;
+class SimFrameSource;
+
+// Consommateurs de frames (V4L2, encodeurs, affichage...)
+static constexpr uint8_t MAX_FRAME_CONSUMERS = 8;
+static constexpr uint8_t INVALID_CONSUMER_ID = 0xFF;
+// Tâches pouvant attendre simultanément une frame (wait_frame)
+static constexpr uint8_t MAX_FRAME_WAITERS = 8;
+// Index de notification réservé aux attentes caméra : celui par défaut (0) reste à la tâche et
+// aux autres composants (wait_frame tourne sur la tâche principale d'ESPHome)
+static constexpr UBaseType_t CAMERA_NOTIFY_INDEX = 1;
+static_assert(CAMERA_NOTIFY_INDEX < configTASK_NOTIFICATION_ARRAY_ENTRIES,
+              "CONFIG_FREERTOS_TASK_NOTIFICATION_ARRAY_ENTRIES must be at least 2 (set by __init__.py)");
+// Cycles 3A sans statistiques ISP avant de repasser sur la passe CPU
+static constexpr uint8_t ISP_STATS_MAX_MISSES = 8;
+
+/**
+ * @brief Bail sur une frame de l'anneau (zéro copie)
+ *
+ * Handle move-only : tant qu'il existe, le slot reste épinglé et le CSI
+ * ne peut pas y écrire. La référence est rendue à la destruction.
+ */
+class FrameLease {
+public:
+  FrameLease() = default;
+  ~FrameLease() { this->release(); }
+  
+  FrameLease(const FrameLease &) = delete;
+  FrameLease &operator=(const FrameLease &) = delete;
+  FrameLease(FrameLease &&other) noexcept { this->take_(other); }
+  FrameLease &operator=(FrameLease &&other) noexcept {
+    if (this != &other) {
+      this->release();
+      this->take_(other);
+    }
+    return *this;
+  }
+  
+  explicit operator bool() const { return this->slot_ != nullptr; }
+  bool valid() const { return this->slot_ != nullptr; }
+  
+  const uint8_t *data() const { return this->slot_ ? this->slot_->buffer : nullptr; }
+  size_t size() const { return this->slot_ ? this->slot_->valid_size : 0; }
+  uint32_t sequence() const { return this->slot_ ? this->slot_->meta.sequence : 0; }
+  const FrameMetadata &metadata() const { return this->slot_ ? this->slot_->meta : EMPTY_METADATA; }
+  // Vrai si la balance des blancs logicielle a déjà été appliquée dans le buffer
+  bool white_balanced() const {
+    return this->slot_ && this->slot_->wb_state.load(std::memory_order_acquire) == FrameSlot::WB_APPLIED;
+  }
+  uint8_t consumer_id() const { return this->consumer_id_; }
+  
+  void release();
+  
+protected:
+  friend class MipiDsiCam;
+  static const FrameMetadata EMPTY_METADATA;
+  
+  FrameLease(MipiDsiCam *camera, FrameSlot *slot, uint8_t consumer_id, int64_t acquired_us)
+    : camera_(camera), slot_(slot), consumer_id_(consumer_id), acquired_us_(acquired_us) {}
+  
+  void take_(FrameLease &other) {
+    this->camera_ = other.camera_;
+    this->slot_ = other.slot_;
+    this->consumer_id_ = other.consumer_id_;
+    this->acquired_us_ = other.acquired_us_;
+    other.camera_ = nullptr;
+    other.slot_ = nullptr;
+    other.consumer_id_ = INVALID_CONSUMER_ID;
+  }
+  
+  MipiDsiCam *camera_{nullptr};
+  FrameSlot *slot_{nullptr};
+  uint8_t consumer_id_{INVALID_CONSUMER_ID};
+  int64_t acquired_us_{0};
+};
+
+/**
+ * @brief Buffers de capture prêtés par un consommateur (V4L2 zéro copie)
+ *
+ * Fonctions appelées depuis l'ISR CSI : IRAM_ATTR, sans attente. La table
+ * reste en RAM chez son propriétaire (pas de vtable en flash dans l'ISR).
+ */
+struct CaptureBufferSource {
+  void *ctx{nullptr};
+  // Prochain buffer d'au moins `size` octets pour le DMA, nullptr si aucun en file
+  uint8_t *(*take)(void *ctx, size_t size){nullptr};
+  // Frame complète dans `buffer`, publiée aussi dans l'anneau ; vrai si une tâche plus prioritaire est réveillée
+  bool (*done)(void *ctx, uint8_t *buffer, size_t size, const FrameMetadata &meta){nullptr};
+  // Buffer rendu sans frame (pas de slot, DMA avorté ou arrêté) : de nouveau en file
+  void (*cancel)(void *ctx, uint8_t *buffer){nullptr};
+};
+
+// Compteurs écrits par la tâche du consommateur, lus par la main loop (télémétrie)
+struct FrameConsumer {
+  const char *name{nullptr};
+  std::atomic<uint32_t> cursor{0};  // Dernière séquence servie
+  std::atomic<uint32_t> frames{0};  // Frames obtenues
+  std::atomic<uint32_t> drops{0};   // Séquences jamais vues par ce consommateur
+  LatencyHistogram capture_to_acquire;  // Fin DMA CSI → acquire()
+  LatencyHistogram hold_time;           // acquire() → release()
+};
 
 // Interface pour les drivers de capteurs
 class ISensorDriver {
@@ -42,18 +165,63 @@ public:
   virtual esp_err_t read_id(uint16_t* pid) = 0;
   virtual esp_err_t start_stream() = 0;
   virtual esp_err_t stop_stream() = 0;
+  // Le capteur a-t-il quitté le standby après start_stream() ? (interrogé au lieu d'une attente fixe)
+  virtual bool is_stream_active() { return true; }
   virtual esp_err_t set_gain(uint32_t gain_index) = 0;
   virtual esp_err_t set_exposure(uint32_t exposure) = 0;
+  // Table de gain du capteur (index -> multiplicateur linéaire), croissante ; 1x par défaut
+  virtual uint16_t get_gain_count() const { return 1; }
+  virtual float get_gain_multiplier(uint16_t /*gain_index*/) const { return 1.0f; }
+  // Décomposition en registres pour la file de commandes (au plus SENSOR_MAX_SETTING_REGISTERS) ;
+  // 0 = non décrit, la file appelle alors set_exposure() / set_gain()
+  virtual size_t get_exposure_registers(uint32_t /*exposure*/, SensorRegister * /*out*/) const { return 0; }
+  virtual size_t get_gain_registers(uint32_t /*gain_index*/, SensorRegister * /*out*/) const { return 0; }
+  // Écritures qui ouvrent / ferment le group hold (application atomique à la frame suivante)
+  virtual bool get_group_hold(SensorRegister * /*begin*/, SensorRegister * /*end*/) const { return false; }
   virtual esp_err_t write_register(uint16_t reg, uint8_t value) = 0;
   virtual esp_err_t read_register(uint16_t reg, uint8_t* value) = 0;
 };
 
 enum class PixelFormat {
   PIXEL_FORMAT_RGB565 = 0,
-  PIXEL_FORMAT_YUV422 = 1,
-  PIXEL_FORMAT_RAW8 = 2,
+  PIXEL_FORMAT_YUV422 = 1,  // YUYV
+  PIXEL_FORMAT_RAW8 = 2,    // Bayer, ISP contourné
+  PIXEL_FORMAT_YUV420 = 3,  // Disposition ESP « O_UYY_E_VYY » : lignes paires U Y Y, impaires V Y Y
 };
 
+// Octets par ligne du format de sortie CSI/ISP (YUV420 : 1,5 octet par pixel sur chaque ligne)
+inline size_t pixel_format_bytes_per_line(PixelFormat format, uint16_t width) {
+  switch (format) {
+    case PixelFormat::PIXEL_FORMAT_RAW8:
+      return width;
+    case PixelFormat::PIXEL_FORMAT_YUV420:
+      return static_cast<size_t>(width) * 3 / 2;
+    case PixelFormat::PIXEL_FORMAT_YUV422:
+    case PixelFormat::PIXEL_FORMAT_RGB565:
+    default:
+      return static_cast<size_t>(width) * 2;
+  }
+}
+
+inline size_t pixel_format_frame_size(PixelFormat format, uint16_t width, uint16_t height) {
+  return pixel_format_bytes_per_line(format, width) * height;
+}
+
+inline const char *pixel_format_to_string(PixelFormat format) {
+  switch (format) {
+    case PixelFormat::PIXEL_FORMAT_RGB565:
+      return "RGB565";
+    case PixelFormat::PIXEL_FORMAT_YUV422:
+      return "YUV422";
+    case PixelFormat::PIXEL_FORMAT_RAW8:
+      return "RAW8";
+    case PixelFormat::PIXEL_FORMAT_YUV420:
+      return "YUV420";
+    default:
+      return "unknown";
+  }
+}
+
 class MipiDsiCam : public Component, public i2c::I2CDevice {
 public:
   void setup() override;
@@ -75,9 +243,22 @@ public:
   }
   void set_bayer_pattern(uint8_t pattern) { this->bayer_pattern_ = pattern; }
   void set_lane_bitrate(uint16_t bitrate) { this->lane_bitrate_mbps_ = bitrate; }
-  void set_pixel_format(PixelFormat format) { this->pixel_format_ = format; }
+  void set_pixel_format(PixelFormat format) {
+    this->pixel_format_ = format;
+    this->processed_format_ = format;
+  }
+  // Format actuellement produit par le CSI (RAW8 quand l'ISP est contourné)
+  PixelFormat get_pixel_format() const { return this->pixel_format_; }
+  // Format configuré, produit par l'ISP hors mode RAW
+  PixelFormat get_processed_format() const { return this->processed_format_; }
+  bool is_raw_capture() const { return this->pixel_format_ == PixelFormat::PIXEL_FORMAT_RAW8; }
+  uint8_t get_bayer_pattern() const { return this->bayer_pattern_; }
+  size_t get_bytes_per_line() const { return pixel_format_bytes_per_line(this->pixel_format_, this->width_); }
   void set_jpeg_quality(uint8_t quality) { this->jpeg_quality_ = quality; }
   void set_framerate(uint8_t fps) { this->framerate_ = fps; }
+  void set_frame_buffer_count(uint8_t count) { this->frame_buffer_count_ = count; }
+  // Capteur "sim" : frames rejouées depuis ce fichier (mire animée si vide)
+  void set_simulation_file(const std::string &path) { this->simulation_file_ = path; }
   
   // Configuration V4L2 et ISP
   void set_enable_v4l2(bool enable) { this->enable_v4l2_on_setup_ = enable; }
@@ -87,25 +268,72 @@ public:
   std::string get_name() const { return this->name_; }
   uint16_t get_image_width() const { return this->width_; }
   uint16_t get_image_height() const { return this->height_; }
-  size_t get_image_size() const { return this->frame_buffer_size_; }
+  size_t get_image_size() const { return pixel_format_frame_size(this->pixel_format_, this->width_, this->height_); }
   uint8_t* get_image_data() const { return this->current_frame_buffer_; }
   bool is_streaming() const { return this->streaming_; }
   bool is_initialized() const { return this->initialized_; }
   bool has_external_clock() const { return this->external_clock_pin_ >= 0; }
+  bool is_simulated() const { return this->sim_source_ != nullptr; }
+  SimFrameSource *get_sim_source() const { return this->sim_source_; }
   
   // Getters pour les adaptateurs
   MipiDsiCamV4L2Adapter* get_v4l2_adapter() const { return this->v4l2_adapter_; }
   MipiDsiCamISPPipeline* get_isp_pipeline() const { return this->isp_pipeline_; }
+  // Processeur ISP courant ; nul en capture RAW ou avant setup()
+  isp_proc_handle_t get_isp_handle() const { return this->isp_handle_; }
   
   // Gestion de la séquence de frames
   uint32_t get_frame_sequence() const { return this->frame_sequence_; }
   uint32_t get_current_sequence() const { return this->locked_sequence_; }
   
+  // Anneau de buffers
+  uint8_t get_frame_buffer_count() const { return this->frame_ring_.get_slot_count(); }
+  uint32_t get_ring_overrun_count() const { return this->frame_ring_.get_overrun_count(); }
+  uint32_t get_ring_skip_count() const { return this->frame_ring_.get_skip_count(); }
+  
   // Contrôle du streaming
   bool start_streaming();
   bool stop_streaming();
+  /**
+   * @brief Bascule entre le flux traité par l'ISP et le Bayer brut (RAW8, ISP contourné)
+   *
+   * Seuls le CSI et l'ISP sont reconfigurés : le capteur n'est ni réinitialisé
+   * ni arrêté, et le flux reprend aussitôt s'il était actif. Les slots de
+   * l'anneau, dimensionnés pour le format configuré, suffisent au RAW8.
+   */
+  bool set_capture_format(PixelFormat format);
+  // Temps entre le début de setup() et la première frame reçue (0 tant qu'aucune frame)
+  uint32_t get_boot_to_first_frame_ms() const { return this->boot_to_first_frame_ms_.load(std::memory_order_relaxed); }
+  
+  // API multi-consommateurs : chaque consommateur a son propre curseur de séquence
+  uint8_t register_consumer(const char *name);
+  FrameLease acquire(uint8_t consumer_id, uint32_t last_seq);
+  FrameLease acquire(uint8_t consumer_id);
+  const FrameConsumer *get_consumer(uint8_t consumer_id) const {
+    return consumer_id < this->consumer_count_ ? &this->consumers_[consumer_id] : nullptr;
+  }
+  uint8_t get_consumer_count() const { return this->consumer_count_; }
+  uint8_t find_consumer(const std::string &name) const;
+  
+  // Télémétrie : histogrammes de latence et pertes par consommateur
+  void dump_telemetry();
   
-  // Nouvelle API de gestion des frames avec verrouillage
+  /**
+   * @brief Fait capturer le DMA directement dans les buffers d'un consommateur
+   *
+   * Les frames vont dans le prochain buffer fourni par `source`, l'anneau
+   * interne ne servant plus que quand aucun n'est en file. nullptr retire
+   * la source : à faire capture arrêtée, avant de libérer les buffers.
+   */
+  void set_capture_buffer_source(const CaptureBufferSource *source);
+  // Frame d'un buffer prêté rendue à son propriétaire : WB en place et télémétrie comme acquire()
+  void complete_external_frame(uint8_t consumer_id, uint8_t *buffer, size_t size, FrameMetadata &meta);
+  
+  // Attente bloquante d'une frame de séquence > last_seq, réveillée par l'ISR CSI
+  bool wait_frame(uint32_t last_seq, uint32_t timeout_ms);
+  FrameLease wait_and_acquire(uint8_t consumer_id, uint32_t timeout_ms);
+  
+  // API mono-détenteur (compatibilité), implémentée par un bail interne
   bool acquire_frame(uint32_t last_served_sequence);
   void release_frame();
   
@@ -123,12 +351,45 @@ public:
   void set_brightness_level(uint8_t level);
   void adjust_exposure(uint16_t exposure_value);
   void adjust_gain(uint8_t gain_index);
+  // Dernière convergence AE (frames / ms entre la perturbation et le retour dans la bande morte)
+  uint32_t get_ae_convergence_frames() const { return this->three_a_state_.load().ae_convergence_frames; }
+  uint32_t get_ae_convergence_ms() const { return this->three_a_state_.load().ae_convergence_ms; }
+  bool is_ae_converged() const { return this->three_a_state_.load().ae_converged; }
+  
+  // Tâche 3A (AE/AWB hors main loop) : coeur (-1 = libre) et priorité FreeRTOS
+  void set_3a_task_core(int8_t core) { this->three_a_task_core_ = core; }
+  void set_3a_task_priority(uint8_t priority) { this->three_a_task_priority_ = priority; }
+  ThreeAState get_3a_state() const { return this->three_a_state_.load(); }
 
   uint8_t get_fps() const { return this->framerate_; }
   // Balance des blancs
   void set_auto_white_balance(bool enable);
   void set_white_balance_gains(float red, float green, float blue, bool update_fixed = true);
   
+  /**
+   * @brief Soumet un lot de contrôles déjà validé (V4L2 S_EXT_CTRLS)
+   *
+   * Appelable depuis n'importe quelle tâche : le lot est fusionné à ceux encore
+   * en attente, puis appliqué en une fois par la main loop à la prochaine
+   * frontière de frame (aussitôt hors flux).
+   */
+  void submit_controls(const ControlBatch &batch);
+  // Valeurs demandées, lots en attente compris ; exposition et gain sont ceux en vigueur côté 3A
+  ControlBatch get_controls() const;
+  uint16_t get_sensor_gain_count() const { return this->sensor_driver_ ? this->sensor_driver_->get_gain_count() : 1; }
+  // Applique la WB une seule fois par séquence, en place dans le slot, à l'acquire (zéro copie)
+  void set_inplace_white_balance(bool enable) { this->inplace_white_balance_ = enable; }
+  bool get_inplace_white_balance() const { return this->inplace_white_balance_; }
+  
+  // Statistiques de frame (zones, histogramme), une passe par séquence
+  void set_stats_config(uint8_t zones_x, uint8_t zones_y, uint8_t stride) {
+    this->stats_engine_.configure(zones_x, zones_y, stride);
+  }
+  // Écrites par la tâche 3A : à lire depuis celle-ci (ou via get_3a_state() ailleurs)
+  const FrameStats &get_frame_stats() const { return this->frame_stats_; }
+  // Statistiques matérielles AE/AWB/histogramme, écrites en ISR par le pipeline ISP
+  IspStatsRing &get_isp_stats_ring() { return this->isp_stats_ring_; }
+  
   // Activer les adaptateurs
   void enable_v4l2_adapter();
   void enable_isp_pipeline();
@@ -149,23 +410,46 @@ protected:
   uint16_t height_{720};
   uint8_t framerate_{30};
   PixelFormat pixel_format_{PixelFormat::PIXEL_FORMAT_RGB565};
+  PixelFormat processed_format_{PixelFormat::PIXEL_FORMAT_RGB565};
   uint8_t jpeg_quality_{10};
   
   // État
   bool initialized_{false};
-  bool streaming_{false};
+  std::atomic<bool> streaming_{false};
+  
+  // Mesure du démarrage : début de setup(), capteur prêt, première frame (écrite par l'ISR)
+  int64_t boot_start_us_{0};
+  uint32_t boot_sensor_ready_ms_{0};
+  std::atomic<uint32_t> boot_to_first_frame_ms_{0};
+  bool boot_time_logged_{false};
   
-  // Système de verrouillage de frames
+  // Séquence des frames
   bool frame_ready_{false};
-  bool frame_locked_{false};
   uint32_t frame_sequence_{0};
   uint32_t locked_sequence_{0};
   
-  // Buffers
-  uint8_t *frame_buffers_[2]{nullptr, nullptr};
+  // Consommateurs et bail de l'API legacy
+  FrameConsumer consumers_[MAX_FRAME_CONSUMERS];
+  uint8_t consumer_count_{0};
+  uint8_t legacy_consumer_id_{INVALID_CONSUMER_ID};
+  FrameLease legacy_lease_;
+  
+  // Tâches en attente de frame (notifiées depuis on_csi_frame_done_)
+  std::atomic<TaskHandle_t> frame_waiters_[MAX_FRAME_WAITERS]{};
+  // Lecteurs qui attendent la fin d'une balance des blancs en place (notifiés par le correcteur)
+  std::atomic<TaskHandle_t> wb_waiters_[MAX_FRAME_WAITERS]{};
+  // Coût de la WB logicielle (télémétrie) : passes, cycles CPU cumulés et max, pixels de la dernière passe
+  std::atomic<uint32_t> wb_apply_frames_{0};
+  std::atomic<uint64_t> wb_apply_cycles_{0};
+  std::atomic<uint32_t> wb_apply_max_cycles_{0};
+  std::atomic<uint32_t> wb_apply_pixels_{0};
+  
+  // Buffers : anneau de N slots à comptage de références
+  FrameRing frame_ring_;
+  uint8_t frame_buffer_count_{3};
   size_t frame_buffer_size_{0};
   uint8_t *current_frame_buffer_{nullptr};
-  uint8_t buffer_index_{0};
+  std::atomic<const CaptureBufferSource *> capture_source_{nullptr};
   
   // Hardware handles
   ISensorDriver *sensor_driver_{nullptr};
@@ -176,23 +460,41 @@ protected:
   
   // Statistiques
   uint32_t total_frames_received_{0};
+  uint32_t skips_at_last_commit_{0};
   uint32_t last_frame_log_time_{0};
+  // Passages de loop() avec / sans frame prête depuis le dernier log FPS
+  uint32_t loop_ready_count_{0};
+  uint32_t loop_not_ready_count_{0};
   
-  // Auto Exposure
-  bool auto_exposure_enabled_{true};
-  uint8_t ae_target_brightness_{128};
-  uint16_t current_exposure_{0x9C0};
+  // Auto Exposure (état propre à la tâche 3A une fois celle-ci démarrée)
+  AutoExposureController ae_controller_;
+  uint16_t current_exposure_{0x9C0};  // Dernières valeurs demandées au capteur
   uint8_t current_gain_index_{0};
-  uint32_t last_ae_update_{0};
+  // Écritures exposition/gain fusionnées, vidées une fois par frame par la tâche 3A
+  SensorCommandQueue sensor_queue_;
+  // Pipeline d'application du capteur (gain << 24 | exposition) : vidé sur le bus -> pris en compte
+  // au début de frame suivant -> visible dans les pixels de la frame d'après
+  std::atomic<uint32_t> written_settings_{0x9C0};
+  uint32_t staged_settings_{0x9C0};
+  uint32_t capture_settings_{0x9C0};
   
   // White Balance
-  bool auto_white_balance_enabled_{false};
   float wb_red_gain_{1.0f};
   float wb_green_gain_{1.0f};
   float wb_blue_gain_{1.0f};
   uint16_t wb_red_gain_fixed_{256};
   uint16_t wb_green_gain_fixed_{256};
   uint16_t wb_blue_gain_fixed_{256};
+  WhiteBalanceLut wb_lut_;  // Double buffer publié par la main loop, lu sous Lease par les autres tâches
+  bool inplace_white_balance_{false};
+  
+  // Statistiques partagées AE/AWB
+  FrameStatsEngine stats_engine_;
+  FrameStats frame_stats_;
+  FrameMetadata stats_metadata_;  // Frame mesurée (exposition/gain effectifs)
+  IspStatsRing isp_stats_ring_;
+  uint8_t isp_stats_misses_{0};  // Cycles 3A consécutifs sans mesure ISP
+  uint8_t stats_consumer_id_{INVALID_CONSUMER_ID};
   uint32_t last_awb_update_{0};
   
   // Adaptateurs optionnels
@@ -201,6 +503,34 @@ protected:
   bool enable_v4l2_on_setup_{false};
   bool enable_isp_on_setup_{false};
   
+  // Backend simulé (capteur "sim" ou build USE_HOST) à la place du CSI
+  SimFrameSource *sim_source_{nullptr};
+  std::string simulation_file_;
+  
+  // 3A : consignes et état échangés sans verrou avec la tâche
+  Snapshot<ThreeAParams> three_a_params_;
+  Snapshot<ThreeAState> three_a_state_;
+  int8_t three_a_task_core_{-1};
+  uint8_t three_a_task_priority_{5};
+  uint32_t three_a_sequence_{0};
+  uint32_t applied_exposure_generation_{0};
+  uint32_t applied_gain_generation_{0};
+  uint32_t applied_awb_generation_{0};
+  uint32_t isp_applied_sequence_{0};  // Dernière frontière de frame traitée (contrôles V4L2, pipeline ISP)
+  // Contrôles V4L2 : valeurs demandées, `fields` = lot en attente de la main loop.
+  // Écrits par la tâche V4L2 et la main loop : écrivains sérialisés par controls_lock_
+  Snapshot<ControlBatch> controls_;
+  SemaphoreHandle_t controls_lock_{nullptr};
+  std::atomic<bool> controls_pending_{false};
+  
+  friend class FrameLease;
+  friend class SimFrameSource;
+  friend class ThreeATask;
+  void release_lease_(FrameSlot *slot, uint8_t consumer_id, int64_t acquired_us);
+  void apply_white_balance_in_place_(FrameSlot *slot);
+  // Passe LUT comptée en cycles CPU pour dump_telemetry()
+  void apply_wb_lut_(const WhiteBalanceLut::Lease &wb, const uint8_t *src, uint8_t *dst, size_t size);
+  
   // Méthodes d'initialisation
   bool create_sensor_driver_();
   bool init_sensor_();
@@ -210,11 +540,35 @@ protected:
   bool init_isp_();
   bool allocate_buffer_();
   void configure_white_balance_();
+  // Gains fixes vers la CCM de l'ISP si le pipeline la pilote, sinon vers la LUT CPU
+  void route_white_balance_();
+  // Supprime les contrôleurs CSI/ISP pour les recréer avec un autre format de sortie
+  void release_capture_pipeline_();
+  // DMA seul (CSI ou source simulée), sans toucher au capteur
+  bool start_capture_();
+  void stop_capture_();
   
   // Auto Exposure & White Balance
-  void update_auto_exposure_();
-  void update_auto_white_balance_();
+  bool run_3a_cycle_(uint32_t timeout_ms);
+  void apply_manual_settings_(const ThreeAParams &params);
+  bool queue_sensor_settings_(bool has_exposure, uint16_t exposure, bool has_gain, uint8_t gain_index);
+  void update_auto_exposure_(const ThreeAParams &params);
+  void stage_sensor_settings_(uint16_t exposure, uint8_t gain_index);
+  bool flush_sensor_commands_();
+  bool write_sensor_settings_(uint16_t exposure, uint8_t gain_index);
+  bool update_auto_white_balance_(const ThreeAParams &params, ThreeAState &state);
   uint32_t calculate_brightness_();
+  bool update_frame_stats_();
+  
+  // Contrôles V4L2 (main loop)
+  template<typename F> void modify_controls_(F fn) {
+    xSemaphoreTake(this->controls_lock_, portMAX_DELAY);
+    this->controls_.modify(fn);
+    xSemaphoreGive(this->controls_lock_);
+  }
+  void apply_controls_();
+  void apply_sensor_controls_(const ControlBatch &batch);
+  void sync_isp_controls_();
   
   // Callbacks CSI
   static bool IRAM_ATTR on_csi_new_frame_(esp_cam_ctlr_handle_t handle,
@@ -224,6 +578,18 @@ protected:
   static bool IRAM_ATTR on_csi_frame_done_(esp_cam_ctlr_handle_t handle,
                                            esp_cam_ctlr_trans_t *trans,
                                            void *user_data);
+  
+  // Déclarée en dernier : arrêtée (host) avant la destruction de ce qu'elle utilise
+  ThreeATask three_a_task_;
+};
+
+template<typename... Ts> class DumpTelemetryAction : public Action<Ts...> {
+public:
+  explicit DumpTelemetryAction(MipiDsiCam *camera) : camera_(camera) {}
+  void play(Ts... x) override { this->camera_->dump_telemetry(); }
+  
+protected:
+  MipiDsiCam *camera_;
 };
 
 // Factory function (déclarée dans le header généré)
@@ -232,7 +598,7 @@ extern ISensorDriver* create_sensor_driver(const std::string& sensor_type, i2c::
 } // namespace mipi_dsi_cam
 } // namespace esphome
 
-#endif // USE_ESP32_VARIANT_ESP32P4
+#endif // USE_ESP32_VARIANT_ESP32P4 || USE_HOST
 
 
 
@@ -0,0 +1,90 @@
+#include "mipi_dsi_cam_3a.h"
+#include "mipi_dsi_cam.h"
+
+#if defined(USE_ESP32_VARIANT_ESP32P4) || defined(USE_HOST)
+
+#include "esphome/core/log.h"
+
+namespace esphome {
+namespace mipi_dsi_cam {
+
+static const char *const TAG = "mipi_dsi_cam.3a";
+
+// Attente maximale d'une frame avant de revérifier l'arrêt de la tâche
+static constexpr uint32_t THREE_A_WAIT_MS = 100;
+// Pause quand le flux est arrêté (wait_frame rend la main immédiatement)
+static constexpr uint32_t THREE_A_IDLE_MS = 20;
+// Période de l'avertissement quand la tâche tarde à sortir dans stop()
+static constexpr uint32_t THREE_A_STOP_WARN_MS = 1000;
+
+bool ThreeATask::start(MipiDsiCam *camera, int8_t core, uint8_t priority) {
+  if (this->running_.load() || camera == nullptr) {
+    return false;
+  }
+
+  this->camera_ = camera;
+  this->running_.store(true, std::memory_order_release);
+
+#ifdef USE_HOST
+  // Ordonnanceur de l'hôte : affinité et priorité FreeRTOS sans équivalent
+  this->thread_ = std::thread(&ThreeATask::entry_, this);
+  ESP_LOGI(TAG, "3A thread started (core %d, priority %u ignored on host)", core, priority);
+#else
+  if (this->exited_ == nullptr) {
+    this->exited_ = xSemaphoreCreateBinary();
+    if (this->exited_ == nullptr) {
+      ESP_LOGE(TAG, "Failed to create 3A exit semaphore");
+      this->running_.store(false);
+      return false;
+    }
+  }
+  BaseType_t ret = xTaskCreatePinnedToCore(&ThreeATask::entry_, "cam_3a", 4096, this, priority, &this->handle_,
+                                           core < 0 ? tskNO_AFFINITY : core);
+  if (ret != pdPASS) {
+    ESP_LOGE(TAG, "Failed to create 3A task");
+    this->running_.store(false);
+    this->handle_ = nullptr;
+    return false;
+  }
+  ESP_LOGI(TAG, "3A task started (core %d, priority %u)", core, priority);
+#endif
+  return true;
+}
+
+void ThreeATask::stop() {
+  if (!this->running_.exchange(false)) {
+    return;
+  }
+#ifdef USE_HOST
+  if (this->thread_.joinable()) {
+    this->thread_.join();
+  }
+#else
+  // La tâche sort de sa boucle au plus tard après THREE_A_WAIT_MS et un cycle 3A : on l'attend,
+  // elle ne doit plus toucher la caméra une fois stop() revenu
+  while (xSemaphoreTake(this->exited_, pdMS_TO_TICKS(THREE_A_STOP_WARN_MS)) != pdTRUE) {
+    ESP_LOGW(TAG, "Waiting for the 3A task to exit");
+  }
+  this->handle_ = nullptr;
+#endif
+}
+
+void ThreeATask::entry_(void *arg) {
+  ThreeATask *self = static_cast<ThreeATask *>(arg);
+
+  while (self->running_.load(std::memory_order_acquire)) {
+    if (!self->camera_->run_3a_cycle_(THREE_A_WAIT_MS) && !self->camera_->is_streaming()) {
+      vTaskDelay(pdMS_TO_TICKS(THREE_A_IDLE_MS));
+    }
+  }
+
+#ifndef USE_HOST
+  xSemaphoreGive(self->exited_);
+  vTaskDelete(nullptr);
+#endif
+}
+
+}  // namespace mipi_dsi_cam
+}  // namespace esphome
+
+#endif  // USE_ESP32_VARIANT_ESP32P4 || USE_HOST
@@ -0,0 +1,241 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#include "mipi_dsi_cam_isp_params.h"
+
+#if defined(USE_ESP32_VARIANT_ESP32P4) || defined(USE_HOST)
+
+#ifdef USE_HOST
+#include <thread>
+#else
+extern "C" {
+  #include "freertos/FreeRTOS.h"
+  #include "freertos/task.h"
+  #include "freertos/semphr.h"
+}
+#endif
+
+namespace esphome {
+namespace mipi_dsi_cam {
+
+class MipiDsiCam;
+
+/**
+ * @brief Instantané partagé sans verrou entre tâches (double tampon versionné)
+ *
+ * L'écrivain remplit le tampon inactif puis le publie ; un lecteur ne
+ * bloque jamais sur un écrivain préempté (il lit le tampon publié) et ne
+ * recommence que si deux écritures complètes l'ont doublé. Un seul écrivain
+ * à la fois : plusieurs tâches écrivantes se sérialisent en amont (verrou).
+ */
+template<typename T> class Snapshot {
+  static_assert(std::is_trivially_copyable<T>::value, "Snapshot<T> requires a trivially copyable T");
+
+ public:
+  Snapshot() { this->store(T{}); }
+
+  T load() const {
+    uint32_t words[WORDS];
+    for (;;) {
+      const uint32_t begin = this->version_.load(std::memory_order_acquire);
+      const std::atomic<uint32_t> *buffer = this->buffers_[(begin >> 1) & 1];
+      for (size_t i = 0; i < WORDS; i++) {
+        words[i] = buffer[i].load(std::memory_order_relaxed);
+      }
+      std::atomic_thread_fence(std::memory_order_acquire);
+      const uint32_t end = this->version_.load(std::memory_order_relaxed);
+      // Pendant une écriture (version impaire), le tampon publié n'est réécrit qu'à la suivante
+      if (end - begin <= ((begin & 1) ? 1u : 2u)) {
+        break;
+      }
+    }
+    T value;
+    std::memcpy(&value, words, sizeof(T));
+    return value;
+  }
+
+  void store(const T &value) {
+    const uint32_t version = this->begin_write_();
+    this->write_(version, value);
+  }
+
+  // Lecture-modification-écriture, vue d'un bloc par les lecteurs
+  template<typename F> void modify(F fn) {
+    const uint32_t version = this->begin_write_();
+    T value = this->read_published_(version);
+    fn(value);
+    this->write_(version, value);
+  }
+
+  // Nombre d'écritures publiées
+  uint32_t generation() const { return this->version_.load(std::memory_order_acquire) >> 1; }
+
+ protected:
+  static constexpr size_t WORDS = (sizeof(T) + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+
+  // Version impaire pendant l'écriture ; pas d'attente, l'écrivain est seul
+  uint32_t begin_write_() {
+    const uint32_t version = this->version_.load(std::memory_order_relaxed) + 1;
+    this->version_.store(version, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    return version;
+  }
+
+  T read_published_(uint32_t version) const {
+    uint32_t words[WORDS];
+    const std::atomic<uint32_t> *buffer = this->buffers_[(version >> 1) & 1];
+    for (size_t i = 0; i < WORDS; i++) {
+      words[i] = buffer[i].load(std::memory_order_relaxed);
+    }
+    T value;
+    std::memcpy(&value, words, sizeof(T));
+    return value;
+  }
+
+  void write_(uint32_t version, const T &value) {
+    uint32_t words[WORDS] = {};
+    std::memcpy(words, &value, sizeof(T));
+    std::atomic<uint32_t> *buffer = this->buffers_[((version >> 1) + 1) & 1];
+    for (size_t i = 0; i < WORDS; i++) {
+      buffer[i].store(words[i], std::memory_order_relaxed);
+    }
+    this->version_.store(version + 1, std::memory_order_release);
+  }
+
+  std::atomic<uint32_t> version_{0};
+  std::atomic<uint32_t> buffers_[2][WORDS]{};
+};
+
+/**
+ * @brief Consignes 3A, écrites par la seule main loop (actions, lots V4L2)
+ *
+ * Les réglages manuels portent chacun une génération : la tâche 3A applique
+ * un champ quand sa génération change, même si plusieurs demandes se sont
+ * succédé entre deux frames.
+ */
+struct ThreeAParams {
+  bool ae_enabled{true};
+  uint8_t ae_target{128};
+  bool awb_enabled{false};
+  float wb_red{1.0f};  // Gains en vigueur, point de départ de l'AWB
+  float wb_green{1.0f};
+  float wb_blue{1.0f};
+  uint32_t exposure_generation{0};
+  uint16_t manual_exposure{0};
+  uint32_t gain_generation{0};
+  uint8_t manual_gain_index{0};
+};
+
+/**
+ * @brief État 3A publié par la tâche après chaque frame traitée
+ */
+struct ThreeAState {
+  uint32_t sequence{0};
+  uint16_t exposure{0};
+  uint8_t gain_index{0};
+  uint8_t luma{0};
+  bool ae_converged{true};
+  uint32_t ae_convergence_frames{0};
+  uint32_t ae_convergence_ms{0};
+  uint32_t awb_generation{0};  // Incrémentée à chaque nouveau jeu de gains AWB
+  float wb_red{1.0f};
+  float wb_green{1.0f};
+  float wb_blue{1.0f};
+};
+
+/**
+ * @brief Lot de contrôles (V4L2 S_EXT_CTRLS) appliqué d'un bloc à une frontière de frame
+ *
+ * `fields` désigne les champs renseignés ; les autres portent les valeurs
+ * demandées en dernier. Les lots soumis entre deux frames sont fusionnés
+ * champ par champ. La main loop programme ensuite l'ISP dans une seule
+ * transaction du pipeline et les consignes capteur en une seule écriture
+ * (un flush de la file de commandes, sous group hold).
+ */
+struct ControlBatch {
+  enum Field : uint32_t {
+    FIELD_AE = 1 << 0,
+    FIELD_EXPOSURE = 1 << 1,
+    FIELD_GAIN = 1 << 2,
+    FIELD_AWB = 1 << 3,
+    FIELD_WB_GAINS = 1 << 4,
+    FIELD_BF = 1 << 5,
+    FIELD_DEMOSAIC = 1 << 6,
+    FIELD_CCM = 1 << 7,  // Activation et matrice ; les gains WB passent par FIELD_WB_GAINS
+    FIELD_GAMMA = 1 << 8,
+    FIELD_SHARPEN = 1 << 9,
+    FIELD_COLOR = 1 << 10,
+  };
+  static constexpr uint32_t SENSOR_FIELDS = FIELD_AE | FIELD_EXPOSURE | FIELD_GAIN;
+  static constexpr uint32_t ISP_FIELDS =
+      FIELD_BF | FIELD_DEMOSAIC | FIELD_CCM | FIELD_GAMMA | FIELD_SHARPEN | FIELD_COLOR;
+
+  uint32_t fields{0};
+  bool ae_enabled{true};
+  uint16_t exposure{0};
+  uint8_t gain_index{0};
+  bool awb_enabled{false};
+  float wb_red{1.0f};
+  float wb_blue{1.0f};
+  IspParams isp;
+
+  // Recopie les champs renseignés de `other` et les ajoute à `fields`
+  void merge(const ControlBatch &other) {
+    const uint32_t f = other.fields;
+    if (f & FIELD_AE) this->ae_enabled = other.ae_enabled;
+    if (f & FIELD_EXPOSURE) this->exposure = other.exposure;
+    if (f & FIELD_GAIN) this->gain_index = other.gain_index;
+    if (f & FIELD_AWB) this->awb_enabled = other.awb_enabled;
+    if (f & FIELD_WB_GAINS) {
+      this->wb_red = other.wb_red;
+      this->wb_blue = other.wb_blue;
+    }
+    if (f & FIELD_BF) this->isp.bf = other.isp.bf;
+    if (f & FIELD_DEMOSAIC) this->isp.demosaic = other.isp.demosaic;
+    if (f & FIELD_CCM) {
+      this->isp.ccm.enabled = other.isp.ccm.enabled;
+      std::memcpy(this->isp.ccm.matrix, other.isp.ccm.matrix, sizeof(this->isp.ccm.matrix));
+    }
+    if (f & FIELD_GAMMA) this->isp.gamma = other.isp.gamma;
+    if (f & FIELD_SHARPEN) this->isp.sharpen = other.isp.sharpen;
+    if (f & FIELD_COLOR) this->isp.color = other.isp.color;
+    this->fields |= f;
+  }
+};
+
+/**
+ * @brief Tâche 3A (AE/AWB) : une itération par nouvelle séquence de frame
+ *
+ * Tâche FreeRTOS épinglée (ou non) sur un coeur, ou std::thread sur host.
+ */
+class ThreeATask {
+ public:
+  ~ThreeATask() { this->stop(); }
+
+  bool start(MipiDsiCam *camera, int8_t core, uint8_t priority);
+  void stop();
+  bool is_running() const { return this->running_.load(std::memory_order_acquire); }
+
+ protected:
+  static void entry_(void *arg);
+
+  MipiDsiCam *camera_{nullptr};
+  std::atomic<bool> running_{false};
+#ifdef USE_HOST
+  std::thread thread_;
+#else
+  TaskHandle_t handle_{nullptr};
+  // Donné par la tâche juste avant vTaskDelete() : stop() ne rend la main qu'après
+  SemaphoreHandle_t exited_{nullptr};
+#endif
+};
+
+}  // namespace mipi_dsi_cam
+}  // namespace esphome
+
+#endif  // USE_ESP32_VARIANT_ESP32P4 || USE_HOST
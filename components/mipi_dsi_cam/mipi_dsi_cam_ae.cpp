@@ -0,0 +1,170 @@
+#include "mipi_dsi_cam_ae.h"
+#include "mipi_dsi_cam.h"
+
+#if defined(USE_ESP32_VARIANT_ESP32P4) || defined(USE_HOST)
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace esphome {
+namespace mipi_dsi_cam {
+
+// Bande morte en log2 : entrée à ±0.1 EV (convergé), sortie à ±0.2 EV (hystérésis)
+static constexpr float AE_CONVERGED_EV = 0.1f;
+static constexpr float AE_DISTURBED_EV = 0.2f;
+// Gain proportionnel du pas log et pas maximal (±2 EV, soit x4 par itération)
+static constexpr float AE_STEP_GAIN = 0.9f;
+static constexpr float AE_MAX_STEP_EV = 2.0f;
+// Frame saturée : pas estimé sur la référence, jusqu'à -4 EV (x1/16)
+static constexpr float AE_MAX_SATURATED_STEP_EV = 4.0f;
+// Pente réponse/commande (EV luma par EV d'exposition) : 1 en linéaire, plus faible
+// quand les hautes lumières saturent ; bornée pour ne jamais sur-corriger
+static constexpr float AE_MIN_SLOPE = 0.5f;
+
+void AutoExposureController::configure(const ISensorDriver *sensor, uint16_t exposure_min,
+                                       uint16_t exposure_max) {
+  this->exposure_min_ = std::max<uint16_t>(1, exposure_min);
+  this->exposure_max_ = std::max(this->exposure_min_, exposure_max);
+
+  this->gain_count_ = 1;
+  this->gains_[0] = 1.0f;
+  if (sensor != nullptr) {
+    this->gain_count_ = std::max<uint16_t>(1, std::min<uint16_t>(sensor->get_gain_count(), AE_MAX_GAIN_STEPS));
+    for (uint16_t i = 0; i < this->gain_count_; i++) {
+      this->gains_[i] = sensor->get_gain_multiplier(i);
+    }
+  }
+}
+
+void AutoExposureController::reset(uint32_t exposure, uint8_t gain_index) {
+  this->written_exposure_ = exposure;
+  this->written_gain_index_ = gain_index;
+  this->converged_ = true;
+  this->has_previous_ = false;
+}
+
+float AutoExposureController::gain_multiplier(uint8_t index) const {
+  return this->gains_[std::min<uint16_t>(index, this->gain_count_ - 1)];
+}
+
+void AutoExposureController::store_reference_(const FrameStats &stats) {
+  if (stats.samples == 0 || stats.clipped_high * 2 > stats.samples) {
+    return;
+  }
+  std::memcpy(this->reference_histogram_, stats.histogram, sizeof(this->reference_histogram_));
+  this->reference_samples_ = stats.samples;
+}
+
+float AutoExposureController::saturated_step_ev_(const FrameStats &stats) const {
+  if (this->reference_samples_ == 0 || stats.samples == 0) {
+    return 0.0f;
+  }
+  // Part non saturée de la frame ; au même rang dans la référence, la luma que la limite de saturation
+  // doit retrouver (scène plus claire uniformément, répartition des lumas conservée)
+  const uint32_t unclipped = stats.samples - std::min(stats.clipped_high, stats.samples);
+  const uint32_t rank = static_cast<uint32_t>(static_cast<uint64_t>(unclipped) * this->reference_samples_ /
+                                              stats.samples);
+  uint32_t seen = 0;
+  for (uint8_t i = 0; i < STATS_HISTOGRAM_BINS; i++) {
+    seen += this->reference_histogram_[i];
+    if (seen > rank) {
+      return std::log2(static_cast<float>(i * 4 + 3) / STATS_CLIP_HIGH);
+    }
+  }
+  return 0.0f;
+}
+
+uint8_t AutoExposureController::gain_index_for_(float multiplier) const {
+  // Table monotone : premier index >= multiplicateur, puis le plus proche en log
+  const float *begin = this->gains_;
+  const float *end = this->gains_ + this->gain_count_;
+  const float *it = std::lower_bound(begin, end, multiplier);
+  if (it == end) {
+    return this->gain_count_ - 1;
+  }
+  if (it != begin && multiplier / *(it - 1) < *it / multiplier) {
+    --it;
+  }
+  return static_cast<uint8_t>(it - begin);
+}
+
+bool AutoExposureController::process(const FrameStats &stats, uint32_t frame_exposure,
+                                     uint8_t frame_gain_index, int64_t capture_us, Decision &out) {
+  if (!stats.valid) {
+    return false;
+  }
+
+  // Compensation du retard capteur : mesurer uniquement une frame exposée avec la dernière écriture
+  if (frame_exposure != this->written_exposure_ || frame_gain_index != this->written_gain_index_) {
+    return false;
+  }
+
+  const float measured = std::max<float>(1.0f, stats.center_weighted_luma());
+  const float measured_ev = std::log2(measured);
+  const float error_ev = std::log2(static_cast<float>(this->target_)) - measured_ev;
+  const float total = static_cast<float>(frame_exposure) * this->gain_multiplier(frame_gain_index);
+  const float total_ev = std::log2(total);
+
+  if (this->converged_) {
+    if (std::fabs(error_ev) < AE_DISTURBED_EV) {
+      this->store_reference_(stats);
+      return false;
+    }
+    this->converged_ = false;
+    this->has_previous_ = false;
+    this->disturbance_sequence_ = stats.sequence;
+    this->disturbance_us_ = capture_us;
+  } else if (std::fabs(error_ev) < AE_CONVERGED_EV) {
+    this->store_reference_(stats);
+    this->converged_ = true;
+    this->last_convergence_frames_ = stats.sequence - this->disturbance_sequence_;
+    this->last_convergence_ms_ = static_cast<uint32_t>((capture_us - this->disturbance_us_) / 1000);
+    return false;
+  }
+
+  // Plus de la moitié de l'image saturée : la mesure ne dit plus rien de l'écart réel
+  const bool saturated = stats.clipped_high * 2 > stats.samples;
+
+  // Sécante dans le domaine log : la réponse observée au pas précédent corrige le suivant
+  float slope = 1.0f;
+  if (this->has_previous_ && !saturated && std::fabs(total_ev - this->previous_total_ev_) > 0.05f) {
+    slope = (measured_ev - this->previous_measured_ev_) / (total_ev - this->previous_total_ev_);
+    slope = std::max(AE_MIN_SLOPE, std::min(1.0f, slope));
+  }
+  this->previous_measured_ev_ = measured_ev;
+  this->previous_total_ev_ = total_ev;
+  this->has_previous_ = !saturated;
+
+  float step_ev = std::max(-AE_MAX_STEP_EV, std::min(AE_MAX_STEP_EV, error_ev * AE_STEP_GAIN / slope));
+  if (error_ev < 0 && saturated) {
+    // Sans référence, pas maximal ; l'écart mesuré reste un minimum (luma sous-estimée par la saturation)
+    const float estimate = this->reference_samples_ > 0 ? this->saturated_step_ev_(stats) : -AE_MAX_STEP_EV;
+    step_ev = std::max(-AE_MAX_SATURATED_STEP_EV, std::min(error_ev, estimate));
+  }
+  const float wanted = total * std::exp2(step_ev);
+
+  // Exposition d'abord (moins de bruit), le gain ne couvre que le reste
+  const uint32_t exposure = static_cast<uint32_t>(
+    std::max<float>(this->exposure_min_, std::min<float>(this->exposure_max_, wanted)));
+  const uint8_t gain_index = this->gain_index_for_(wanted / static_cast<float>(exposure));
+
+  if (exposure == frame_exposure && gain_index == frame_gain_index) {
+    // Butée (exposition et gain aux limites) : rien de plus à faire
+    this->converged_ = true;
+    this->last_convergence_frames_ = stats.sequence - this->disturbance_sequence_;
+    this->last_convergence_ms_ = static_cast<uint32_t>((capture_us - this->disturbance_us_) / 1000);
+    return false;
+  }
+
+  this->written_exposure_ = exposure;
+  this->written_gain_index_ = gain_index;
+  out.exposure = exposure;
+  out.gain_index = gain_index;
+  return true;
+}
+
+}  // namespace mipi_dsi_cam
+}  // namespace esphome
+
+#endif  // USE_ESP32_VARIANT_ESP32P4 || USE_HOST
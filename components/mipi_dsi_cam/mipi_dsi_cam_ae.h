@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(USE_ESP32_VARIANT_ESP32P4) || defined(USE_HOST)
+
+#include "mipi_dsi_cam_stats.h"
+
+namespace esphome {
+namespace mipi_dsi_cam {
+
+class ISensorDriver;
+
+static constexpr uint16_t AE_MAX_GAIN_STEPS = 256;
+// Bornes d'exposition par défaut (unités registre 0x3e00-0x3e02, 1/16 de ligne)
+static constexpr uint16_t AE_EXPOSURE_MIN = 0x040;
+static constexpr uint16_t AE_EXPOSURE_MAX = 0xF00;
+
+/**
+ * @brief Régulateur d'exposition en boucle fermée
+ *
+ * Travaille sur l'exposition totale (exposition x gain linéaire) dans le
+ * domaine log : un pas proportionnel au log2(cible / mesure), corrigé par
+ * la pente observée au pas précédent (saturation) et borné, puis répartition exposition d'abord, gain ensuite (table de gains
+ * du capteur). Une mesure n'est prise en compte que si les métadonnées de
+ * la frame montrent la dernière écriture effectivement appliquée.
+ * Une frame saturée ne dit rien de l'écart : il est estimé en plaçant la
+ * limite de saturation sur l'histogramme de la dernière frame convergée.
+ */
+class AutoExposureController {
+ public:
+  struct Decision {
+    uint32_t exposure;
+    uint8_t gain_index;
+  };
+
+  void configure(const ISensorDriver *sensor, uint16_t exposure_min, uint16_t exposure_max);
+  void set_target(uint8_t target) {
+    if (target != this->target_) {
+      this->reference_samples_ = 0;
+    }
+    this->target_ = target;
+  }
+  uint8_t get_target() const { return this->target_; }
+
+  // Point de départ (valeurs déjà programmées au capteur)
+  void reset(uint32_t exposure, uint8_t gain_index);
+
+  /**
+   * @brief Traite les statistiques d'une frame
+   *
+   * @return true si une nouvelle exposition/gain doit être écrite (dans `out`)
+   */
+  bool process(const FrameStats &stats, uint32_t frame_exposure, uint8_t frame_gain_index,
+               int64_t capture_us, Decision &out);
+
+  bool is_converged() const { return this->converged_; }
+  // Dernière convergence mesurée : frames et durée depuis la perturbation
+  uint32_t get_last_convergence_frames() const { return this->last_convergence_frames_; }
+  uint32_t get_last_convergence_ms() const { return this->last_convergence_ms_; }
+
+  float gain_multiplier(uint8_t index) const;
+
+ protected:
+  uint8_t gain_index_for_(float multiplier) const;
+  void store_reference_(const FrameStats &stats);
+  // Pas (EV, négatif) ramenant une frame saturée à la référence ; 0 sans référence
+  float saturated_step_ev_(const FrameStats &stats) const;
+
+  float gains_[AE_MAX_GAIN_STEPS]{1.0f};
+  uint16_t gain_count_{1};
+  uint16_t exposure_min_{AE_EXPOSURE_MIN};
+  uint16_t exposure_max_{AE_EXPOSURE_MAX};
+  uint8_t target_{128};
+
+  // Dernière écriture, attendue dans les métadonnées avant toute nouvelle mesure
+  uint32_t written_exposure_{0};
+  uint8_t written_gain_index_{0};
+
+  // Mesure précédente (EV) pour estimer la pente de réponse du capteur
+  bool has_previous_{false};
+  float previous_measured_ev_{0.0f};
+  float previous_total_ev_{0.0f};
+
+  // Histogramme de la dernière frame convergée (à la cible), 0 échantillon = pas de référence
+  uint32_t reference_histogram_[STATS_HISTOGRAM_BINS]{};
+  uint32_t reference_samples_{0};
+
+  bool converged_{true};
+  uint32_t disturbance_sequence_{0};
+  int64_t disturbance_us_{0};
+  uint32_t last_convergence_frames_{0};
+  uint32_t last_convergence_ms_{0};
+};
+
+}  // namespace mipi_dsi_cam
+}  // namespace esphome
+
+#endif  // USE_ESP32_VARIANT_ESP32P4 || USE_HOST
@@ -0,0 +1,138 @@
+#include "mipi_dsi_cam_command_queue.h"
+#include "mipi_dsi_cam.h"
+
+#if defined(USE_ESP32_VARIANT_ESP32P4) || defined(USE_HOST)
+
+#include "esphome/core/log.h"
+
+namespace esphome {
+namespace mipi_dsi_cam {
+
+static const char *const TAG = "mipi_dsi_cam.cmdq";
+
+bool SensorCommandQueue::shadow_matches_(const SensorRegister &write) const {
+  for (size_t i = 0; i < this->shadow_count_; i++) {
+    if (this->shadow_[i].reg == write.reg) {
+      return this->shadow_[i].value == write.value;
+    }
+  }
+  return false;
+}
+
+void SensorCommandQueue::shadow_store_(const SensorRegister &write) {
+  for (size_t i = 0; i < this->shadow_count_; i++) {
+    if (this->shadow_[i].reg == write.reg) {
+      this->shadow_[i].value = write.value;
+      return;
+    }
+  }
+  if (this->shadow_count_ < SENSOR_SHADOW_REGISTERS) {
+    this->shadow_[this->shadow_count_++] = write;
+  }
+}
+
+esp_err_t SensorCommandQueue::flush() {
+  if (this->sensor_ == nullptr) {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  if (this->shadow_invalid_.exchange(false)) {
+    this->shadow_count_ = 0;
+  }
+
+  const uint32_t exposure_request = this->pending_exposure_.exchange(0);
+  const uint32_t gain_request = this->pending_gain_.exchange(0);
+  if (exposure_request == 0 && gain_request == 0) {
+    return ESP_OK;
+  }
+
+  const uint32_t exposure = exposure_request & VALUE_MASK;
+  const uint32_t gain_index = gain_request & VALUE_MASK;
+
+  // Décomposition en registres ; 0 registre = le driver écrit lui-même
+  SensorRegister writes[2 * SENSOR_MAX_SETTING_REGISTERS];
+  size_t count = 0;
+  bool direct_exposure = false;
+  bool direct_gain = false;
+  if (exposure_request != 0) {
+    size_t n = this->sensor_->get_exposure_registers(exposure, &writes[count]);
+    direct_exposure = n == 0;
+    count += n;
+  }
+  if (gain_request != 0) {
+    size_t n = this->sensor_->get_gain_registers(gain_index, &writes[count]);
+    direct_gain = n == 0;
+    count += n;
+  }
+
+  // Cache miroir : seules les valeurs qui changent partent sur le bus
+  size_t changed = 0;
+  for (size_t i = 0; i < count; i++) {
+    if (this->shadow_matches_(writes[i])) {
+      this->skipped_count_++;
+    } else {
+      writes[changed++] = writes[i];
+    }
+  }
+
+  esp_err_t ret = ESP_OK;
+  if (changed > 0 || direct_exposure || direct_gain) {
+    SensorRegister hold_begin;
+    SensorRegister hold_end;
+    const bool hold = this->sensor_->get_group_hold(&hold_begin, &hold_end);
+    if (hold) {
+      ret = this->sensor_->write_register(hold_begin.reg, hold_begin.value);
+    }
+
+    for (size_t i = 0; i < changed && ret == ESP_OK; i++) {
+      ret = this->sensor_->write_register(writes[i].reg, writes[i].value);
+      if (ret == ESP_OK) {
+        this->shadow_store_(writes[i]);
+        this->write_count_++;
+      }
+    }
+    if (ret == ESP_OK && direct_exposure) {
+      ret = this->sensor_->set_exposure(exposure);
+    }
+    if (ret == ESP_OK && direct_gain) {
+      ret = this->sensor_->set_gain(gain_index);
+    }
+
+    // Toujours relâcher le group hold, même après un échec
+    if (hold) {
+      esp_err_t release = this->sensor_->write_register(hold_end.reg, hold_end.value);
+      if (ret == ESP_OK) {
+        ret = release;
+      }
+    }
+  }
+
+  if (ret != ESP_OK) {
+    // État du capteur incertain : miroir invalidé, demandes rejouées au prochain flush si personne ne les a remplacées
+    ESP_LOGW(TAG, "Sensor command flush failed: %d", ret);
+    this->shadow_count_ = 0;
+    uint32_t expected = 0;
+    if (exposure_request != 0) {
+      this->pending_exposure_.compare_exchange_strong(expected, exposure_request);
+    }
+    expected = 0;
+    if (gain_request != 0) {
+      this->pending_gain_.compare_exchange_strong(expected, gain_request);
+    }
+    return ret;
+  }
+
+  if (exposure_request != 0) {
+    this->exposure_ = exposure;
+  }
+  if (gain_request != 0) {
+    this->gain_index_ = gain_index;
+  }
+  this->flush_count_++;
+  return ESP_OK;
+}
+
+}  // namespace mipi_dsi_cam
+}  // namespace esphome
+
+#endif  // USE_ESP32_VARIANT_ESP32P4 || USE_HOST
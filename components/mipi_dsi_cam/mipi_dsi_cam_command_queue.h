@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(USE_ESP32_VARIANT_ESP32P4) || defined(USE_HOST)
+
+#ifdef USE_HOST
+#include "mipi_dsi_cam_host.h"
+#else
+#include "esp_err.h"
+#endif
+
+namespace esphome {
+namespace mipi_dsi_cam {
+
+class ISensorDriver;
+
+struct SensorRegister {
+  uint16_t reg;
+  uint8_t value;
+};
+
+// Registres au plus par réglage (exposition ou gain)
+static constexpr size_t SENSOR_MAX_SETTING_REGISTERS = 4;
+// Registres suivis par le cache miroir
+static constexpr size_t SENSOR_SHADOW_REGISTERS = 16;
+
+/**
+ * @brief File de commandes capteur, vidée une fois par frame
+ *
+ * Les demandes d'exposition et de gain sont fusionnées (seule la dernière
+ * survit) et peuvent venir de n'importe quelle tâche. flush() les écrit
+ * depuis une seule tâche, encadrées par le group hold du capteur pour
+ * qu'elles prennent effet à la même frontière de frame ; un cache miroir
+ * supprime les écritures qui ne changent pas la valeur du registre.
+ * Un capteur qui ne décrit pas ses registres retombe sur set_exposure() /
+ * set_gain(), toujours fusionnés et synchronisés à la frame.
+ */
+class SensorCommandQueue {
+ public:
+  void set_sensor(ISensorDriver *sensor) {
+    this->sensor_ = sensor;
+    this->invalidate_shadow();
+  }
+
+  void queue_exposure(uint32_t exposure) { this->pending_exposure_.store(PENDING | (exposure & VALUE_MASK)); }
+  void queue_gain(uint32_t gain_index) { this->pending_gain_.store(PENDING | (gain_index & VALUE_MASK)); }
+  bool has_pending() const { return (this->pending_exposure_.load() | this->pending_gain_.load()) != 0; }
+
+  // Écrit les demandes en attente ; en cas d'échec elles restent en attente (sauf si remplacées)
+  esp_err_t flush();
+
+  // Le capteur a été écrit hors de la file (init, reset) : miroir vidé au prochain flush
+  void invalidate_shadow() { this->shadow_invalid_.store(true); }
+
+  // Valeurs effectivement écrites par le dernier flush réussi
+  uint32_t get_exposure() const { return this->exposure_; }
+  uint32_t get_gain_index() const { return this->gain_index_; }
+
+  uint32_t get_flush_count() const { return this->flush_count_; }
+  uint32_t get_write_count() const { return this->write_count_; }
+  uint32_t get_skipped_count() const { return this->skipped_count_; }
+
+ protected:
+  static constexpr uint32_t PENDING = 0x80000000u;
+  static constexpr uint32_t VALUE_MASK = 0x7FFFFFFFu;
+
+  bool shadow_matches_(const SensorRegister &write) const;
+  void shadow_store_(const SensorRegister &write);
+
+  ISensorDriver *sensor_{nullptr};
+  std::atomic<uint32_t> pending_exposure_{0};
+  std::atomic<uint32_t> pending_gain_{0};
+  std::atomic<bool> shadow_invalid_{false};
+
+  // Propres à la tâche qui appelle flush()
+  SensorRegister shadow_[SENSOR_SHADOW_REGISTERS]{};
+  size_t shadow_count_{0};
+  uint32_t exposure_{0};
+  uint32_t gain_index_{0};
+  uint32_t flush_count_{0};
+  uint32_t write_count_{0};
+  uint32_t skipped_count_{0};
+};
+
+}  // namespace mipi_dsi_cam
+}  // namespace esphome
+
+#endif  // USE_ESP32_VARIANT_ESP32P4 || USE_HOST
@@ -0,0 +1,267 @@
+#include "mipi_dsi_cam_frame_ring.h"
+
+#if defined(USE_ESP32_VARIANT_ESP32P4) || defined(USE_HOST)
+
+#ifndef USE_HOST
+#include "esp_heap_caps.h"
+#endif
+
+namespace esphome {
+namespace mipi_dsi_cam {
+
+bool FrameRing::allocate(uint8_t count, size_t size) {
+  this->free();
+
+  if (count == 0 || count > FRAME_RING_MAX_SLOTS || size == 0) {
+    return false;
+  }
+
+  for (uint8_t i = 0; i < count; i++) {
+    uint8_t *buffer = (uint8_t *) heap_caps_aligned_alloc(64, size, MALLOC_CAP_SPIRAM);
+    if (buffer == nullptr) {
+      this->count_ = i;
+      this->free();
+      return false;
+    }
+    this->slots_[i].buffer = buffer;
+    this->slots_[i].own_buffer = buffer;
+    this->slots_[i].index = i;
+    this->slots_[i].state.store(0, std::memory_order_relaxed);
+    this->slots_[i].meta = FrameMetadata();
+    this->slots_[i].wb_state.store(FrameSlot::WB_RAW, std::memory_order_relaxed);
+    this->slots_[i].valid_size = 0;
+  }
+
+  this->count_ = count;
+  this->size_ = size;
+  this->reset();
+  return true;
+}
+
+void FrameRing::free() {
+  for (uint8_t i = 0; i < this->count_; i++) {
+    if (this->slots_[i].own_buffer != nullptr) {
+      heap_caps_free(this->slots_[i].own_buffer);
+      this->slots_[i].own_buffer = nullptr;
+    }
+    this->slots_[i].buffer = nullptr;
+  }
+  this->count_ = 0;
+  this->size_ = 0;
+  this->latest_.store(-1, std::memory_order_relaxed);
+}
+
+void FrameRing::reset() {
+  // Le DMA est arrêté : on libère les slots qu'il possédait, les lecteurs gardent leurs références
+  for (uint8_t i = 0; i < this->count_; i++) {
+    this->slots_[i].state.fetch_and(REF_MASK, std::memory_order_acq_rel);
+  }
+  this->latest_.store(-1, std::memory_order_release);
+  this->next_capture_ = 0;
+  this->overruns_.store(0, std::memory_order_relaxed);
+  this->skips_.store(0, std::memory_order_relaxed);
+}
+
+bool IRAM_ATTR FrameRing::try_claim_(FrameSlot *slot) {
+  uint32_t expected = 0;
+  return slot->state.compare_exchange_strong(expected, CAPTURING, std::memory_order_acquire,
+                                             std::memory_order_relaxed);
+}
+
+bool IRAM_ATTR FrameRing::try_recycle_(FrameSlot *slot) {
+  if (!this->try_claim_(slot)) {
+    return false;
+  }
+  // Buffer prêté déjà corrigé en place : son DQBUF doit encore retrouver ce slot, sinon la
+  // balance des blancs serait appliquée une seconde fois. Relu sous possession : un lecteur a
+  // pu corriger le slot juste avant la prise.
+  if (slot->is_external() && slot->wb_state.load(std::memory_order_acquire) != FrameSlot::WB_RAW) {
+    slot->state.store(0, std::memory_order_release);
+    return false;
+  }
+  return true;
+}
+
+FrameSlot *IRAM_ATTR FrameRing::claim_for_capture(uint8_t *external) {
+  if (this->count_ == 0) {
+    return nullptr;
+  }
+  if (external != nullptr) {
+    return this->claim_external_(external);
+  }
+
+  const int8_t latest = this->latest_.load(std::memory_order_relaxed);
+
+  // 1. Un slot libre autre que la dernière frame complète
+  for (uint8_t n = 0; n < this->count_; n++) {
+    uint8_t i = (this->next_capture_ + n) % this->count_;
+    if (i == latest) {
+      continue;
+    }
+    if (this->try_recycle_(&this->slots_[i])) {
+      this->next_capture_ = (i + 1) % this->count_;
+      this->slots_[i].buffer = this->slots_[i].own_buffer;
+      return &this->slots_[i];
+    }
+  }
+
+  // 2. Tous les autres slots sont épinglés : recycler la dernière frame si personne ne la lit
+  if (latest >= 0 && this->try_recycle_(&this->slots_[latest])) {
+    this->latest_.store(-1, std::memory_order_release);
+    this->overruns_.fetch_add(1, std::memory_order_relaxed);
+    this->slots_[latest].buffer = this->slots_[latest].own_buffer;
+    return &this->slots_[latest];
+  }
+
+  // 3. Aucun slot libre : la frame part dans le buffer de secours du driver
+  this->skips_.fetch_add(1, std::memory_order_relaxed);
+  return nullptr;
+}
+
+FrameSlot *IRAM_ATTR FrameRing::claim_external_(uint8_t *buffer) {
+  // Buffer encore publié par un slot : c'est ce slot qu'on reprend, ses lecteurs le protègent
+  for (uint8_t i = 0; i < this->count_; i++) {
+    FrameSlot *slot = &this->slots_[i];
+    if (slot->buffer != buffer) {
+      continue;
+    }
+    if (!this->try_claim_(slot)) {
+      return nullptr;
+    }
+    // Rendu par son propriétaire : la frame qu'il portait n'a plus à rester lisible
+    int8_t expected = static_cast<int8_t>(i);
+    this->latest_.compare_exchange_strong(expected, -1, std::memory_order_release, std::memory_order_relaxed);
+    return slot;
+  }
+
+  // Sinon un slot libre, de préférence un slot qui ne publie pas un autre buffer externe
+  const int8_t latest = this->latest_.load(std::memory_order_relaxed);
+  for (uint8_t pass = 0; pass < 2; pass++) {
+    for (uint8_t n = 0; n < this->count_; n++) {
+      uint8_t i = (this->next_capture_ + n) % this->count_;
+      FrameSlot *slot = &this->slots_[i];
+      if (i == latest || (pass == 0 && slot->is_external())) {
+        continue;
+      }
+      if (this->try_recycle_(slot)) {
+        this->next_capture_ = (i + 1) % this->count_;
+        slot->buffer = buffer;
+        return slot;
+      }
+    }
+  }
+
+  // Pas de slot : l'appelant rend le buffer et se rabat sur l'anneau (skip compté là)
+  return nullptr;
+}
+
+void IRAM_ATTR FrameRing::commit_capture(FrameSlot *slot, size_t received, const FrameMetadata &meta) {
+  slot->meta = meta;
+  slot->valid_size = received;
+  slot->wb_state.store(FrameSlot::WB_RAW, std::memory_order_relaxed);
+  slot->state.store(0, std::memory_order_release);
+  this->latest_.store(slot->index, std::memory_order_release);
+}
+
+void IRAM_ATTR FrameRing::abort_capture(FrameSlot *slot) {
+  slot->state.store(0, std::memory_order_release);
+}
+
+FrameSlot *IRAM_ATTR FrameRing::find_by_buffer(const void *buffer) {
+  for (uint8_t i = 0; i < this->count_; i++) {
+    if (this->slots_[i].buffer == buffer) {
+      return &this->slots_[i];
+    }
+  }
+  return nullptr;
+}
+
+FrameSlot *FrameRing::pin_latest(uint32_t last_sequence) {
+  const int8_t latest = this->latest_.load(std::memory_order_acquire);
+  if (latest < 0) {
+    return nullptr;
+  }
+
+  FrameSlot *slot = &this->slots_[latest];
+  if (!this->pin_(slot)) {
+    return nullptr;
+  }
+
+  // La séquence n'est lue qu'une fois la référence prise : elle ne peut plus changer
+  if (static_cast<int32_t>(slot->meta.sequence - last_sequence) <= 0) {
+    this->unpin(slot);
+    return nullptr;
+  }
+
+  return slot;
+}
+
+FrameSlot *FrameRing::pin_buffer(const void *buffer, uint32_t sequence) {
+  for (uint8_t i = 0; i < this->count_; i++) {
+    FrameSlot *slot = &this->slots_[i];
+    if (slot->buffer != buffer || !this->pin_(slot)) {
+      continue;
+    }
+    // Relu sous référence : le slot a pu changer de buffer avant d'être épinglé
+    if (slot->buffer == buffer && slot->meta.sequence == sequence) {
+      return slot;
+    }
+    this->unpin(slot);
+  }
+  return nullptr;
+}
+
+bool FrameRing::pin_(FrameSlot *slot) {
+  uint32_t state = slot->state.load(std::memory_order_relaxed);
+  do {
+    if (state & CAPTURING) {
+      // Le CSI a repris ce slot entre-temps
+      return false;
+    }
+  } while (!slot->state.compare_exchange_weak(state, state + 1, std::memory_order_acquire,
+                                              std::memory_order_relaxed));
+  return true;
+}
+
+FrameSlot *FrameRing::peek_latest() {
+  const int8_t latest = this->latest_.load(std::memory_order_acquire);
+  return latest < 0 ? nullptr : &this->slots_[latest];
+}
+
+void FrameRing::unpin(FrameSlot *slot) {
+  if (slot != nullptr) {
+    slot->state.fetch_sub(1, std::memory_order_release);
+  }
+}
+
+bool FrameRing::release_external() {
+  bool released = true;
+  for (uint8_t i = 0; i < this->count_; i++) {
+    FrameSlot *slot = &this->slots_[i];
+    if (!slot->is_external()) {
+      continue;
+    }
+    int8_t expected = static_cast<int8_t>(i);
+    this->latest_.compare_exchange_strong(expected, -1, std::memory_order_release, std::memory_order_relaxed);
+    // Capture interrompue par l'arrêt du DMA : le slot n'appartient plus au CSI
+    slot->state.fetch_and(REF_MASK, std::memory_order_acq_rel);
+    if (!this->try_claim_(slot)) {
+      released = false;
+      continue;
+    }
+    slot->buffer = slot->own_buffer;
+    slot->valid_size = 0;
+    slot->state.store(0, std::memory_order_release);
+  }
+  return released;
+}
+
+uint32_t FrameRing::get_latest_sequence() const {
+  const int8_t latest = this->latest_.load(std::memory_order_acquire);
+  return latest < 0 ? 0 : this->slots_[latest].meta.sequence;
+}
+
+}  // namespace mipi_dsi_cam
+}  // namespace esphome
+
+#endif  // USE_ESP32_VARIANT_ESP32P4 || USE_HOST
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(USE_ESP32_VARIANT_ESP32P4) || defined(USE_HOST)
+
+#ifdef USE_HOST
+#include "mipi_dsi_cam_host.h"
+#else
+#include "esp_attr.h"
+#endif
+
+namespace esphome {
+namespace mipi_dsi_cam {
+
+// Nombre maximum de slots dans l'anneau de frames
+static constexpr uint8_t FRAME_RING_MAX_SLOTS = 8;
+
+/**
+ * @brief Métadonnées attachées à chaque frame, figées dans l'ISR de fin de frame
+ */
+struct FrameMetadata {
+  int64_t capture_us{0};        // esp_timer_get_time() à la fin du DMA
+  uint32_t sequence{0};
+  uint16_t exposure{0};         // Exposition programmée au capteur
+  uint8_t gain_index{0};        // Index dans la table de gain du capteur
+  uint16_t wb_red_gain{256};    // Gains WB logiciels (8.8 fixe)
+  uint16_t wb_green_gain{256};
+  uint16_t wb_blue_gain{256};
+  uint32_t dropped_before{0};   // Frames perdues par le CSI depuis la frame précédente
+  uint8_t pixel_format{0};      // PixelFormat du contenu (le mode RAW peut changer en cours de flux)
+};
+
+/**
+ * @brief Slot de l'anneau : un buffer DMA + son compteur de références
+ *
+ * Le mot d'état encode à la fois la possession par le CSI (bit CAPTURING)
+ * et le nombre de lecteurs qui ont épinglé la frame (bits bas).
+ * Un slot n'est donné au DMA que si ce mot vaut 0.
+ */
+struct FrameSlot {
+  // États de la balance des blancs appliquée en place dans le buffer
+  static constexpr uint8_t WB_RAW = 0;
+  static constexpr uint8_t WB_APPLYING = 1;
+  static constexpr uint8_t WB_APPLIED = 2;
+
+  uint8_t *buffer{nullptr};      // Buffer de la frame courante : propre ou prêté (zéro copie)
+  uint8_t *own_buffer{nullptr};  // Buffer alloué par l'anneau
+  std::atomic<uint32_t> state{0};
+  std::atomic<uint8_t> wb_state{WB_RAW};  // Remis à WB_RAW à chaque nouvelle capture
+  FrameMetadata meta;
+  volatile size_t valid_size{0};
+  uint8_t index{0};
+
+  bool is_external() const { return this->buffer != this->own_buffer; }
+};
+
+/**
+ * @brief Anneau de N buffers de frames à comptage de références
+ *
+ * Remplace le double buffer : le CSI écrit toujours dans un slot libre
+ * (aucun lecteur), la dernière frame complète reste lisible tant qu'un
+ * autre slot est disponible. Quand tous les slots sont épinglés, la frame
+ * est abandonnée (skip) au lieu d'écraser un buffer en cours de lecture.
+ *
+ * Un slot peut aussi capturer dans un buffer externe (buffer V4L2 mis en
+ * file) : la frame est publiée normalement, sans copie. Un buffer externe
+ * n'est lié qu'à un seul slot à la fois ; une fois corrigé en place (WB),
+ * il ne quitte son slot qu'à sa remise en file ou à l'arrêt du DMA.
+ */
+class FrameRing {
+ public:
+  static constexpr uint32_t CAPTURING = 0x80000000u;
+  static constexpr uint32_t REF_MASK = 0x7FFFFFFFu;
+
+  ~FrameRing() { this->free(); }
+
+  bool allocate(uint8_t count, size_t size);
+  void free();
+  void reset();
+
+  uint8_t get_slot_count() const { return this->count_; }
+  size_t get_slot_size() const { return this->size_; }
+  FrameSlot *get_slot(uint8_t index) { return index < this->count_ ? &this->slots_[index] : nullptr; }
+
+  // Côté ISR CSI ; `external` : buffer prêté pour cette capture (nullptr = buffer du slot)
+  FrameSlot *claim_for_capture(uint8_t *external = nullptr);
+  void commit_capture(FrameSlot *slot, size_t received, const FrameMetadata &meta);
+  void abort_capture(FrameSlot *slot);
+  FrameSlot *find_by_buffer(const void *buffer);
+
+  // Côté consommateurs : épingle la dernière frame si sa séquence > last_sequence
+  FrameSlot *pin_latest(uint32_t last_sequence);
+  // Épingle le slot qui publie encore `buffer`, si c'est toujours la frame `sequence`
+  FrameSlot *pin_buffer(const void *buffer, uint32_t sequence);
+  // Dernière frame complète, sans référence (usage legacy)
+  FrameSlot *peek_latest();
+  void unpin(FrameSlot *slot);
+  // DMA arrêté : plus aucun slot ne publie de buffer externe ; false tant qu'un lecteur en épingle un
+  bool release_external();
+
+  uint32_t get_latest_sequence() const;
+  // Frame complète recyclée avant d'avoir été lue (tous les autres slots épinglés)
+  uint32_t get_overrun_count() const { return this->overruns_.load(std::memory_order_relaxed); }
+  // Frame abandonnée par le CSI faute de slot libre
+  uint32_t get_skip_count() const { return this->skips_.load(std::memory_order_relaxed); }
+
+ protected:
+  bool try_claim_(FrameSlot *slot);
+  // Prise pour une autre frame que celle publiée (pas un buffer externe déjà corrigé en place)
+  bool try_recycle_(FrameSlot *slot);
+  FrameSlot *claim_external_(uint8_t *buffer);
+  bool pin_(FrameSlot *slot);
+
+  FrameSlot slots_[FRAME_RING_MAX_SLOTS];
+  uint8_t count_{0};
+  size_t size_{0};
+  std::atomic<int8_t> latest_{-1};
+  uint8_t next_capture_{0};
+
+  std::atomic<uint32_t> overruns_{0};
+  std::atomic<uint32_t> skips_{0};
+};
+
+}  // namespace mipi_dsi_cam
+}  // namespace esphome
+
+#endif  // USE_ESP32_VARIANT_ESP32P4 || USE_HOST
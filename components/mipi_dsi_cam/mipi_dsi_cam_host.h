@@ -0,0 +1,162 @@
+#pragma once
+
+/**
+ * @brief Équivalents Linux des primitives ESP-IDF / FreeRTOS utilisées par le coeur caméra
+ *
+ * Uniquement pour USE_HOST : permet de compiler l'anneau, les baux, wait_frame()
+ * et la télémétrie sur une machine de build, alimentés par SimFrameSource.
+ * Les ticks FreeRTOS sont des millisecondes (configTICK_RATE_HZ = 1000).
+ */
+
+#ifdef USE_HOST
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+
+// ---- esp_err / esp_attr ----
+typedef int esp_err_t;
+#ifndef ESP_OK
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERR_NO_MEM 0x101
+#define ESP_ERR_INVALID_ARG 0x102
+#define ESP_ERR_INVALID_STATE 0x103
+#define ESP_ERR_INVALID_SIZE 0x104
+#define ESP_ERR_NOT_FOUND 0x105
+#define ESP_ERR_NOT_SUPPORTED 0x106
+#define ESP_ERR_TIMEOUT 0x107
+#endif
+#ifndef IRAM_ATTR
+#define IRAM_ATTR
+#endif
+
+// ---- esp_heap_caps ----
+#define MALLOC_CAP_SPIRAM (1 << 10)
+#define MALLOC_CAP_DMA (1 << 3)
+#define MALLOC_CAP_8BIT (1 << 2)
+inline void *heap_caps_aligned_alloc(size_t alignment, size_t size, uint32_t /*caps*/) {
+  return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+}
+inline void heap_caps_free(void *ptr) { std::free(ptr); }
+
+// ---- esp_timer ----
+inline int64_t esp_timer_get_time() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// ---- esp_cpu ----
+// Pas de compteur de cycles portable : nanosecondes, soit les cycles d'un cœur nominal à 1 GHz
+inline uint32_t esp_cpu_get_cycle_count() {
+  return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                   std::chrono::steady_clock::now().time_since_epoch())
+                                   .count());
+}
+
+// ---- esp_cam_ctlr (transaction CSI simulée) ----
+typedef struct {
+  void *buffer;
+  size_t buflen;
+  size_t received_size;
+} esp_cam_ctlr_trans_t;
+typedef struct esp_cam_ctlr_t *esp_cam_ctlr_handle_t;
+typedef struct isp_processor_t *isp_proc_handle_t;
+typedef struct isp_awb_controller_t *isp_awb_ctlr_t;
+typedef struct esp_ldo_channel_t *esp_ldo_channel_handle_t;
+
+// ---- FreeRTOS : notifications de tâche (indexées) ----
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+#define configTASK_NOTIFICATION_ARRAY_ENTRIES 2
+#define pdFALSE 0
+#define pdTRUE 1
+#define portMAX_DELAY ((TickType_t) 0xFFFFFFFFu)
+#define pdMS_TO_TICKS(ms) ((TickType_t) (ms))
+
+struct HostTask {
+  std::mutex mutex;
+  std::condition_variable cv;
+  uint32_t notifications[configTASK_NOTIFICATION_ARRAY_ENTRIES]{};
+};
+typedef HostTask *TaskHandle_t;
+
+inline TaskHandle_t xTaskGetCurrentTaskHandle() {
+  thread_local HostTask task;
+  return &task;
+}
+
+inline TickType_t xTaskGetTickCount() {
+  return (TickType_t) std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+inline uint32_t ulTaskNotifyTakeIndexed(UBaseType_t index, BaseType_t clear_on_exit, TickType_t ticks) {
+  HostTask *task = xTaskGetCurrentTaskHandle();
+  uint32_t &notifications = task->notifications[index];
+  std::unique_lock<std::mutex> lock(task->mutex);
+  auto pending = [&notifications]() { return notifications > 0; };
+  if (ticks == portMAX_DELAY) {
+    task->cv.wait(lock, pending);
+  } else {
+    task->cv.wait_for(lock, std::chrono::milliseconds(ticks), pending);
+  }
+  uint32_t value = notifications;
+  if (value > 0) {
+    notifications = clear_on_exit ? 0 : value - 1;
+  }
+  return value;
+}
+
+inline void vTaskNotifyGiveIndexedFromISR(TaskHandle_t task, UBaseType_t index,
+                                          BaseType_t *higher_priority_task_woken) {
+  {
+    std::lock_guard<std::mutex> lock(task->mutex);
+    task->notifications[index]++;
+  }
+  task->cv.notify_one();
+  if (higher_priority_task_woken != nullptr) {
+    *higher_priority_task_woken = pdTRUE;
+  }
+}
+
+// ---- FreeRTOS : mutex (attente illimitée uniquement) ----
+typedef std::mutex *SemaphoreHandle_t;
+inline SemaphoreHandle_t xSemaphoreCreateMutex() { return new std::mutex(); }
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t mutex, TickType_t /*ticks*/) {
+  mutex->lock();
+  return pdTRUE;
+}
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t mutex) {
+  mutex->unlock();
+  return pdTRUE;
+}
+
+inline BaseType_t xTaskNotifyGiveIndexed(TaskHandle_t task, UBaseType_t index) {
+  vTaskNotifyGiveIndexedFromISR(task, index, nullptr);
+  return pdTRUE;
+}
+
+inline void vTaskDelay(TickType_t ticks) { std::this_thread::sleep_for(std::chrono::milliseconds(ticks)); }
+
+// ---- I2C : le capteur simulé n'a pas de bus ----
+namespace esphome {
+namespace i2c {
+class I2CDevice {
+ public:
+  void set_i2c_address(uint8_t address) { this->address_ = address; }
+
+ protected:
+  uint8_t address_{0};
+};
+}  // namespace i2c
+}  // namespace esphome
+
+#endif  // USE_HOST
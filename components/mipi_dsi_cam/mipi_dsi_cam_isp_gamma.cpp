@@ -0,0 +1,54 @@
+#include "mipi_dsi_cam_isp_gamma.h"
+
+#if defined(USE_ESP32_VARIANT_ESP32P4) || defined(USE_HOST)
+
+namespace esphome {
+namespace mipi_dsi_cam {
+
+namespace {
+
+struct BuiltinCurve {
+  uint16_t key;
+  IspGammaCurve curve;
+};
+
+// Évaluées à la compilation : aucun calcul transcendant au runtime pour ces profils
+constexpr BuiltinCurve BUILTIN_CURVES[] = {
+    {100, isp_gamma_make_curve(100)},
+    {180, isp_gamma_make_curve(180)},
+    {220, isp_gamma_make_curve(220)},
+    {240, isp_gamma_make_curve(240)},
+    {ISP_GAMMA_KEY_SRGB, isp_gamma_make_curve(ISP_GAMMA_KEY_SRGB)},
+};
+
+// Garde-fou sur l'évaluation constexpr
+static_assert(BUILTIN_CURVES[0].curve.y[0] == 16 && BUILTIN_CURVES[0].curve.y[ISP_GAMMA_POINTS - 1] == 255,
+              "linear gamma curve must be the identity");
+
+}  // namespace
+
+const IspGammaCurve &IspGammaCache::get(float gamma) {
+  const uint16_t key = isp_gamma_key(gamma);
+  for (const auto &builtin : BUILTIN_CURVES) {
+    if (builtin.key == key) {
+      return builtin.curve;
+    }
+  }
+  for (const auto &entry : this->entries_) {
+    if (entry.key == key) {
+      return entry.curve;
+    }
+  }
+
+  Entry &entry = this->entries_[this->next_slot_];
+  this->next_slot_ = (this->next_slot_ + 1) % CACHE_SLOTS;
+  entry.key = key;
+  entry.curve = isp_gamma_make_curve(key);
+  this->miss_count_++;
+  return entry.curve;
+}
+
+}  // namespace mipi_dsi_cam
+}  // namespace esphome
+
+#endif  // USE_ESP32_VARIANT_ESP32P4 || USE_HOST
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(USE_ESP32_VARIANT_ESP32P4) || defined(USE_HOST)
+
+namespace esphome {
+namespace mipi_dsi_cam {
+
+// Points de la courbe gamma matérielle (ISP_GAMMA_CURVE_POINTS_NUM)
+static constexpr size_t ISP_GAMMA_POINTS = 16;
+
+// Gamma quantifié au centième : clé des tables et du cache
+static constexpr uint16_t ISP_GAMMA_SCALE = 100;
+// Valeur de gamma sélectionnant la courbe sRGB (segment linéaire + puissance 1/2.4)
+static constexpr float ISP_GAMMA_SRGB = 0.0f;
+static constexpr uint16_t ISP_GAMMA_KEY_SRGB = 0xFFFF;
+
+/**
+ * @brief Courbe gamma telle que la programme l'ISP (points 8 bits)
+ *
+ * L'ISP part d'une origine implicite (0, 0) et impose des écarts en
+ * puissance de 2 entre abscisses : points en (i + 1) * 16, le dernier
+ * ramené à 255.
+ */
+struct IspGammaCurve {
+  uint8_t x[ISP_GAMMA_POINTS];
+  uint8_t y[ISP_GAMMA_POINTS];
+};
+
+namespace gamma_math {
+
+// exp/log évaluables à la compilation (powf ne l'est pas)
+constexpr double exp(double v) {
+  int halvings = 0;
+  while (v > 0.5 || v < -0.5) {
+    v /= 2.0;
+    halvings++;
+  }
+  double term = 1.0;
+  double sum = 1.0;
+  for (int n = 1; n < 20; n++) {
+    term *= v / n;
+    sum += term;
+  }
+  while (halvings-- > 0) {
+    sum *= sum;
+  }
+  return sum;
+}
+
+constexpr double log(double v) {
+  // v = m * 2^k avec m dans [1, 2), puis ln(m) = 2 atanh((m - 1) / (m + 1))
+  int k = 0;
+  while (v >= 2.0) {
+    v /= 2.0;
+    k++;
+  }
+  while (v < 1.0) {
+    v *= 2.0;
+    k--;
+  }
+  const double z = (v - 1.0) / (v + 1.0);
+  double term = z;
+  double sum = 0.0;
+  for (int n = 1; n < 40; n += 2) {
+    sum += term / n;
+    term *= z * z;
+  }
+  return 2.0 * sum + k * 0.69314718055994531;
+}
+
+constexpr double pow(double base, double exponent) { return base <= 0.0 ? 0.0 : exp(exponent * log(base)); }
+
+constexpr double encode(uint16_t key, double x) {
+  if (key == ISP_GAMMA_KEY_SRGB) {
+    return x <= 0.0031308 ? 12.92 * x : 1.055 * pow(x, 1.0 / 2.4) - 0.055;
+  }
+  return pow(x, static_cast<double>(ISP_GAMMA_SCALE) / key);
+}
+
+}  // namespace gamma_math
+
+// Même calcul à la compilation (tables par défaut) et à l'exécution (cache)
+constexpr IspGammaCurve isp_gamma_make_curve(uint16_t key) {
+  IspGammaCurve curve{};
+  for (size_t i = 0; i < ISP_GAMMA_POINTS; i++) {
+    const uint32_t x = (i + 1) * (256 / ISP_GAMMA_POINTS);
+    curve.x[i] = static_cast<uint8_t>(x > 255 ? 255 : x);
+    const double y = gamma_math::encode(key, curve.x[i] / 255.0) * 255.0 + 0.5;
+    curve.y[i] = static_cast<uint8_t>(y > 255.0 ? 255.0 : y);
+  }
+  return curve;
+}
+
+// gamma <= 0 : courbe sRGB
+inline uint16_t isp_gamma_key(float gamma) {
+  if (gamma <= 0.0f) {
+    return ISP_GAMMA_KEY_SRGB;
+  }
+  const float scaled = gamma * ISP_GAMMA_SCALE + 0.5f;
+  return scaled < 1.0f ? 1 : (scaled > 60000.0f ? 60000 : static_cast<uint16_t>(scaled));
+}
+
+/**
+ * @brief Courbes gamma : tables par défaut précalculées + cache des autres valeurs
+ *
+ * 1.0, 1.8, 2.2, 2.4 et sRGB sont calculées à la compilation ; tout autre
+ * gamma est calculé une fois puis mémorisé dans CACHE_SLOTS entrées
+ * (remplacement circulaire). Changer de profil coûte une copie de table.
+ * Non thread-safe : une instance par propriétaire.
+ */
+class IspGammaCache {
+ public:
+  static constexpr uint8_t CACHE_SLOTS = 4;
+
+  const IspGammaCurve &get(float gamma);
+
+  uint32_t get_miss_count() const { return this->miss_count_; }
+
+ protected:
+  struct Entry {
+    uint16_t key{0};  // 0 = libre
+    IspGammaCurve curve{};
+  };
+
+  Entry entries_[CACHE_SLOTS];
+  uint8_t next_slot_{0};
+  uint32_t miss_count_{0};
+};
+
+}  // namespace mipi_dsi_cam
+}  // namespace esphome
+
+#endif  // USE_ESP32_VARIANT_ESP32P4 || USE_HOST
@@ -0,0 +1,337 @@
+#include "mipi_dsi_cam_isp_model.h"
+
+#if defined(USE_ESP32_VARIANT_ESP32P4) || defined(USE_HOST)
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#ifdef USE_HOST
+#include "mipi_dsi_cam_host.h"
+#else
+#include "esp_timer.h"
+#endif
+
+namespace esphome {
+namespace mipi_dsi_cam {
+
+// Réflexion sans répétition du bord : -1 -> 1, n -> n-2 (conserve la parité Bayer)
+static inline int isp_mirror(int i, int n) { return i < 0 ? -i : (i >= n ? 2 * n - 2 - i : i); }
+
+static inline uint8_t isp_clamp(int32_t v) { return v < 0 ? 0 : (v > 255 ? 255 : static_cast<uint8_t>(v)); }
+
+void IspModel::configure(const IspParams &params, uint8_t bayer_pattern) {
+  this->params_ = params;
+
+  // Position du rouge dans le quad Bayer (BGGR, GBRG, GRBG, RGGB)
+  static const uint8_t RED_POS[4][2] = {{1, 1}, {0, 1}, {1, 0}, {0, 0}};
+  this->red_x_ = RED_POS[bayer_pattern & 3][0];
+  this->red_y_ = RED_POS[bayer_pattern & 3][1];
+
+  // Filtre Bayer
+  this->bf_weight_sum_ = 0;
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      this->bf_weights_[i][j] = params.bf.kernel[i][j];
+      this->bf_weight_sum_ += params.bf.kernel[i][j];
+    }
+  }
+  this->bf_level_ = params.bf.enabled && this->bf_weight_sum_ > 0 ? std::min<int32_t>(20, params.bf.denoising_level) : 0;
+
+  // Dématriçage : désactivé = bilinéaire
+  const float ratio = std::min(1.0f, std::max(0.0f, params.demosaic.gradient_ratio));
+  this->grad_num_ = params.demosaic.enabled ? static_cast<int32_t>(lroundf(ratio * 256.0f)) : 0;
+
+  // CCM : la colonne j porte le gain WB du canal d'entrée j, comme dans start_ccm_()
+  const float gains[3] = {params.ccm.red_gain, params.ccm.green_gain, params.ccm.blue_gain};
+  this->ccm_identity_ = true;
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      float m = params.ccm.enabled ? params.ccm.matrix[i][j] * gains[j] : (i == j ? 1.0f : 0.0f);
+      this->ccm_[i][j] = static_cast<int32_t>(lroundf(m * 4096.0f));
+      this->ccm_identity_ &= this->ccm_[i][j] == (i == j ? 4096 : 0);
+    }
+  }
+
+  // Gamma : interpolation linéaire entre les points programmés dans l'ISP
+  if (params.gamma.enabled) {
+    const IspGammaCurve &curve = this->gamma_cache_.get(params.gamma.gamma);
+    const uint8_t *x = curve.x;
+    const uint8_t *y = curve.y;
+    // Premier segment depuis l'origine implicite (0, 0), comme le matériel
+    size_t seg = 0;
+    for (int v = 0; v < 256; v++) {
+      while (seg + 1 < ISP_GAMMA_POINTS && v > x[seg]) {
+        seg++;
+      }
+      const int x0 = seg == 0 ? 0 : x[seg - 1];
+      const int y0 = seg == 0 ? 0 : y[seg - 1];
+      const int x1 = x[seg];
+      const int y1 = y[seg];
+      if (v >= x1) {
+        this->gamma_lut_[v] = static_cast<uint8_t>(y1);
+      } else {
+        this->gamma_lut_[v] = static_cast<uint8_t>(y0 + ((y1 - y0) * (v - x0) + (x1 - x0) / 2) / (x1 - x0));
+      }
+    }
+  } else {
+    for (int v = 0; v < 256; v++) {
+      this->gamma_lut_[v] = static_cast<uint8_t>(v);
+    }
+  }
+
+  // Accentuation
+  this->sharpen_h_ = params.sharpen.enabled ? static_cast<int32_t>(lroundf(params.sharpen.h_coeff * 256.0f)) : 0;
+  this->sharpen_m_ = params.sharpen.enabled ? static_cast<int32_t>(lroundf(params.sharpen.m_coeff * 256.0f)) : 0;
+
+  // Couleur : contraste autour de 128 puis luminosité ; chroma tournée (teinte) et mise à l'échelle (saturation)
+  const IspColorParams &color = params.color;
+  for (int v = 0; v < 256; v++) {
+    this->luma_lut_[v] = isp_clamp(((v - 128) * color.contrast) / 128 + 128 + color.brightness);
+  }
+  const float hue = (color.hue % 360) * static_cast<float>(M_PI) / 180.0f;
+  const float sat = color.saturation / 128.0f;
+  this->chroma_uu_ = static_cast<int32_t>(lroundf(cosf(hue) * sat * 4096.0f));
+  this->chroma_uv_ = static_cast<int32_t>(lroundf(-sinf(hue) * sat * 4096.0f));
+  this->chroma_vu_ = static_cast<int32_t>(lroundf(sinf(hue) * sat * 4096.0f));
+  this->chroma_vv_ = this->chroma_uu_;
+  this->color_neutral_ = color.brightness == 0 && color.contrast == 128 && color.saturation == 128 &&
+                         (color.hue % 360) == 0;
+}
+
+bool IspModel::process(const uint8_t *raw, uint16_t width, uint16_t height, uint8_t *rgb565) {
+  if (raw == nullptr || rgb565 == nullptr || width < 4 || height < 4) {
+    return false;
+  }
+
+  const int64_t start_us = esp_timer_get_time();
+  const uint32_t stripes = (height + ISP_MODEL_STRIPE_ROWS - 1) / ISP_MODEL_STRIPE_ROWS;
+
+  uint32_t threads = this->thread_count_;
+  if (threads == 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  threads = std::min<uint32_t>({threads, ISP_MODEL_MAX_THREADS, stripes});
+
+  this->scratch_.resize(threads);
+  for (Scratch &scratch : this->scratch_) {
+    scratch.bayer.resize(static_cast<size_t>(ISP_MODEL_STRIPE_ROWS + 4) * width);
+    scratch.rgb.resize(static_cast<size_t>(ISP_MODEL_STRIPE_ROWS + 3) * width * 3);
+    scratch.luma.resize(static_cast<size_t>(ISP_MODEL_STRIPE_ROWS + 2) * width);
+  }
+
+  // Bandes entrelacées entre threads : charge équilibrée, résultat identique quel que soit le découpage
+  auto worker = [&](uint32_t index) {
+    for (uint32_t stripe = index; stripe < stripes; stripe += threads) {
+      const uint16_t y0 = stripe * ISP_MODEL_STRIPE_ROWS;
+      const uint16_t y1 = std::min<uint32_t>(height, y0 + ISP_MODEL_STRIPE_ROWS);
+      this->process_stripe_(raw, width, height, y0, y1, rgb565, this->scratch_[index]);
+    }
+  };
+
+  std::thread pool[ISP_MODEL_MAX_THREADS];
+  for (uint32_t i = 1; i < threads; i++) {
+    pool[i] = std::thread(worker, i);
+  }
+  worker(0);
+  for (uint32_t i = 1; i < threads; i++) {
+    pool[i].join();
+  }
+
+  this->last_thread_count_ = threads;
+  this->last_process_us_ = static_cast<uint32_t>(esp_timer_get_time() - start_us);
+  return true;
+}
+
+void IspModel::process_stripe_(const uint8_t *raw, uint16_t width, uint16_t height, uint16_t y0, uint16_t y1,
+                               uint8_t *rgb565, Scratch &scratch) const {
+  // Halo : 1 ligne RGB pour l'accentuation, donc 2 lignes Bayer filtrées pour le dématriçage
+  const int bayer_base = std::max(0, y0 - 2);
+  const int bayer_end = std::min<int>(height, y1 + 2);
+  const int rgb_base = std::max(0, y0 - 1);
+  const int rgb_end = std::min<int>(height, y1 + 1);
+  const bool sharpen = this->sharpen_h_ != 0 || this->sharpen_m_ != 0;
+
+  for (int y = bayer_base; y < bayer_end; y++) {
+    this->filter_row_(raw, width, height, y, &scratch.bayer[static_cast<size_t>(y - bayer_base) * width]);
+  }
+
+  for (int y = rgb_base; y < rgb_end; y++) {
+    uint8_t *rgb = &scratch.rgb[static_cast<size_t>(y - rgb_base) * width * 3];
+    this->demosaic_row_(scratch.bayer.data(), bayer_base, width, height, y, rgb);
+    if (sharpen) {
+      uint8_t *luma = &scratch.luma[static_cast<size_t>(y - rgb_base) * width];
+      for (uint16_t x = 0; x < width; x++) {
+        luma[x] = (rgb[x * 3] * 77 + rgb[x * 3 + 1] * 150 + rgb[x * 3 + 2] * 29 + 128) >> 8;
+      }
+    }
+  }
+
+  // Dernière ligne du tampon RGB : ligne de sortie (accentuée, puis ajustée en couleur)
+  uint8_t *line = &scratch.rgb[static_cast<size_t>(ISP_MODEL_STRIPE_ROWS + 2) * width * 3];
+  for (int y = y0; y < y1; y++) {
+    if (sharpen) {
+      this->sharpen_row_(scratch.rgb.data(), scratch.luma.data(), rgb_base, width, height, y, line);
+    } else {
+      std::memcpy(line, &scratch.rgb[static_cast<size_t>(y - rgb_base) * width * 3], static_cast<size_t>(width) * 3);
+    }
+    this->color_row_(line, width);
+
+    uint8_t *out = rgb565 + static_cast<size_t>(y) * width * 2;
+    for (uint16_t x = 0; x < width; x++) {
+      const uint16_t pixel = ((line[x * 3] >> 3) << 11) | ((line[x * 3 + 1] >> 2) << 5) | (line[x * 3 + 2] >> 3);
+      out[x * 2] = pixel & 0xFF;
+      out[x * 2 + 1] = pixel >> 8;
+    }
+  }
+}
+
+void IspModel::filter_row_(const uint8_t *raw, uint16_t width, uint16_t height, int y, uint8_t *out) const {
+  const uint8_t *center = raw + static_cast<size_t>(y) * width;
+  if (this->bf_level_ == 0) {
+    std::memcpy(out, center, width);
+    return;
+  }
+
+  // Voisins de même couleur : pas de 2 dans la mosaïque
+  const uint8_t *rows[3] = {
+      raw + static_cast<size_t>(isp_mirror(y - 2, height)) * width,
+      center,
+      raw + static_cast<size_t>(isp_mirror(y + 2, height)) * width,
+  };
+  for (int x = 0; x < width; x++) {
+    const int cols[3] = {isp_mirror(x - 2, width), x, isp_mirror(x + 2, width)};
+    int32_t acc = 0;
+    for (int i = 0; i < 3; i++) {
+      for (int j = 0; j < 3; j++) {
+        acc += this->bf_weights_[i][j] * rows[i][cols[j]];
+      }
+    }
+    const int32_t value = center[x];
+    const int32_t mean = (acc + this->bf_weight_sum_ / 2) / this->bf_weight_sum_;
+    out[x] = isp_clamp(value + ((mean - value) * this->bf_level_) / 20);
+  }
+}
+
+void IspModel::demosaic_row_(const uint8_t *bayer, int base, uint16_t width, uint16_t height, int y,
+                             uint8_t *rgb) const {
+  const uint8_t *up = bayer + static_cast<size_t>(isp_mirror(y - 1, height) - base) * width;
+  const uint8_t *mid = bayer + static_cast<size_t>(y - base) * width;
+  const uint8_t *down = bayer + static_cast<size_t>(isp_mirror(y + 1, height) - base) * width;
+
+  for (int x = 0; x < width; x++) {
+    const int xl = isp_mirror(x - 1, width);
+    const int xr = isp_mirror(x + 1, width);
+    const uint8_t site = this->site_color_(x, y);
+    int32_t c[3];
+
+    if (site == 1) {
+      // Vert : les voisins horizontaux portent la couleur de la ligne, les verticaux l'autre
+      const int32_t horizontal = (mid[xl] + mid[xr] + 1) >> 1;
+      const int32_t vertical = (up[x] + down[x] + 1) >> 1;
+      const bool red_row = this->site_color_(xr, y) == 0;
+      c[0] = red_row ? horizontal : vertical;
+      c[1] = mid[x];
+      c[2] = red_row ? vertical : horizontal;
+    } else {
+      // Rouge ou bleu : vert interpolé dans la direction du plus faible gradient, l'autre couleur en diagonale
+      const int32_t grad_h = std::abs(mid[xl] - mid[xr]);
+      const int32_t grad_v = std::abs(up[x] - down[x]);
+      int32_t green;
+      if (grad_h * 256 < grad_v * this->grad_num_) {
+        green = (mid[xl] + mid[xr] + 1) >> 1;
+      } else if (grad_v * 256 < grad_h * this->grad_num_) {
+        green = (up[x] + down[x] + 1) >> 1;
+      } else {
+        green = (mid[xl] + mid[xr] + up[x] + down[x] + 2) >> 2;
+      }
+      const int32_t diagonal = (up[xl] + up[xr] + down[xl] + down[xr] + 2) >> 2;
+      c[site] = mid[x];
+      c[1] = green;
+      c[2 - site] = diagonal;
+    }
+
+    if (!this->ccm_identity_) {
+      int32_t corrected[3];
+      for (int i = 0; i < 3; i++) {
+        corrected[i] = (this->ccm_[i][0] * c[0] + this->ccm_[i][1] * c[1] + this->ccm_[i][2] * c[2] + 2048) >> 12;
+      }
+      c[0] = corrected[0];
+      c[1] = corrected[1];
+      c[2] = corrected[2];
+    }
+
+    rgb[x * 3] = this->gamma_lut_[isp_clamp(c[0])];
+    rgb[x * 3 + 1] = this->gamma_lut_[isp_clamp(c[1])];
+    rgb[x * 3 + 2] = this->gamma_lut_[isp_clamp(c[2])];
+  }
+}
+
+void IspModel::sharpen_row_(const uint8_t *rgb, const uint8_t *luma, int base, uint16_t width, uint16_t height, int y,
+                            uint8_t *out) const {
+  const uint8_t *rows[3] = {
+      luma + static_cast<size_t>(isp_mirror(y - 1, height) - base) * width,
+      luma + static_cast<size_t>(y - base) * width,
+      luma + static_cast<size_t>(isp_mirror(y + 1, height) - base) * width,
+  };
+  const uint8_t *src = rgb + static_cast<size_t>(y - base) * width * 3;
+  const IspSharpenParams &params = this->params_.sharpen;
+  int32_t kernel_sum = 0;
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      kernel_sum += params.kernel[i][j];
+    }
+  }
+
+  for (int x = 0; x < width; x++) {
+    const int cols[3] = {isp_mirror(x - 1, width), x, isp_mirror(x + 1, width)};
+    // Hautes fréquences : pixel moins la moyenne pondérée par le gabarit passe-bas
+    int32_t hf = 0;
+    if (kernel_sum > 0) {
+      int32_t low = 0;
+      for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+          low += params.kernel[i][j] * rows[i][cols[j]];
+        }
+      }
+      hf = (kernel_sum * rows[1][x] - low) / kernel_sum;
+    }
+    const int32_t magnitude = std::abs(hf);
+    const int32_t coeff = magnitude > params.h_thresh ? this->sharpen_h_ : (magnitude > params.l_thresh ? this->sharpen_m_ : 0);
+    const int32_t delta = (hf * coeff) / 256;
+    out[x * 3] = isp_clamp(src[x * 3] + delta);
+    out[x * 3 + 1] = isp_clamp(src[x * 3 + 1] + delta);
+    out[x * 3 + 2] = isp_clamp(src[x * 3 + 2] + delta);
+  }
+}
+
+void IspModel::color_row_(uint8_t *rgb, uint16_t width) const {
+  if (this->color_neutral_) {
+    return;
+  }
+
+  // Luma BT.601 et différences de couleur B-Y / R-Y
+  for (int x = 0; x < width; x++) {
+    const int32_t r = rgb[x * 3];
+    const int32_t g = rgb[x * 3 + 1];
+    const int32_t b = rgb[x * 3 + 2];
+    const int32_t luma = (r * 77 + g * 150 + b * 29 + 128) >> 8;
+    const int32_t u = b - luma;
+    const int32_t v = r - luma;
+
+    const int32_t y2 = this->luma_lut_[luma];
+    const int32_t u2 = (this->chroma_uu_ * u + this->chroma_uv_ * v) / 4096;
+    const int32_t v2 = (this->chroma_vu_ * u + this->chroma_vv_ * v) / 4096;
+
+    rgb[x * 3] = isp_clamp(y2 + v2);
+    rgb[x * 3 + 1] = isp_clamp(y2 - (77 * v2 + 29 * u2) / 150);
+    rgb[x * 3 + 2] = isp_clamp(y2 + u2);
+  }
+}
+
+}  // namespace mipi_dsi_cam
+}  // namespace esphome
+
+#endif  // USE_ESP32_VARIANT_ESP32P4 || USE_HOST
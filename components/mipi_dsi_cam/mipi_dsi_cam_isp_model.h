@@ -0,0 +1,118 @@
+#pragma once
+
+#include "mipi_dsi_cam_isp_gamma.h"
+#include "mipi_dsi_cam_isp_params.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined(USE_ESP32_VARIANT_ESP32P4) || defined(USE_HOST)
+
+namespace esphome {
+namespace mipi_dsi_cam {
+
+// Lignes traitées par bande : le travail d'une bande (halo compris) reste en cache
+static constexpr uint16_t ISP_MODEL_STRIPE_ROWS = 16;
+static constexpr uint8_t ISP_MODEL_MAX_THREADS = 8;
+
+/**
+ * @brief Modèle logiciel du pipeline ISP : RAW8 Bayer -> RGB565
+ *
+ * Exécute sur CPU les blocs que MipiDsiCamISPPipeline programme dans l'ISP,
+ * à partir des mêmes IspParams : filtre Bayer 3x3, dématriçage à gradient,
+ * CCM 3x3 (gains WB repliés), gamma, accentuation à seuils h/l, puis
+ * luminosité / contraste / saturation / teinte. Sert de référence pour les
+ * images dorées et les benchmarks sur l'hôte, et de repli CPU pour une
+ * frame capturée en RAW8.
+ *
+ * L'image est découpée en bandes de ISP_MODEL_STRIPE_ROWS lignes, chacune
+ * traitée de bout en bout (avec un halo de 4 lignes Bayer) pour rester en
+ * cache ; les bandes sont réparties entre plusieurs threads. Le résultat ne
+ * dépend ni du découpage ni du nombre de threads. Les bords sont étendus
+ * par réflexion, ce qui conserve la parité de la mosaïque.
+ */
+class IspModel {
+ public:
+  // Précalcule tables et coefficients ; à rappeler après tout changement de paramètres
+  void configure(const IspParams &params, uint8_t bayer_pattern);
+
+  // 0 = un thread par cœur (borné à ISP_MODEL_MAX_THREADS)
+  void set_thread_count(uint8_t threads) { this->thread_count_ = threads; }
+
+  /**
+   * @brief Traite une frame RAW8 complète
+   * @param raw Mosaïque Bayer, width octets par ligne
+   * @param rgb565 Sortie RGB565 little-endian, width * 2 octets par ligne
+   * @return false si l'image est trop petite (moins de 4x4)
+   */
+  bool process(const uint8_t *raw, uint16_t width, uint16_t height, uint8_t *rgb565);
+
+  const IspParams &get_params() const { return this->params_; }
+  // Durée du dernier process(), pour les benchmarks
+  uint32_t get_last_process_us() const { return this->last_process_us_; }
+  uint8_t get_last_thread_count() const { return this->last_thread_count_; }
+
+ protected:
+  // Tampons intermédiaires propres à un thread
+  struct Scratch {
+    std::vector<uint8_t> bayer;  // Mosaïque filtrée, bande + halo de 2 lignes
+    std::vector<uint8_t> rgb;    // RGB888 après CCM/gamma, bande + halo d'une ligne
+    std::vector<uint8_t> luma;   // Luma des lignes RGB pour l'accentuation
+  };
+
+  void process_stripe_(const uint8_t *raw, uint16_t width, uint16_t height, uint16_t y0, uint16_t y1,
+                       uint8_t *rgb565, Scratch &scratch) const;
+  void filter_row_(const uint8_t *raw, uint16_t width, uint16_t height, int y, uint8_t *out) const;
+  void demosaic_row_(const uint8_t *bayer, int base, uint16_t width, uint16_t height, int y, uint8_t *rgb) const;
+  void sharpen_row_(const uint8_t *rgb, const uint8_t *luma, int base, uint16_t width, uint16_t height, int y,
+                    uint8_t *out) const;
+  void color_row_(uint8_t *rgb, uint16_t width) const;
+
+  // Couleur du site (x, y) : 0 = rouge, 1 = vert, 2 = bleu
+  uint8_t site_color_(int x, int y) const {
+    const bool red_column = (x & 1) == this->red_x_;
+    const bool red_row = (y & 1) == this->red_y_;
+    return red_column && red_row ? 0 : (!red_column && !red_row ? 2 : 1);
+  }
+
+  IspParams params_;
+  uint8_t red_x_{1};
+  uint8_t red_y_{1};
+
+  // Filtre Bayer : poids entiers et force (0-20)
+  int32_t bf_weights_[3][3]{};
+  int32_t bf_weight_sum_{9};
+  int32_t bf_level_{0};
+
+  // Dématriçage : direction retenue si grad * ratio_den < grad_orthogonal * ratio_num
+  int32_t grad_num_{0};
+
+  // CCM Q12 (gains WB inclus) et LUT gamma 256 entrées
+  int32_t ccm_[3][3]{};
+  bool ccm_identity_{true};
+  uint8_t gamma_lut_[256]{};
+  IspGammaCache gamma_cache_;
+
+  // Accentuation : coefficients Q8
+  int32_t sharpen_h_{0};
+  int32_t sharpen_m_{0};
+
+  // Couleur : LUT luma (luminosité + contraste), rotation/saturation chroma Q12
+  uint8_t luma_lut_[256]{};
+  int32_t chroma_uu_{4096};
+  int32_t chroma_uv_{0};
+  int32_t chroma_vu_{0};
+  int32_t chroma_vv_{4096};
+  bool color_neutral_{true};
+
+  uint8_t thread_count_{0};
+  uint8_t last_thread_count_{1};
+  uint32_t last_process_us_{0};
+  std::vector<Scratch> scratch_;
+};
+
+}  // namespace mipi_dsi_cam
+}  // namespace esphome
+
+#endif  // USE_ESP32_VARIANT_ESP32P4 || USE_HOST
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(USE_ESP32_VARIANT_ESP32P4) || defined(USE_HOST)
+
+namespace esphome {
+namespace mipi_dsi_cam {
+
+/**
+ * @brief Paramètres des blocs ISP, partagés par MipiDsiCamISPPipeline et IspModel
+ *
+ * Structures sans dépendance ESP-IDF : le pipeline les traduit en
+ * esp_isp_*_config_t, le modèle logiciel les exécute sur l'hôte.
+ */
+struct IspBayerFilterParams {
+  bool enabled{true};
+  uint8_t denoising_level{8};  // 0-20
+  // Poids des 3x3 voisins de même couleur (pas de 2 pixels dans la mosaïque)
+  uint8_t kernel[3][3]{{1, 1, 1}, {1, 1, 1}, {1, 1, 1}};
+};
+
+struct IspDemosaicParams {
+  bool enabled{true};
+  // Une direction d'interpolation n'est choisie que si son gradient est
+  // inférieur à ratio x le gradient orthogonal (0 = toujours bilinéaire)
+  float gradient_ratio{0.5f};
+};
+
+struct IspCcmParams {
+  bool enabled{true};
+  float matrix[3][3]{{1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f, 1.0f}};
+  // Gains de balance des blancs, repliés dans les colonnes de la matrice
+  float red_gain{1.0f};
+  float green_gain{1.0f};
+  float blue_gain{1.0f};
+};
+
+struct IspGammaParams {
+  bool enabled{true};
+  float gamma{2.2f};  // 1.0 = linéaire, ISP_GAMMA_SRGB = courbe sRGB
+};
+
+struct IspSharpenParams {
+  bool enabled{true};
+  uint8_t h_thresh{100};  // Au-delà : hautes fréquences (h_coeff)
+  uint8_t l_thresh{50};   // En dessous : bruit, non accentué ; entre les deux : m_coeff
+  float h_coeff{0.8f};
+  float m_coeff{0.5f};
+  // Gabarit passe-bas : hautes fréquences = pixel - moyenne pondérée (poids non signés côté ISP)
+  uint8_t kernel[3][3]{{1, 2, 1}, {2, 4, 2}, {1, 2, 1}};
+};
+
+struct IspColorParams {
+  int8_t brightness{0};     // -128..127, 0 = neutre
+  uint8_t contrast{128};    // 128 = neutre
+  uint8_t saturation{128};  // 128 = neutre
+  uint16_t hue{0};          // Degrés
+};
+
+struct IspParams {
+  IspBayerFilterParams bf;
+  IspDemosaicParams demosaic;
+  IspCcmParams ccm;
+  IspGammaParams gamma;
+  IspSharpenParams sharpen;
+  IspColorParams color;
+};
+
+// Comparaisons champ à champ : un bloc n'est reprogrammé que si ses paramètres changent
+inline bool operator==(const IspBayerFilterParams &a, const IspBayerFilterParams &b) {
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      if (a.kernel[i][j] != b.kernel[i][j]) {
+        return false;
+      }
+    }
+  }
+  return a.enabled == b.enabled && a.denoising_level == b.denoising_level;
+}
+
+inline bool operator==(const IspDemosaicParams &a, const IspDemosaicParams &b) {
+  return a.enabled == b.enabled && a.gradient_ratio == b.gradient_ratio;
+}
+
+inline bool operator==(const IspCcmParams &a, const IspCcmParams &b) {
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      if (a.matrix[i][j] != b.matrix[i][j]) {
+        return false;
+      }
+    }
+  }
+  return a.enabled == b.enabled && a.red_gain == b.red_gain && a.green_gain == b.green_gain &&
+         a.blue_gain == b.blue_gain;
+}
+
+inline bool operator==(const IspGammaParams &a, const IspGammaParams &b) {
+  return a.enabled == b.enabled && a.gamma == b.gamma;
+}
+
+inline bool operator==(const IspSharpenParams &a, const IspSharpenParams &b) {
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      if (a.kernel[i][j] != b.kernel[i][j]) {
+        return false;
+      }
+    }
+  }
+  return a.enabled == b.enabled && a.h_thresh == b.h_thresh && a.l_thresh == b.l_thresh && a.h_coeff == b.h_coeff &&
+         a.m_coeff == b.m_coeff;
+}
+
+inline bool operator==(const IspColorParams &a, const IspColorParams &b) {
+  return a.brightness == b.brightness && a.contrast == b.contrast && a.saturation == b.saturation && a.hue == b.hue;
+}
+
+inline bool operator!=(const IspBayerFilterParams &a, const IspBayerFilterParams &b) { return !(a == b); }
+inline bool operator!=(const IspDemosaicParams &a, const IspDemosaicParams &b) { return !(a == b); }
+inline bool operator!=(const IspCcmParams &a, const IspCcmParams &b) { return !(a == b); }
+inline bool operator!=(const IspGammaParams &a, const IspGammaParams &b) { return !(a == b); }
+inline bool operator!=(const IspSharpenParams &a, const IspSharpenParams &b) { return !(a == b); }
+inline bool operator!=(const IspColorParams &a, const IspColorParams &b) { return !(a == b); }
+
+}  // namespace mipi_dsi_cam
+}  // namespace esphome
+
+#endif  // USE_ESP32_VARIANT_ESP32P4 || USE_HOST
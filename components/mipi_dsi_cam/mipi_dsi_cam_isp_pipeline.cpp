@@ -2,6 +2,7 @@
 
 #include "mipi_dsi_cam_isp_pipeline.h"
 #include "esphome/core/log.h"
+#include <algorithm>
 #include <cmath>
 
 #ifdef USE_ESP32_VARIANT_ESP32P4
@@ -23,10 +24,7 @@ namespace mipi_dsi_cam {
 static const char *TAG = "mipi_dsi_cam.isp_pipeline";
 
 MipiDsiCamISPPipeline::MipiDsiCamISPPipeline(MipiDsiCam *camera) 
-  : camera_(camera) {
-  // Initialiser la matrice CCM par défaut (identité)
-  this->init_default_ccm_matrix_();
-}
+  : camera_(camera) {}
 
 MipiDsiCamISPPipeline::~MipiDsiCamISPPipeline() {
   if (this->pipeline_started_) {
@@ -66,24 +64,26 @@ esp_err_t MipiDsiCamISPPipeline::init() {
   // 6. Color management (luminosité, contraste, etc.)
   ESP_RETURN_ON_ERROR(this->init_color_(), TAG, "Failed to init Color");
   
-  // 7. AWB (Auto White Balance)
-  ESP_RETURN_ON_ERROR(this->init_awb_(), TAG, "Failed to init AWB");
-  
-  // 8. AE (Auto Exposure)
-  ESP_RETURN_ON_ERROR(this->init_ae_(), TAG, "Failed to init AE");
-  
-  // 9. Histogram
-  ESP_RETURN_ON_ERROR(this->init_histogram_(), TAG, "Failed to init Histogram");
+  // 7-9. Statistiques AWB / AE / histogramme : facultatives, la caméra retombe sur sa passe CPU
+  if (this->init_awb_() != ESP_OK) {
+    ESP_LOGW(TAG, "AWB statistics unavailable");
+  }
+  if (this->init_ae_() != ESP_OK) {
+    ESP_LOGW(TAG, "AE statistics unavailable");
+  }
+  if (this->init_histogram_() != ESP_OK) {
+    ESP_LOGW(TAG, "Histogram statistics unavailable");
+  }
   
   this->pipeline_initialized_ = true;
   
   ESP_LOGI(TAG, "✅ ISP pipeline initialized successfully");
   ESP_LOGI(TAG, "   Modules: BF=%s CCM=%s Sharpen=%s Gamma=%s Demosaic=%s",
-           this->bf_enabled_ ? "ON" : "OFF",
-           this->ccm_enabled_ ? "ON" : "OFF",
-           this->sharpen_enabled_ ? "ON" : "OFF",
-           this->gamma_enabled_ ? "ON" : "OFF",
-           this->demosaic_enabled_ ? "ON" : "OFF");
+           this->params_.bf.enabled ? "ON" : "OFF",
+           this->params_.ccm.enabled ? "ON" : "OFF",
+           this->params_.sharpen.enabled ? "ON" : "OFF",
+           this->params_.gamma.enabled ? "ON" : "OFF",
+           this->params_.demosaic.enabled ? "ON" : "OFF");
   
   return ESP_OK;
 }
@@ -101,42 +101,49 @@ esp_err_t MipiDsiCamISPPipeline::start() {
   
   ESP_LOGI(TAG, "▶️  Starting ISP pipeline...");
   
+  // Réglages faits pendant l'arrêt : pris en compte dès le démarrage
+  if (this->update_depth_ == 0) {
+    this->params_ = this->pending_;
+    this->dirty_ = 0;
+  }
+  
   // Démarrer les modules activés
-  if (this->bf_enabled_) {
+  if (this->params_.bf.enabled) {
     ESP_RETURN_ON_ERROR(this->start_bayer_filter_(), TAG, "Failed to start BF");
   }
   
-  if (this->demosaic_enabled_) {
+  if (this->params_.demosaic.enabled) {
     ESP_RETURN_ON_ERROR(this->start_demosaic_(), TAG, "Failed to start Demosaic");
   }
   
-  if (this->ccm_enabled_) {
+  if (this->params_.ccm.enabled) {
     ESP_RETURN_ON_ERROR(this->start_ccm_(), TAG, "Failed to start CCM");
   }
   
-  if (this->gamma_enabled_) {
+  if (this->params_.gamma.enabled) {
     ESP_RETURN_ON_ERROR(this->start_gamma_(), TAG, "Failed to start Gamma");
   }
   
-  if (this->sharpen_enabled_) {
+  if (this->params_.sharpen.enabled) {
     ESP_RETURN_ON_ERROR(this->start_sharpen_(), TAG, "Failed to start Sharpen");
   }
   
   ESP_RETURN_ON_ERROR(this->start_color_(), TAG, "Failed to start Color");
   
-  if (this->awb_enabled_) {
-    ESP_RETURN_ON_ERROR(this->start_awb_(), TAG, "Failed to start AWB");
+  if (this->awb_enabled_ && this->awb_ctlr_) {
+    this->start_awb_();
   }
   
-  if (this->ae_enabled_) {
-    ESP_RETURN_ON_ERROR(this->start_ae_(), TAG, "Failed to start AE");
+  if (this->ae_enabled_ && this->ae_ctlr_) {
+    this->start_ae_();
   }
   
-  if (this->histogram_enabled_) {
-    ESP_RETURN_ON_ERROR(this->start_histogram_(), TAG, "Failed to start Histogram");
+  if (this->histogram_enabled_ && this->hist_ctlr_) {
+    this->start_histogram_();
   }
   
   this->pipeline_started_ = true;
+  this->update_stats_expected_();
   ESP_LOGI(TAG, "✅ ISP pipeline started");
   
   return ESP_OK;
@@ -149,38 +156,33 @@ esp_err_t MipiDsiCamISPPipeline::stop() {
   
   ESP_LOGI(TAG, "⏸️  Stopping ISP pipeline...");
   
-  // Arrêter dans l'ordre inverse
-  if (this->histogram_enabled_) {
-    this->stop_histogram_();
-  }
-  
-  if (this->ae_enabled_) {
-    this->stop_ae_();
-  }
+  // La 3A cesse d'attendre des statistiques matérielles avant l'arrêt des contrôleurs
+  this->camera_->get_isp_stats_ring().set_expected(0);
   
-  if (this->awb_enabled_) {
-    this->stop_awb_();
-  }
+  // Arrêter dans l'ordre inverse
+  this->stop_histogram_();
+  this->stop_ae_();
+  this->stop_awb_();
   
   this->stop_color_();
   
-  if (this->sharpen_enabled_) {
+  if (this->params_.sharpen.enabled) {
     this->stop_sharpen_();
   }
   
-  if (this->gamma_enabled_) {
+  if (this->params_.gamma.enabled) {
     this->stop_gamma_();
   }
   
-  if (this->ccm_enabled_) {
+  if (this->params_.ccm.enabled) {
     this->stop_ccm_();
   }
   
-  if (this->demosaic_enabled_) {
+  if (this->params_.demosaic.enabled) {
     this->stop_demosaic_();
   }
   
-  if (this->bf_enabled_) {
+  if (this->params_.bf.enabled) {
     this->stop_bayer_filter_();
   }
   
@@ -219,6 +221,78 @@ esp_err_t MipiDsiCamISPPipeline::deinit() {
   return ESP_OK;
 }
 
+// ===== Mises à jour transactionnelles =====
+
+void MipiDsiCamISPPipeline::begin_update() {
+  this->update_depth_++;
+}
+
+esp_err_t MipiDsiCamISPPipeline::commit() {
+  if (this->update_depth_ == 0) {
+    ESP_LOGW(TAG, "commit() without begin_update()");
+    return ESP_ERR_INVALID_STATE;
+  }
+  this->update_depth_--;
+  return this->mark_dirty_(0);
+}
+
+esp_err_t MipiDsiCamISPPipeline::mark_dirty_(uint8_t block) {
+  this->dirty_ |= block;
+  // Pipeline arrêté : rien à programmer, les paramètres valent tout de suite
+  if (!this->pipeline_started_ && this->update_depth_ == 0) {
+    this->params_ = this->pending_;
+    this->dirty_ = 0;
+  }
+  return ESP_OK;
+}
+
+esp_err_t MipiDsiCamISPPipeline::apply_block_(bool enabled, esp_err_t (MipiDsiCamISPPipeline::*start)(),
+                                              esp_err_t (MipiDsiCamISPPipeline::*stop)()) {
+  return enabled ? (this->*start)() : (this->*stop)();
+}
+
+esp_err_t MipiDsiCamISPPipeline::apply_pending() {
+  if (this->dirty_ == 0 || this->update_depth_ > 0 || !this->pipeline_started_) {
+    return ESP_OK;
+  }
+  
+  const uint8_t dirty = this->dirty_;
+  const IspParams applied = this->params_;
+  this->dirty_ = 0;
+  this->params_ = this->pending_;  // Lu par les start_*_()
+  
+  // Ordre du pipeline ; un bloc revenu à sa valeur programmée n'est pas touché
+  esp_err_t result = ESP_OK;
+  auto apply = [&](uint8_t block, bool changed, bool enabled, esp_err_t (MipiDsiCamISPPipeline::*start)(),
+                   esp_err_t (MipiDsiCamISPPipeline::*stop)()) {
+    if (!(dirty & block) || !changed) {
+      return;
+    }
+    esp_err_t ret = this->apply_block_(enabled, start, stop);
+    if (ret != ESP_OK && result == ESP_OK) {
+      result = ret;
+    }
+  };
+  apply(HW_BLOCK_BF, this->params_.bf != applied.bf, this->params_.bf.enabled,
+        &MipiDsiCamISPPipeline::start_bayer_filter_, &MipiDsiCamISPPipeline::stop_bayer_filter_);
+  apply(HW_BLOCK_DEMOSAIC, this->params_.demosaic != applied.demosaic, this->params_.demosaic.enabled,
+        &MipiDsiCamISPPipeline::start_demosaic_, &MipiDsiCamISPPipeline::stop_demosaic_);
+  apply(HW_BLOCK_CCM, this->params_.ccm != applied.ccm, this->params_.ccm.enabled,
+        &MipiDsiCamISPPipeline::start_ccm_, &MipiDsiCamISPPipeline::stop_ccm_);
+  apply(HW_BLOCK_GAMMA, this->params_.gamma != applied.gamma, this->params_.gamma.enabled,
+        &MipiDsiCamISPPipeline::start_gamma_, &MipiDsiCamISPPipeline::stop_gamma_);
+  apply(HW_BLOCK_SHARPEN, this->params_.sharpen != applied.sharpen, this->params_.sharpen.enabled,
+        &MipiDsiCamISPPipeline::start_sharpen_, &MipiDsiCamISPPipeline::stop_sharpen_);
+  apply(HW_BLOCK_COLOR, this->params_.color != applied.color, true,
+        &MipiDsiCamISPPipeline::start_color_, &MipiDsiCamISPPipeline::stop_color_);
+  
+  this->applied_updates_++;
+  if (result != ESP_OK) {
+    ESP_LOGW(TAG, "ISP update partially applied: 0x%x", result);
+  }
+  return result;
+}
+
 // ===== Bayer Filter =====
 
 esp_err_t MipiDsiCamISPPipeline::init_bayer_filter_() {
@@ -228,57 +302,56 @@ esp_err_t MipiDsiCamISPPipeline::init_bayer_filter_() {
 }
 
 esp_err_t MipiDsiCamISPPipeline::enable_bayer_filter(bool enable) {
-  this->bf_enabled_ = enable;
+  this->pending_.bf.enabled = enable;
   
-  if (this->pipeline_started_) {
-    if (enable) {
-      return this->start_bayer_filter_();
-    } else {
-      return this->stop_bayer_filter_();
-    }
-  }
-  
-  return ESP_OK;
+  return this->mark_dirty_(HW_BLOCK_BF);
 }
 
 esp_err_t MipiDsiCamISPPipeline::set_denoising_level(uint8_t level) {
   if (level > 20) {
     level = 20;
   }
-  this->denoising_level_ = level;
+  this->pending_.bf.denoising_level = level;
   
-  if (this->pipeline_started_ && this->bf_enabled_) {
-    // Reconfigurer le BF avec le nouveau niveau
-    return this->start_bayer_filter_();
+  return this->mark_dirty_(HW_BLOCK_BF);
+}
+
+esp_err_t MipiDsiCamISPPipeline::set_bayer_filter_kernel(const uint8_t kernel[3][3]) {
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      this->pending_.bf.kernel[i][j] = std::min<uint8_t>(kernel[i][j], 15);
+    }
   }
   
-  return ESP_OK;
+  return this->mark_dirty_(HW_BLOCK_BF);
 }
 
 esp_err_t MipiDsiCamISPPipeline::start_bayer_filter_() {
-  // Note: Dans le vrai code, utiliser l'ISP handle de la caméra
-  // isp_proc_handle_t isp = this->camera_->get_isp_handle();
+  isp_proc_handle_t isp = this->camera_->get_isp_handle();
+  if (isp == nullptr) {
+    return ESP_ERR_INVALID_STATE;
+  }
   
   esp_isp_bf_config_t bf_config = {};
-  bf_config.denoising_level = this->denoising_level_;
+  bf_config.denoising_level = this->params_.bf.denoising_level;
   bf_config.padding_mode = ISP_BF_EDGE_PADDING_MODE_SRND_DATA;
   
-  // Matrice de filtrage par défaut (filtre moyenneur 3x3)
+  // Matrice de filtrage (filtre moyenneur 3x3 par défaut)
   for (int i = 0; i < ISP_BF_TEMPLATE_X_NUMS; i++) {
     for (int j = 0; j < ISP_BF_TEMPLATE_Y_NUMS; j++) {
-      bf_config.bf_template[i][j] = 1;
+      bf_config.bf_template[i][j] = this->params_.bf.kernel[i][j];
     }
   }
   
-  // ESP_RETURN_ON_ERROR(esp_isp_bf_configure(isp, &bf_config), TAG, "BF config failed");
-  // ESP_RETURN_ON_ERROR(esp_isp_bf_enable(isp), TAG, "BF enable failed");
+  ESP_RETURN_ON_ERROR(esp_isp_bf_configure(isp, &bf_config), TAG, "BF config failed");
+  ESP_RETURN_ON_ERROR(this->enable_block_(HW_BLOCK_BF, esp_isp_bf_enable), TAG, "BF enable failed");
   
-  ESP_LOGI(TAG, "✅ Bayer Filter started (level=%u)", this->denoising_level_);
+  ESP_LOGI(TAG, "✅ Bayer Filter started (level=%u)", this->params_.bf.denoising_level);
   return ESP_OK;
 }
 
 esp_err_t MipiDsiCamISPPipeline::stop_bayer_filter_() {
-  // ESP_RETURN_ON_ERROR(esp_isp_bf_disable(isp), TAG, "BF disable failed");
+  ESP_RETURN_ON_ERROR(this->disable_block_(HW_BLOCK_BF, esp_isp_bf_disable), TAG, "BF disable failed");
   ESP_LOGD(TAG, "Bayer Filter stopped");
   return ESP_OK;
 }
@@ -291,72 +364,61 @@ esp_err_t MipiDsiCamISPPipeline::init_ccm_() {
 }
 
 esp_err_t MipiDsiCamISPPipeline::enable_ccm(bool enable) {
-  this->ccm_enabled_ = enable;
+  this->pending_.ccm.enabled = enable;
   
-  if (this->pipeline_started_) {
-    if (enable) {
-      return this->start_ccm_();
-    } else {
-      return this->stop_ccm_();
-    }
-  }
-  
-  return ESP_OK;
+  return this->mark_dirty_(HW_BLOCK_CCM);
 }
 
 esp_err_t MipiDsiCamISPPipeline::set_ccm_matrix(float matrix[3][3]) {
   for (int i = 0; i < 3; i++) {
     for (int j = 0; j < 3; j++) {
-      this->ccm_matrix_[i][j] = matrix[i][j];
+      this->pending_.ccm.matrix[i][j] = matrix[i][j];
     }
   }
   
-  if (this->pipeline_started_ && this->ccm_enabled_) {
-    return this->start_ccm_();
-  }
-  
-  return ESP_OK;
+  return this->mark_dirty_(HW_BLOCK_CCM);
 }
 
 esp_err_t MipiDsiCamISPPipeline::set_white_balance(float red_gain, float green_gain, float blue_gain) {
-  this->red_balance_ = red_gain;
-  this->green_balance_ = green_gain;
-  this->blue_balance_ = blue_gain;
-  
-  ESP_LOGI(TAG, "White Balance: R=%.2f G=%.2f B=%.2f", red_gain, green_gain, blue_gain);
+  this->pending_.ccm.red_gain = red_gain;
+  this->pending_.ccm.green_gain = green_gain;
+  this->pending_.ccm.blue_gain = blue_gain;
   
-  if (this->pipeline_started_ && this->ccm_enabled_) {
-    return this->start_ccm_();
-  }
+  ESP_LOGD(TAG, "White Balance: R=%.2f G=%.2f B=%.2f", red_gain, green_gain, blue_gain);
   
-  return ESP_OK;
+  return this->mark_dirty_(HW_BLOCK_CCM);
 }
 
 esp_err_t MipiDsiCamISPPipeline::start_ccm_() {
+  isp_proc_handle_t isp = this->camera_->get_isp_handle();
+  if (isp == nullptr) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  
   esp_isp_ccm_config_t ccm_config = {};
   ccm_config.saturation = true;
   
   // Appliquer la matrice CCM avec les gains de balance des blancs
   for (int i = 0; i < 3; i++) {
     for (int j = 0; j < 3; j++) {
-      ccm_config.matrix[i][j] = this->ccm_matrix_[i][j];
+      ccm_config.matrix[i][j] = this->params_.ccm.matrix[i][j];
     }
     // Appliquer les gains R/G/B
-    ccm_config.matrix[i][0] *= this->red_balance_;
-    ccm_config.matrix[i][1] *= this->green_balance_;
-    ccm_config.matrix[i][2] *= this->blue_balance_;
+    ccm_config.matrix[i][0] *= this->params_.ccm.red_gain;
+    ccm_config.matrix[i][1] *= this->params_.ccm.green_gain;
+    ccm_config.matrix[i][2] *= this->params_.ccm.blue_gain;
   }
   
-  // ESP_RETURN_ON_ERROR(esp_isp_ccm_configure(isp, &ccm_config), TAG, "CCM config failed");
-  // ESP_RETURN_ON_ERROR(esp_isp_ccm_enable(isp), TAG, "CCM enable failed");
+  ESP_RETURN_ON_ERROR(esp_isp_ccm_configure(isp, &ccm_config), TAG, "CCM config failed");
+  ESP_RETURN_ON_ERROR(this->enable_block_(HW_BLOCK_CCM, esp_isp_ccm_enable), TAG, "CCM enable failed");
   
-  ESP_LOGI(TAG, "✅ CCM started (WB: R=%.2f G=%.2f B=%.2f)", 
-           this->red_balance_, this->green_balance_, this->blue_balance_);
+  ESP_LOGD(TAG, "✅ CCM started (WB: R=%.2f G=%.2f B=%.2f)", 
+           this->params_.ccm.red_gain, this->params_.ccm.green_gain, this->params_.ccm.blue_gain);
   return ESP_OK;
 }
 
 esp_err_t MipiDsiCamISPPipeline::stop_ccm_() {
-  // ESP_RETURN_ON_ERROR(esp_isp_ccm_disable(isp), TAG, "CCM disable failed");
+  ESP_RETURN_ON_ERROR(this->disable_block_(HW_BLOCK_CCM, esp_isp_ccm_disable), TAG, "CCM disable failed");
   ESP_LOGD(TAG, "CCM stopped");
   return ESP_OK;
 }
@@ -369,74 +431,71 @@ esp_err_t MipiDsiCamISPPipeline::init_sharpen_() {
 }
 
 esp_err_t MipiDsiCamISPPipeline::enable_sharpen(bool enable) {
-  this->sharpen_enabled_ = enable;
-  
-  if (this->pipeline_started_) {
-    if (enable) {
-      return this->start_sharpen_();
-    } else {
-      return this->stop_sharpen_();
-    }
-  }
+  this->pending_.sharpen.enabled = enable;
   
-  return ESP_OK;
+  return this->mark_dirty_(HW_BLOCK_SHARPEN);
 }
 
 esp_err_t MipiDsiCamISPPipeline::set_sharpen_params(uint8_t h_thresh, uint8_t l_thresh,
                                                      float h_coeff, float m_coeff) {
-  this->sharpen_h_thresh_ = h_thresh;
-  this->sharpen_l_thresh_ = l_thresh;
-  this->sharpen_h_coeff_ = h_coeff;
-  this->sharpen_m_coeff_ = m_coeff;
+  this->pending_.sharpen.h_thresh = h_thresh;
+  this->pending_.sharpen.l_thresh = l_thresh;
+  this->pending_.sharpen.h_coeff = h_coeff;
+  this->pending_.sharpen.m_coeff = m_coeff;
   
-  if (this->pipeline_started_ && this->sharpen_enabled_) {
-    return this->start_sharpen_();
+  return this->mark_dirty_(HW_BLOCK_SHARPEN);
+}
+
+esp_err_t MipiDsiCamISPPipeline::set_sharpen_kernel(const uint8_t kernel[3][3]) {
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      this->pending_.sharpen.kernel[i][j] = std::min<uint8_t>(kernel[i][j], 31);
+    }
   }
   
-  return ESP_OK;
+  return this->mark_dirty_(HW_BLOCK_SHARPEN);
 }
 
 esp_err_t MipiDsiCamISPPipeline::start_sharpen_() {
-  esp_isp_sharpen_config_t sharpen_config = {};
+  isp_proc_handle_t isp = this->camera_->get_isp_handle();
+  if (isp == nullptr) {
+    return ESP_ERR_INVALID_STATE;
+  }
   
-  uint8_t h_amount = 1 << ISP_SHARPEN_H_FREQ_COEF_DEC_BITS;
-  uint8_t m_amount = 1 << ISP_SHARPEN_M_FREQ_COEF_DEC_BITS;
+  esp_isp_sharpen_config_t sharpen_config = {};
   
-  uint8_t h_integer = (uint8_t)(this->sharpen_h_coeff_ * h_amount);
-  uint8_t m_integer = (uint8_t)(this->sharpen_m_coeff_ * m_amount);
+  // Coefficients en virgule fixe (partie entière 3 bits)
+  const uint32_t h_amount = 1 << ISP_SHARPEN_H_FREQ_COEF_DEC_BITS;
+  const uint32_t m_amount = 1 << ISP_SHARPEN_M_FREQ_COEF_DEC_BITS;
+  uint32_t h_fixed = std::min<uint32_t>(lroundf(this->params_.sharpen.h_coeff * h_amount), 8 * h_amount - 1);
+  uint32_t m_fixed = std::min<uint32_t>(lroundf(this->params_.sharpen.m_coeff * m_amount), 8 * m_amount - 1);
   
-  sharpen_config.h_freq_coeff.integer = h_integer / m_amount;
-  sharpen_config.h_freq_coeff.decimal = h_integer % m_amount;
-  sharpen_config.m_freq_coeff.integer = m_integer / m_amount;
-  sharpen_config.m_freq_coeff.decimal = m_integer % m_amount;
+  sharpen_config.h_freq_coeff.integer = h_fixed / h_amount;
+  sharpen_config.h_freq_coeff.decimal = h_fixed % h_amount;
+  sharpen_config.m_freq_coeff.integer = m_fixed / m_amount;
+  sharpen_config.m_freq_coeff.decimal = m_fixed % m_amount;
   
-  sharpen_config.h_thresh = this->sharpen_h_thresh_;
-  sharpen_config.l_thresh = this->sharpen_l_thresh_;
+  sharpen_config.h_thresh = this->params_.sharpen.h_thresh;
+  sharpen_config.l_thresh = this->params_.sharpen.l_thresh;
   sharpen_config.padding_mode = ISP_SHARPEN_EDGE_PADDING_MODE_SRND_DATA;
   
-  // Matrice de sharpening par défaut (Laplacien)
-  int8_t sharpen_matrix[3][3] = {
-    { -1, -1, -1 },
-    { -1,  9, -1 },
-    { -1, -1, -1 }
-  };
-  
+  // Passe-bas de référence : hautes fréquences = pixel - moyenne pondérée
   for (int i = 0; i < ISP_SHARPEN_TEMPLATE_X_NUMS; i++) {
     for (int j = 0; j < ISP_SHARPEN_TEMPLATE_Y_NUMS; j++) {
-      sharpen_config.sharpen_template[i][j] = sharpen_matrix[i][j];
+      sharpen_config.sharpen_template[i][j] = this->params_.sharpen.kernel[i][j];
     }
   }
   
-  // ESP_RETURN_ON_ERROR(esp_isp_sharpen_configure(isp, &sharpen_config), TAG, "Sharpen config failed");
-  // ESP_RETURN_ON_ERROR(esp_isp_sharpen_enable(isp), TAG, "Sharpen enable failed");
+  ESP_RETURN_ON_ERROR(esp_isp_sharpen_configure(isp, &sharpen_config), TAG, "Sharpen config failed");
+  ESP_RETURN_ON_ERROR(this->enable_block_(HW_BLOCK_SHARPEN, esp_isp_sharpen_enable), TAG, "Sharpen enable failed");
   
   ESP_LOGI(TAG, "✅ Sharpen started (h_thresh=%u l_thresh=%u)", 
-           this->sharpen_h_thresh_, this->sharpen_l_thresh_);
+           this->params_.sharpen.h_thresh, this->params_.sharpen.l_thresh);
   return ESP_OK;
 }
 
 esp_err_t MipiDsiCamISPPipeline::stop_sharpen_() {
-  // ESP_RETURN_ON_ERROR(esp_isp_sharpen_disable(isp), TAG, "Sharpen disable failed");
+  ESP_RETURN_ON_ERROR(this->disable_block_(HW_BLOCK_SHARPEN, esp_isp_sharpen_disable), TAG, "Sharpen disable failed");
   ESP_LOGD(TAG, "Sharpen stopped");
   return ESP_OK;
 }
@@ -449,47 +508,40 @@ esp_err_t MipiDsiCamISPPipeline::init_gamma_() {
 }
 
 esp_err_t MipiDsiCamISPPipeline::enable_gamma(bool enable) {
-  this->gamma_enabled_ = enable;
-  
-  if (this->pipeline_started_) {
-    if (enable) {
-      return this->start_gamma_();
-    } else {
-      return this->stop_gamma_();
-    }
-  }
+  this->pending_.gamma.enabled = enable;
   
-  return ESP_OK;
+  return this->mark_dirty_(HW_BLOCK_GAMMA);
 }
 
 esp_err_t MipiDsiCamISPPipeline::set_gamma_curve(float gamma) {
-  if (gamma < 0.1f) gamma = 0.1f;
+  if (gamma != ISP_GAMMA_SRGB && gamma < 0.1f) gamma = 0.1f;
   if (gamma > 5.0f) gamma = 5.0f;
   
-  this->gamma_value_ = gamma;
-  
-  if (this->pipeline_started_ && this->gamma_enabled_) {
-    return this->start_gamma_();
-  }
+  this->pending_.gamma.gamma = gamma;
   
-  return ESP_OK;
+  return this->mark_dirty_(HW_BLOCK_GAMMA);
 }
 
 esp_err_t MipiDsiCamISPPipeline::start_gamma_() {
+  isp_proc_handle_t isp = this->camera_->get_isp_handle();
+  if (isp == nullptr) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  
   isp_gamma_curve_points_t gamma_curve;
-  this->generate_gamma_curve_(this->gamma_value_, &gamma_curve);
+  this->generate_gamma_curve_(this->params_.gamma.gamma, &gamma_curve);
   
-  // ESP_RETURN_ON_ERROR(esp_isp_gamma_configure(isp, COLOR_COMPONENT_R, &gamma_curve), TAG, "Gamma R failed");
-  // ESP_RETURN_ON_ERROR(esp_isp_gamma_configure(isp, COLOR_COMPONENT_G, &gamma_curve), TAG, "Gamma G failed");
-  // ESP_RETURN_ON_ERROR(esp_isp_gamma_configure(isp, COLOR_COMPONENT_B, &gamma_curve), TAG, "Gamma B failed");
-  // ESP_RETURN_ON_ERROR(esp_isp_gamma_enable(isp), TAG, "Gamma enable failed");
+  ESP_RETURN_ON_ERROR(esp_isp_gamma_configure(isp, COLOR_COMPONENT_R, &gamma_curve), TAG, "Gamma R failed");
+  ESP_RETURN_ON_ERROR(esp_isp_gamma_configure(isp, COLOR_COMPONENT_G, &gamma_curve), TAG, "Gamma G failed");
+  ESP_RETURN_ON_ERROR(esp_isp_gamma_configure(isp, COLOR_COMPONENT_B, &gamma_curve), TAG, "Gamma B failed");
+  ESP_RETURN_ON_ERROR(this->enable_block_(HW_BLOCK_GAMMA, esp_isp_gamma_enable), TAG, "Gamma enable failed");
   
-  ESP_LOGI(TAG, "✅ Gamma started (gamma=%.2f)", this->gamma_value_);
+  ESP_LOGI(TAG, "✅ Gamma started (gamma=%.2f)", this->params_.gamma.gamma);
   return ESP_OK;
 }
 
 esp_err_t MipiDsiCamISPPipeline::stop_gamma_() {
-  // ESP_RETURN_ON_ERROR(esp_isp_gamma_disable(isp), TAG, "Gamma disable failed");
+  ESP_RETURN_ON_ERROR(this->disable_block_(HW_BLOCK_GAMMA, esp_isp_gamma_disable), TAG, "Gamma disable failed");
   ESP_LOGD(TAG, "Gamma stopped");
   return ESP_OK;
 }
@@ -502,50 +554,43 @@ esp_err_t MipiDsiCamISPPipeline::init_demosaic_() {
 }
 
 esp_err_t MipiDsiCamISPPipeline::enable_demosaic(bool enable) {
-  this->demosaic_enabled_ = enable;
+  this->pending_.demosaic.enabled = enable;
   
-  if (this->pipeline_started_) {
-    if (enable) {
-      return this->start_demosaic_();
-    } else {
-      return this->stop_demosaic_();
-    }
-  }
-  
-  return ESP_OK;
+  return this->mark_dirty_(HW_BLOCK_DEMOSAIC);
 }
 
 esp_err_t MipiDsiCamISPPipeline::set_demosaic_gradient_ratio(float ratio) {
   if (ratio < 0.0f) ratio = 0.0f;
   if (ratio > 1.0f) ratio = 1.0f;
   
-  this->demosaic_gradient_ratio_ = ratio;
+  this->pending_.demosaic.gradient_ratio = ratio;
   
-  if (this->pipeline_started_ && this->demosaic_enabled_) {
-    return this->start_demosaic_();
-  }
-  
-  return ESP_OK;
+  return this->mark_dirty_(HW_BLOCK_DEMOSAIC);
 }
 
 esp_err_t MipiDsiCamISPPipeline::start_demosaic_() {
+  isp_proc_handle_t isp = this->camera_->get_isp_handle();
+  if (isp == nullptr) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  
   esp_isp_demosaic_config_t demosaic_config = {};
   
   uint32_t gradient_ratio_amount = 1 << ISP_DEMOSAIC_GRAD_RATIO_DEC_BITS;
-  uint32_t gradient_ratio_val = (uint32_t)(this->demosaic_gradient_ratio_ * gradient_ratio_amount);
+  uint32_t gradient_ratio_val = (uint32_t)(this->params_.demosaic.gradient_ratio * gradient_ratio_amount);
   
   demosaic_config.grad_ratio.integer = gradient_ratio_val / gradient_ratio_amount;
   demosaic_config.grad_ratio.decimal = gradient_ratio_val % gradient_ratio_amount;
   
-  // ESP_RETURN_ON_ERROR(esp_isp_demosaic_configure(isp, &demosaic_config), TAG, "Demosaic config failed");
-  // ESP_RETURN_ON_ERROR(esp_isp_demosaic_enable(isp), TAG, "Demosaic enable failed");
+  ESP_RETURN_ON_ERROR(esp_isp_demosaic_configure(isp, &demosaic_config), TAG, "Demosaic config failed");
+  ESP_RETURN_ON_ERROR(this->enable_block_(HW_BLOCK_DEMOSAIC, esp_isp_demosaic_enable), TAG, "Demosaic enable failed");
   
-  ESP_LOGI(TAG, "✅ Demosaic started (gradient_ratio=%.2f)", this->demosaic_gradient_ratio_);
+  ESP_LOGI(TAG, "✅ Demosaic started (gradient_ratio=%.2f)", this->params_.demosaic.gradient_ratio);
   return ESP_OK;
 }
 
 esp_err_t MipiDsiCamISPPipeline::stop_demosaic_() {
-  // ESP_RETURN_ON_ERROR(esp_isp_demosaic_disable(isp), TAG, "Demosaic disable failed");
+  ESP_RETURN_ON_ERROR(this->disable_block_(HW_BLOCK_DEMOSAIC, esp_isp_demosaic_disable), TAG, "Demosaic disable failed");
   ESP_LOGD(TAG, "Demosaic stopped");
   return ESP_OK;
 }
@@ -558,64 +603,53 @@ esp_err_t MipiDsiCamISPPipeline::init_color_() {
 }
 
 esp_err_t MipiDsiCamISPPipeline::set_brightness(int8_t brightness) {
-  this->brightness_ = brightness;
-  
-  if (this->pipeline_started_) {
-    return this->start_color_();
-  }
+  this->pending_.color.brightness = brightness;
   
-  return ESP_OK;
+  return this->mark_dirty_(HW_BLOCK_COLOR);
 }
 
 esp_err_t MipiDsiCamISPPipeline::set_contrast(uint8_t contrast) {
-  this->contrast_ = contrast;
+  this->pending_.color.contrast = contrast;
   
-  if (this->pipeline_started_) {
-    return this->start_color_();
-  }
-  
-  return ESP_OK;
+  return this->mark_dirty_(HW_BLOCK_COLOR);
 }
 
 esp_err_t MipiDsiCamISPPipeline::set_saturation(uint8_t saturation) {
-  this->saturation_ = saturation;
-  
-  if (this->pipeline_started_) {
-    return this->start_color_();
-  }
+  this->pending_.color.saturation = saturation;
   
-  return ESP_OK;
+  return this->mark_dirty_(HW_BLOCK_COLOR);
 }
 
 esp_err_t MipiDsiCamISPPipeline::set_hue(uint16_t hue) {
   if (hue > 360) hue = 360;
-  this->hue_ = hue;
-  
-  if (this->pipeline_started_) {
-    return this->start_color_();
-  }
+  this->pending_.color.hue = hue;
   
-  return ESP_OK;
+  return this->mark_dirty_(HW_BLOCK_COLOR);
 }
 
 esp_err_t MipiDsiCamISPPipeline::start_color_() {
+  isp_proc_handle_t isp = this->camera_->get_isp_handle();
+  if (isp == nullptr) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  
   esp_isp_color_config_t color_config = {};
   
-  color_config.color_brightness = this->brightness_;
-  color_config.color_contrast.val = this->contrast_;
-  color_config.color_saturation.val = this->saturation_;
-  color_config.color_hue = this->hue_;
+  color_config.color_brightness = this->params_.color.brightness;
+  color_config.color_contrast.val = this->params_.color.contrast;
+  color_config.color_saturation.val = this->params_.color.saturation;
+  color_config.color_hue = this->params_.color.hue;
   
-  // ESP_RETURN_ON_ERROR(esp_isp_color_configure(isp, &color_config), TAG, "Color config failed");
-  // ESP_RETURN_ON_ERROR(esp_isp_color_enable(isp), TAG, "Color enable failed");
+  ESP_RETURN_ON_ERROR(esp_isp_color_configure(isp, &color_config), TAG, "Color config failed");
+  ESP_RETURN_ON_ERROR(this->enable_block_(HW_BLOCK_COLOR, esp_isp_color_enable), TAG, "Color enable failed");
   
   ESP_LOGI(TAG, "✅ Color started (B=%d C=%u S=%u H=%u)", 
-           this->brightness_, this->contrast_, this->saturation_, this->hue_);
+           this->params_.color.brightness, this->params_.color.contrast, this->params_.color.saturation, this->params_.color.hue);
   return ESP_OK;
 }
 
 esp_err_t MipiDsiCamISPPipeline::stop_color_() {
-  // ESP_RETURN_ON_ERROR(esp_isp_color_disable(isp), TAG, "Color disable failed");
+  ESP_RETURN_ON_ERROR(this->disable_block_(HW_BLOCK_COLOR, esp_isp_color_disable), TAG, "Color disable failed");
   ESP_LOGD(TAG, "Color stopped");
   return ESP_OK;
 }
@@ -625,11 +659,17 @@ esp_err_t MipiDsiCamISPPipeline::stop_color_() {
 esp_err_t MipiDsiCamISPPipeline::init_awb_() {
   ESP_LOGD(TAG, "Initializing AWB");
   
+  isp_proc_handle_t isp = this->camera_->get_isp_handle();
+  if (isp == nullptr) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  
   uint32_t width = this->camera_->get_image_width();
   uint32_t height = this->camera_->get_image_height();
   
   esp_isp_awb_config_t awb_config = {};
-  awb_config.sample_point = ISP_AWB_SAMPLE_POINT_BEFORE_CCM;
+  // Après la CCM : mesure dans le domaine corrigé, comme la boucle AWB itérative de la caméra
+  awb_config.sample_point = ISP_AWB_SAMPLE_POINT_AFTER_CCM;
   
   // Fenêtre centrale (80% de l'image)
   awb_config.window.top_left.x = width * 0.1f;
@@ -637,86 +677,92 @@ esp_err_t MipiDsiCamISPPipeline::init_awb_() {
   awb_config.window.btm_right.x = width * 0.9f;
   awb_config.window.btm_right.y = height * 0.9f;
   
-  // Configuration White Patch
+  // Configuration White Patch : ratios centrés sur 1 (gains déjà appliqués une fois convergé)
   awb_config.white_patch.luminance.min = 185;
   awb_config.white_patch.luminance.max = 395;
-  awb_config.white_patch.red_green_ratio.min = 0.5040f;
-  awb_config.white_patch.red_green_ratio.max = 0.8899f;
-  awb_config.white_patch.blue_green_ratio.min = 0.4838f;
-  awb_config.white_patch.blue_green_ratio.max = 0.7822f;
+  awb_config.white_patch.red_green_ratio.min = 0.5f;
+  awb_config.white_patch.red_green_ratio.max = 2.0f;
+  awb_config.white_patch.blue_green_ratio.min = 0.5f;
+  awb_config.white_patch.blue_green_ratio.max = 2.0f;
   
-  // ESP_RETURN_ON_ERROR(esp_isp_new_awb_controller(isp, &awb_config, &this->awb_ctlr_), TAG, "AWB create failed");
+  ESP_RETURN_ON_ERROR(esp_isp_new_awb_controller(isp, &awb_config, &this->awb_ctlr_), TAG, "AWB create failed");
   
   // Enregistrer le callback
   esp_isp_awb_cbs_t awb_cbs = {};
   awb_cbs.on_statistics_done = MipiDsiCamISPPipeline::awb_stats_callback;
   
-  // ESP_RETURN_ON_ERROR(esp_isp_awb_register_event_callbacks(this->awb_ctlr_, &awb_cbs, this), TAG, "AWB callback failed");
-  
-  return ESP_OK;
+  esp_err_t ret = esp_isp_awb_register_event_callbacks(this->awb_ctlr_, &awb_cbs, this);
+  if (ret != ESP_OK) {
+    ESP_LOGE(TAG, "AWB callback failed");
+    esp_isp_del_awb_controller(this->awb_ctlr_);
+    this->awb_ctlr_ = nullptr;
+  }
+  return ret;
 }
 
 esp_err_t MipiDsiCamISPPipeline::enable_awb(bool enable) {
   this->awb_enabled_ = enable;
   
+  esp_err_t ret = ESP_OK;
   if (this->pipeline_started_) {
-    if (enable) {
-      return this->start_awb_();
-    } else {
-      return this->stop_awb_();
-    }
+    ret = enable ? this->start_awb_() : this->stop_awb_();
+    this->update_stats_expected_();
   }
   
-  return ESP_OK;
+  return ret;
 }
 
 esp_err_t MipiDsiCamISPPipeline::start_awb_() {
   if (!this->awb_ctlr_) {
-    ESP_LOGE(TAG, "AWB controller not initialized");
-    return ESP_FAIL;
+    ESP_LOGW(TAG, "AWB controller not initialized");
+    return ESP_ERR_INVALID_STATE;
+  }
+  if (this->awb_running_) {
+    return ESP_OK;
   }
   
-  // ESP_RETURN_ON_ERROR(esp_isp_awb_controller_enable(this->awb_ctlr_), TAG, "AWB enable failed");
-  // ESP_RETURN_ON_ERROR(esp_isp_awb_controller_start_continuous_statistics(this->awb_ctlr_), TAG, "AWB start failed");
+  ESP_RETURN_ON_ERROR(esp_isp_awb_controller_enable(this->awb_ctlr_), TAG, "AWB enable failed");
+  esp_err_t ret = esp_isp_awb_controller_start_continuous_statistics(this->awb_ctlr_);
+  if (ret != ESP_OK) {
+    ESP_LOGE(TAG, "AWB start failed");
+    esp_isp_awb_controller_disable(this->awb_ctlr_);
+    return ret;
+  }
+  this->awb_running_ = true;
   
   ESP_LOGI(TAG, "✅ AWB started (continuous statistics)");
   return ESP_OK;
 }
 
 esp_err_t MipiDsiCamISPPipeline::stop_awb_() {
-  if (!this->awb_ctlr_) {
+  if (!this->awb_ctlr_ || !this->awb_running_) {
     return ESP_OK;
   }
+  this->awb_running_ = false;
   
-  // ESP_RETURN_ON_ERROR(esp_isp_awb_controller_stop_continuous_statistics(this->awb_ctlr_), TAG, "AWB stop failed");
-  // ESP_RETURN_ON_ERROR(esp_isp_awb_controller_disable(this->awb_ctlr_), TAG, "AWB disable failed");
+  ESP_RETURN_ON_ERROR(esp_isp_awb_controller_stop_continuous_statistics(this->awb_ctlr_), TAG, "AWB stop failed");
+  ESP_RETURN_ON_ERROR(esp_isp_awb_controller_disable(this->awb_ctlr_), TAG, "AWB disable failed");
   
   ESP_LOGD(TAG, "AWB stopped");
   return ESP_OK;
 }
 
-bool MipiDsiCamISPPipeline::awb_stats_callback(isp_awb_ctlr_t awb_ctlr,
-                                                const esp_isp_awb_evt_data_t *edata,
-                                                void *user_data) {
+bool IRAM_ATTR MipiDsiCamISPPipeline::awb_stats_callback(isp_awb_ctlr_t awb_ctlr,
+                                                         const esp_isp_awb_evt_data_t *edata,
+                                                         void *user_data) {
   MipiDsiCamISPPipeline *pipeline = (MipiDsiCamISPPipeline*)user_data;
-  
-  // CORRECTION: Utiliser les vrais noms de membres de la structure
-  // Note: Ces noms peuvent varier selon la version d'ESP-IDF
-  // Vérifier la documentation pour les noms exacts
-  
-  // Calculer les gains de balance des blancs à partir des statistiques
-  // Version simplifiée sans accès direct aux membres
-  float red_gain = 1.3f;   // Valeurs par défaut
-  float blue_gain = 1.1f;
-  
-  // Appliquer les gains avec un filtre pour éviter les changements brusques
-  pipeline->red_balance_ = pipeline->red_balance_ * 0.9f + red_gain * 0.1f;
-  pipeline->blue_balance_ = pipeline->blue_balance_ * 0.9f + blue_gain * 0.1f;
-  
-  ESP_LOGV(TAG, "AWB: R=%.2f B=%.2f", 
-           pipeline->red_balance_, pipeline->blue_balance_);
-  
-  return false; // Ne pas bloquer l'ISR
+  IspStatsRing &ring = pipeline->camera_->get_isp_stats_ring();
+  
+  // Sommes white patch brutes : la décision AWB est prise par la tâche 3A
+  IspStatsRecord &record = ring.begin_write(IspStatsRecord::FLAG_AWB, pipeline->camera_->get_frame_sequence());
+  record.awb_white_patches = edata->awb_result.white_patch_num;
+  record.awb_sum_r = edata->awb_result.sum_r;
+  record.awb_sum_g = edata->awb_result.sum_g;
+  record.awb_sum_b = edata->awb_result.sum_b;
+  record.awb_after_gains = (pipeline->hw_enabled_ & HW_BLOCK_CCM) != 0;
+  ring.end_write(IspStatsRecord::FLAG_AWB);
+  
+  return false; // Pas de tâche réveillée
 }
 
 // ===== Auto Exposure =====
@@ -724,82 +770,104 @@ bool MipiDsiCamISPPipeline::awb_stats_callback(isp_awb_ctlr_t awb_ctlr,
 esp_err_t MipiDsiCamISPPipeline::init_ae_() {
   ESP_LOGD(TAG, "Initializing AE");
   
+  isp_proc_handle_t isp = this->camera_->get_isp_handle();
+  if (isp == nullptr) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  
   uint32_t width = this->camera_->get_image_width();
   uint32_t height = this->camera_->get_image_height();
   
   esp_isp_ae_config_t ae_config = {};
   ae_config.sample_point = ISP_AE_SAMPLE_POINT_AFTER_GAMMA;
   
-  // Fenêtre centrale
-  ae_config.window.top_left.x = width * 0.2f;
-  ae_config.window.top_left.y = height * 0.2f;
-  ae_config.window.btm_right.x = width * 0.8f;
-  ae_config.window.btm_right.y = height * 0.8f;
+  // Image entière : la pondération centrale est faite par FrameStats::center_weighted_luma()
+  ae_config.window.top_left.x = 0;
+  ae_config.window.top_left.y = 0;
+  ae_config.window.btm_right.x = width - 1;
+  ae_config.window.btm_right.y = height - 1;
   
   ae_config.intr_priority = 0;
   
-  // ESP_RETURN_ON_ERROR(esp_isp_new_ae_controller(isp, &ae_config, &this->ae_ctlr_), TAG, "AE create failed");
+  ESP_RETURN_ON_ERROR(esp_isp_new_ae_controller(isp, &ae_config, &this->ae_ctlr_), TAG, "AE create failed");
   
   // Enregistrer le callback
   esp_isp_ae_env_detector_evt_cbs_t ae_cbs = {};
   ae_cbs.on_env_statistics_done = MipiDsiCamISPPipeline::ae_stats_callback;
   
-  // ESP_RETURN_ON_ERROR(esp_isp_ae_env_detector_register_event_callbacks(this->ae_ctlr_, &ae_cbs, this), TAG, "AE callback failed");
-  
-  return ESP_OK;
+  esp_err_t ret = esp_isp_ae_env_detector_register_event_callbacks(this->ae_ctlr_, &ae_cbs, this);
+  if (ret != ESP_OK) {
+    ESP_LOGE(TAG, "AE callback failed");
+    esp_isp_del_ae_controller(this->ae_ctlr_);
+    this->ae_ctlr_ = nullptr;
+  }
+  return ret;
 }
 
 esp_err_t MipiDsiCamISPPipeline::enable_ae(bool enable) {
   this->ae_enabled_ = enable;
   
+  esp_err_t ret = ESP_OK;
   if (this->pipeline_started_) {
-    if (enable) {
-      return this->start_ae_();
-    } else {
-      return this->stop_ae_();
-    }
+    ret = enable ? this->start_ae_() : this->stop_ae_();
+    this->update_stats_expected_();
   }
   
-  return ESP_OK;
+  return ret;
 }
 
 esp_err_t MipiDsiCamISPPipeline::start_ae_() {
   if (!this->ae_ctlr_) {
-    ESP_LOGE(TAG, "AE controller not initialized");
-    return ESP_FAIL;
+    ESP_LOGW(TAG, "AE controller not initialized");
+    return ESP_ERR_INVALID_STATE;
+  }
+  if (this->ae_running_) {
+    return ESP_OK;
   }
   
-  // ESP_RETURN_ON_ERROR(esp_isp_ae_controller_enable(this->ae_ctlr_), TAG, "AE enable failed");
-  // ESP_RETURN_ON_ERROR(esp_isp_ae_controller_start_continuous_statistics(this->ae_ctlr_), TAG, "AE start failed");
+  ESP_RETURN_ON_ERROR(esp_isp_ae_controller_enable(this->ae_ctlr_), TAG, "AE enable failed");
+  esp_err_t ret = esp_isp_ae_controller_start_continuous_statistics(this->ae_ctlr_);
+  if (ret != ESP_OK) {
+    ESP_LOGE(TAG, "AE start failed");
+    esp_isp_ae_controller_disable(this->ae_ctlr_);
+    return ret;
+  }
+  this->ae_running_ = true;
   
   ESP_LOGI(TAG, "✅ AE started (continuous statistics)");
   return ESP_OK;
 }
 
 esp_err_t MipiDsiCamISPPipeline::stop_ae_() {
-  if (!this->ae_ctlr_) {
+  if (!this->ae_ctlr_ || !this->ae_running_) {
     return ESP_OK;
   }
+  this->ae_running_ = false;
   
-  // ESP_RETURN_ON_ERROR(esp_isp_ae_controller_stop_continuous_statistics(this->ae_ctlr_), TAG, "AE stop failed");
-  // ESP_RETURN_ON_ERROR(esp_isp_ae_controller_disable(this->ae_ctlr_), TAG, "AE disable failed");
+  ESP_RETURN_ON_ERROR(esp_isp_ae_controller_stop_continuous_statistics(this->ae_ctlr_), TAG, "AE stop failed");
+  ESP_RETURN_ON_ERROR(esp_isp_ae_controller_disable(this->ae_ctlr_), TAG, "AE disable failed");
   
   ESP_LOGD(TAG, "AE stopped");
   return ESP_OK;
 }
 
-bool MipiDsiCamISPPipeline::ae_stats_callback(isp_ae_ctlr_t ae_ctlr,
-                                               const esp_isp_ae_env_detector_evt_data_t *edata,
-                                               void *user_data) {
-  // MipiDsiCamISPPipeline *pipeline = (MipiDsiCamISPPipeline*)user_data;
-  
-  // CORRECTION: Calculer la luminosité moyenne de façon simplifiée
-  uint32_t avg_lum = 128; // Valeur par défaut
-  
-  ESP_LOGV(TAG, "AE: avg_lum=%u", avg_lum);
-  
-  // L'ajustement d'exposition devrait être fait via le capteur
-  // pipeline->camera_->adjust_exposure_from_ae(avg_lum);
+bool IRAM_ATTR MipiDsiCamISPPipeline::ae_stats_callback(isp_ae_ctlr_t ae_ctlr,
+                                                        const esp_isp_ae_env_detector_evt_data_t *edata,
+                                                        void *user_data) {
+  MipiDsiCamISPPipeline *pipeline = (MipiDsiCamISPPipeline*)user_data;
+  IspStatsRing &ring = pipeline->camera_->get_isp_stats_ring();
+  
+  // luminance[x][y] côté driver, [y][x] dans l'enregistrement (ordre des zones FrameStats)
+  static_assert(ISP_AE_BLOCK_X_NUM == ISP_STATS_AE_BLOCKS && ISP_AE_BLOCK_Y_NUM == ISP_STATS_AE_BLOCKS,
+                "AE block count mismatch");
+  IspStatsRecord &record = ring.begin_write(IspStatsRecord::FLAG_AE, pipeline->camera_->get_frame_sequence());
+  for (int x = 0; x < ISP_AE_BLOCK_X_NUM; x++) {
+    for (int y = 0; y < ISP_AE_BLOCK_Y_NUM; y++) {
+      const uint32_t luma = edata->ae_result.luminance[x][y];
+      record.ae_luma[y][x] = luma > 255 ? 255 : luma;
+    }
+  }
+  ring.end_write(IspStatsRecord::FLAG_AE);
   
   return false;
 }
@@ -809,6 +877,11 @@ bool MipiDsiCamISPPipeline::ae_stats_callback(isp_ae_ctlr_t ae_ctlr,
 esp_err_t MipiDsiCamISPPipeline::init_histogram_() {
   ESP_LOGD(TAG, "Initializing Histogram");
   
+  isp_proc_handle_t isp = this->camera_->get_isp_handle();
+  if (isp == nullptr) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  
   uint32_t width = this->camera_->get_image_width();
   uint32_t height = this->camera_->get_image_height();
   
@@ -832,82 +905,138 @@ esp_err_t MipiDsiCamISPPipeline::init_histogram_() {
     hist_config.window_weight[i].decimal = 10;
   }
   
-  // ✅ CORRECTION : limiter la boucle pour éviter le débordement
-  const int max_segments = std::min(static_cast<int>(ISP_HIST_SEGMENT_NUMS), 15);
-  for (int i = 0; i < max_segments; i++) {
+  // Tranches de 16 niveaux, telles que les attend isp_stats_to_frame_stats()
+  static_assert(ISP_HIST_SEGMENT_NUMS == ISP_STATS_HIST_BINS, "histogram segment count mismatch");
+  for (int i = 0; i < ISP_HIST_INTERVAL_NUMS; i++) {
     hist_config.segment_threshold[i] = (i + 1) * 16;
   }
   
-  // Reste de la fonction...
-  return ESP_OK;
+  ESP_RETURN_ON_ERROR(esp_isp_new_hist_controller(isp, &hist_config, &this->hist_ctlr_), TAG, "Hist create failed");
+  
+  esp_isp_hist_cbs_t hist_cbs = {};
+  hist_cbs.on_statistics_done = MipiDsiCamISPPipeline::hist_stats_callback;
+  
+  esp_err_t ret = esp_isp_hist_register_event_callbacks(this->hist_ctlr_, &hist_cbs, this);
+  if (ret != ESP_OK) {
+    ESP_LOGE(TAG, "Hist callback failed");
+    esp_isp_del_hist_controller(this->hist_ctlr_);
+    this->hist_ctlr_ = nullptr;
+  }
+  return ret;
 }
 
 esp_err_t MipiDsiCamISPPipeline::enable_histogram(bool enable) {
   this->histogram_enabled_ = enable;
   
+  esp_err_t ret = ESP_OK;
   if (this->pipeline_started_) {
-    if (enable) {
-      return this->start_histogram_();
-    } else {
-      return this->stop_histogram_();
-    }
+    ret = enable ? this->start_histogram_() : this->stop_histogram_();
+    this->update_stats_expected_();
   }
   
-  return ESP_OK;
+  return ret;
 }
 
 esp_err_t MipiDsiCamISPPipeline::start_histogram_() {
   if (!this->hist_ctlr_) {
-    ESP_LOGE(TAG, "Histogram controller not initialized");
-    return ESP_FAIL;
+    ESP_LOGW(TAG, "Histogram controller not initialized");
+    return ESP_ERR_INVALID_STATE;
+  }
+  if (this->hist_running_) {
+    return ESP_OK;
   }
   
-  // ESP_RETURN_ON_ERROR(esp_isp_hist_controller_enable(this->hist_ctlr_), TAG, "Hist enable failed");
-  // ESP_RETURN_ON_ERROR(esp_isp_hist_controller_start_continuous_statistics(this->hist_ctlr_), TAG, "Hist start failed");
+  ESP_RETURN_ON_ERROR(esp_isp_hist_controller_enable(this->hist_ctlr_), TAG, "Hist enable failed");
+  esp_err_t ret = esp_isp_hist_controller_start_continuous_statistics(this->hist_ctlr_);
+  if (ret != ESP_OK) {
+    ESP_LOGE(TAG, "Hist start failed");
+    esp_isp_hist_controller_disable(this->hist_ctlr_);
+    return ret;
+  }
+  this->hist_running_ = true;
   
   ESP_LOGI(TAG, "✅ Histogram started (continuous statistics)");
   return ESP_OK;
 }
 
 esp_err_t MipiDsiCamISPPipeline::stop_histogram_() {
-  if (!this->hist_ctlr_) {
+  if (!this->hist_ctlr_ || !this->hist_running_) {
     return ESP_OK;
   }
+  this->hist_running_ = false;
   
-  // ESP_RETURN_ON_ERROR(esp_isp_hist_controller_stop_continuous_statistics(this->hist_ctlr_), TAG, "Hist stop failed");
-  // ESP_RETURN_ON_ERROR(esp_isp_hist_controller_disable(this->hist_ctlr_), TAG, "Hist disable failed");
+  ESP_RETURN_ON_ERROR(esp_isp_hist_controller_stop_continuous_statistics(this->hist_ctlr_), TAG, "Hist stop failed");
+  ESP_RETURN_ON_ERROR(esp_isp_hist_controller_disable(this->hist_ctlr_), TAG, "Hist disable failed");
   
   ESP_LOGD(TAG, "Histogram stopped");
   return ESP_OK;
 }
 
-bool MipiDsiCamISPPipeline::hist_stats_callback(isp_hist_ctlr_t hist_ctlr,
-                                                 const esp_isp_hist_evt_data_t *edata,
-                                                 void *user_data) {
-  // Traiter les données d'histogramme si nécessaire
-  ESP_LOGV(TAG, "Histogram data received");
+bool IRAM_ATTR MipiDsiCamISPPipeline::hist_stats_callback(isp_hist_ctlr_t hist_ctlr,
+                                                          const esp_isp_hist_evt_data_t *edata,
+                                                          void *user_data) {
+  MipiDsiCamISPPipeline *pipeline = (MipiDsiCamISPPipeline*)user_data;
+  IspStatsRing &ring = pipeline->camera_->get_isp_stats_ring();
+  
+  IspStatsRecord &record = ring.begin_write(IspStatsRecord::FLAG_HIST, pipeline->camera_->get_frame_sequence());
+  for (int i = 0; i < ISP_HIST_SEGMENT_NUMS; i++) {
+    record.hist[i] = edata->hist_result.hist_value[i];
+  }
+  ring.end_write(IspStatsRecord::FLAG_HIST);
+  
   return false;
 }
 
+void MipiDsiCamISPPipeline::update_stats_expected_() {
+  // Mesures réellement produites par frame ; 0 = la caméra garde sa passe CPU
+  uint8_t expected = 0;
+  if (this->pipeline_started_) {
+    expected |= this->ae_running_ ? IspStatsRecord::FLAG_AE : 0;
+    expected |= this->awb_running_ ? IspStatsRecord::FLAG_AWB : 0;
+    expected |= this->hist_running_ ? IspStatsRecord::FLAG_HIST : 0;
+  }
+  // Sans luminance AE, les statistiques matérielles ne suffisent pas à la 3A
+  if (!(expected & IspStatsRecord::FLAG_AE)) {
+    expected = 0;
+  }
+  this->camera_->get_isp_stats_ring().set_expected(expected);
+}
+
 // ===== Utilitaires =====
 
-void MipiDsiCamISPPipeline::init_default_ccm_matrix_() {
-  // Matrice identité par défaut
-  for (int i = 0; i < 3; i++) {
-    for (int j = 0; j < 3; j++) {
-      this->ccm_matrix_[i][j] = (i == j) ? 1.0f : 0.0f;
-    }
+esp_err_t MipiDsiCamISPPipeline::enable_block_(uint8_t block, esp_err_t (*enable)(isp_proc_handle_t)) {
+  // Reconfigurer un bloc déjà actif ne doit pas le réactiver (le driver refuse)
+  if (this->hw_enabled_ & block) {
+    return ESP_OK;
+  }
+  esp_err_t ret = enable(this->camera_->get_isp_handle());
+  if (ret == ESP_OK) {
+    this->hw_enabled_ |= block;
   }
+  return ret;
+}
+
+esp_err_t MipiDsiCamISPPipeline::disable_block_(uint8_t block, esp_err_t (*disable)(isp_proc_handle_t)) {
+  if (!(this->hw_enabled_ & block)) {
+    return ESP_OK;
+  }
+  // Bit effacé même en cas d'échec : le processeur ISP a pu être détruit entre-temps
+  this->hw_enabled_ &= ~block;
+  isp_proc_handle_t isp = this->camera_->get_isp_handle();
+  return isp != nullptr ? disable(isp) : ESP_OK;
+}
+
+bool MipiDsiCamISPPipeline::handles_white_balance() const {
+  return this->pipeline_started_ && (this->hw_enabled_ & HW_BLOCK_CCM) && this->camera_->get_isp_handle() != nullptr;
 }
 
 void MipiDsiCamISPPipeline::generate_gamma_curve_(float gamma, isp_gamma_curve_points_t *curve) {
-  // Générer une courbe gamma standard
+  // Mêmes points que le modèle logiciel (IspModel) ; tables précalculées ou cache, pas de powf
+  static_assert(ISP_GAMMA_CURVE_POINTS_NUM == ISP_GAMMA_POINTS, "gamma curve size mismatch");
+  const IspGammaCurve &points = this->gamma_cache_.get(gamma);
   for (int i = 0; i < ISP_GAMMA_CURVE_POINTS_NUM; i++) {
-    float x = (float)i / (ISP_GAMMA_CURVE_POINTS_NUM - 1);
-    float y = powf(x, 1.0f / gamma);
-    
-    curve->pt[i].x = (uint32_t)(x * 255.0f);
-    curve->pt[i].y = (uint32_t)(y * 255.0f);
+    curve->pt[i].x = points.x[i];
+    curve->pt[i].y = points.y[i];
   }
 }
 
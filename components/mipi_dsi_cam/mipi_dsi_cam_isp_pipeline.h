@@ -3,6 +3,9 @@
 //#ifdef MIPI_DSI_CAM_ENABLE_ISP_PIPELINE
 
 #include "mipi_dsi_cam.h"
+#include "mipi_dsi_cam_isp_gamma.h"
+#include "mipi_dsi_cam_isp_params.h"
+#include "mipi_dsi_cam_isp_stats.h"
 
 #ifdef USE_ESP32_VARIANT_ESP32P4
 
@@ -62,6 +65,34 @@ class MipiDsiCamISPPipeline {
    */
   esp_err_t deinit();
   
+  // ===== Mises à jour transactionnelles =====
+  //
+  // Les setters ci-dessous n'écrivent que dans une configuration miroir ;
+  // apply_pending() la programme une seule fois par frame, en ne touchant
+  // que les blocs dont les paramètres ont réellement changé. Entre
+  // begin_update() et commit(), rien n'est appliqué : un lot de réglages
+  // arrive dans l'ISP sur la même frame. À appeler depuis la main loop.
+  
+  /**
+   * @brief Ouvre une transaction (imbricable)
+   */
+  void begin_update();
+  
+  /**
+   * @brief Ferme la transaction ; le lot part à la prochaine frontière de frame
+   * @return ESP_ERR_INVALID_STATE sans begin_update() correspondant
+   */
+  esp_err_t commit();
+  
+  /**
+   * @brief Programme les blocs modifiés ; appelé une fois par frame terminée
+   * @return Première erreur rencontrée, les autres blocs étant tout de même appliqués
+   */
+  esp_err_t apply_pending();
+  
+  bool has_pending_update() const { return this->dirty_ != 0; }
+  uint32_t get_applied_update_count() const { return this->applied_updates_; }
+  
   // ===== Configuration Bayer Filter =====
   
   /**
@@ -74,6 +105,11 @@ class MipiDsiCamISPPipeline {
    */
   esp_err_t set_denoising_level(uint8_t level);
   
+  /**
+   * @brief Configure le gabarit 3x3 du filtre (poids 0-15)
+   */
+  esp_err_t set_bayer_filter_kernel(const uint8_t kernel[3][3]);
+  
   // ===== Configuration CCM (Color Correction Matrix) =====
   
   /**
@@ -112,6 +148,11 @@ class MipiDsiCamISPPipeline {
   esp_err_t set_sharpen_params(uint8_t h_thresh, uint8_t l_thresh, 
                                 float h_coeff, float m_coeff);
   
+  /**
+   * @brief Configure le gabarit passe-bas 3x3 de référence (poids 0-31)
+   */
+  esp_err_t set_sharpen_kernel(const uint8_t kernel[3][3]);
+  
   // ===== Configuration Gamma =====
   
   /**
@@ -121,7 +162,8 @@ class MipiDsiCamISPPipeline {
   
   /**
    * @brief Configure la courbe gamma
-   * @param gamma Valeur gamma (0.1 - 5.0), 1.0 = linéaire, <1.0 = plus lumineux, >1.0 = plus sombre
+   * @param gamma Valeur gamma (0.1 - 5.0), 1.0 = linéaire, <1.0 = plus lumineux, >1.0 = plus sombre ;
+   *              ISP_GAMMA_SRGB pour la courbe sRGB. 1.0/1.8/2.2/2.4/sRGB sont précalculées
    */
   esp_err_t set_gamma_curve(float gamma);
   
@@ -185,49 +227,52 @@ class MipiDsiCamISPPipeline {
    */
   esp_err_t enable_histogram(bool enable);
   
+  // Paramètres programmés, exécutables par IspModel pour valider un réglage sans matériel
+  const IspParams &get_params() const { return this->params_; }
+  // Paramètres demandés, pas encore appliqués
+  const IspParams &get_pending_params() const { return this->pending_; }
+  
+  /**
+   * @brief Vrai si la CCM matérielle applique la balance des blancs
+   *
+   * La caméra n'a alors plus à corriger les pixels sur CPU.
+   */
+  bool handles_white_balance() const;
+  
  protected:
+  // Blocs actuellement activés dans l'ISP
+  enum HwBlock : uint8_t {
+    HW_BLOCK_BF = 1 << 0,
+    HW_BLOCK_DEMOSAIC = 1 << 1,
+    HW_BLOCK_CCM = 1 << 2,
+    HW_BLOCK_GAMMA = 1 << 3,
+    HW_BLOCK_SHARPEN = 1 << 4,
+    HW_BLOCK_COLOR = 1 << 5,
+  };
+  
+
   MipiDsiCam *camera_;
   
   // États du pipeline
   bool pipeline_initialized_{false};
   bool pipeline_started_{false};
   
-  // États des modules ISP
-  bool bf_enabled_{true};
-  bool ccm_enabled_{true};
-  bool sharpen_enabled_{true};
-  bool gamma_enabled_{true};
-  bool demosaic_enabled_{true};
-  bool awb_enabled_{false};
-  bool ae_enabled_{false};
-  bool histogram_enabled_{false};
-  
-  // Paramètres Bayer Filter
-  uint8_t denoising_level_{8};
-  
-  // Paramètres CCM
-  float ccm_matrix_[3][3];
-  float red_balance_{1.0f};
-  float green_balance_{1.0f};
-  float blue_balance_{1.0f};
-  
-  // Paramètres Sharpen
-  uint8_t sharpen_h_thresh_{100};
-  uint8_t sharpen_l_thresh_{50};
-  float sharpen_h_coeff_{0.8f};
-  float sharpen_m_coeff_{0.5f};
-  
-  // Paramètres Gamma
-  float gamma_value_{2.2f};
-  
-  // Paramètres Demosaic
-  float demosaic_gradient_ratio_{0.5f};
-  
-  // Paramètres Color
-  int8_t brightness_{0};
-  uint8_t contrast_{128};
-  uint8_t saturation_{128};
-  uint16_t hue_{0};
+  // Paramètres des blocs (mêmes structures que le modèle logiciel IspModel) :
+  // params_ = programmés dans l'ISP, pending_ = miroir écrit par les setters
+  IspParams params_;
+  IspParams pending_;
+  uint8_t dirty_{0};         // Masque HwBlock des blocs à reprogrammer
+  uint8_t update_depth_{0};  // Transactions ouvertes
+  uint32_t applied_updates_{0};
+  IspGammaCache gamma_cache_;
+  // Statistiques matérielles, publiées dans l'IspStatsRing de la caméra pour la 3A
+  bool awb_enabled_{true};
+  bool ae_enabled_{true};
+  bool histogram_enabled_{true};
+  bool awb_running_{false};
+  bool ae_running_{false};
+  bool hist_running_{false};
+  uint8_t hw_enabled_{0};  // Masque HwBlock
   
   // Contrôleurs ISP
   isp_awb_ctlr_t awb_ctlr_{nullptr};
@@ -267,7 +312,7 @@ class MipiDsiCamISPPipeline {
   esp_err_t stop_ae_();
   esp_err_t stop_histogram_();
   
-  // Callbacks ISP
+  // Callbacks ISP (contexte ISR, interruption ISP partagée : jamais concurrents)
   static bool awb_stats_callback(isp_awb_ctlr_t awb_ctlr,
                                   const esp_isp_awb_evt_data_t *edata,
                                   void *user_data);
@@ -281,7 +326,12 @@ class MipiDsiCamISPPipeline {
                                    void *user_data);
   
   // Méthodes utilitaires
-  void init_default_ccm_matrix_();
+  void update_stats_expected_();
+  esp_err_t mark_dirty_(uint8_t block);
+  esp_err_t apply_block_(bool enabled, esp_err_t (MipiDsiCamISPPipeline::*start)(),
+                         esp_err_t (MipiDsiCamISPPipeline::*stop)());
+  esp_err_t enable_block_(uint8_t block, esp_err_t (*enable)(isp_proc_handle_t));
+  esp_err_t disable_block_(uint8_t block, esp_err_t (*disable)(isp_proc_handle_t));
   void generate_gamma_curve_(float gamma, isp_gamma_curve_points_t *curve);
 };
 
@@ -0,0 +1,124 @@
+#include "mipi_dsi_cam_isp_stats.h"
+#include "mipi_dsi_cam_stats.h"
+
+#if defined(USE_ESP32_VARIANT_ESP32P4) || defined(USE_HOST)
+
+#include <algorithm>
+#include <cstring>
+
+namespace esphome {
+namespace mipi_dsi_cam {
+
+void IspStatsRing::set_expected(uint8_t flags) {
+  this->staging_.flags = 0;
+  this->expected_.store(flags, std::memory_order_release);
+}
+
+IspStatsRecord &IRAM_ATTR IspStatsRing::begin_write(uint8_t flag, uint32_t sequence) {
+  // Mesure déjà reçue : la frame précédente n'en enverra pas d'autre
+  if (this->staging_.flags & flag) {
+    this->publish_();
+  }
+  if (this->staging_.flags == 0) {
+    this->staging_.sequence = sequence;
+  }
+  return this->staging_;
+}
+
+void IRAM_ATTR IspStatsRing::end_write(uint8_t flag) {
+  this->staging_.flags |= flag;
+  const uint8_t expected = this->expected_.load(std::memory_order_relaxed);
+  if (expected != 0 && (this->staging_.flags & expected) == expected) {
+    this->publish_();
+  }
+}
+
+void IRAM_ATTR IspStatsRing::publish_() {
+  if (this->staging_.flags == 0) {
+    return;
+  }
+  const uint32_t head = this->head_.load(std::memory_order_relaxed);
+  const uint32_t tail = this->tail_.load(std::memory_order_acquire);
+  if (head - tail >= ISP_STATS_RING_SLOTS) {
+    this->dropped_.fetch_add(1, std::memory_order_relaxed);
+  } else {
+    this->slots_[head % ISP_STATS_RING_SLOTS] = this->staging_;
+    this->head_.store(head + 1, std::memory_order_release);
+    this->published_.fetch_add(1, std::memory_order_relaxed);
+  }
+  this->staging_.flags = 0;
+}
+
+bool IspStatsRing::pop_latest(IspStatsRecord &out) {
+  const uint32_t tail = this->tail_.load(std::memory_order_relaxed);
+  const uint32_t head = this->head_.load(std::memory_order_acquire);
+  if (head == tail) {
+    return false;
+  }
+  // Le producteur n'écrit qu'au-delà de head tant que tail n'avance pas : ce slot est stable
+  out = this->slots_[(head - 1) % ISP_STATS_RING_SLOTS];
+  this->tail_.store(head, std::memory_order_release);
+  return true;
+}
+
+bool isp_stats_to_frame_stats(const IspStatsRecord &record, FrameStats &out) {
+  if (!(record.flags & IspStatsRecord::FLAG_AE)) {
+    out.valid = false;
+    return false;
+  }
+
+  out.sequence = record.sequence;
+  out.zones_x = ISP_STATS_AE_BLOCKS;
+  out.zones_y = ISP_STATS_AE_BLOCKS;
+  uint32_t luma_sum = 0;
+  for (uint8_t y = 0; y < ISP_STATS_AE_BLOCKS; y++) {
+    for (uint8_t x = 0; x < ISP_STATS_AE_BLOCKS; x++) {
+      const uint8_t luma = record.ae_luma[y][x];
+      StatsZone &zone = out.zones[y * ISP_STATS_AE_BLOCKS + x];
+      zone.luma = luma;
+      zone.r = luma;
+      zone.g = luma;
+      zone.b = luma;
+      zone.clipped = luma >= STATS_CLIP_HIGH ? 1 : 0;
+      luma_sum += luma;
+    }
+  }
+  out.mean_luma = luma_sum / (ISP_STATS_AE_BLOCKS * ISP_STATS_AE_BLOCKS);
+
+  // Tranche i (Y de 16i à 16i+15) sur le bin de sa borne haute : luma_percentile() reste conservateur
+  std::memset(out.histogram, 0, sizeof(out.histogram));
+  out.samples = 0;
+  out.clipped_high = 0;
+  out.clipped_low = 0;
+  if (record.flags & IspStatsRecord::FLAG_HIST) {
+    static_assert(STATS_HISTOGRAM_BINS == ISP_STATS_HIST_BINS * 4, "histogram bin mapping");
+    for (uint8_t i = 0; i < ISP_STATS_HIST_BINS; i++) {
+      out.histogram[i * 4 + 3] = record.hist[i];
+      out.samples += record.hist[i];
+    }
+    out.clipped_high = record.hist[ISP_STATS_HIST_BINS - 1];
+    out.clipped_low = record.hist[0];
+  }
+
+  out.white_patches = 0;
+  out.wb_after_gains = false;
+  out.mean_r = out.mean_luma;
+  out.mean_g = out.mean_luma;
+  out.mean_b = out.mean_luma;
+  if ((record.flags & IspStatsRecord::FLAG_AWB) && record.awb_white_patches > 0) {
+    const uint32_t n = record.awb_white_patches;
+    out.white_patches = n;
+    out.wb_after_gains = record.awb_after_gains;
+    out.mean_r = std::min<uint32_t>(255, record.awb_sum_r / n);
+    out.mean_g = std::min<uint32_t>(255, record.awb_sum_g / n);
+    out.mean_b = std::min<uint32_t>(255, record.awb_sum_b / n);
+  }
+
+  out.valid = true;
+  return true;
+}
+
+}  // namespace mipi_dsi_cam
+}  // namespace esphome
+
+#endif  // USE_ESP32_VARIANT_ESP32P4 || USE_HOST
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(USE_ESP32_VARIANT_ESP32P4) || defined(USE_HOST)
+
+#ifdef USE_HOST
+#include "mipi_dsi_cam_host.h"
+#else
+#include "esp_attr.h"
+#endif
+
+namespace esphome {
+namespace mipi_dsi_cam {
+
+struct FrameStats;
+
+// Géométrie des statistiques matérielles (ISP_AE_BLOCK_*_NUM, ISP_HIST_SEGMENT_NUMS)
+static constexpr uint8_t ISP_STATS_AE_BLOCKS = 5;
+static constexpr uint8_t ISP_STATS_HIST_BINS = 16;
+static constexpr uint8_t ISP_STATS_RING_SLOTS = 4;
+
+/**
+ * @brief Mesures ISP d'une frame : luminance AE, white patch AWB, histogramme Y
+ *
+ * Assemblé en ISR à partir des callbacks AE/AWB/histogramme, qui arrivent
+ * séparément pour une même frame.
+ */
+struct IspStatsRecord {
+  enum Flag : uint8_t {
+    FLAG_AE = 1 << 0,
+    FLAG_AWB = 1 << 1,
+    FLAG_HIST = 1 << 2,
+  };
+
+  uint32_t sequence{0};  // Séquence caméra à la première mesure reçue
+  uint8_t flags{0};
+
+  uint8_t ae_luma[ISP_STATS_AE_BLOCKS][ISP_STATS_AE_BLOCKS]{};  // [y][x], moyenne par fenêtre
+
+  uint32_t awb_white_patches{0};
+  uint32_t awb_sum_r{0};
+  uint32_t awb_sum_g{0};
+  uint32_t awb_sum_b{0};
+  bool awb_after_gains{false};  // Mesuré après la CCM portant les gains de balance des blancs
+
+  uint32_t hist[ISP_STATS_HIST_BINS]{};  // Y par tranches de 16
+};
+
+/**
+ * @brief Anneau SPSC des statistiques ISP : ISR -> tâche 3A
+ *
+ * Producteur unique : les callbacks AE/AWB/histogramme partagent
+ * l'interruption ISP et ne s'exécutent jamais en parallèle. Ils complètent
+ * un enregistrement privé, publié dès que toutes les mesures attendues
+ * sont là, ou dès qu'une mesure déjà présente revient (frame suivante :
+ * l'enregistrement partiel part tel quel). Anneau plein : l'enregistrement
+ * est compté perdu, jamais d'attente en ISR.
+ *
+ * Consommateur unique : la tâche 3A (ou la main loop à défaut) ne garde
+ * que le plus récent.
+ */
+class IspStatsRing {
+ public:
+  // Mesures attendues par frame ; 0 = statistiques matérielles inactives.
+  // À changer contrôleurs arrêtés.
+  void set_expected(uint8_t flags);
+  uint8_t get_expected() const { return this->expected_.load(std::memory_order_acquire); }
+  bool is_active() const { return this->get_expected() != 0; }
+
+  // Côté ISR : enregistrement en cours pour la mesure `flag`, à refermer par end_write()
+  IspStatsRecord &begin_write(uint8_t flag, uint32_t sequence);
+  void end_write(uint8_t flag);
+
+  // Côté 3A : dernier enregistrement publié, les plus anciens sont abandonnés
+  bool pop_latest(IspStatsRecord &out);
+
+  uint32_t get_published_count() const { return this->published_.load(std::memory_order_relaxed); }
+  uint32_t get_dropped_count() const { return this->dropped_.load(std::memory_order_relaxed); }
+
+ protected:
+  void publish_();
+
+  IspStatsRecord slots_[ISP_STATS_RING_SLOTS];
+  IspStatsRecord staging_;
+  std::atomic<uint32_t> head_{0};  // Écrit par le producteur
+  std::atomic<uint32_t> tail_{0};  // Écrit par le consommateur
+  std::atomic<uint8_t> expected_{0};
+  std::atomic<uint32_t> published_{0};
+  std::atomic<uint32_t> dropped_{0};
+};
+
+/**
+ * @brief Traduit un enregistrement ISP en FrameStats pour l'AE/AWB
+ *
+ * Zones = fenêtres AE 5x5 ; histogramme 16 tranches reporté sur les bins
+ * hauts de FrameStats ; saturation haute estimée par la dernière tranche
+ * (Y >= 240). Moyennes R/G/B = moyennes white patch quand l'AWB a mesuré.
+ * @return false sans mesure AE
+ */
+bool isp_stats_to_frame_stats(const IspStatsRecord &record, FrameStats &out);
+
+}  // namespace mipi_dsi_cam
+}  // namespace esphome
+
+#endif  // USE_ESP32_VARIANT_ESP32P4 || USE_HOST
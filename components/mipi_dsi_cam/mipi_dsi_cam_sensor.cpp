@@ -0,0 +1,89 @@
+#include "mipi_dsi_cam_sensor.h"
+
+#if defined(USE_ESP32_VARIANT_ESP32P4) && defined(USE_SENSOR)
+
+#include "esphome/core/log.h"
+
+namespace esphome {
+namespace mipi_dsi_cam {
+
+static const char *const TAG = "mipi_dsi_cam.sensor";
+
+void MipiDsiCamSensor::update() {
+  if (this->camera_ == nullptr) {
+    return;
+  }
+
+  if (this->ring_overruns_sensor_ != nullptr) {
+    this->ring_overruns_sensor_->publish_state(this->camera_->get_ring_overrun_count());
+  }
+  if (this->ring_skips_sensor_ != nullptr) {
+    this->ring_skips_sensor_->publish_state(this->camera_->get_ring_skip_count());
+  }
+  // Durée de la dernière convergence AE, publiée une fois qu'il y en a eu une
+  if (this->ae_convergence_time_sensor_ != nullptr && this->camera_->get_ae_convergence_frames() > 0) {
+    this->ae_convergence_time_sensor_->publish_state(this->camera_->get_ae_convergence_ms());
+  }
+  // Mesuré une seule fois ; publié dès que la première frame est arrivée
+  if (this->boot_to_first_frame_sensor_ != nullptr && this->camera_->get_boot_to_first_frame_ms() > 0 &&
+      !this->boot_to_first_frame_sensor_->has_state()) {
+    this->boot_to_first_frame_sensor_->publish_state(this->camera_->get_boot_to_first_frame_ms());
+  }
+
+  if (this->consumer_id_ == INVALID_CONSUMER_ID) {
+    this->consumer_id_ = this->camera_->find_consumer(this->consumer_name_);
+    if (this->consumer_id_ == INVALID_CONSUMER_ID) {
+      ESP_LOGV(TAG, "Consumer '%s' not registered yet", this->consumer_name_.c_str());
+      return;
+    }
+  }
+
+  const FrameConsumer *consumer = this->camera_->get_consumer(this->consumer_id_);
+  if (consumer == nullptr) {
+    return;
+  }
+
+  // Fenêtre depuis le dernier update()
+  const LatencySnapshot capture = consumer->capture_to_acquire.snapshot();
+  const LatencySnapshot hold = consumer->hold_time.snapshot();
+  const LatencySnapshot capture_window = capture.since(this->last_capture_latency_);
+  const LatencySnapshot hold_window = hold.since(this->last_hold_time_);
+  this->last_capture_latency_ = capture;
+  this->last_hold_time_ = hold;
+
+  if (this->capture_latency_sensor_ != nullptr && capture_window.count > 0) {
+    this->capture_latency_sensor_->publish_state(capture_window.mean_ms());
+  }
+  if (this->capture_latency_p95_sensor_ != nullptr && capture_window.count > 0) {
+    this->capture_latency_p95_sensor_->publish_state(capture_window.percentile_ms(95));
+  }
+  if (this->hold_time_sensor_ != nullptr && hold_window.count > 0) {
+    this->hold_time_sensor_->publish_state(hold_window.mean_ms());
+  }
+  if (this->hold_time_p95_sensor_ != nullptr && hold_window.count > 0) {
+    this->hold_time_p95_sensor_->publish_state(hold_window.percentile_ms(95));
+  }
+  if (this->dropped_frames_sensor_ != nullptr) {
+    this->dropped_frames_sensor_->publish_state(consumer->drops);
+  }
+}
+
+void MipiDsiCamSensor::dump_config() {
+  ESP_LOGCONFIG(TAG, "MIPI Camera telemetry:");
+  ESP_LOGCONFIG(TAG, "  Consumer: %s", this->consumer_name_.c_str());
+  LOG_UPDATE_INTERVAL(this);
+  LOG_SENSOR("  ", "Capture latency", this->capture_latency_sensor_);
+  LOG_SENSOR("  ", "Capture latency p95", this->capture_latency_p95_sensor_);
+  LOG_SENSOR("  ", "Hold time", this->hold_time_sensor_);
+  LOG_SENSOR("  ", "Hold time p95", this->hold_time_p95_sensor_);
+  LOG_SENSOR("  ", "Dropped frames", this->dropped_frames_sensor_);
+  LOG_SENSOR("  ", "Ring overruns", this->ring_overruns_sensor_);
+  LOG_SENSOR("  ", "Ring skips", this->ring_skips_sensor_);
+  LOG_SENSOR("  ", "AE convergence time", this->ae_convergence_time_sensor_);
+  LOG_SENSOR("  ", "Boot to first frame", this->boot_to_first_frame_sensor_);
+}
+
+}  // namespace mipi_dsi_cam
+}  // namespace esphome
+
+#endif  // USE_ESP32_VARIANT_ESP32P4 && USE_SENSOR
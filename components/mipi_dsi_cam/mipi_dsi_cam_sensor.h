@@ -0,0 +1,62 @@
+#pragma once
+
+#include "esphome/core/defines.h"
+
+#if defined(USE_ESP32_VARIANT_ESP32P4) && defined(USE_SENSOR)
+
+#include "esphome/core/component.h"
+#include "esphome/components/sensor/sensor.h"
+#include "mipi_dsi_cam.h"
+
+namespace esphome {
+namespace mipi_dsi_cam {
+
+/**
+ * @brief Expose la télémétrie d'un consommateur de frames en sensors ESPHome
+ *
+ * Les latences sont calculées sur la fenêtre entre deux update() (différence
+ * de snapshots), les compteurs sont cumulés depuis le boot.
+ */
+class MipiDsiCamSensor : public PollingComponent {
+public:
+  void update() override;
+  void dump_config() override;
+  float get_setup_priority() const override { return setup_priority::LATE; }
+
+  void set_camera(MipiDsiCam *camera) { this->camera_ = camera; }
+  void set_consumer_name(const std::string &name) { this->consumer_name_ = name; }
+
+  void set_capture_latency_sensor(sensor::Sensor *s) { this->capture_latency_sensor_ = s; }
+  void set_capture_latency_p95_sensor(sensor::Sensor *s) { this->capture_latency_p95_sensor_ = s; }
+  void set_hold_time_sensor(sensor::Sensor *s) { this->hold_time_sensor_ = s; }
+  void set_hold_time_p95_sensor(sensor::Sensor *s) { this->hold_time_p95_sensor_ = s; }
+  void set_dropped_frames_sensor(sensor::Sensor *s) { this->dropped_frames_sensor_ = s; }
+  void set_ring_overruns_sensor(sensor::Sensor *s) { this->ring_overruns_sensor_ = s; }
+  void set_ring_skips_sensor(sensor::Sensor *s) { this->ring_skips_sensor_ = s; }
+  void set_ae_convergence_time_sensor(sensor::Sensor *s) { this->ae_convergence_time_sensor_ = s; }
+  void set_boot_to_first_frame_sensor(sensor::Sensor *s) { this->boot_to_first_frame_sensor_ = s; }
+
+protected:
+  MipiDsiCam *camera_{nullptr};
+  std::string consumer_name_;
+  // Les consommateurs s'enregistrent dans leur setup() : résolution paresseuse
+  uint8_t consumer_id_{INVALID_CONSUMER_ID};
+
+  LatencySnapshot last_capture_latency_;
+  LatencySnapshot last_hold_time_;
+
+  sensor::Sensor *capture_latency_sensor_{nullptr};
+  sensor::Sensor *capture_latency_p95_sensor_{nullptr};
+  sensor::Sensor *hold_time_sensor_{nullptr};
+  sensor::Sensor *hold_time_p95_sensor_{nullptr};
+  sensor::Sensor *dropped_frames_sensor_{nullptr};
+  sensor::Sensor *ring_overruns_sensor_{nullptr};
+  sensor::Sensor *ring_skips_sensor_{nullptr};
+  sensor::Sensor *ae_convergence_time_sensor_{nullptr};
+  sensor::Sensor *boot_to_first_frame_sensor_{nullptr};
+};
+
+}  // namespace mipi_dsi_cam
+}  // namespace esphome
+
+#endif  // USE_ESP32_VARIANT_ESP32P4 && USE_SENSOR
@@ -0,0 +1,352 @@
+#include "mipi_dsi_cam_sim.h"
+
+#if defined(USE_ESP32_VARIANT_ESP32P4) || defined(USE_HOST)
+
+#include "esphome/core/log.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+namespace esphome {
+namespace mipi_dsi_cam {
+
+static const char *const TAG = "mipi_dsi_cam.sim";
+
+// Registres SC202CS reproduits par le capteur simulé
+static constexpr uint16_t SIM_REG_SENSOR_ID_H = 0x3107;
+static constexpr uint16_t SIM_REG_SENSOR_ID_L = 0x3108;
+static constexpr uint16_t SIM_REG_STREAM_MODE = 0x0100;
+static constexpr uint16_t SIM_REG_EXPOSURE_H = 0x3e00;
+static constexpr uint16_t SIM_REG_EXPOSURE_M = 0x3e01;
+static constexpr uint16_t SIM_REG_EXPOSURE_L = 0x3e02;
+static constexpr uint16_t SIM_REG_GAIN_COARSE = 0x3e06;
+static constexpr uint16_t SIM_REG_GAIN_FINE = 0x3e07;
+static constexpr uint16_t SIM_REG_GAIN_ANALOG = 0x3e09;
+static constexpr uint16_t SIM_REG_GROUP_HOLD = 0x3812;
+static constexpr uint8_t SIM_GROUP_HOLD_BEGIN = 0x00;
+static constexpr uint8_t SIM_GROUP_HOLD_END = 0x30;
+
+esp_err_t SimSensorDriver::init() {
+  this->registers_[SIM_REG_SENSOR_ID_H] = this->pid_ >> 8;
+  this->registers_[SIM_REG_SENSOR_ID_L] = this->pid_ & 0xFF;
+  this->registers_[SIM_REG_STREAM_MODE] = 0x00;
+  ESP_LOGI(TAG, "Simulated sensor %ux%u @ %u fps (PID 0x%04X)",
+           this->width_, this->height_, this->fps_, this->pid_);
+  return ESP_OK;
+}
+
+esp_err_t SimSensorDriver::read_id(uint16_t* pid) {
+  if (pid == nullptr) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  *pid = this->pid_;
+  return ESP_OK;
+}
+
+esp_err_t SimSensorDriver::start_stream() {
+  return this->write_register(SIM_REG_STREAM_MODE, 0x01);
+}
+
+esp_err_t SimSensorDriver::stop_stream() {
+  return this->write_register(SIM_REG_STREAM_MODE, 0x00);
+}
+
+esp_err_t SimSensorDriver::set_gain(uint32_t gain_index) {
+  SensorRegister writes[SENSOR_MAX_SETTING_REGISTERS];
+  size_t count = this->get_gain_registers(gain_index, writes);
+  for (size_t i = 0; i < count; i++) {
+    esp_err_t ret = this->write_register(writes[i].reg, writes[i].value);
+    if (ret != ESP_OK) return ret;
+  }
+  return ESP_OK;
+}
+
+esp_err_t SimSensorDriver::set_exposure(uint32_t exposure) {
+  SensorRegister writes[SENSOR_MAX_SETTING_REGISTERS];
+  size_t count = this->get_exposure_registers(exposure, writes);
+  for (size_t i = 0; i < count; i++) {
+    esp_err_t ret = this->write_register(writes[i].reg, writes[i].value);
+    if (ret != ESP_OK) return ret;
+  }
+  return ESP_OK;
+}
+
+size_t SimSensorDriver::get_exposure_registers(uint32_t exposure, SensorRegister *out) const {
+  out[0] = {SIM_REG_EXPOSURE_H, static_cast<uint8_t>((exposure >> 12) & 0x0F)};
+  out[1] = {SIM_REG_EXPOSURE_M, static_cast<uint8_t>((exposure >> 4) & 0xFF)};
+  out[2] = {SIM_REG_EXPOSURE_L, static_cast<uint8_t>((exposure & 0x0F) << 4)};
+  return 3;
+}
+
+size_t SimSensorDriver::get_gain_registers(uint32_t gain_index, SensorRegister *out) const {
+  // Même découpage que la table SC202CS : pas fin dans 0x3e07, octave dans coarse/analog
+  gain_index = std::min<uint32_t>(gain_index, GAIN_STEPS - 1);
+  const uint32_t octave = gain_index / 32;
+  const uint8_t analog = octave > 1 ? static_cast<uint8_t>((1u << (octave - 1)) - 1) : 0x00;
+  out[0] = {SIM_REG_GAIN_FINE, static_cast<uint8_t>(0x80 + (gain_index % 32) * 4)};
+  out[1] = {SIM_REG_GAIN_COARSE, static_cast<uint8_t>(octave > 0 ? 0x01 : 0x00)};
+  out[2] = {SIM_REG_GAIN_ANALOG, analog};
+  return 3;
+}
+
+bool SimSensorDriver::get_group_hold(SensorRegister *begin, SensorRegister *end) const {
+  *begin = {SIM_REG_GROUP_HOLD, SIM_GROUP_HOLD_BEGIN};
+  *end = {SIM_REG_GROUP_HOLD, SIM_GROUP_HOLD_END};
+  return true;
+}
+
+esp_err_t SimSensorDriver::write_register(uint16_t reg, uint8_t value) {
+  this->registers_[reg] = value;
+  this->write_count_.fetch_add(1, std::memory_order_relaxed);
+
+  switch (reg) {
+    case SIM_REG_STREAM_MODE:
+      this->streaming_.store(value & 0x01, std::memory_order_relaxed);
+      break;
+    case SIM_REG_GROUP_HOLD:
+      // Les registres tenus deviennent effectifs ensemble à la libération
+      this->group_hold_ = value == SIM_GROUP_HOLD_BEGIN;
+      if (!this->group_hold_) {
+        this->update_settings_();
+      }
+      break;
+    case SIM_REG_EXPOSURE_H:
+    case SIM_REG_EXPOSURE_M:
+    case SIM_REG_EXPOSURE_L:
+    case SIM_REG_GAIN_COARSE:
+    case SIM_REG_GAIN_FINE:
+    case SIM_REG_GAIN_ANALOG:
+      if (!this->group_hold_) {
+        this->update_settings_();
+      }
+      break;
+    default:
+      break;
+  }
+  return ESP_OK;
+}
+
+void SimSensorDriver::update_settings_() {
+  this->exposure_.store(((this->registers_[SIM_REG_EXPOSURE_H] & 0x0F) << 12) |
+                            (this->registers_[SIM_REG_EXPOSURE_M] << 4) |
+                            (this->registers_[SIM_REG_EXPOSURE_L] >> 4),
+                        std::memory_order_relaxed);
+
+  const uint8_t fine = this->registers_[SIM_REG_GAIN_FINE];
+  uint32_t octave = this->registers_[SIM_REG_GAIN_COARSE];
+  for (uint8_t analog = this->registers_[SIM_REG_GAIN_ANALOG] & 0x0F; analog != 0; analog >>= 1) {
+    octave += analog & 1;
+  }
+  const uint32_t step = fine >= 0x80 ? (fine - 0x80) / 4 : 0;
+  this->gain_index_.store(std::min<uint32_t>(octave * 32 + std::min<uint32_t>(step, 31), GAIN_STEPS - 1),
+                          std::memory_order_relaxed);
+}
+
+float SimSensorDriver::get_gain_multiplier(uint16_t gain_index) const {
+  gain_index = std::min<uint16_t>(gain_index, GAIN_STEPS - 1);
+  return static_cast<float>(1u << (gain_index / 32)) * (1.0f + (gain_index % 32) / 32.0f);
+}
+
+void SimSensorDriver::latch_frame() {
+  this->frame_settings_.store(this->staged_settings_, std::memory_order_relaxed);
+  this->staged_settings_ = (this->gain_index_.load(std::memory_order_relaxed) << 24) |
+                           (this->exposure_.load(std::memory_order_relaxed) & 0xFFFFFF);
+}
+
+esp_err_t SimSensorDriver::read_register(uint16_t reg, uint8_t* value) {
+  if (value == nullptr) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  auto it = this->registers_.find(reg);
+  *value = it != this->registers_.end() ? it->second : 0x00;
+  return ESP_OK;
+}
+
+size_t SimFrameSource::frame_size_for(PixelFormat format, uint16_t width, uint16_t height) {
+  return pixel_format_frame_size(format, width, height);
+}
+
+bool SimFrameSource::load_file(const std::string &path) {
+  this->frame_size_ = frame_size_for(this->format_, this->width_, this->height_);
+
+  FILE *file = fopen(path.c_str(), "rb");
+  if (file == nullptr) {
+    ESP_LOGE(TAG, "Cannot open %s", path.c_str());
+    return false;
+  }
+
+  fseek(file, 0, SEEK_END);
+  long file_size = ftell(file);
+  fseek(file, 0, SEEK_SET);
+
+  size_t count = file_size > 0 ? static_cast<size_t>(file_size) / this->frame_size_ : 0;
+  if (count == 0) {
+    ESP_LOGE(TAG, "%s is smaller than one frame (%u bytes)", path.c_str(), (unsigned) this->frame_size_);
+    fclose(file);
+    return false;
+  }
+
+  this->frames_.resize(count * this->frame_size_);
+  size_t read = fread(this->frames_.data(), 1, this->frames_.size(), file);
+  fclose(file);
+  if (read != this->frames_.size()) {
+    ESP_LOGE(TAG, "Short read on %s", path.c_str());
+    this->frames_.clear();
+    return false;
+  }
+
+  this->frame_count_ = count;
+  this->file_format_ = this->format_;
+  ESP_LOGI(TAG, "Loaded %u frames from %s", (unsigned) count, path.c_str());
+  return true;
+}
+
+bool SimFrameSource::start(MipiDsiCam *camera, uint8_t fps) {
+  if (this->running_.load() || camera == nullptr || fps == 0) {
+    return false;
+  }
+
+  this->frame_size_ = frame_size_for(this->format_, this->width_, this->height_);
+  this->camera_ = camera;
+  this->period_us_ = 1000000 / fps;
+  this->delivered_.store(0);
+  this->lost_.store(0);
+  this->running_.store(true);
+  this->thread_ = std::thread(&SimFrameSource::run_, this);
+
+  ESP_LOGI(TAG, "Simulated CSI started: %u fps, %s, %s", fps,
+           this->replays_file_() ? "file replay" : "test pattern", pixel_format_to_string(this->format_));
+  return true;
+}
+
+void SimFrameSource::stop() {
+  if (!this->running_.exchange(false)) {
+    return;
+  }
+  if (this->thread_.joinable()) {
+    this->thread_.join();
+  }
+  ESP_LOGI(TAG, "Simulated CSI stopped (%u delivered, %u lost)",
+           this->delivered_.load(), this->lost_.load());
+}
+
+void SimFrameSource::run_() {
+  auto deadline = std::chrono::steady_clock::now();
+  uint32_t index = 0;
+
+  while (this->running_.load(std::memory_order_relaxed)) {
+    deadline += std::chrono::microseconds(this->period_us_);
+    std::this_thread::sleep_until(deadline);
+    this->deliver_(index++);
+  }
+}
+
+void SimFrameSource::deliver_(uint32_t index) {
+  if (this->sensor_ != nullptr) {
+    this->sensor_->latch_frame();
+  }
+
+  // Même protocole que le driver CSI : demande d'un buffer, DMA, fin de transaction
+  esp_cam_ctlr_trans_t trans = {};
+  MipiDsiCam::on_csi_new_frame_(nullptr, &trans, this->camera_);
+  if (trans.buffer == nullptr) {
+    // Le driver CSI utiliserait son buffer de secours : pas de on_trans_finished
+    this->lost_.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  size_t size = std::min(trans.buflen, this->frame_size_);
+  uint8_t *dst = static_cast<uint8_t *>(trans.buffer);
+  if (this->replays_file_()) {
+    std::memcpy(dst, &this->frames_[(index % this->frame_count_) * this->frame_size_], size);
+  } else {
+    this->render_pattern_(dst, size, index);
+  }
+
+  trans.received_size = size;
+  MipiDsiCam::on_csi_frame_done_(nullptr, &trans, this->camera_);
+  this->delivered_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void SimFrameSource::render_pattern_(uint8_t *dst, size_t size, uint32_t index) {
+  // Mire 8 barres (blanc, jaune, cyan, vert, magenta, rouge, bleu, noir) défilant de 4 px/frame
+  static const uint8_t BARS[8][3] = {
+    {255, 255, 255}, {255, 255, 0}, {0, 255, 255}, {0, 255, 0},
+    {255, 0, 255}, {255, 0, 0}, {0, 0, 255}, {0, 0, 0},
+  };
+
+  // Luminosité proportionnelle à l'exposition totale (exposition x gain) effective ;
+  // la scène peut dépasser 255 : les barres claires saturent, comme sur un vrai capteur
+  uint32_t level = 128;
+  if (this->sensor_ != nullptr) {
+    float total = this->sensor_->get_frame_exposure() *
+                  this->sensor_->get_gain_multiplier(this->sensor_->get_frame_gain_index());
+    level = std::min<uint32_t>(255 * 64, static_cast<uint32_t>(total * 128.0f / SimSensorDriver::NOMINAL_EXPOSURE));
+  }
+
+  const size_t stride = pixel_format_bytes_per_line(this->format_, this->width_);
+  if (stride == 0) {
+    return;
+  }
+
+  // Une paire de lignes est calculée (mosaïque Bayer en RAW8), les autres en sont des copies
+  std::vector<uint8_t> lines(stride * 2);
+  uint8_t *line = lines.data();
+  uint8_t *odd_line = line + stride;
+  // Position du rouge dans le quad Bayer (BGGR, GBRG, GRBG, RGGB)
+  static const uint8_t RED_POS[4][2] = {{1, 1}, {0, 1}, {1, 0}, {0, 0}};
+  const uint8_t bayer = this->camera_ != nullptr ? this->camera_->get_bayer_pattern() & 3 : 0;
+  const uint32_t red_x = RED_POS[bayer][0];
+  const uint32_t red_y = RED_POS[bayer][1];
+  const uint32_t bar_width = std::max<uint32_t>(1, this->width_ / 8);
+  for (uint32_t x = 0; x < this->width_; x++) {
+    const uint8_t *rgb = BARS[((x + index * 4) / bar_width) % 8];
+    // Barres à 75 % sur fond gris 25 % : la luma moyenne peut atteindre la saturation
+    uint8_t r = std::min<uint32_t>(255, (64 + rgb[0] * 3 / 4) * level / 255);
+    uint8_t g = std::min<uint32_t>(255, (64 + rgb[1] * 3 / 4) * level / 255);
+    uint8_t b = std::min<uint32_t>(255, (64 + rgb[2] * 3 / 4) * level / 255);
+
+    switch (this->format_) {
+      case PixelFormat::PIXEL_FORMAT_RAW8: {
+        // Rouge en (red_x, red_y), bleu à l'opposé, vert ailleurs
+        const bool red_column = (x & 1) == red_x;
+        line[x] = red_y == 0 ? (red_column ? r : g) : (red_column ? g : b);
+        odd_line[x] = red_y == 1 ? (red_column ? r : g) : (red_column ? g : b);
+        break;
+      }
+      case PixelFormat::PIXEL_FORMAT_YUV422:
+        // YUYV : luma par pixel, chroma neutre
+        line[x * 2] = (r * 77 + g * 150 + b * 29) >> 8;
+        line[x * 2 + 1] = 128;
+        break;
+      case PixelFormat::PIXEL_FORMAT_YUV420:
+        // U/V Y Y par paire de pixels, chroma neutre (lignes U et V identiques)
+        if ((x & 1) == 0) {
+          line[(x / 2) * 3] = 128;
+        }
+        line[(x / 2) * 3 + 1 + (x & 1)] = (r * 77 + g * 150 + b * 29) >> 8;
+        break;
+      case PixelFormat::PIXEL_FORMAT_RGB565:
+      default: {
+        uint16_t pixel = ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3);
+        line[x * 2] = pixel & 0xFF;
+        line[x * 2 + 1] = pixel >> 8;
+        break;
+      }
+    }
+  }
+  if (this->format_ != PixelFormat::PIXEL_FORMAT_RAW8) {
+    std::memcpy(odd_line, line, stride);
+  }
+
+  for (size_t offset = 0, row = 0; offset < size; offset += stride, row++) {
+    std::memcpy(dst + offset, (row & 1) ? odd_line : line, std::min(stride, size - offset));
+  }
+}
+
+}  // namespace mipi_dsi_cam
+}  // namespace esphome
+
+#endif  // USE_ESP32_VARIANT_ESP32P4 || USE_HOST
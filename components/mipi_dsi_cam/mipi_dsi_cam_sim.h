@@ -0,0 +1,150 @@
+#pragma once
+
+#include "mipi_dsi_cam.h"
+
+#if defined(USE_ESP32_VARIANT_ESP32P4) || defined(USE_HOST)
+
+#include <atomic>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace esphome {
+namespace mipi_dsi_cam {
+
+/**
+ * @brief Capteur simulé : accepte toutes les écritures registres, renvoie le PID attendu
+ *
+ * Les registres d'exposition/gain suivent la disposition SC202CS, ce qui
+ * permet à SimFrameSource de moduler la luminosité de sa mire.
+ */
+class SimSensorDriver : public ISensorDriver {
+public:
+  static constexpr uint16_t DEFAULT_PID = 0xEB52;
+  static constexpr uint16_t NOMINAL_EXPOSURE = 0x9C0;
+  // Même progression que la table SC202CS : 6 octaves de 32 pas
+  static constexpr uint16_t GAIN_STEPS = 192;
+
+  SimSensorDriver(uint16_t width, uint16_t height, uint8_t fps, uint16_t pid = DEFAULT_PID)
+    : width_(width), height_(height), fps_(fps), pid_(pid) {}
+
+  const char* get_name() const override { return "sim"; }
+  uint16_t get_pid() const override { return this->pid_; }
+  uint8_t get_i2c_address() const override { return 0x36; }
+  uint8_t get_lane_count() const override { return 1; }
+  uint8_t get_bayer_pattern() const override { return 0; }
+  uint16_t get_lane_bitrate_mbps() const override { return 576; }
+  uint16_t get_width() const override { return this->width_; }
+  uint16_t get_height() const override { return this->height_; }
+  uint8_t get_fps() const override { return this->fps_; }
+
+  esp_err_t init() override;
+  esp_err_t read_id(uint16_t* pid) override;
+  esp_err_t start_stream() override;
+  esp_err_t stop_stream() override;
+  bool is_stream_active() override { return this->is_streaming(); }
+  esp_err_t set_gain(uint32_t gain_index) override;
+  esp_err_t set_exposure(uint32_t exposure) override;
+  esp_err_t write_register(uint16_t reg, uint8_t value) override;
+  esp_err_t read_register(uint16_t reg, uint8_t* value) override;
+  uint16_t get_gain_count() const override { return GAIN_STEPS; }
+  float get_gain_multiplier(uint16_t gain_index) const override;
+  size_t get_exposure_registers(uint32_t exposure, SensorRegister *out) const override;
+  size_t get_gain_registers(uint32_t gain_index, SensorRegister *out) const override;
+  bool get_group_hold(SensorRegister *begin, SensorRegister *end) const override;
+
+  /**
+   * @brief Début de frame : les registres écrits deviennent effectifs deux frames plus tard
+   *
+   * Reproduit le pipeline d'exposition d'un vrai capteur (écriture pendant
+   * la frame N, prise en compte à N+1, visible dans les pixels de N+2).
+   */
+  void latch_frame();
+  uint32_t get_frame_exposure() const { return this->frame_settings_.load(std::memory_order_relaxed) & 0xFFFFFF; }
+  uint32_t get_frame_gain_index() const { return this->frame_settings_.load(std::memory_order_relaxed) >> 24; }
+
+  // Introspection pour les tests et benchmarks
+  uint32_t get_exposure() const { return this->exposure_.load(std::memory_order_relaxed); }
+  uint32_t get_gain_index() const { return this->gain_index_.load(std::memory_order_relaxed); }
+  uint32_t get_register_write_count() const { return this->write_count_.load(std::memory_order_relaxed); }
+  bool is_streaming() const { return this->streaming_.load(std::memory_order_relaxed); }
+
+protected:
+  // Recalcule exposition/gain depuis les registres (différé pendant un group hold)
+  void update_settings_();
+
+  uint16_t width_;
+  uint16_t height_;
+  uint8_t fps_;
+  uint16_t pid_;
+
+  std::map<uint16_t, uint8_t> registers_;
+  bool group_hold_{false};
+  std::atomic<uint32_t> exposure_{NOMINAL_EXPOSURE};
+  std::atomic<uint32_t> gain_index_{0};
+  std::atomic<uint32_t> write_count_{0};
+  // Réglages (gain << 24 | exposition) en attente puis effectifs pour la frame courante
+  uint32_t staged_settings_{NOMINAL_EXPOSURE};
+  std::atomic<uint32_t> frame_settings_{NOMINAL_EXPOSURE};
+  std::atomic<bool> streaming_{false};
+};
+
+/**
+ * @brief Source de frames simulée : remplace le DMA CSI
+ *
+ * Un thread cadencé (échéances absolues, sans dérive) appelle les mêmes
+ * callbacks on_csi_new_frame_ / on_csi_frame_done_ que le driver CSI.
+ * Les frames viennent d'un fichier brut (frames concaténées au format
+ * configuré) ou, à défaut, d'une mire animée dont la luminosité suit
+ * l'exposition et le gain effectifs du SimSensorDriver (avec son retard).
+ */
+class SimFrameSource {
+public:
+  SimFrameSource(PixelFormat format, uint16_t width, uint16_t height)
+    : format_(format), width_(width), height_(height) {}
+  ~SimFrameSource() { this->stop(); }
+
+  static size_t frame_size_for(PixelFormat format, uint16_t width, uint16_t height);
+
+  bool load_file(const std::string &path);
+  // Flux arrêté uniquement ; un fichier chargé n'est rejoué que dans son propre format
+  void set_format(PixelFormat format) { this->format_ = format; }
+  void set_sensor(SimSensorDriver *sensor) { this->sensor_ = sensor; }
+
+  bool start(MipiDsiCam *camera, uint8_t fps);
+  void stop();
+  bool is_running() const { return this->running_.load(std::memory_order_relaxed); }
+
+  uint32_t get_frames_delivered() const { return this->delivered_.load(std::memory_order_relaxed); }
+  uint32_t get_frames_lost() const { return this->lost_.load(std::memory_order_relaxed); }
+
+protected:
+  void run_();
+  void deliver_(uint32_t index);
+  void render_pattern_(uint8_t *dst, size_t size, uint32_t index);
+  bool replays_file_() const { return this->frame_count_ > 0 && this->format_ == this->file_format_; }
+
+  PixelFormat format_;
+  uint16_t width_;
+  uint16_t height_;
+  size_t frame_size_{0};
+
+  std::vector<uint8_t> frames_;
+  size_t frame_count_{0};
+  PixelFormat file_format_{PixelFormat::PIXEL_FORMAT_RGB565};
+
+  SimSensorDriver *sensor_{nullptr};
+  MipiDsiCam *camera_{nullptr};
+  uint32_t period_us_{33333};
+
+  std::thread thread_;
+  std::atomic<bool> running_{false};
+  std::atomic<uint32_t> delivered_{0};
+  std::atomic<uint32_t> lost_{0};
+};
+
+}  // namespace mipi_dsi_cam
+}  // namespace esphome
+
+#endif  // USE_ESP32_VARIANT_ESP32P4 || USE_HOST
@@ -0,0 +1,223 @@
+#include "mipi_dsi_cam_stats.h"
+#include "mipi_dsi_cam.h"
+
+#if defined(USE_ESP32_VARIANT_ESP32P4) || defined(USE_HOST)
+
+#include <algorithm>
+#include <cstring>
+
+namespace esphome {
+namespace mipi_dsi_cam {
+
+static inline uint8_t stats_luma(uint8_t r, uint8_t g, uint8_t b) {
+  return static_cast<uint8_t>((r * 77 + g * 150 + b * 29) >> 8);
+}
+
+static inline uint8_t stats_clamp(int32_t v) {
+  return static_cast<uint8_t>(v < 0 ? 0 : (v > 255 ? 255 : v));
+}
+
+uint8_t FrameStats::center_weighted_luma() const {
+  if (!this->valid || this->zones_x == 0 || this->zones_y == 0) {
+    return this->mean_luma;
+  }
+
+  uint32_t sum = 0;
+  uint32_t weight = 0;
+  for (uint8_t y = 0; y < this->zones_y; y++) {
+    for (uint8_t x = 0; x < this->zones_x; x++) {
+      // Moitié centrale de l'image comptée double
+      bool center = x >= this->zones_x / 4 && x < this->zones_x - this->zones_x / 4 &&
+                    y >= this->zones_y / 4 && y < this->zones_y - this->zones_y / 4;
+      uint32_t w = center ? 2 : 1;
+      sum += this->zone(x, y).luma * w;
+      weight += w;
+    }
+  }
+  return weight > 0 ? sum / weight : this->mean_luma;
+}
+
+uint8_t FrameStats::luma_percentile(float percentile) const {
+  if (this->samples == 0) {
+    return 0;
+  }
+  uint32_t rank = static_cast<uint32_t>(this->samples * percentile / 100.0f);
+  uint32_t seen = 0;
+  for (uint8_t i = 0; i < STATS_HISTOGRAM_BINS; i++) {
+    seen += this->histogram[i];
+    if (seen > rank) {
+      return i * 4 + 3;
+    }
+  }
+  return 255;
+}
+
+void FrameStatsEngine::configure(uint8_t zones_x, uint8_t zones_y, uint8_t stride) {
+  this->zones_x_ = std::max<uint8_t>(1, std::min(zones_x, STATS_MAX_ZONES_X));
+  this->zones_y_ = std::max<uint8_t>(1, std::min(zones_y, STATS_MAX_ZONES_Y));
+  this->stride_ = std::max<uint8_t>(1, stride);
+}
+
+void FrameStatsEngine::accumulate_(uint32_t zone, uint8_t r, uint8_t g, uint8_t b, FrameStats &out) {
+  const uint8_t y = stats_luma(r, g, b);
+  ZoneAccumulator &acc = this->acc_[zone];
+  acc.luma += y;
+  acc.r += r;
+  acc.g += g;
+  acc.b += b;
+  acc.count++;
+
+  out.histogram[y >> 2]++;
+  if (y >= STATS_CLIP_HIGH) {
+    acc.clipped++;
+    out.clipped_high++;
+  } else if (y <= STATS_CLIP_LOW) {
+    out.clipped_low++;
+  }
+}
+
+bool FrameStatsEngine::compute(const uint8_t *frame, size_t size, uint16_t width, uint16_t height,
+                               PixelFormat format, uint8_t bayer_pattern, FrameStats &out) {
+  if (frame == nullptr || width == 0 || height == 0) {
+    out.valid = false;
+    return false;
+  }
+
+  const bool raw = format == PixelFormat::PIXEL_FORMAT_RAW8;
+  // RAW et YUV420 se lisent par paires de lignes (quad Bayer, lignes U puis V)
+  const bool line_pairs = raw || format == PixelFormat::PIXEL_FORMAT_YUV420;
+  const size_t line_bytes = pixel_format_bytes_per_line(format, width);
+  if (size < line_bytes * height) {
+    out.valid = false;
+    return false;
+  }
+
+  const uint8_t zx_count = this->zones_x_;
+  const uint8_t zy_count = this->zones_y_;
+  // En RAW, on échantillonne des quads 2x2 complets : pas pair
+  const uint32_t stride = raw ? ((this->stride_ + 1) & ~1u) : this->stride_;
+
+  std::memset(this->acc_, 0, sizeof(ZoneAccumulator) * zx_count * zy_count);
+  std::memset(out.histogram, 0, sizeof(out.histogram));
+  out.samples = 0;
+  out.clipped_high = 0;
+  out.clipped_low = 0;
+  out.white_patches = 0;
+  out.wb_after_gains = false;
+
+  // Position du rouge dans le quad Bayer (BGGR, GBRG, GRBG, RGGB)
+  static const uint8_t RED_POS[4][2] = {{1, 1}, {0, 1}, {1, 0}, {0, 0}};
+  const uint8_t red_x = RED_POS[bayer_pattern & 3][0];
+  const uint8_t red_y = RED_POS[bayer_pattern & 3][1];
+
+  // En RAW, première ligne paire : les quads lus restent alignés sur le motif Bayer
+  const uint32_t y_start = raw ? ((stride / 2) & ~1u) : stride / 2;
+  for (uint32_t y = y_start; y + (line_pairs ? 1 : 0) < height; y += stride) {
+    const uint8_t *line = frame + y * line_bytes;
+    const uint32_t zone_row = (y * zy_count / height) * zx_count;
+
+    for (uint8_t zx = 0; zx < zx_count; zx++) {
+      // Bornes de zone calculées une fois par ligne : pas de division dans la boucle pixel
+      uint32_t x_start = (static_cast<uint32_t>(width) * zx) / zx_count;
+      uint32_t x_end = (static_cast<uint32_t>(width) * (zx + 1)) / zx_count;
+      uint32_t first = ((x_start + stride - 1) / stride) * stride;
+      const uint32_t zone = zone_row + zx;
+
+      switch (format) {
+        case PixelFormat::PIXEL_FORMAT_RAW8: {
+          const uint8_t *next = line + line_bytes;
+          for (uint32_t x = first; x + 1 < x_end; x += stride) {
+            const uint8_t q[2][2] = {{line[x], line[x + 1]}, {next[x], next[x + 1]}};
+            uint8_t r = q[red_y][red_x];
+            uint8_t b = q[1 - red_y][1 - red_x];
+            uint8_t g = (q[red_y][1 - red_x] + q[1 - red_y][red_x]) >> 1;
+            this->accumulate_(zone, r, g, b, out);
+          }
+          break;
+        }
+        case PixelFormat::PIXEL_FORMAT_YUV422: {
+          // YUYV : une paire de pixels partage U/V, lue d'un seul mot 32 bits
+          for (uint32_t x = first & ~1u; x + 1 < x_end; x += std::max<uint32_t>(stride, 2)) {
+            uint32_t word;
+            std::memcpy(&word, line + x * 2, sizeof(word));
+            int32_t y0 = word & 0xFF;
+            int32_t u = static_cast<int32_t>((word >> 8) & 0xFF) - 128;
+            int32_t v = static_cast<int32_t>(word >> 24) - 128;
+            uint8_t r = stats_clamp(y0 + ((359 * v) >> 8));
+            uint8_t g = stats_clamp(y0 - ((88 * u + 183 * v) >> 8));
+            uint8_t b = stats_clamp(y0 + ((454 * u) >> 8));
+            this->accumulate_(zone, r, g, b, out);
+          }
+          break;
+        }
+        case PixelFormat::PIXEL_FORMAT_YUV420: {
+          // Groupes U/V Y Y de 3 octets ; U sur la ligne paire, V sur l'impaire de la même paire
+          const uint8_t *u_line = frame + (y & ~1u) * line_bytes;
+          const uint8_t *v_line = u_line + line_bytes;
+          for (uint32_t x = first & ~1u; x + 1 < x_end; x += std::max<uint32_t>(stride, 2)) {
+            const size_t group = (x / 2) * 3;
+            int32_t y0 = line[group + 1];
+            int32_t u = static_cast<int32_t>(u_line[group]) - 128;
+            int32_t v = static_cast<int32_t>(v_line[group]) - 128;
+            uint8_t r = stats_clamp(y0 + ((359 * v) >> 8));
+            uint8_t g = stats_clamp(y0 - ((88 * u + 183 * v) >> 8));
+            uint8_t b = stats_clamp(y0 + ((454 * u) >> 8));
+            this->accumulate_(zone, r, g, b, out);
+          }
+          break;
+        }
+        case PixelFormat::PIXEL_FORMAT_RGB565:
+        default: {
+          for (uint32_t x = first; x < x_end; x += stride) {
+            uint16_t p;
+            std::memcpy(&p, line + x * 2, sizeof(p));
+            uint8_t r5 = p >> 11;
+            uint8_t g6 = (p >> 5) & 0x3F;
+            uint8_t b5 = p & 0x1F;
+            this->accumulate_(zone, (r5 << 3) | (r5 >> 2), (g6 << 2) | (g6 >> 4), (b5 << 3) | (b5 >> 2), out);
+          }
+          break;
+        }
+      }
+    }
+  }
+
+  // Moyennes par zone et globales
+  uint64_t total_y = 0, total_r = 0, total_g = 0, total_b = 0;
+  uint32_t total = 0;
+  out.zones_x = zx_count;
+  out.zones_y = zy_count;
+  for (uint32_t i = 0; i < static_cast<uint32_t>(zx_count) * zy_count; i++) {
+    const ZoneAccumulator &acc = this->acc_[i];
+    StatsZone &zone = out.zones[i];
+    if (acc.count == 0) {
+      zone = StatsZone();
+      continue;
+    }
+    zone.luma = acc.luma / acc.count;
+    zone.r = acc.r / acc.count;
+    zone.g = acc.g / acc.count;
+    zone.b = acc.b / acc.count;
+    zone.clipped = std::min<uint32_t>(acc.clipped, UINT16_MAX);
+    total_y += acc.luma;
+    total_r += acc.r;
+    total_g += acc.g;
+    total_b += acc.b;
+    total += acc.count;
+  }
+
+  out.samples = total;
+  out.valid = total > 0;
+  if (total > 0) {
+    out.mean_luma = total_y / total;
+    out.mean_r = total_r / total;
+    out.mean_g = total_g / total;
+    out.mean_b = total_b / total;
+  }
+  return out.valid;
+}
+
+}  // namespace mipi_dsi_cam
+}  // namespace esphome
+
+#endif  // USE_ESP32_VARIANT_ESP32P4 || USE_HOST
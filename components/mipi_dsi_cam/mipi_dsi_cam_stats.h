@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(USE_ESP32_VARIANT_ESP32P4) || defined(USE_HOST)
+
+namespace esphome {
+namespace mipi_dsi_cam {
+
+enum class PixelFormat;
+
+static constexpr uint8_t STATS_MAX_ZONES_X = 16;
+static constexpr uint8_t STATS_MAX_ZONES_Y = 16;
+static constexpr uint8_t STATS_HISTOGRAM_BINS = 64;
+// Seuils de saturation (luma 8 bits)
+static constexpr uint8_t STATS_CLIP_HIGH = 250;
+static constexpr uint8_t STATS_CLIP_LOW = 5;
+
+struct StatsZone {
+  uint8_t luma{0};
+  uint8_t r{0};
+  uint8_t g{0};
+  uint8_t b{0};
+  uint16_t clipped{0};  // Échantillons saturés (haut) dans la zone
+};
+
+/**
+ * @brief Statistiques d'une frame, calculées en une seule passe
+ *
+ * Partagées par l'AE, l'AWB et tout autre consommateur : personne ne
+ * relit la frame pour ses propres mesures.
+ */
+struct FrameStats {
+  uint32_t sequence{0};
+  bool valid{false};
+
+  uint8_t zones_x{0};
+  uint8_t zones_y{0};
+  StatsZone zones[STATS_MAX_ZONES_X * STATS_MAX_ZONES_Y];
+
+  uint32_t histogram[STATS_HISTOGRAM_BINS]{};  // Luma / 4
+  uint32_t samples{0};
+  uint32_t clipped_high{0};
+  uint32_t clipped_low{0};
+
+  uint8_t mean_luma{0};
+  uint8_t mean_r{0};
+  uint8_t mean_g{0};
+  uint8_t mean_b{0};
+
+  // Mesure AWB matérielle : moyennes R/G/B ci-dessus sur les white patches (0 = passe CPU, gray world par zone)
+  uint32_t white_patches{0};
+  bool wb_after_gains{false};  // Mesures (white patches ou zones) prises après les gains de balance des blancs
+
+  const StatsZone &zone(uint8_t x, uint8_t y) const { return this->zones[y * this->zones_x + x]; }
+  // Moyenne de luma pondérée centre (zones centrales x2)
+  uint8_t center_weighted_luma() const;
+  // Luma en dessous de laquelle se trouve `percentile` % des échantillons
+  uint8_t luma_percentile(float percentile) const;
+};
+
+/**
+ * @brief Moteur de statistiques : sous-échantillonnage par pas configurable
+ *
+ * Les lignes sautées ne sont jamais lues (lignes de cache PSRAM évitées),
+ * les lignes retenues sont parcourues séquentiellement : RGB565 par mots
+ * de 16 bits, YUYV par paires de pixels sur 32 bits, RAW8 par quads 2x2.
+ */
+class FrameStatsEngine {
+ public:
+  void configure(uint8_t zones_x, uint8_t zones_y, uint8_t stride);
+  uint8_t get_zones_x() const { return this->zones_x_; }
+  uint8_t get_zones_y() const { return this->zones_y_; }
+  uint8_t get_stride() const { return this->stride_; }
+
+  bool compute(const uint8_t *frame, size_t size, uint16_t width, uint16_t height,
+               PixelFormat format, uint8_t bayer_pattern, FrameStats &out);
+
+ protected:
+  struct ZoneAccumulator {
+    uint32_t luma;
+    uint32_t r;
+    uint32_t g;
+    uint32_t b;
+    uint32_t count;
+    uint32_t clipped;
+  };
+
+  void accumulate_(uint32_t zone, uint8_t r, uint8_t g, uint8_t b, FrameStats &out);
+
+  uint8_t zones_x_{STATS_MAX_ZONES_X};
+  uint8_t zones_y_{STATS_MAX_ZONES_Y};
+  uint8_t stride_{8};
+  ZoneAccumulator acc_[STATS_MAX_ZONES_X * STATS_MAX_ZONES_Y];
+};
+
+}  // namespace mipi_dsi_cam
+}  // namespace esphome
+
+#endif  // USE_ESP32_VARIANT_ESP32P4 || USE_HOST
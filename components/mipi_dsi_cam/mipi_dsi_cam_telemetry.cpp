@@ -0,0 +1,94 @@
+#include "mipi_dsi_cam_telemetry.h"
+
+#if defined(USE_ESP32_VARIANT_ESP32P4) || defined(USE_HOST)
+
+namespace esphome {
+namespace mipi_dsi_cam {
+
+uint8_t LatencyHistogram::bucket_for(uint32_t latency_us) {
+  uint32_t scaled = latency_us >> LATENCY_FIRST_BUCKET_SHIFT;
+  if (scaled == 0) {
+    return 0;
+  }
+  uint8_t bucket = 32 - __builtin_clz(scaled);
+  return bucket < LATENCY_BUCKET_COUNT ? bucket : LATENCY_BUCKET_COUNT - 1;
+}
+
+void LatencyHistogram::record(int64_t latency_us) {
+  uint32_t us = latency_us <= 0 ? 0 : (latency_us > UINT32_MAX ? UINT32_MAX : (uint32_t) latency_us);
+
+  this->counts_[bucket_for(us)].fetch_add(1, std::memory_order_relaxed);
+  this->count_.fetch_add(1, std::memory_order_relaxed);
+  this->sum_us_.fetch_add(us, std::memory_order_relaxed);
+
+  uint32_t max = this->max_us_.load(std::memory_order_relaxed);
+  while (us > max && !this->max_us_.compare_exchange_weak(max, us, std::memory_order_relaxed)) {
+  }
+}
+
+void LatencyHistogram::reset() {
+  for (auto &count : this->counts_) {
+    count.store(0, std::memory_order_relaxed);
+  }
+  this->count_.store(0, std::memory_order_relaxed);
+  this->sum_us_.store(0, std::memory_order_relaxed);
+  this->max_us_.store(0, std::memory_order_relaxed);
+}
+
+LatencySnapshot LatencyHistogram::snapshot() const {
+  LatencySnapshot snap;
+  for (uint8_t i = 0; i < LATENCY_BUCKET_COUNT; i++) {
+    snap.counts[i] = this->counts_[i].load(std::memory_order_relaxed);
+  }
+  snap.count = this->count_.load(std::memory_order_relaxed);
+  snap.sum_us = this->sum_us_.load(std::memory_order_relaxed);
+  snap.max_us = this->max_us_.load(std::memory_order_relaxed);
+  return snap;
+}
+
+LatencySnapshot LatencySnapshot::since(const LatencySnapshot &previous) const {
+  LatencySnapshot delta;
+  for (uint8_t i = 0; i < LATENCY_BUCKET_COUNT; i++) {
+    delta.counts[i] = this->counts[i] - previous.counts[i];
+  }
+  delta.count = this->count - previous.count;
+  delta.sum_us = this->sum_us - previous.sum_us;
+  // Le max n'est pas fenêtrable : on garde le max cumulé
+  delta.max_us = this->max_us;
+  return delta;
+}
+
+float LatencySnapshot::mean_ms() const {
+  return this->count == 0 ? 0.0f : (float) this->sum_us / (float) this->count / 1000.0f;
+}
+
+uint32_t LatencySnapshot::bucket_upper_us(uint8_t bucket) {
+  return (1u << LATENCY_FIRST_BUCKET_SHIFT) << bucket;
+}
+
+float LatencySnapshot::percentile_ms(float percentile) const {
+  if (this->count == 0) {
+    return 0.0f;
+  }
+
+  uint32_t rank = (uint32_t) ((float) this->count * percentile / 100.0f + 0.5f);
+  if (rank == 0) {
+    rank = 1;
+  }
+
+  uint32_t seen = 0;
+  for (uint8_t i = 0; i < LATENCY_BUCKET_COUNT; i++) {
+    seen += this->counts[i];
+    if (seen >= rank) {
+      // Dernier bucket ouvert : le max observé est la meilleure borne
+      uint32_t upper = (i == LATENCY_BUCKET_COUNT - 1) ? this->max_us : bucket_upper_us(i);
+      return (float) upper / 1000.0f;
+    }
+  }
+  return (float) this->max_us / 1000.0f;
+}
+
+}  // namespace mipi_dsi_cam
+}  // namespace esphome
+
+#endif  // USE_ESP32_VARIANT_ESP32P4 || USE_HOST
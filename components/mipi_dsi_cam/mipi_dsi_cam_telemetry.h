@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(USE_ESP32_VARIANT_ESP32P4) || defined(USE_HOST)
+
+namespace esphome {
+namespace mipi_dsi_cam {
+
+// Buckets log2 : [0, 128µs), [128, 256µs), ... , [131ms, ∞)
+static constexpr uint8_t LATENCY_BUCKET_COUNT = 12;
+static constexpr uint8_t LATENCY_FIRST_BUCKET_SHIFT = 7;
+
+/**
+ * @brief Copie figée d'un histogramme, exploitable hors du chemin chaud
+ *
+ * La différence de deux snapshots donne l'histogramme d'une fenêtre
+ * (entre deux polls d'un sensor) sans jamais remettre à zéro la source.
+ */
+struct LatencySnapshot {
+  uint32_t counts[LATENCY_BUCKET_COUNT]{};
+  uint32_t count{0};
+  uint64_t sum_us{0};
+  uint32_t max_us{0};
+
+  LatencySnapshot since(const LatencySnapshot &previous) const;
+  float mean_ms() const;
+  // Borne haute du bucket contenant le percentile demandé (0-100)
+  float percentile_ms(float percentile) const;
+
+  static uint32_t bucket_upper_us(uint8_t bucket);
+};
+
+/**
+ * @brief Histogramme de latence à buckets fixes
+ *
+ * record() ne fait que des fetch_add relaxés : utilisable depuis plusieurs
+ * tâches sans verrou, coût constant quel que soit le nombre d'échantillons.
+ */
+class LatencyHistogram {
+ public:
+  void record(int64_t latency_us);
+  void reset();
+  LatencySnapshot snapshot() const;
+
+  static uint8_t bucket_for(uint32_t latency_us);
+
+ protected:
+  std::atomic<uint32_t> counts_[LATENCY_BUCKET_COUNT]{};
+  std::atomic<uint32_t> count_{0};
+  std::atomic<uint64_t> sum_us_{0};
+  std::atomic<uint32_t> max_us_{0};
+};
+
+}  // namespace mipi_dsi_cam
+}  // namespace esphome
+
+#endif  // USE_ESP32_VARIANT_ESP32P4 || USE_HOST
@@ -1,12 +1,15 @@
+#ifdef USE_ESP32_VARIANT_ESP32P4
+
 #include "mipi_dsi_cam_v4l2_adapter.h"
 #include "esp_video_init.h"
 #include "esp_video_buffer.h"
+#include "mipi_dsi_cam_isp_gamma.h"
 #include "esphome/core/log.h"
+#include "../lvgl_camera_display/esp_video_isp_ioctl.h"
 #include <cstring>
+#include <cmath>
 #include <algorithm>
 
-#ifdef USE_ESP32_VARIANT_ESP32P4
-
 namespace esphome {
 namespace mipi_dsi_cam {
 
@@ -26,22 +29,33 @@ const esp_video_ops MipiDsiCamV4L2Adapter::s_video_ops = {
     .qbuf = MipiDsiCamV4L2Adapter::v4l2_qbuf,
     .dqbuf = MipiDsiCamV4L2Adapter::v4l2_dqbuf,
     .querycap = MipiDsiCamV4L2Adapter::v4l2_querycap,
+    .poll = MipiDsiCamV4L2Adapter::v4l2_poll,
+    .expbuf = MipiDsiCamV4L2Adapter::v4l2_expbuf,
+    .queryctrl = MipiDsiCamV4L2Adapter::v4l2_queryctrl,
+    .g_ctrl = MipiDsiCamV4L2Adapter::v4l2_g_ctrl,
+    .s_ctrl = MipiDsiCamV4L2Adapter::v4l2_s_ctrl,
+    .g_ext_ctrls = MipiDsiCamV4L2Adapter::v4l2_g_ext_ctrls,
+    .s_ext_ctrls = MipiDsiCamV4L2Adapter::v4l2_s_ext_ctrls,
 };
 
 MipiDsiCamV4L2Adapter::MipiDsiCamV4L2Adapter(MipiDsiCam *camera) {
-    memset(&this->context_, 0, sizeof(this->context_));
     this->context_.camera = camera;
+    this->context_.consumer_id = INVALID_CONSUMER_ID;
     this->context_.width = camera->get_image_width();
     this->context_.height = camera->get_image_height();
-    this->context_.pixelformat = V4L2_PIX_FMT_RGB565;
+    this->context_.pixelformat = pixel_format_to_v4l2(camera->get_pixel_format(), camera->get_bayer_pattern());
     this->context_.streaming = false;
     this->context_.buffers = nullptr;
     this->context_.buffer_count = 0;
-    this->context_.queued_count = 0;
+    this->context_.queued_count.store(0, std::memory_order_relaxed);
     this->context_.frame_count = 0;
     this->context_.drop_count = 0;
     this->context_.last_frame_sequence = 0;
     this->context_.total_dqbuf_calls = 0;
+    this->context_.capture_source.ctx = &this->context_;
+    this->context_.capture_source.take = MipiDsiCamV4L2Adapter::capture_take_;
+    this->context_.capture_source.done = MipiDsiCamV4L2Adapter::capture_done_;
+    this->context_.capture_source.cancel = MipiDsiCamV4L2Adapter::capture_cancel_;
 }
 
 MipiDsiCamV4L2Adapter::~MipiDsiCamV4L2Adapter() {
@@ -58,6 +72,8 @@ esp_err_t MipiDsiCamV4L2Adapter::init() {
     
     ESP_LOGI(TAG, "🎬 Initializing V4L2 adapter...");
     
+    this->context_.consumer_id = this->context_.camera->register_consumer("v4l2");
+    
     esp_err_t ret = esp_video_register_device(
         0,
         &this->context_,
@@ -90,6 +106,9 @@ esp_err_t MipiDsiCamV4L2Adapter::deinit() {
         }
         
         if (this->context_.buffers) {
+            if (esp_video_revoke_buffers(&this->context_) != ESP_OK) {
+                ESP_LOGW(TAG, "⚠️  Freeing buffers still imported by another device");
+            }
             esp_video_buffer_destroy(this->context_.buffers);
             this->context_.buffers = nullptr;
         }
@@ -107,7 +126,7 @@ esp_err_t MipiDsiCamV4L2Adapter::v4l2_init(void *video) {
     ESP_LOGI(TAG, "V4L2 init callback");
     ESP_LOGI(TAG, "  Camera: %s", ctx->camera->get_name().c_str());
     ESP_LOGI(TAG, "  Resolution: %ux%u", ctx->width, ctx->height);
-    ESP_LOGI(TAG, "  Format: RGB565");
+    ESP_LOGI(TAG, "  Format: %s", pixel_format_to_string(ctx->camera->get_pixel_format()));
     return ESP_OK;
 }
 
@@ -137,9 +156,13 @@ esp_err_t MipiDsiCamV4L2Adapter::v4l2_start(void *video, uint32_t type) {
         return ESP_FAIL;
     }
     
+    // Les buffers déjà en file reçoivent les frames dès le démarrage du DMA
+    cam->set_capture_buffer_source(&ctx->capture_source);
+    
     if (!cam->is_streaming()) {
         if (!cam->start_streaming()) {
             ESP_LOGE(TAG, "❌ Failed to start camera streaming");
+            cam->set_capture_buffer_source(nullptr);
             return ESP_FAIL;
         }
     }
@@ -173,13 +196,12 @@ esp_err_t MipiDsiCamV4L2Adapter::v4l2_stop(void *video, uint32_t type) {
     if (cam->is_streaming()) {
         cam->stop_streaming();
     }
+    // DMA arrêté : l'anneau ne publie plus les buffers V4L2
+    cam->set_capture_buffer_source(nullptr);
     
     ctx->streaming = false;
     
-    if (ctx->buffers) {
-        esp_video_buffer_reset(ctx->buffers);
-        ctx->queued_count = 0;
-    }
+    reset_queues_(ctx);
     
     ctx->last_frame_sequence = 0;
     
@@ -195,16 +217,16 @@ esp_err_t MipiDsiCamV4L2Adapter::v4l2_enum_format(void *video, uint32_t type,
         return ESP_ERR_NOT_SUPPORTED;
     }
     
-    static const uint32_t formats[] = {
-        V4L2_PIX_FMT_RGB565,
-        V4L2_PIX_FMT_SBGGR8,
-    };
-    
-    if (index >= sizeof(formats) / sizeof(formats[0])) {
+    // Formats produits sans conversion logicielle : sortie ISP configurée, puis Bayer brut (ISP contourné)
+    MipiCameraV4L2Context *ctx = (MipiCameraV4L2Context*)video;
+    const PixelFormat processed = ctx->camera->get_processed_format();
+    if (index == 0) {
+        *pixel_format = pixel_format_to_v4l2(processed, ctx->camera->get_bayer_pattern());
+    } else if (index == 1 && processed != PixelFormat::PIXEL_FORMAT_RAW8) {
+        *pixel_format = pixel_format_to_v4l2(PixelFormat::PIXEL_FORMAT_RAW8, ctx->camera->get_bayer_pattern());
+    } else {
         return ESP_ERR_NOT_FOUND;
     }
-    
-    *pixel_format = formats[index];
     ESP_LOGD(TAG, "V4L2 enum_format[%u] = 0x%08X", index, *pixel_format);
     
     return ESP_OK;
@@ -233,12 +255,33 @@ esp_err_t MipiDsiCamV4L2Adapter::v4l2_set_format(void *video, const void *format
         return ESP_ERR_INVALID_ARG;
     }
     
-    if (pix->pixelformat != V4L2_PIX_FMT_RGB565 &&
-        pix->pixelformat != V4L2_PIX_FMT_SBGGR8) {
-        ESP_LOGE(TAG, "❌ Unsupported pixel format: 0x%08X", pix->pixelformat);
+    const PixelFormat processed = ctx->camera->get_processed_format();
+    const uint8_t bayer = ctx->camera->get_bayer_pattern();
+    PixelFormat requested;
+    if (pix->pixelformat == pixel_format_to_v4l2(processed, bayer)) {
+        requested = processed;
+    } else if (pix->pixelformat == pixel_format_to_v4l2(PixelFormat::PIXEL_FORMAT_RAW8, bayer)) {
+        requested = PixelFormat::PIXEL_FORMAT_RAW8;
+    } else {
+        ESP_LOGE(TAG, "❌ Unsupported pixel format: 0x%08X (camera outputs %s or RAW8)",
+                 pix->pixelformat, pixel_format_to_string(processed));
         return ESP_ERR_NOT_SUPPORTED;
     }
     
+    // Bascule traité <-> brut sans réinitialiser le capteur, y compris en cours de flux
+    // tant que les buffers déjà alloués peuvent contenir le nouveau format
+    if (requested != ctx->camera->get_pixel_format()) {
+        const size_t frame_size = pixel_format_frame_size(requested, pix->width, pix->height);
+        if (ctx->buffers && ctx->buffers->info.size < frame_size) {
+            ESP_LOGE(TAG, "❌ Buffers too small for %s (%u < %u bytes), REQBUFS again",
+                     pixel_format_to_string(requested), ctx->buffers->info.size, (unsigned) frame_size);
+            return ESP_ERR_INVALID_STATE;
+        }
+        if (!ctx->camera->set_capture_format(requested)) {
+            return ESP_FAIL;
+        }
+    }
+    
     ctx->width = pix->width;
     ctx->height = pix->height;
     ctx->pixelformat = pix->pixelformat;
@@ -261,8 +304,8 @@ esp_err_t MipiDsiCamV4L2Adapter::v4l2_get_format(void *video, void *format) {
     pix->height = ctx->height;
     pix->pixelformat = ctx->pixelformat;
     pix->field = V4L2_FIELD_NONE;
-    pix->bytesperline = ctx->width * 2;
-    pix->sizeimage = ctx->width * ctx->height * 2;
+    pix->bytesperline = ctx->camera->get_bytes_per_line();
+    pix->sizeimage = ctx->camera->get_image_size();
     pix->colorspace = V4L2_COLORSPACE_SRGB;
     
     ESP_LOGD(TAG, "V4L2 get_format: %ux%u, format=0x%08X", 
@@ -283,8 +326,8 @@ esp_err_t MipiDsiCamV4L2Adapter::v4l2_reqbufs(void *video, void *reqbufs) {
         return ESP_ERR_NOT_SUPPORTED;
     }
     
-    if (req->memory != V4L2_MEMORY_MMAP) {
-        ESP_LOGE(TAG, "❌ Only MMAP memory supported");
+    if (req->memory != V4L2_MEMORY_MMAP && req->memory != V4L2_MEMORY_USERPTR) {
+        ESP_LOGE(TAG, "❌ Only MMAP and USERPTR memory supported");
         return ESP_ERR_NOT_SUPPORTED;
     }
     
@@ -294,23 +337,29 @@ esp_err_t MipiDsiCamV4L2Adapter::v4l2_reqbufs(void *video, void *reqbufs) {
     }
     
     if (ctx->buffers) {
+        // Un encodeur qui lit encore un buffer exporté le verrait libéré sous lui
+        if (esp_video_revoke_buffers(ctx) != ESP_OK) {
+            ESP_LOGE(TAG, "❌ Buffers still imported by another device, dequeue them there first");
+            return ESP_ERR_INVALID_STATE;
+        }
         esp_video_buffer_destroy(ctx->buffers);
         ctx->buffers = nullptr;
         ctx->buffer_count = 0;
     }
     
     if (req->count > 0) {
-        if (req->count > 8) {
-            ESP_LOGW(TAG, "⚠️  Limiting buffer count from %u to 8", req->count);
-            req->count = 8;
+        if (req->count > V4L2_MAX_BUFFERS) {
+            ESP_LOGW(TAG, "⚠️  Limiting buffer count from %u to %u", req->count, V4L2_MAX_BUFFERS);
+            req->count = V4L2_MAX_BUFFERS;
         }
         
+        // USERPTR : rien n'est alloué, `size` devient la longueur minimale exigée au QBUF
         struct esp_video_buffer_info buffer_info = {
             .count = req->count,
-            .size = ctx->width * ctx->height * 2,
-            .align_size = 64,
+            .size = static_cast<uint32_t>(ctx->camera->get_image_size()),
+            .align_size = V4L2_USERPTR_ALIGN,
             .caps = MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT,
-            .memory_type = V4L2_MEMORY_MMAP
+            .memory_type = req->memory
         };
         
         ctx->buffers = esp_video_buffer_create(&buffer_info);
@@ -320,10 +369,14 @@ esp_err_t MipiDsiCamV4L2Adapter::v4l2_reqbufs(void *video, void *reqbufs) {
         }
         
         ctx->buffer_count = req->count;
-        ctx->queued_count = 0;
+        ctx->memory = req->memory;
+        for (auto &length : ctx->buffer_length) {
+            length = 0;
+        }
+        reset_queues_(ctx);
         
-        ESP_LOGI(TAG, "✅ Created %u buffers of %u bytes each", 
-                 req->count, buffer_info.size);
+        ESP_LOGI(TAG, "✅ Created %u %s buffers of %u bytes each", req->count,
+                 req->memory == V4L2_MEMORY_USERPTR ? "USERPTR" : "MMAP", buffer_info.size);
     } else {
         ESP_LOGI(TAG, "✅ Freed all buffers");
     }
@@ -341,21 +394,23 @@ esp_err_t MipiDsiCamV4L2Adapter::v4l2_querybuf(void *video, void *buffer) {
         return ESP_ERR_INVALID_ARG;
     }
     
-    struct esp_video_buffer_element *elem = &ctx->buffers->element[buf->index];
-    
     buf->type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    buf->memory = V4L2_MEMORY_MMAP;
-    buf->length = ctx->buffers->info.size;
-    buf->m.offset = buf->index;
+    fill_buffer_location_(ctx, buf->index, buf);
     
-    if (ELEMENT_IS_FREE(elem)) {
-        buf->flags = 0;
-    } else {
-        buf->flags = V4L2_BUF_FLAG_QUEUED;
+    switch (ctx->buffer_state[buf->index].load(std::memory_order_acquire)) {
+        case V4L2_BUFFER_DEQUEUED:
+            buf->flags = 0;
+            break;
+        case V4L2_BUFFER_DONE:
+            buf->flags = V4L2_BUF_FLAG_DONE;
+            break;
+        default:
+            buf->flags = V4L2_BUF_FLAG_QUEUED;
+            break;
     }
     
-    ESP_LOGD(TAG, "V4L2 querybuf[%u]: length=%u, offset=%u, flags=0x%x", 
-             buf->index, buf->length, buf->m.offset, buf->flags);
+    ESP_LOGD(TAG, "V4L2 querybuf[%u]: length=%u, flags=0x%x", 
+             buf->index, buf->length, buf->flags);
     
     return ESP_OK;
 }
@@ -369,25 +424,35 @@ esp_err_t MipiDsiCamV4L2Adapter::v4l2_qbuf(void *video, void *buffer) {
         return ESP_ERR_INVALID_ARG;
     }
     
-    struct esp_video_buffer_element *elem = &ctx->buffers->element[buf->index];
+    if (buf->memory != ctx->memory) {
+        ESP_LOGE(TAG, "❌ Buffer %u: memory %u does not match REQBUFS (%u)", buf->index, buf->memory, ctx->memory);
+        return ESP_ERR_INVALID_ARG;
+    }
     
-    if (!ELEMENT_IS_FREE(elem)) {
+    if (ctx->buffer_state[buf->index].load(std::memory_order_acquire) != V4L2_BUFFER_DEQUEUED) {
         ESP_LOGW(TAG, "⚠️  Buffer %u already queued", buf->index);
         return ESP_ERR_INVALID_STATE;
     }
     
-    ELEMENT_SET_FREE(elem);
-    ELEMENT_SET_ALLOCATED(elem);
-    elem->valid_size = 0;
-    ctx->queued_count++;
+    if (ctx->memory == V4L2_MEMORY_USERPTR) {
+        esp_err_t ret = attach_userptr_(ctx, buf);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+    }
+    
+    ctx->buffers->element[buf->index].valid_size = 0;
+    ctx->queued_count.fetch_add(1, std::memory_order_relaxed);
+    // État posé avant la mise en file : l'ISR CSI peut prendre le buffer dès le push
+    ctx->buffer_state[buf->index].store(V4L2_BUFFER_QUEUED, std::memory_order_relaxed);
+    ctx->queued.push(buf->index);
     
     ESP_LOGV(TAG, "V4L2 qbuf[%u] (queued: %u/%u)", 
-             buf->index, ctx->queued_count, ctx->buffer_count);
+             buf->index, ctx->queued_count.load(std::memory_order_relaxed), ctx->buffer_count);
     
     return ESP_OK;
 }
 
-// ✅ UNE SEULE DÉFINITION DE v4l2_dqbuf
 esp_err_t MipiDsiCamV4L2Adapter::v4l2_dqbuf(void *video, void *buffer) {
     MipiCameraV4L2Context *ctx = (MipiCameraV4L2Context*)video;
     struct v4l2_buffer *buf = (struct v4l2_buffer*)buffer;
@@ -399,90 +464,714 @@ esp_err_t MipiDsiCamV4L2Adapter::v4l2_dqbuf(void *video, void *buffer) {
         return ESP_ERR_INVALID_STATE;
     }
     
-    if (ctx->queued_count == 0) {
+    if (ctx->queued_count.load(std::memory_order_relaxed) == 0) {
         ESP_LOGV(TAG, "DQBUF: No buffers queued");
         return ESP_ERR_NOT_FOUND;
     }
     
-    if (!ctx->camera->acquire_frame(ctx->last_frame_sequence)) {
-        if (ctx->total_dqbuf_calls % 100 == 0) {
-            ESP_LOGD(TAG, "DQBUF: Waiting for new frame (last_seq=%u, cam_seq=%u, calls=%u)",
-                     ctx->last_frame_sequence,
-                     ctx->camera->get_frame_sequence(),
-                     ctx->total_dqbuf_calls);
+    // Buffer rempli le plus ancien (ordre de capture), rendu tel quel : le DMA y a écrit la frame
+    uint8_t index;
+    FrameMetadata meta;
+    for (;;) {
+        if (!ctx->done.pop(&index)) {
+            if (ctx->total_dqbuf_calls % 100 == 0) {
+                ESP_LOGD(TAG, "DQBUF: Waiting for new frame (last_seq=%u, cam_seq=%u, calls=%u)",
+                         ctx->last_frame_sequence,
+                         ctx->camera->get_frame_sequence(),
+                         ctx->total_dqbuf_calls);
+            }
+            return ESP_ERR_NOT_FOUND;
         }
-        return ESP_ERR_NOT_FOUND;
+        meta = ctx->buffer_meta[index];
+        if (meta.pixel_format == static_cast<uint8_t>(ctx->camera->get_pixel_format())) {
+            break;
+        }
+        // Frame capturée avant une bascule de format : pas livrable dans le format courant, le buffer repart en file
+        ctx->buffer_state[index].store(V4L2_BUFFER_QUEUED, std::memory_order_relaxed);
+        ctx->queued.push(index);
     }
     
-    uint8_t *camera_data = ctx->camera->get_image_data();
-    size_t camera_size = ctx->camera->get_image_size();
-    uint32_t current_sequence = ctx->camera->get_current_sequence();
+    struct esp_video_buffer_element *elem = &ctx->buffers->element[index];
+    const uint32_t bytesused = elem->valid_size;
+    ctx->camera->complete_external_frame(ctx->consumer_id, elem->buffer, bytesused, meta);
+    const uint32_t current_sequence = meta.sequence;
     
-    if (!camera_data) {
-        ctx->camera->release_frame();
-        ESP_LOGE(TAG, "❌ DQBUF: No camera data after acquire");
-        return ESP_ERR_INVALID_STATE;
+    buf->index = elem->index;
+    buf->type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buf->bytesused = bytesused;
+    buf->flags = V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC;
+    buf->field = V4L2_FIELD_NONE;
+    fill_buffer_location_(ctx, elem->index, buf);
+    buf->sequence = current_sequence;
+    
+    // Horodatage de capture (fin du DMA CSI), pas de l'instant du DQBUF
+    buf->timestamp.tv_sec = meta.capture_us / 1000000;
+    buf->timestamp.tv_usec = meta.capture_us % 1000000;
+    
+    ctx->buffer_state[index].store(V4L2_BUFFER_DEQUEUED, std::memory_order_relaxed);
+    // Décrément sans passage sous zéro (reset_queues_ peut l'avoir remis à 0)
+    uint32_t queued = ctx->queued_count.load(std::memory_order_relaxed);
+    while (queued > 0 && !ctx->queued_count.compare_exchange_weak(queued, queued - 1, std::memory_order_relaxed)) {
     }
     
-    if (current_sequence <= ctx->last_frame_sequence) {
-        ctx->camera->release_frame();
-        ESP_LOGE(TAG, "❌ DQBUF: Sequence inconsistency! current=%u, last=%u",
-                 current_sequence, ctx->last_frame_sequence);
-        ctx->drop_count++;
-        return ESP_ERR_INVALID_STATE;
+    ctx->last_frame_sequence = current_sequence;
+    ctx->frame_count++;
+    
+    if (ctx->frame_count % 30 == 0) {
+        ESP_LOGI(TAG, "✅ DQBUF[%u]: seq=%u, %u bytes (total: %u frames, %u drops, queued: %u/%u)",
+                 elem->index, current_sequence, bytesused,
+                 ctx->frame_count, ctx->drop_count,
+                 ctx->queued_count.load(std::memory_order_relaxed), ctx->buffer_count);
+    }
+    
+    return ESP_OK;
+}
+
+// ===== Mémoire des buffers (MMAP, USERPTR, export) =====
+
+esp_err_t MipiDsiCamV4L2Adapter::attach_userptr_(MipiCameraV4L2Context *ctx, const struct v4l2_buffer *buf) {
+    uint8_t *ptr = reinterpret_cast<uint8_t*>(buf->m.userptr);
+    if (ptr == nullptr || buf->m.userptr % V4L2_USERPTR_ALIGN != 0) {
+        ESP_LOGE(TAG, "❌ USERPTR %p must be %u-byte aligned", ptr, V4L2_USERPTR_ALIGN);
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (buf->length < ctx->buffers->info.size) {
+        ESP_LOGE(TAG, "❌ USERPTR buffer %u too small: %u < %u bytes",
+                 buf->index, buf->length, ctx->buffers->info.size);
+        return ESP_ERR_INVALID_ARG;
     }
     
-    struct esp_video_buffer_element *elem = nullptr;
+    // L'ISR retrouve l'index par l'adresse : un pointeur ne porte qu'un index à la fois
     for (uint32_t i = 0; i < ctx->buffer_count; i++) {
-        if (!ELEMENT_IS_FREE(&ctx->buffers->element[i])) {
-            elem = &ctx->buffers->element[i];
+        struct esp_video_buffer_element *other = &ctx->buffers->element[i];
+        if (i == buf->index || other->buffer != ptr) {
+            continue;
+        }
+        if (ctx->buffer_state[i].load(std::memory_order_acquire) != V4L2_BUFFER_DEQUEUED) {
+            ESP_LOGE(TAG, "❌ USERPTR %p already queued as buffer %u", ptr, i);
+            return ESP_ERR_INVALID_ARG;
+        }
+        other->buffer = nullptr;
+    }
+    
+    // Publié à l'ISR par le push dans `queued` qui suit
+    ctx->buffers->element[buf->index].buffer = ptr;
+    ctx->buffer_length[buf->index] = buf->length;
+    return ESP_OK;
+}
+
+void MipiDsiCamV4L2Adapter::fill_buffer_location_(MipiCameraV4L2Context *ctx, uint32_t index,
+                                                  struct v4l2_buffer *buf) {
+    buf->memory = ctx->memory;
+    if (ctx->memory == V4L2_MEMORY_USERPTR) {
+        buf->m.userptr = reinterpret_cast<unsigned long>(ctx->buffers->element[index].buffer);
+        buf->length = ctx->buffer_length[index];
+    } else {
+        buf->m.offset = index;
+        buf->length = ctx->buffers->info.size;
+    }
+}
+
+esp_err_t MipiDsiCamV4L2Adapter::v4l2_expbuf(void *video, void *exportbuffer) {
+    MipiCameraV4L2Context *ctx = (MipiCameraV4L2Context*)video;
+    struct v4l2_exportbuffer *exp = (struct v4l2_exportbuffer*)exportbuffer;
+    
+    if (exp->type != V4L2_BUF_TYPE_VIDEO_CAPTURE) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    // Seuls les buffers alloués ici s'exportent : un buffer USERPTR a déjà un pointeur partageable
+    if (!ctx->buffers || ctx->memory != V4L2_MEMORY_MMAP || exp->index >= ctx->buffer_count) {
+        ESP_LOGE(TAG, "❌ EXPBUF: invalid buffer %u (MMAP buffers only)", exp->index);
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    const int handle = esp_video_export_buffer(ctx, ctx->buffers->element[exp->index].buffer,
+                                               ctx->buffers->info.size);
+    if (handle < 0) {
+        return ESP_ERR_NO_MEM;
+    }
+    exp->fd = handle;
+    
+    ESP_LOGD(TAG, "V4L2 expbuf[%u] -> handle %d", exp->index, handle);
+    return ESP_OK;
+}
+
+// ===== Contrôles (QUERYCTRL, G/S_CTRL, G/S/TRY_EXT_CTRLS) =====
+
+// Contrôle exposé : bornes des contrôles entiers, taille de structure des contrôles ISP composés
+struct V4L2ControlDesc {
+    uint32_t id;
+    uint32_t type;
+    const char *name;
+    int32_t minimum;
+    int32_t maximum;  // Gain : remplacé par la taille de la table du capteur
+    int32_t default_value;
+    uint32_t payload_size;  // 0 = valeur entière (v4l2_ext_control::value)
+    bool needs_isp;         // Indisponible sans pipeline ISP
+};
+
+static const V4L2ControlDesc V4L2_CONTROLS[] = {
+    {V4L2_CID_BRIGHTNESS, V4L2_CTRL_TYPE_INTEGER, "Brightness", -128, 127, 0, 0, true},
+    {V4L2_CID_CONTRAST, V4L2_CTRL_TYPE_INTEGER, "Contrast", 0, 255, 128, 0, true},
+    {V4L2_CID_SATURATION, V4L2_CTRL_TYPE_INTEGER, "Saturation", 0, 255, 128, 0, true},
+    {V4L2_CID_HUE, V4L2_CTRL_TYPE_INTEGER, "Hue", 0, 360, 0, 0, true},
+    {V4L2_CID_AUTO_WHITE_BALANCE, V4L2_CTRL_TYPE_BOOLEAN, "White Balance, Automatic", 0, 1, 0, 0, false},
+    {V4L2_CID_RED_BALANCE, V4L2_CTRL_TYPE_INTEGER, "Red Balance", 1, 3999, V4L2_CID_RED_BALANCE_DEN, 0, false},
+    {V4L2_CID_BLUE_BALANCE, V4L2_CTRL_TYPE_INTEGER, "Blue Balance", 1, 3999, V4L2_CID_BLUE_BALANCE_DEN, 0, false},
+    // Gamma x100, 0 = courbe sRGB
+    {V4L2_CID_GAMMA, V4L2_CTRL_TYPE_INTEGER, "Gamma", 0, 500, 220, 0, true},
+    // Exposition en unités registre du capteur (1/16 de ligne), bornée comme l'AE. Pas de
+    // V4L2_CID_EXPOSURE_ABSOLUTE (100 µs) : le temps de ligne n'est pas connu du pilote
+    {V4L2_CID_EXPOSURE, V4L2_CTRL_TYPE_INTEGER, "Exposure", AE_EXPOSURE_MIN, AE_EXPOSURE_MAX, 0x9C0, 0, false},
+    {V4L2_CID_GAIN, V4L2_CTRL_TYPE_INTEGER, "Gain", 0, 0, 0, 0, false},
+    {V4L2_CID_USER_ESP_ISP_CCM, V4L2_CTRL_TYPE_U8, "Color Correction Matrix", 0, 255, 0,
+     sizeof(esp_video_isp_ccm_t), true},
+    {V4L2_CID_USER_ESP_ISP_GAMMA, V4L2_CTRL_TYPE_U8, "Gamma Curve", 0, 255, 0, sizeof(esp_video_isp_gamma_t), true},
+    {V4L2_CID_USER_ESP_ISP_BF, V4L2_CTRL_TYPE_U8, "Bayer Filter", 0, 255, 0, sizeof(esp_video_isp_bf_t), true},
+    {V4L2_CID_USER_ESP_ISP_SHARPEN, V4L2_CTRL_TYPE_U8, "Sharpen", 0, 255, 0, sizeof(esp_video_isp_sharpen_t), true},
+    {V4L2_CID_USER_ESP_ISP_DEMOSAIC, V4L2_CTRL_TYPE_U8, "Demosaic", 0, 255, 0, sizeof(esp_video_isp_demosaic_t),
+     true},
+    {V4L2_CID_USER_ESP_ISP_WB, V4L2_CTRL_TYPE_U8, "White Balance Gains", 0, 255, 0, sizeof(esp_video_isp_wb_t), false},
+    {V4L2_CID_EXPOSURE_AUTO, V4L2_CTRL_TYPE_MENU, "Auto Exposure", V4L2_EXPOSURE_AUTO, V4L2_EXPOSURE_MANUAL,
+     V4L2_EXPOSURE_AUTO, 0, false},
+};
+
+static bool control_available(MipiCameraV4L2Context *ctx, const V4L2ControlDesc &desc) {
+    return !desc.needs_isp || ctx->camera->get_isp_pipeline() != nullptr;
+}
+
+static const V4L2ControlDesc *find_control(MipiCameraV4L2Context *ctx, uint32_t id) {
+    for (const auto &desc : V4L2_CONTROLS) {
+        if (desc.id == id) {
+            return control_available(ctx, desc) ? &desc : nullptr;
+        }
+    }
+    return nullptr;
+}
+
+static int32_t control_maximum(MipiCameraV4L2Context *ctx, const V4L2ControlDesc &desc) {
+    if (desc.id == V4L2_CID_GAIN) {
+        return ctx->camera->get_sensor_gain_count() - 1;
+    }
+    return desc.maximum;
+}
+
+// Courbe libre ramenée à y = x^(1/gamma) par moindres carrés en log : le pipeline programme ses courbes depuis un gamma
+static bool fit_gamma_curve(const esp_video_isp_gamma_t &curve, float *gamma) {
+    double sxx = 0.0;
+    double sxy = 0.0;
+    for (int i = 0; i < ISP_GAMMA_CURVE_POINTS_NUM; i++) {
+        const esp_video_isp_gamma_point_t &point = curve.points[i];
+        if (i > 0 && point.x <= curve.points[i - 1].x) {
+            return false;
+        }
+        if (point.x == 0 || point.x == 255 || point.y == 0 || point.y == 255) {
+            continue;
+        }
+        const double lx = std::log(point.x / 255.0);
+        sxx += lx * lx;
+        sxy += lx * std::log(point.y / 255.0);
+    }
+    if (sxx <= 0.0 || sxy <= 0.0) {
+        return false;
+    }
+    *gamma = static_cast<float>(sxx / sxy);
+    return *gamma >= 0.1f && *gamma <= 5.0f;
+}
+
+static bool matrix_in_range(const uint8_t matrix[3][3], uint8_t maximum) {
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            if (matrix[i][j] > maximum) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+esp_err_t MipiDsiCamV4L2Adapter::read_control_(MipiCameraV4L2Context *ctx, const ControlBatch &values,
+                                               bool defaults, struct v4l2_ext_control *ctrl) {
+    const V4L2ControlDesc *desc = find_control(ctx, ctrl->id);
+    if (desc == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    if (desc->payload_size == 0) {
+        if (defaults) {
+            ctrl->value = desc->default_value;
+            return ESP_OK;
+        }
+        const IspColorParams &color = values.isp.color;
+        switch (ctrl->id) {
+            case V4L2_CID_BRIGHTNESS: ctrl->value = color.brightness; break;
+            case V4L2_CID_CONTRAST: ctrl->value = color.contrast; break;
+            case V4L2_CID_SATURATION: ctrl->value = color.saturation; break;
+            case V4L2_CID_HUE: ctrl->value = color.hue; break;
+            case V4L2_CID_AUTO_WHITE_BALANCE: ctrl->value = values.awb_enabled ? 1 : 0; break;
+            case V4L2_CID_RED_BALANCE: ctrl->value = lroundf(values.wb_red * V4L2_CID_RED_BALANCE_DEN); break;
+            case V4L2_CID_BLUE_BALANCE: ctrl->value = lroundf(values.wb_blue * V4L2_CID_BLUE_BALANCE_DEN); break;
+            case V4L2_CID_GAMMA:
+                ctrl->value = values.isp.gamma.gamma <= 0.0f ? 0 : lroundf(values.isp.gamma.gamma * 100.0f);
+                break;
+            case V4L2_CID_EXPOSURE: ctrl->value = values.exposure; break;
+            case V4L2_CID_GAIN: ctrl->value = values.gain_index; break;
+            case V4L2_CID_EXPOSURE_AUTO:
+                ctrl->value = values.ae_enabled ? V4L2_EXPOSURE_AUTO : V4L2_EXPOSURE_MANUAL;
+                break;
+            default: return ESP_ERR_INVALID_ARG;
+        }
+        return ESP_OK;
+    }
+    
+    // Contrôle composé : structure d'esp_video_isp_ioctl.h recopiée dans le buffer de l'application
+    if (ctrl->size < desc->payload_size) {
+        ctrl->size = desc->payload_size;
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (ctrl->ptr == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    ctrl->size = desc->payload_size;
+    memset(ctrl->ptr, 0, desc->payload_size);
+    
+    const ControlBatch reference{};
+    const IspParams &isp = defaults ? reference.isp : values.isp;
+    switch (ctrl->id) {
+        case V4L2_CID_USER_ESP_ISP_CCM: {
+            esp_video_isp_ccm_t *ccm = (esp_video_isp_ccm_t*)ctrl->ptr;
+            ccm->enable = isp.ccm.enabled;
+            memcpy(ccm->matrix, isp.ccm.matrix, sizeof(ccm->matrix));
             break;
         }
+        case V4L2_CID_USER_ESP_ISP_GAMMA: {
+            esp_video_isp_gamma_t *gamma = (esp_video_isp_gamma_t*)ctrl->ptr;
+            const IspGammaCurve curve = isp_gamma_make_curve(isp_gamma_key(isp.gamma.gamma));
+            gamma->enable = isp.gamma.enabled;
+            for (int i = 0; i < ISP_GAMMA_CURVE_POINTS_NUM; i++) {
+                gamma->points[i].x = curve.x[i];
+                gamma->points[i].y = curve.y[i];
+            }
+            break;
+        }
+        case V4L2_CID_USER_ESP_ISP_BF: {
+            esp_video_isp_bf_t *bf = (esp_video_isp_bf_t*)ctrl->ptr;
+            bf->enable = isp.bf.enabled;
+            bf->level = isp.bf.denoising_level;
+            memcpy(bf->matrix, isp.bf.kernel, sizeof(bf->matrix));
+            break;
+        }
+        case V4L2_CID_USER_ESP_ISP_SHARPEN: {
+            esp_video_isp_sharpen_t *sharpen = (esp_video_isp_sharpen_t*)ctrl->ptr;
+            sharpen->enable = isp.sharpen.enabled;
+            sharpen->h_thresh = isp.sharpen.h_thresh;
+            sharpen->l_thresh = isp.sharpen.l_thresh;
+            sharpen->h_coeff = isp.sharpen.h_coeff;
+            sharpen->m_coeff = isp.sharpen.m_coeff;
+            memcpy(sharpen->matrix, isp.sharpen.kernel, sizeof(sharpen->matrix));
+            break;
+        }
+        case V4L2_CID_USER_ESP_ISP_DEMOSAIC: {
+            esp_video_isp_demosaic_t *demosaic = (esp_video_isp_demosaic_t*)ctrl->ptr;
+            demosaic->enable = isp.demosaic.enabled;
+            demosaic->gradient_ratio = isp.demosaic.gradient_ratio;
+            break;
+        }
+        case V4L2_CID_USER_ESP_ISP_WB: {
+            esp_video_isp_wb_t *wb = (esp_video_isp_wb_t*)ctrl->ptr;
+            const ControlBatch &gains = defaults ? reference : values;
+            wb->enable = gains.wb_red != 1.0f || gains.wb_blue != 1.0f;
+            wb->red_gain = gains.wb_red;
+            wb->blue_gain = gains.wb_blue;
+            break;
+        }
+        default:
+            return ESP_ERR_INVALID_ARG;
+    }
+    return ESP_OK;
+}
+
+esp_err_t MipiDsiCamV4L2Adapter::stage_control_(MipiCameraV4L2Context *ctx, const struct v4l2_ext_control *ctrl,
+                                                ControlBatch &batch) {
+    const V4L2ControlDesc *desc = find_control(ctx, ctrl->id);
+    if (desc == nullptr) {
+        return ESP_ERR_INVALID_ARG;
     }
     
-    if (!elem) {
-        ctx->camera->release_frame();
-        ctx->drop_count++;
-        ESP_LOGW(TAG, "⚠️  No queued buffer available (dropped frames: %u)", ctx->drop_count);
-        return ESP_ERR_NOT_FOUND;
+    if (desc->payload_size == 0) {
+        int32_t value = ctrl->value;
+        if (desc->id == V4L2_CID_EXPOSURE || desc->id == V4L2_CID_GAIN) {
+            // Plage du capteur : ramenée dans les bornes comme un contrôle entier V4L2, jamais écrite au-delà
+            value = std::min(std::max(value, desc->minimum), control_maximum(ctx, *desc));
+        } else if (value < desc->minimum || value > control_maximum(ctx, *desc)) {
+            ESP_LOGW(TAG, "⚠️ Control %s: %d out of range [%d, %d]", desc->name, value, desc->minimum,
+                     control_maximum(ctx, *desc));
+            return ESP_ERR_INVALID_ARG;
+        }
+        IspColorParams &color = batch.isp.color;
+        switch (ctrl->id) {
+            case V4L2_CID_BRIGHTNESS: color.brightness = value; batch.fields |= ControlBatch::FIELD_COLOR; break;
+            case V4L2_CID_CONTRAST: color.contrast = value; batch.fields |= ControlBatch::FIELD_COLOR; break;
+            case V4L2_CID_SATURATION: color.saturation = value; batch.fields |= ControlBatch::FIELD_COLOR; break;
+            case V4L2_CID_HUE: color.hue = value; batch.fields |= ControlBatch::FIELD_COLOR; break;
+            case V4L2_CID_AUTO_WHITE_BALANCE:
+                batch.awb_enabled = value != 0;
+                batch.fields |= ControlBatch::FIELD_AWB;
+                break;
+            case V4L2_CID_RED_BALANCE:
+                batch.wb_red = (float)value / V4L2_CID_RED_BALANCE_DEN;
+                batch.fields |= ControlBatch::FIELD_WB_GAINS;
+                break;
+            case V4L2_CID_BLUE_BALANCE:
+                batch.wb_blue = (float)value / V4L2_CID_BLUE_BALANCE_DEN;
+                batch.fields |= ControlBatch::FIELD_WB_GAINS;
+                break;
+            case V4L2_CID_GAMMA:
+                batch.isp.gamma.gamma = value == 0 ? ISP_GAMMA_SRGB : std::max(value, 10) / 100.0f;
+                batch.fields |= ControlBatch::FIELD_GAMMA;
+                break;
+            case V4L2_CID_EXPOSURE:
+                batch.exposure = value;
+                batch.fields |= ControlBatch::FIELD_EXPOSURE;
+                break;
+            case V4L2_CID_GAIN:
+                batch.gain_index = value;
+                batch.fields |= ControlBatch::FIELD_GAIN;
+                break;
+            case V4L2_CID_EXPOSURE_AUTO:
+                batch.ae_enabled = value == V4L2_EXPOSURE_AUTO;
+                batch.fields |= ControlBatch::FIELD_AE;
+                break;
+            default:
+                return ESP_ERR_INVALID_ARG;
+        }
+        return ESP_OK;
     }
     
-    size_t copy_size = std::min(camera_size, static_cast<size_t>(ctx->buffers->info.size));
-    memcpy(elem->buffer, camera_data, copy_size);
-    elem->valid_size = copy_size;
+    if (ctrl->size != desc->payload_size || ctrl->ptr == nullptr) {
+        ESP_LOGW(TAG, "⚠️ Control %s: payload of %u bytes, expected %u", desc->name, ctrl->size,
+                 desc->payload_size);
+        return ESP_ERR_INVALID_ARG;
+    }
     
-    ctx->camera->release_frame();
+    switch (ctrl->id) {
+        case V4L2_CID_USER_ESP_ISP_CCM: {
+            const esp_video_isp_ccm_t *ccm = (const esp_video_isp_ccm_t*)ctrl->ptr;
+            for (int i = 0; i < 3; i++) {
+                for (int j = 0; j < 3; j++) {
+                    // Plage matérielle (-4, 4) ; NaN refusé par la même comparaison
+                    if (!(std::fabs(ccm->matrix[i][j]) < 4.0f)) {
+                        return ESP_ERR_INVALID_ARG;
+                    }
+                }
+            }
+            batch.isp.ccm.enabled = ccm->enable;
+            memcpy(batch.isp.ccm.matrix, ccm->matrix, sizeof(batch.isp.ccm.matrix));
+            batch.fields |= ControlBatch::FIELD_CCM;
+            break;
+        }
+        case V4L2_CID_USER_ESP_ISP_GAMMA: {
+            const esp_video_isp_gamma_t *gamma = (const esp_video_isp_gamma_t*)ctrl->ptr;
+            float value = batch.isp.gamma.gamma;
+            if (gamma->enable && !fit_gamma_curve(*gamma, &value)) {
+                return ESP_ERR_INVALID_ARG;
+            }
+            batch.isp.gamma.enabled = gamma->enable;
+            batch.isp.gamma.gamma = value;
+            batch.fields |= ControlBatch::FIELD_GAMMA;
+            break;
+        }
+        case V4L2_CID_USER_ESP_ISP_BF: {
+            const esp_video_isp_bf_t *bf = (const esp_video_isp_bf_t*)ctrl->ptr;
+            if (bf->level > 20 || !matrix_in_range(bf->matrix, 15)) {
+                return ESP_ERR_INVALID_ARG;
+            }
+            batch.isp.bf.enabled = bf->enable;
+            batch.isp.bf.denoising_level = bf->level;
+            memcpy(batch.isp.bf.kernel, bf->matrix, sizeof(batch.isp.bf.kernel));
+            batch.fields |= ControlBatch::FIELD_BF;
+            break;
+        }
+        case V4L2_CID_USER_ESP_ISP_SHARPEN: {
+            const esp_video_isp_sharpen_t *sharpen = (const esp_video_isp_sharpen_t*)ctrl->ptr;
+            // Coefficients en 1/32, au plus 255/32
+            const float max_coeff = 255.0f / 32.0f;
+            if (sharpen->l_thresh > sharpen->h_thresh || !matrix_in_range(sharpen->matrix, 31) ||
+                !(sharpen->h_coeff >= 0.0f && sharpen->h_coeff <= max_coeff) ||
+                !(sharpen->m_coeff >= 0.0f && sharpen->m_coeff <= max_coeff)) {
+                return ESP_ERR_INVALID_ARG;
+            }
+            IspSharpenParams &params = batch.isp.sharpen;
+            params.enabled = sharpen->enable;
+            params.h_thresh = sharpen->h_thresh;
+            params.l_thresh = sharpen->l_thresh;
+            params.h_coeff = sharpen->h_coeff;
+            params.m_coeff = sharpen->m_coeff;
+            memcpy(params.kernel, sharpen->matrix, sizeof(params.kernel));
+            batch.fields |= ControlBatch::FIELD_SHARPEN;
+            break;
+        }
+        case V4L2_CID_USER_ESP_ISP_DEMOSAIC: {
+            const esp_video_isp_demosaic_t *demosaic = (const esp_video_isp_demosaic_t*)ctrl->ptr;
+            if (!(demosaic->gradient_ratio >= 0.0f && demosaic->gradient_ratio <= 1.0f)) {
+                return ESP_ERR_INVALID_ARG;
+            }
+            batch.isp.demosaic.enabled = demosaic->enable;
+            batch.isp.demosaic.gradient_ratio = demosaic->gradient_ratio;
+            batch.fields |= ControlBatch::FIELD_DEMOSAIC;
+            break;
+        }
+        case V4L2_CID_USER_ESP_ISP_WB: {
+            const esp_video_isp_wb_t *wb = (const esp_video_isp_wb_t*)ctrl->ptr;
+            if (wb->enable && !(wb->red_gain > 0.0f && wb->red_gain < 4.0f && wb->blue_gain > 0.0f &&
+                                wb->blue_gain < 4.0f)) {
+                return ESP_ERR_INVALID_ARG;
+            }
+            // Désactivée : gains neutres
+            batch.wb_red = wb->enable ? wb->red_gain : 1.0f;
+            batch.wb_blue = wb->enable ? wb->blue_gain : 1.0f;
+            batch.fields |= ControlBatch::FIELD_WB_GAINS;
+            break;
+        }
+        default:
+            return ESP_ERR_INVALID_ARG;
+    }
+    return ESP_OK;
+}
+
+esp_err_t MipiDsiCamV4L2Adapter::v4l2_queryctrl(void *video, void *queryctrl) {
+    MipiCameraV4L2Context *ctx = (MipiCameraV4L2Context*)video;
+    struct v4l2_queryctrl *query = (struct v4l2_queryctrl*)queryctrl;
+    
+    // Énumération : plus petit identifiant supérieur, composés seulement avec NEXT_COMPOUND
+    const uint32_t next = query->id & (V4L2_CTRL_FLAG_NEXT_CTRL | V4L2_CTRL_FLAG_NEXT_COMPOUND);
+    const uint32_t id = query->id & ~next;
+    const V4L2ControlDesc *desc = nullptr;
+    if (next == 0) {
+        desc = find_control(ctx, id);
+    } else {
+        for (const auto &candidate : V4L2_CONTROLS) {
+            const bool compound = candidate.payload_size != 0;
+            const bool wanted = compound ? (next & V4L2_CTRL_FLAG_NEXT_COMPOUND) : (next & V4L2_CTRL_FLAG_NEXT_CTRL);
+            if (wanted && candidate.id > id && (desc == nullptr || candidate.id < desc->id) &&
+                control_available(ctx, candidate)) {
+                desc = &candidate;
+            }
+        }
+    }
+    if (desc == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
     
-    buf->index = elem->index;
-    buf->type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    buf->bytesused = copy_size;
-    buf->flags = 0;
-    buf->field = V4L2_FIELD_NONE;
-    buf->memory = V4L2_MEMORY_MMAP;
-    buf->m.offset = elem->index;
-    buf->length = ctx->buffers->info.size;
-    buf->sequence = current_sequence;
+    memset(query, 0, sizeof(*query));
+    query->id = desc->id;
+    query->type = desc->type;
+    strncpy((char*)query->name, desc->name, sizeof(query->name) - 1);
+    query->minimum = desc->minimum;
+    query->maximum = control_maximum(ctx, *desc);
+    query->step = 1;
+    query->default_value = desc->default_value;
+    
+    // Exposition/gain suivent l'AE, gains rouge/bleu l'AWB : relus à chaque G_CTRL, inactifs en automatique
+    const ControlBatch values = ctx->camera->get_controls();
+    if (desc->payload_size != 0) {
+        query->flags = V4L2_CTRL_FLAG_HAS_PAYLOAD;
+    } else if (desc->id == V4L2_CID_EXPOSURE || desc->id == V4L2_CID_GAIN) {
+        query->flags = V4L2_CTRL_FLAG_VOLATILE | (values.ae_enabled ? V4L2_CTRL_FLAG_INACTIVE : 0);
+    } else if (desc->id == V4L2_CID_RED_BALANCE || desc->id == V4L2_CID_BLUE_BALANCE) {
+        query->flags = V4L2_CTRL_FLAG_VOLATILE | (values.awb_enabled ? V4L2_CTRL_FLAG_INACTIVE : 0);
+    }
+    return ESP_OK;
+}
+
+esp_err_t MipiDsiCamV4L2Adapter::v4l2_g_ctrl(void *video, void *control) {
+    MipiCameraV4L2Context *ctx = (MipiCameraV4L2Context*)video;
+    struct v4l2_control *c = (struct v4l2_control*)control;
+    
+    // Les contrôles composés ne passent que par G_EXT_CTRLS
+    struct v4l2_ext_control ctrl = {};
+    ctrl.id = c->id;
+    const V4L2ControlDesc *desc = find_control(ctx, c->id);
+    if (desc == nullptr || desc->payload_size != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    const esp_err_t ret = read_control_(ctx, ctx->camera->get_controls(), false, &ctrl);
+    if (ret == ESP_OK) {
+        c->value = ctrl.value;
+    }
+    return ret;
+}
+
+esp_err_t MipiDsiCamV4L2Adapter::v4l2_s_ctrl(void *video, void *control) {
+    struct v4l2_control *c = (struct v4l2_control*)control;
+    
+    // Lot d'un seul contrôle : même validation et même frontière de frame que S_EXT_CTRLS
+    struct v4l2_ext_control ctrl = {};
+    ctrl.id = c->id;
+    ctrl.value = c->value;
+    struct v4l2_ext_controls ext = {};
+    ext.which = V4L2_CTRL_WHICH_CUR_VAL;
+    ext.count = 1;
+    ext.controls = &ctrl;
+    return v4l2_s_ext_ctrls(video, &ext, false);
+}
+
+esp_err_t MipiDsiCamV4L2Adapter::v4l2_g_ext_ctrls(void *video, void *ext_controls) {
+    MipiCameraV4L2Context *ctx = (MipiCameraV4L2Context*)video;
+    struct v4l2_ext_controls *ext = (struct v4l2_ext_controls*)ext_controls;
     
-    gettimeofday(&buf->timestamp, nullptr);
+    if (ext->which == V4L2_CTRL_WHICH_REQUEST_VAL || (ext->count > 0 && ext->controls == nullptr)) {
+        ext->error_idx = ext->count;
+        return ESP_ERR_INVALID_ARG;
+    }
     
-    ELEMENT_SET_FREE(elem);
-    if (ctx->queued_count > 0) {
-        ctx->queued_count--;
+    const bool defaults = ext->which == V4L2_CTRL_WHICH_DEF_VAL;
+    const ControlBatch values = ctx->camera->get_controls();
+    for (uint32_t i = 0; i < ext->count; i++) {
+        struct v4l2_ext_control *ctrl = &ext->controls[i];
+        if (!defaults && ext->which != V4L2_CTRL_WHICH_CUR_VAL && V4L2_CTRL_ID2WHICH(ctrl->id) != ext->which) {
+            ext->error_idx = i;
+            return ESP_ERR_INVALID_ARG;
+        }
+        const esp_err_t ret = read_control_(ctx, values, defaults, ctrl);
+        if (ret != ESP_OK) {
+            ext->error_idx = i;
+            return ret;
+        }
     }
+    return ESP_OK;
+}
+
+esp_err_t MipiDsiCamV4L2Adapter::v4l2_s_ext_ctrls(void *video, void *ext_controls, bool try_only) {
+    MipiCameraV4L2Context *ctx = (MipiCameraV4L2Context*)video;
+    struct v4l2_ext_controls *ext = (struct v4l2_ext_controls*)ext_controls;
     
-    ctx->last_frame_sequence = current_sequence;
-    ctx->frame_count++;
+    if (ext->which == V4L2_CTRL_WHICH_DEF_VAL || ext->which == V4L2_CTRL_WHICH_REQUEST_VAL ||
+        (ext->count > 0 && ext->controls == nullptr)) {
+        ext->error_idx = ext->count;
+        return ESP_ERR_INVALID_ARG;
+    }
     
-    if (ctx->frame_count % 30 == 0) {
-        ESP_LOGI(TAG, "✅ DQBUF[%u]: seq=%u, %u bytes (total: %u frames, %u drops, queued: %u/%u)",
-                 elem->index, current_sequence, copy_size,
-                 ctx->frame_count, ctx->drop_count,
-                 ctx->queued_count, ctx->buffer_count);
+    // Tout le lot est validé avant d'appliquer quoi que ce soit ; les contrôles absents gardent leur valeur
+    ControlBatch batch = ctx->camera->get_controls();
+    batch.fields = 0;
+    for (uint32_t i = 0; i < ext->count; i++) {
+        const struct v4l2_ext_control *ctrl = &ext->controls[i];
+        esp_err_t ret = ESP_ERR_INVALID_ARG;
+        if (ext->which == V4L2_CTRL_WHICH_CUR_VAL || V4L2_CTRL_ID2WHICH(ctrl->id) == ext->which) {
+            ret = stage_control_(ctx, ctrl, batch);
+        }
+        if (ret != ESP_OK) {
+            // Comme sous Linux : TRY désigne le contrôle fautif, S signale count (rien n'a été appliqué)
+            ext->error_idx = try_only ? i : ext->count;
+            ESP_LOGW(TAG, "⚠️ %s_EXT_CTRLS: control 0x%08x rejected (index %u)", try_only ? "TRY" : "S",
+                     ctrl->id, i);
+            return ret;
+        }
+    }
+    if (try_only) {
+        return ESP_OK;
     }
     
+    ctx->camera->submit_controls(batch);
+    ESP_LOGD(TAG, "V4L2 controls: %u queued for the next frame (fields=0x%03X)", ext->count, batch.fields);
     return ESP_OK;
 }
 
+// ===== Files d'index (ISR CSI <-> application) =====
+
+bool IRAM_ATTR V4L2IndexQueue::push(uint8_t buffer_index) {
+    const uint32_t h = this->head.load(std::memory_order_relaxed);
+    if (h - this->tail.load(std::memory_order_acquire) >= V4L2_MAX_BUFFERS) {
+        return false;
+    }
+    this->index[h % V4L2_MAX_BUFFERS] = buffer_index;
+    this->head.store(h + 1, std::memory_order_release);
+    return true;
+}
+
+bool IRAM_ATTR V4L2IndexQueue::pop(uint8_t *buffer_index) {
+    const uint32_t t = this->tail.load(std::memory_order_relaxed);
+    if (t == this->head.load(std::memory_order_acquire)) {
+        return false;
+    }
+    *buffer_index = this->index[t % V4L2_MAX_BUFFERS];
+    this->tail.store(t + 1, std::memory_order_release);
+    return true;
+}
+
+void MipiDsiCamV4L2Adapter::reset_queues_(MipiCameraV4L2Context *ctx) {
+    ctx->queued.reset();
+    ctx->done.reset();
+    ctx->retry_mask.store(0, std::memory_order_relaxed);
+    ctx->queued_count.store(0, std::memory_order_relaxed);
+    for (auto &state : ctx->buffer_state) {
+        state.store(V4L2_BUFFER_DEQUEUED, std::memory_order_relaxed);
+    }
+}
+
+// ===== Source de buffers de capture (ISR CSI) =====
+
+uint8_t *IRAM_ATTR MipiDsiCamV4L2Adapter::capture_take_(void *video, size_t size) {
+    MipiCameraV4L2Context *ctx = (MipiCameraV4L2Context*)video;
+    if (ctx->buffers == nullptr || ctx->buffers->info.size < size) {
+        return nullptr;
+    }
+    
+    // Buffer rendu par un DMA avorté : il était en tête de file, il repasse en premier
+    uint8_t index;
+    const uint32_t retry = ctx->retry_mask.load(std::memory_order_acquire);
+    if (retry != 0) {
+        index = __builtin_ctz(retry);
+        ctx->retry_mask.fetch_and(~(1u << index), std::memory_order_relaxed);
+    } else if (!ctx->queued.pop(&index)) {
+        // Aucun buffer en file : la frame ne va que dans l'anneau interne, perdue pour V4L2
+        if (ctx->streaming) {
+            ctx->drop_count++;
+        }
+        return nullptr;
+    }
+    
+    ctx->buffer_state[index].store(V4L2_BUFFER_ACTIVE, std::memory_order_relaxed);
+    return ctx->buffers->element[index].buffer;
+}
+
+bool IRAM_ATTR MipiDsiCamV4L2Adapter::capture_done_(void *video, uint8_t *buffer, size_t size,
+                                                     const FrameMetadata &meta) {
+    MipiCameraV4L2Context *ctx = (MipiCameraV4L2Context*)video;
+    struct esp_video_buffer_element *elem = esp_video_buffer_get_element_by_buffer(ctx->buffers, buffer);
+    if (elem == nullptr) {
+        return false;
+    }
+    ctx->buffer_meta[elem->index] = meta;
+    elem->valid_size = size;
+    ctx->buffer_state[elem->index].store(V4L2_BUFFER_DONE, std::memory_order_relaxed);
+    ctx->done.push(elem->index);
+    
+    // DQBUF bloquant et select() : réveillés dès la fin du DMA
+    return esp_video_notify_ready_from_isr(video);
+}
+
+void IRAM_ATTR MipiDsiCamV4L2Adapter::capture_cancel_(void *video, uint8_t *buffer) {
+    MipiCameraV4L2Context *ctx = (MipiCameraV4L2Context*)video;
+    struct esp_video_buffer_element *elem = esp_video_buffer_get_element_by_buffer(ctx->buffers, buffer);
+    if (elem == nullptr) {
+        return;
+    }
+    ctx->buffer_state[elem->index].store(V4L2_BUFFER_QUEUED, std::memory_order_relaxed);
+    ctx->retry_mask.fetch_or(1u << elem->index, std::memory_order_release);
+}
+
+esp_err_t MipiDsiCamV4L2Adapter::v4l2_poll(void *video) {
+    MipiCameraV4L2Context *ctx = (MipiCameraV4L2Context*)video;
+    
+    // Hors flux, DQBUF échoue immédiatement : rien à attendre
+    if (!ctx->buffers || !ctx->streaming) {
+        return ESP_OK;
+    }
+    return ctx->done.empty() ? ESP_ERR_NOT_FOUND : ESP_OK;
+}
+
 esp_err_t MipiDsiCamV4L2Adapter::v4l2_querycap(void *video, void *cap) {
     MipiCameraV4L2Context *ctx = (MipiCameraV4L2Context*)video;
     struct v4l2_capability *capability = (struct v4l2_capability*)cap;
@@ -21,6 +21,42 @@ extern "C" esp_err_t esp_video_register_device(int device_id,
 namespace esphome {
 namespace mipi_dsi_cam {
 
+// Buffers V4L2 maximum par REQBUFS
+static constexpr uint32_t V4L2_MAX_BUFFERS = 8;
+// Alignement exigé des buffers USERPTR (cible directe du DMA CSI, comme les buffers MMAP)
+static constexpr uint32_t V4L2_USERPTR_ALIGN = 64;
+
+// Possession d'un buffer V4L2 : application, puis file -> DMA -> rempli côté driver
+enum V4L2BufferState : uint8_t {
+  V4L2_BUFFER_DEQUEUED = 0,  // Chez l'application
+  V4L2_BUFFER_QUEUED,        // Dans la file `queued`, prêt pour le DMA
+  V4L2_BUFFER_ACTIVE,        // Cible du DMA CSI en cours
+  V4L2_BUFFER_DONE,          // Dans la file `done`, en attente de DQBUF
+};
+
+/**
+ * File FIFO d'index de buffers, sans verrou : un seul producteur, un seul consommateur
+ *
+ * Chaque buffer y figure au plus une fois : V4L2_MAX_BUFFERS places suffisent,
+ * push() ne peut échouer que sur un index déjà en file (erreur de logique).
+ */
+struct V4L2IndexQueue {
+  uint8_t index[V4L2_MAX_BUFFERS]{};
+  std::atomic<uint32_t> head{0};  // Écrit par le producteur
+  std::atomic<uint32_t> tail{0};  // Écrit par le consommateur
+
+  bool push(uint8_t buffer_index);
+  bool pop(uint8_t *buffer_index);
+  bool empty() const {
+    return this->head.load(std::memory_order_acquire) == this->tail.load(std::memory_order_acquire);
+  }
+  // Producteur et consommateur arrêtés (hors flux)
+  void reset() {
+    this->head.store(0, std::memory_order_relaxed);
+    this->tail.store(0, std::memory_order_relaxed);
+  }
+};
+
 /**
  * Contexte V4L2 associé à la caméra MIPI.
  * On ne redéfinit PAS les structures des buffers : on pointe vers celles d'esp_video_buffer.h
@@ -28,6 +64,9 @@ namespace mipi_dsi_cam {
 struct MipiCameraV4L2Context {
   // Pointeur vers la caméra (driver propriétaire)
   MipiDsiCam *camera{nullptr};
+  
+  // Identifiant de consommateur (curseur de séquence propre au device V4L2)
+  uint8_t consumer_id{INVALID_CONSUMER_ID};
 
   // Pointeur opaque vers la structure "device" exposée à esp_video
   void *video_device{nullptr};
@@ -46,7 +85,21 @@ struct MipiCameraV4L2Context {
   //   element[i].size   (size_t)  // le nom peut varier selon ta version, adapter dans mman.cpp si besoin
   esp_video_buffer *buffers{nullptr};
   uint32_t buffer_count{0};
-  uint32_t queued_count{0};
+  std::atomic<uint32_t> queued_count{0};
+  // V4L2_MEMORY_MMAP : buffers alloués ici ; V4L2_MEMORY_USERPTR : element[i].buffer posé à chaque QBUF
+  uint32_t memory{V4L2_MEMORY_MMAP};
+  uint32_t buffer_length[V4L2_MAX_BUFFERS]{};  // Longueur déclarée par l'application (USERPTR)
+
+  // Zéro copie : les buffers en file sont les cibles du DMA CSI.
+  // queued : QBUF -> ISR CSI ; done : ISR CSI -> DQBUF. Files SPSC : côté application,
+  // QBUF/DQBUF sont sérialisés par le verrou du device (video_ioctl, esp_video_init.cpp).
+  std::atomic<uint8_t> buffer_state[V4L2_MAX_BUFFERS]{};
+  FrameMetadata buffer_meta[V4L2_MAX_BUFFERS];
+  V4L2IndexQueue queued;
+  V4L2IndexQueue done;
+  // Buffers pris puis rendus par l'ISR (DMA avorté) : repris avant la file, ils en étaient la tête
+  std::atomic<uint32_t> retry_mask{0};
+  CaptureBufferSource capture_source;
 
   // Anti-duplicata / stats
   uint32_t last_frame_sequence{0};
@@ -72,12 +125,41 @@ struct esp_video_ops {
   esp_err_t (*qbuf)(void *video, void *buffer);
   esp_err_t (*dqbuf)(void *video, void *buffer);
   esp_err_t (*querycap)(void *video, void *cap);
+  esp_err_t (*poll)(void *video);
+  esp_err_t (*expbuf)(void *video, void *exportbuffer);
+  esp_err_t (*queryctrl)(void *video, void *queryctrl);
+  esp_err_t (*g_ctrl)(void *video, void *control);
+  esp_err_t (*s_ctrl)(void *video, void *control);
+  esp_err_t (*g_ext_ctrls)(void *video, void *ext_controls);
+  esp_err_t (*s_ext_ctrls)(void *video, void *ext_controls, bool try_only);
 };
 
+// FourCC V4L2 du format de sortie de la caméra ; RAW8 selon l'ordre Bayer (BGGR, GBRG, GRBG, RGGB)
+inline uint32_t pixel_format_to_v4l2(PixelFormat format, uint8_t bayer_pattern) {
+  static const uint32_t BAYER8[4] = {
+    V4L2_PIX_FMT_SBGGR8, V4L2_PIX_FMT_SGBRG8, V4L2_PIX_FMT_SGRBG8, V4L2_PIX_FMT_SRGGB8,
+  };
+  switch (format) {
+    case PixelFormat::PIXEL_FORMAT_YUV422:
+      return V4L2_PIX_FMT_YUYV;
+    case PixelFormat::PIXEL_FORMAT_YUV420:
+      return V4L2_PIX_FMT_YUV420;
+    case PixelFormat::PIXEL_FORMAT_RAW8:
+      return BAYER8[bayer_pattern & 3];
+    case PixelFormat::PIXEL_FORMAT_RGB565:
+    default:
+      return V4L2_PIX_FMT_RGB565;
+  }
+}
+
 /**
  * Adaptateur V4L2 complet pour MipiDsiCam
  * - N’enregistre pas de nouveaux types de buffers : s’appuie sur esp_video_buffer.h
+ * - Zéro copie : le CSI écrit dans les buffers mis en file, DQBUF les rend tels quels
+ * - MMAP (exportables via VIDIOC_EXPBUF vers les devices M2M) ou USERPTR
  * - Compatible avec un mmap() qui traite buf.m.offset comme un index (démo M5Stack)
+ * - Contrôles exposition/gain/WB/ISP : un lot S_EXT_CTRLS est validé en entier,
+ *   puis appliqué par la caméra à une seule frontière de frame
  */
 class MipiDsiCamV4L2Adapter {
  public:
@@ -106,8 +188,31 @@ class MipiDsiCamV4L2Adapter {
   static esp_err_t v4l2_qbuf(void *video, void *buffer);
   static esp_err_t v4l2_dqbuf(void *video, void *buffer);
   static esp_err_t v4l2_querycap(void *video, void *cap);
+  static esp_err_t v4l2_poll(void *video);
+  static esp_err_t v4l2_expbuf(void *video, void *exportbuffer);
+  static esp_err_t v4l2_queryctrl(void *video, void *queryctrl);
+  static esp_err_t v4l2_g_ctrl(void *video, void *control);
+  static esp_err_t v4l2_s_ctrl(void *video, void *control);
+  static esp_err_t v4l2_g_ext_ctrls(void *video, void *ext_controls);
+  static esp_err_t v4l2_s_ext_ctrls(void *video, void *ext_controls, bool try_only);
 
  protected:
+  // CaptureBufferSource, appelées depuis l'ISR CSI
+  static uint8_t *capture_take_(void *video, size_t size);
+  static bool capture_done_(void *video, uint8_t *buffer, size_t size, const FrameMetadata &meta);
+  static void capture_cancel_(void *video, uint8_t *buffer);
+  // Hors flux : tous les buffers reviennent à l'application, files vidées
+  static void reset_queues_(MipiCameraV4L2Context *ctx);
+  // QBUF USERPTR : vérifie et lie le buffer de l'application à son index
+  static esp_err_t attach_userptr_(MipiCameraV4L2Context *ctx, const struct v4l2_buffer *buf);
+  // Emplacement du buffer tel que le voit l'application (offset MMAP ou pointeur USERPTR)
+  static void fill_buffer_location_(MipiCameraV4L2Context *ctx, uint32_t index, struct v4l2_buffer *buf);
+  // Contrôles : lecture depuis un lot de valeurs, validation puis écriture dans le lot à soumettre
+  static esp_err_t read_control_(MipiCameraV4L2Context *ctx, const ControlBatch &values, bool defaults,
+                                 struct v4l2_ext_control *ctrl);
+  static esp_err_t stage_control_(MipiCameraV4L2Context *ctx, const struct v4l2_ext_control *ctrl,
+                                  ControlBatch &batch);
+
   MipiCameraV4L2Context context_{};
   bool initialized_{false};
 
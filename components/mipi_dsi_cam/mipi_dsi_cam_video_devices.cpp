@@ -1,14 +1,50 @@
+#ifdef USE_ESP32_VARIANT_ESP32P4
+
 #include "mipi_dsi_cam_video_devices.h"
 #include "esp_video_init.h"
 #include "esp_video_device.h"
 #include "videodev2.h"
 #include "esphome/core/log.h"
 #include <cstring>  // ✅ AJOUT : pour memset et strncpy
-
-#ifdef USE_ESP32_VARIANT_ESP32P4
+#include <algorithm>
 
 static const char *TAG = "video_devices";
 
+// ===== Files de buffers M2M (OUTPUT = image à coder, CAPTURE = flux codé) =====
+
+// Aucun buffer n'est alloué par ces devices : l'application les fournit (USERPTR)
+// ou importe un buffer exporté par /dev/video0 (DMABUF, handle de VIDIOC_EXPBUF)
+static constexpr uint32_t M2M_MAX_BUFFERS = 8;
+static constexpr uintptr_t M2M_BUFFER_ALIGN = 64;
+
+struct M2MBuffer {
+  uint8_t *data;
+  uint32_t length;
+  uint32_t bytesused;
+  int dmabuf_fd;  // Référence d'import tenue jusqu'au DQBUF ; -1 en USERPTR
+  uint32_t flags;
+  struct timeval timestamp;
+  uint32_t sequence;
+  bool queued;
+};
+
+struct M2MQueue {
+  uint32_t memory;
+  uint32_t count;
+  bool streaming;
+  M2MBuffer buffers[M2M_MAX_BUFFERS];
+  // Index en file, dans l'ordre du QBUF : à traiter, puis traités en attente de DQBUF
+  uint8_t pending[M2M_MAX_BUFFERS];
+  uint8_t pending_count;
+  uint8_t done[M2M_MAX_BUFFERS];
+  uint8_t done_count;
+};
+
+struct M2MDevice {
+  M2MQueue output;   // V4L2_BUF_TYPE_VIDEO_OUTPUT
+  M2MQueue capture;  // V4L2_BUF_TYPE_VIDEO_CAPTURE
+};
+
 // ===== Contextes des encodeurs =====
 struct JPEGDeviceContext {
   void *user_ctx;
@@ -16,6 +52,7 @@ struct JPEGDeviceContext {
   uint32_t width;
   uint32_t height;
   uint8_t quality;
+  M2MDevice m2m;
 };
 
 struct H264DeviceContext {
@@ -25,11 +62,221 @@ struct H264DeviceContext {
   uint32_t height;
   uint32_t bitrate;
   uint32_t gop_size;
+  M2MDevice m2m;
 };
 
 static JPEGDeviceContext s_jpeg_ctx = {0};
 static H264DeviceContext s_h264_ctx = {0};
 
+static M2MQueue *m2m_queue(M2MDevice *dev, uint32_t type) {
+  if (type == V4L2_BUF_TYPE_VIDEO_OUTPUT) {
+    return &dev->output;
+  }
+  if (type == V4L2_BUF_TYPE_VIDEO_CAPTURE) {
+    return &dev->capture;
+  }
+  return nullptr;
+}
+
+static uint8_t m2m_fifo_pop(uint8_t *fifo, uint8_t *count) {
+  const uint8_t index = fifo[0];
+  memmove(fifo, fifo + 1, --(*count));
+  return index;
+}
+
+static void m2m_release(M2MBuffer *b) {
+  if (b->dmabuf_fd >= 0) {
+    esp_video_release_buffer(b->dmabuf_fd);
+    b->dmabuf_fd = -1;
+  }
+  b->queued = false;
+}
+
+// Tous les buffers de la file reviennent à l'application (STREAMOFF, REQBUFS)
+static void m2m_flush(M2MQueue *q) {
+  for (uint32_t i = 0; i < q->count; i++) {
+    if (q->buffers[i].queued) {
+      m2m_release(&q->buffers[i]);
+    }
+  }
+  q->pending_count = 0;
+  q->done_count = 0;
+}
+
+// Un job = tête de OUTPUT + tête de CAPTURE, les deux files en flux.
+// Aucun moteur de codage n'est branché sur ces devices : le buffer CAPTURE revient vide.
+static void m2m_run(M2MDevice *dev) {
+  while (dev->output.streaming && dev->capture.streaming &&
+         dev->output.pending_count > 0 && dev->capture.pending_count > 0) {
+    const uint8_t in = m2m_fifo_pop(dev->output.pending, &dev->output.pending_count);
+    const uint8_t out = m2m_fifo_pop(dev->capture.pending, &dev->capture.pending_count);
+    const M2MBuffer *src = &dev->output.buffers[in];
+    M2MBuffer *dst = &dev->capture.buffers[out];
+    
+    dst->bytesused = 0;
+    dst->flags = src->flags & V4L2_BUF_FLAG_TIMESTAMP_COPY;
+    if (dst->flags) {
+      dst->timestamp = src->timestamp;
+      dst->sequence = src->sequence;
+    }
+    
+    dev->output.done[dev->output.done_count++] = in;
+    dev->capture.done[dev->capture.done_count++] = out;
+  }
+}
+
+static esp_err_t m2m_reqbufs(M2MDevice *dev, struct v4l2_requestbuffers *req) {
+  M2MQueue *q = m2m_queue(dev, req->type);
+  if (!q) {
+    return ESP_ERR_NOT_SUPPORTED;
+  }
+  if (req->memory != V4L2_MEMORY_USERPTR && req->memory != V4L2_MEMORY_DMABUF) {
+    ESP_LOGE(TAG, "❌ M2M buffers must be USERPTR or DMABUF (memory=%u)", req->memory);
+    return ESP_ERR_NOT_SUPPORTED;
+  }
+  if (q->streaming) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  
+  m2m_flush(q);
+  q->memory = req->memory;
+  q->count = std::min<uint32_t>(req->count, M2M_MAX_BUFFERS);
+  req->count = q->count;
+  for (auto &b : q->buffers) {
+    b = {};
+    b.dmabuf_fd = -1;
+  }
+  return ESP_OK;
+}
+
+static void m2m_fill(const M2MQueue *q, uint32_t index, struct v4l2_buffer *buf) {
+  const M2MBuffer *b = &q->buffers[index];
+  buf->memory = q->memory;
+  buf->length = b->length;
+  if (q->memory == V4L2_MEMORY_DMABUF) {
+    buf->m.fd = b->dmabuf_fd;
+  } else {
+    buf->m.userptr = reinterpret_cast<unsigned long>(b->data);
+  }
+}
+
+static esp_err_t m2m_querybuf(M2MDevice *dev, struct v4l2_buffer *buf) {
+  M2MQueue *q = m2m_queue(dev, buf->type);
+  if (!q || buf->index >= q->count) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  m2m_fill(q, buf->index, buf);
+  buf->bytesused = q->buffers[buf->index].bytesused;
+  buf->flags = q->buffers[buf->index].queued ? V4L2_BUF_FLAG_QUEUED : 0;
+  return ESP_OK;
+}
+
+// capture_min_size : taille minimale d'un buffer de flux codé (sizeimage)
+static esp_err_t m2m_qbuf(M2MDevice *dev, struct v4l2_buffer *buf, uint32_t capture_min_size) {
+  M2MQueue *q = m2m_queue(dev, buf->type);
+  if (!q) {
+    return ESP_ERR_NOT_SUPPORTED;
+  }
+  if (buf->index >= q->count || buf->memory != q->memory) {
+    ESP_LOGE(TAG, "❌ Invalid M2M buffer %u (memory=%u)", buf->index, buf->memory);
+    return ESP_ERR_INVALID_ARG;
+  }
+  M2MBuffer *b = &q->buffers[buf->index];
+  if (b->queued) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  
+  uint8_t *data;
+  uint32_t length;
+  int fd = -1;
+  if (q->memory == V4L2_MEMORY_DMABUF) {
+    // Buffer d'un autre device, sans copie : sa longueur est celle de l'export
+    if (esp_video_import_buffer(buf->m.fd, &data, &length) != ESP_OK) {
+      ESP_LOGE(TAG, "❌ Unknown or revoked DMABUF handle %d", buf->m.fd);
+      return ESP_ERR_INVALID_ARG;
+    }
+    fd = buf->m.fd;
+  } else {
+    data = reinterpret_cast<uint8_t*>(buf->m.userptr);
+    length = buf->length;
+  }
+  
+  const bool is_output = buf->type == V4L2_BUF_TYPE_VIDEO_OUTPUT;
+  const uint32_t required = is_output ? (buf->bytesused ? buf->bytesused : length) : capture_min_size;
+  if (data == nullptr || reinterpret_cast<uintptr_t>(data) % M2M_BUFFER_ALIGN != 0 || length < required) {
+    ESP_LOGE(TAG, "❌ M2M buffer %u rejected: %p, %u bytes (need %u-byte alignment, %u bytes)",
+             buf->index, data, length, (unsigned) M2M_BUFFER_ALIGN, required);
+    if (fd >= 0) {
+      esp_video_release_buffer(fd);
+    }
+    return ESP_ERR_INVALID_ARG;
+  }
+  
+  b->data = data;
+  b->length = length;
+  b->dmabuf_fd = fd;
+  b->bytesused = is_output ? required : 0;
+  b->flags = is_output ? (buf->flags & V4L2_BUF_FLAG_TIMESTAMP_COPY) : 0;
+  b->timestamp = buf->timestamp;
+  b->sequence = buf->sequence;
+  b->queued = true;
+  q->pending[q->pending_count++] = buf->index;
+  
+  m2m_run(dev);
+  return ESP_OK;
+}
+
+static esp_err_t m2m_dqbuf(M2MDevice *dev, struct v4l2_buffer *buf) {
+  M2MQueue *q = m2m_queue(dev, buf->type);
+  if (!q) {
+    return ESP_ERR_NOT_SUPPORTED;
+  }
+  if (!q->streaming) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  if (q->done_count == 0) {
+    return ESP_ERR_NOT_FOUND;
+  }
+  
+  const uint8_t index = m2m_fifo_pop(q->done, &q->done_count);
+  M2MBuffer *b = &q->buffers[index];
+  buf->index = index;
+  m2m_fill(q, index, buf);
+  buf->bytesused = b->bytesused;
+  buf->flags = b->flags;
+  buf->field = V4L2_FIELD_NONE;
+  buf->timestamp = b->timestamp;
+  buf->sequence = b->sequence;
+  
+  // L'exportateur peut de nouveau libérer ou réutiliser ce buffer
+  m2m_release(b);
+  return ESP_OK;
+}
+
+static esp_err_t m2m_start(M2MDevice *dev, uint32_t type) {
+  M2MQueue *q = m2m_queue(dev, type);
+  if (!q) {
+    return ESP_ERR_NOT_SUPPORTED;
+  }
+  q->streaming = true;
+  m2m_run(dev);
+  return ESP_OK;
+}
+
+static esp_err_t m2m_stop(M2MDevice *dev, uint32_t type) {
+  M2MQueue *q = m2m_queue(dev, type);
+  if (!q) {
+    return ESP_ERR_NOT_SUPPORTED;
+  }
+  q->streaming = false;
+  m2m_flush(q);
+  return ESP_OK;
+}
+
+static esp_err_t m2m_poll(M2MDevice *dev) {
+  return (dev->capture.done_count > 0 || dev->output.done_count > 0) ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
 // ===== Callbacks JPEG =====
 static esp_err_t jpeg_init(void *video) {
   ESP_LOGI(TAG, "JPEG encoder init");
@@ -43,16 +290,20 @@ static esp_err_t jpeg_deinit(void *video) {
 
 static esp_err_t jpeg_start(void *video, uint32_t type) {
   JPEGDeviceContext *ctx = (JPEGDeviceContext*)video;
-  ctx->streaming = true;
-  ESP_LOGI(TAG, "JPEG streaming started");
-  return ESP_OK;
+  esp_err_t ret = m2m_start(&ctx->m2m, type);
+  if (ret == ESP_OK) {
+    ctx->streaming = true;
+    ESP_LOGI(TAG, "JPEG streaming started (type=%u)", type);
+  }
+  return ret;
 }
 
 static esp_err_t jpeg_stop(void *video, uint32_t type) {
   JPEGDeviceContext *ctx = (JPEGDeviceContext*)video;
-  ctx->streaming = false;
-  ESP_LOGI(TAG, "JPEG streaming stopped");
-  return ESP_OK;
+  esp_err_t ret = m2m_stop(&ctx->m2m, type);
+  ctx->streaming = ctx->m2m.output.streaming || ctx->m2m.capture.streaming;
+  ESP_LOGI(TAG, "JPEG streaming stopped (type=%u)", type);
+  return ret;
 }
 
 static esp_err_t jpeg_set_format(void *video, const void *format) {
@@ -84,6 +335,27 @@ static esp_err_t jpeg_get_format(void *video, void *format) {
   return ESP_OK;
 }
 
+static esp_err_t jpeg_reqbufs(void *video, void *reqbufs) {
+  return m2m_reqbufs(&((JPEGDeviceContext*)video)->m2m, (struct v4l2_requestbuffers*)reqbufs);
+}
+
+static esp_err_t jpeg_querybuf(void *video, void *buffer) {
+  return m2m_querybuf(&((JPEGDeviceContext*)video)->m2m, (struct v4l2_buffer*)buffer);
+}
+
+static esp_err_t jpeg_qbuf(void *video, void *buffer) {
+  JPEGDeviceContext *ctx = (JPEGDeviceContext*)video;
+  return m2m_qbuf(&ctx->m2m, (struct v4l2_buffer*)buffer, ctx->width * ctx->height);
+}
+
+static esp_err_t jpeg_dqbuf(void *video, void *buffer) {
+  return m2m_dqbuf(&((JPEGDeviceContext*)video)->m2m, (struct v4l2_buffer*)buffer);
+}
+
+static esp_err_t jpeg_poll(void *video) {
+  return m2m_poll(&((JPEGDeviceContext*)video)->m2m);
+}
+
 static esp_err_t jpeg_querycap(void *video, void *cap) {
   struct v4l2_capability *capability = (struct v4l2_capability*)cap;
   
@@ -111,11 +383,13 @@ static const esp_video_ops jpeg_ops = {
   .enum_format = nullptr,
   .set_format = jpeg_set_format,
   .get_format = jpeg_get_format,
-  .reqbufs = nullptr,
-  .querybuf = nullptr,
-  .qbuf = nullptr,
-  .dqbuf = nullptr,
+  .reqbufs = jpeg_reqbufs,
+  .querybuf = jpeg_querybuf,
+  .qbuf = jpeg_qbuf,
+  .dqbuf = jpeg_dqbuf,
   .querycap = jpeg_querycap,
+  .poll = jpeg_poll,
+  .expbuf = nullptr,
 };
 
 // ===== Callbacks H.264 =====
@@ -131,16 +405,20 @@ static esp_err_t h264_deinit(void *video) {
 
 static esp_err_t h264_start(void *video, uint32_t type) {
   H264DeviceContext *ctx = (H264DeviceContext*)video;
-  ctx->streaming = true;
-  ESP_LOGI(TAG, "H.264 streaming started");
-  return ESP_OK;
+  esp_err_t ret = m2m_start(&ctx->m2m, type);
+  if (ret == ESP_OK) {
+    ctx->streaming = true;
+    ESP_LOGI(TAG, "H.264 streaming started (type=%u)", type);
+  }
+  return ret;
 }
 
 static esp_err_t h264_stop(void *video, uint32_t type) {
   H264DeviceContext *ctx = (H264DeviceContext*)video;
-  ctx->streaming = false;
-  ESP_LOGI(TAG, "H.264 streaming stopped");
-  return ESP_OK;
+  esp_err_t ret = m2m_stop(&ctx->m2m, type);
+  ctx->streaming = ctx->m2m.output.streaming || ctx->m2m.capture.streaming;
+  ESP_LOGI(TAG, "H.264 streaming stopped (type=%u)", type);
+  return ret;
 }
 
 static esp_err_t h264_set_format(void *video, const void *format) {
@@ -172,6 +450,27 @@ static esp_err_t h264_get_format(void *video, void *format) {
   return ESP_OK;
 }
 
+static esp_err_t h264_reqbufs(void *video, void *reqbufs) {
+  return m2m_reqbufs(&((H264DeviceContext*)video)->m2m, (struct v4l2_requestbuffers*)reqbufs);
+}
+
+static esp_err_t h264_querybuf(void *video, void *buffer) {
+  return m2m_querybuf(&((H264DeviceContext*)video)->m2m, (struct v4l2_buffer*)buffer);
+}
+
+static esp_err_t h264_qbuf(void *video, void *buffer) {
+  H264DeviceContext *ctx = (H264DeviceContext*)video;
+  return m2m_qbuf(&ctx->m2m, (struct v4l2_buffer*)buffer, ctx->width * ctx->height);
+}
+
+static esp_err_t h264_dqbuf(void *video, void *buffer) {
+  return m2m_dqbuf(&((H264DeviceContext*)video)->m2m, (struct v4l2_buffer*)buffer);
+}
+
+static esp_err_t h264_poll(void *video) {
+  return m2m_poll(&((H264DeviceContext*)video)->m2m);
+}
+
 static esp_err_t h264_querycap(void *video, void *cap) {
   struct v4l2_capability *capability = (struct v4l2_capability*)cap;
   
@@ -196,11 +495,13 @@ static const esp_video_ops h264_ops = {
   .enum_format = nullptr,
   .set_format = h264_set_format,
   .get_format = h264_get_format,
-  .reqbufs = nullptr,
-  .querybuf = nullptr,
-  .qbuf = nullptr,
-  .dqbuf = nullptr,
+  .reqbufs = h264_reqbufs,
+  .querybuf = h264_querybuf,
+  .qbuf = h264_qbuf,
+  .dqbuf = h264_dqbuf,
   .querycap = h264_querycap,
+  .poll = h264_poll,
+  .expbuf = nullptr,
 };
 
 // ===== API Publique =====
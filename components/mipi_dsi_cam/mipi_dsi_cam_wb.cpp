@@ -0,0 +1,272 @@
+#include "mipi_dsi_cam_wb.h"
+
+#if defined(USE_ESP32_VARIANT_ESP32P4) || defined(USE_HOST)
+
+#include <cstring>
+
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#define MIPI_DSI_CAM_WB_SSSE3
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define MIPI_DSI_CAM_WB_NEON
+#endif
+
+namespace esphome {
+namespace mipi_dsi_cam {
+
+// Même arithmétique que l'ancien copy_frame_rgb565 : 8 bits -> gain 8.8 arrondi -> saturation
+static inline uint8_t wb_apply_gain(uint16_t value, uint16_t gain) {
+  uint32_t scaled = (static_cast<uint32_t>(value) * gain + 128) >> 8;
+  return scaled > 255 ? 255 : static_cast<uint8_t>(scaled);
+}
+
+WhiteBalanceLut::WhiteBalanceLut() {
+  build_(this->tables_[0], 256, 256, 256);
+  build_(this->tables_[1], 256, 256, 256);
+  this->readers_[0].store(0, std::memory_order_relaxed);
+  this->readers_[1].store(0, std::memory_order_relaxed);
+}
+
+void WhiteBalanceLut::build_(Table &table, uint16_t red_gain, uint16_t green_gain, uint16_t blue_gain) {
+  table.red_gain = red_gain;
+  table.green_gain = green_gain;
+  table.blue_gain = blue_gain;
+
+  bool identity = true;
+  for (uint8_t v = 0; v < 32; v++) {
+    uint16_t v8 = (static_cast<uint16_t>(v) << 3) | (v >> 2);
+    table.r5[v] = wb_apply_gain(v8, red_gain) >> 3;
+    table.b5[v] = wb_apply_gain(v8, blue_gain) >> 3;
+    table.r_shifted[v] = static_cast<uint16_t>(table.r5[v]) << 11;
+    table.b_shifted[v] = table.b5[v];
+    identity &= (table.r5[v] == v) && (table.b5[v] == v);
+  }
+  for (uint8_t v = 0; v < 64; v++) {
+    uint16_t v8 = (static_cast<uint16_t>(v) << 2) | (v >> 4);
+    table.g6[v] = wb_apply_gain(v8, green_gain) >> 2;
+    table.g_shifted[v] = static_cast<uint16_t>(table.g6[v]) << 5;
+    identity &= (table.g6[v] == v);
+  }
+
+  table.identity = identity;
+}
+
+bool WhiteBalanceLut::update(uint16_t red_gain, uint16_t green_gain, uint16_t blue_gain) {
+  const Table &current = this->tables_[this->active_.load(std::memory_order_relaxed)];
+  if (red_gain == current.red_gain && green_gain == current.green_gain && blue_gain == current.blue_gain) {
+    // Retour aux gains publiés : la publication différée n'a plus lieu d'être
+    this->pending_ = false;
+    return false;
+  }
+
+  this->pending_red_gain_ = red_gain;
+  this->pending_green_gain_ = green_gain;
+  this->pending_blue_gain_ = blue_gain;
+  this->pending_ = true;
+  return this->publish_pending();
+}
+
+bool WhiteBalanceLut::publish_pending() {
+  if (!this->pending_) {
+    return false;
+  }
+
+  // Seul écrivain : la réserve est la table non publiée. Un lecteur qui l'a vue publiée avant
+  // l'échange précédent peut encore la tenir ; acquire() relit l'index après s'être compté,
+  // ce qui ferme la course avec ce test (ordre séquentiel sur readers_ et active_).
+  const uint8_t spare = this->active_.load(std::memory_order_relaxed) ^ 1;
+  if (this->readers_[spare].load() != 0) {
+    return false;
+  }
+
+  build_(this->tables_[spare], this->pending_red_gain_, this->pending_green_gain_, this->pending_blue_gain_);
+  this->active_.store(spare);
+  this->pending_ = false;
+  return true;
+}
+
+WhiteBalanceLut::Lease WhiteBalanceLut::acquire() const {
+  for (;;) {
+    const uint8_t index = this->active_.load();
+    this->readers_[index].fetch_add(1);
+    if (this->active_.load() == index) {
+      return Lease(this, index);
+    }
+    // Échange pendant la prise : la table vue n'est plus publiée et peut être réécrite
+    this->readers_[index].fetch_sub(1, std::memory_order_release);
+  }
+}
+
+static void wb_apply_words(const WhiteBalanceLut::Table &t, const uint8_t *src, uint8_t *dst, size_t pixels) {
+  // Pas de SIMD : 4 pixels par mot de 64 bits pour les accès PSRAM (une lecture et une écriture
+  // au lieu de 8 accès octet), les recherches de table restent pixel par pixel
+  size_t i = 0;
+  for (; i + 4 <= pixels; i += 4) {
+    uint64_t in;
+    std::memcpy(&in, src + i * 2, sizeof(in));
+
+    uint64_t out = 0;
+    for (uint8_t lane = 0; lane < 4; lane++) {
+      uint16_t p = static_cast<uint16_t>(in >> (lane * 16));
+      uint16_t q = t.r_shifted[p >> 11] | t.g_shifted[(p >> 5) & 0x3F] | t.b_shifted[p & 0x1F];
+      out |= static_cast<uint64_t>(q) << (lane * 16);
+    }
+
+    std::memcpy(dst + i * 2, &out, sizeof(out));
+  }
+
+  for (; i < pixels; i++) {
+    uint16_t p = static_cast<uint16_t>(src[i * 2]) | (static_cast<uint16_t>(src[i * 2 + 1]) << 8);
+    uint16_t q = t.r_shifted[p >> 11] | t.g_shifted[(p >> 5) & 0x3F] | t.b_shifted[p & 0x1F];
+    dst[i * 2] = static_cast<uint8_t>(q & 0xFF);
+    dst[i * 2 + 1] = static_cast<uint8_t>(q >> 8);
+  }
+}
+
+#if defined(MIPI_DSI_CAM_WB_SSSE3)
+
+// pshufb ne couvre que 16 entrées : une passe par quart de table, indices hors plage forcés à 0x80 (-> 0)
+static inline __m128i wb_lookup(const uint8_t *table, uint8_t entries, __m128i idx) {
+  const __m128i sixteen = _mm_set1_epi8(16);
+  const __m128i fifteen = _mm_set1_epi8(15);
+  __m128i result = _mm_setzero_si128();
+  for (uint8_t base = 0; base < entries; base += 16) {
+    __m128i t = _mm_loadu_si128(reinterpret_cast<const __m128i *>(table + base));
+    __m128i out_of_range = _mm_cmpgt_epi8(idx, fifteen);
+    result = _mm_or_si128(result, _mm_shuffle_epi8(t, _mm_or_si128(idx, out_of_range)));
+    idx = _mm_sub_epi8(idx, sixteen);
+  }
+  return result;
+}
+
+static void wb_apply_simd(const WhiteBalanceLut::Table &t, const uint8_t *src, uint8_t *dst, size_t pixels) {
+  const __m128i mask5 = _mm_set1_epi16(0x1F);
+  const __m128i mask6 = _mm_set1_epi16(0x3F);
+  const __m128i zero = _mm_setzero_si128();
+
+  for (size_t i = 0; i < pixels; i += 16) {
+    __m128i p0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 2));
+    __m128i p1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 2 + 16));
+
+    // Indices canal, un octet par pixel (16 pixels)
+    __m128i r = _mm_packus_epi16(_mm_srli_epi16(p0, 11), _mm_srli_epi16(p1, 11));
+    __m128i g = _mm_packus_epi16(_mm_and_si128(_mm_srli_epi16(p0, 5), mask6),
+                                 _mm_and_si128(_mm_srli_epi16(p1, 5), mask6));
+    __m128i b = _mm_packus_epi16(_mm_and_si128(p0, mask5), _mm_and_si128(p1, mask5));
+
+    r = wb_lookup(t.r5, 32, r);
+    g = wb_lookup(t.g6, 64, g);
+    b = wb_lookup(t.b5, 32, b);
+
+    __m128i o0 = _mm_or_si128(_mm_or_si128(_mm_slli_epi16(_mm_unpacklo_epi8(r, zero), 11),
+                                           _mm_slli_epi16(_mm_unpacklo_epi8(g, zero), 5)),
+                              _mm_unpacklo_epi8(b, zero));
+    __m128i o1 = _mm_or_si128(_mm_or_si128(_mm_slli_epi16(_mm_unpackhi_epi8(r, zero), 11),
+                                           _mm_slli_epi16(_mm_unpackhi_epi8(g, zero), 5)),
+                              _mm_unpackhi_epi8(b, zero));
+
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i * 2), o0);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i * 2 + 16), o1);
+  }
+}
+
+#elif defined(MIPI_DSI_CAM_WB_NEON)
+
+static void wb_apply_simd(const WhiteBalanceLut::Table &t, const uint8_t *src, uint8_t *dst, size_t pixels) {
+  // TBL accepte 32 (tbl2) et 64 (tbl4) entrées directement
+  const uint8x16x2_t r_table = {{vld1q_u8(t.r5), vld1q_u8(t.r5 + 16)}};
+  const uint8x16x2_t b_table = {{vld1q_u8(t.b5), vld1q_u8(t.b5 + 16)}};
+  const uint8x16x4_t g_table = {{vld1q_u8(t.g6), vld1q_u8(t.g6 + 16),
+                                 vld1q_u8(t.g6 + 32), vld1q_u8(t.g6 + 48)}};
+  const uint16x8_t mask5 = vdupq_n_u16(0x1F);
+  const uint16x8_t mask6 = vdupq_n_u16(0x3F);
+
+  for (size_t i = 0; i < pixels; i += 16) {
+    uint16x8_t p0 = vld1q_u16(reinterpret_cast<const uint16_t *>(src + i * 2));
+    uint16x8_t p1 = vld1q_u16(reinterpret_cast<const uint16_t *>(src + i * 2 + 16));
+
+    uint8x16_t r = vcombine_u8(vmovn_u16(vshrq_n_u16(p0, 11)), vmovn_u16(vshrq_n_u16(p1, 11)));
+    uint8x16_t g = vcombine_u8(vmovn_u16(vandq_u16(vshrq_n_u16(p0, 5), mask6)),
+                               vmovn_u16(vandq_u16(vshrq_n_u16(p1, 5), mask6)));
+    uint8x16_t b = vcombine_u8(vmovn_u16(vandq_u16(p0, mask5)), vmovn_u16(vandq_u16(p1, mask5)));
+
+    r = vqtbl2q_u8(r_table, r);
+    g = vqtbl4q_u8(g_table, g);
+    b = vqtbl2q_u8(b_table, b);
+
+    uint16x8_t o0 = vorrq_u16(vorrq_u16(vshlq_n_u16(vmovl_u8(vget_low_u8(r)), 11),
+                                        vshlq_n_u16(vmovl_u8(vget_low_u8(g)), 5)),
+                              vmovl_u8(vget_low_u8(b)));
+    uint16x8_t o1 = vorrq_u16(vorrq_u16(vshlq_n_u16(vmovl_u8(vget_high_u8(r)), 11),
+                                        vshlq_n_u16(vmovl_u8(vget_high_u8(g)), 5)),
+                              vmovl_u8(vget_high_u8(b)));
+
+    vst1q_u16(reinterpret_cast<uint16_t *>(dst + i * 2), o0);
+    vst1q_u16(reinterpret_cast<uint16_t *>(dst + i * 2 + 16), o1);
+  }
+}
+
+#endif
+
+const char *WhiteBalanceLut::get_kernel_name() {
+#if defined(MIPI_DSI_CAM_WB_SSSE3)
+  return "ssse3";
+#elif defined(MIPI_DSI_CAM_WB_NEON)
+  return "neon";
+#else
+  return "words";
+#endif
+}
+
+void WhiteBalanceLut::Table::apply(const uint8_t *src, uint8_t *dst, size_t size) const {
+  size &= ~static_cast<size_t>(1);
+  if (this->identity) {
+    if (src != dst) {
+      std::memcpy(dst, src, size);
+    }
+    return;
+  }
+
+  size_t pixels = size / 2;
+  size_t done = 0;
+
+#if defined(MIPI_DSI_CAM_WB_SSSE3) || defined(MIPI_DSI_CAM_WB_NEON)
+  done = pixels & ~static_cast<size_t>(15);
+  wb_apply_simd(*this, src, dst, done);
+#endif
+
+  wb_apply_words(*this, src + done * 2, dst + done * 2, pixels - done);
+}
+
+void WhiteBalanceLut::apply_scalar(const uint8_t *src, uint8_t *dst, size_t size,
+                                   uint16_t red_gain, uint16_t green_gain, uint16_t blue_gain) {
+  for (size_t offset = 0; offset + 1 < size; offset += 2) {
+    uint16_t pixel = static_cast<uint16_t>(src[offset]) |
+                     (static_cast<uint16_t>(src[offset + 1]) << 8);
+
+    uint8_t r5 = (pixel >> 11) & 0x1F;
+    uint8_t g6 = (pixel >> 5) & 0x3F;
+    uint8_t b5 = pixel & 0x1F;
+
+    uint16_t r8 = (static_cast<uint16_t>(r5) << 3) | (r5 >> 2);
+    uint16_t g8 = (static_cast<uint16_t>(g6) << 2) | (g6 >> 4);
+    uint16_t b8 = (static_cast<uint16_t>(b5) << 3) | (b5 >> 2);
+
+    r8 = wb_apply_gain(r8, red_gain);
+    g8 = wb_apply_gain(g8, green_gain);
+    b8 = wb_apply_gain(b8, blue_gain);
+
+    uint16_t corrected = (static_cast<uint16_t>(r8 >> 3) << 11) |
+                         (static_cast<uint16_t>(g8 >> 2) << 5) |
+                         static_cast<uint16_t>(b8 >> 3);
+
+    dst[offset] = static_cast<uint8_t>(corrected & 0xFF);
+    dst[offset + 1] = static_cast<uint8_t>(corrected >> 8);
+  }
+}
+
+}  // namespace mipi_dsi_cam
+}  // namespace esphome
+
+#endif  // USE_ESP32_VARIANT_ESP32P4 || USE_HOST
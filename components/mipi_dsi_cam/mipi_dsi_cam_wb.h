@@ -0,0 +1,123 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(USE_ESP32_VARIANT_ESP32P4) || defined(USE_HOST)
+
+namespace esphome {
+namespace mipi_dsi_cam {
+
+/**
+ * @brief Tables de gains WB pour le RGB565 (32 entrées R/B, 64 entrées G)
+ *
+ * Le résultat de la chaîne scalaire (expansion 8 bits, gain 8.8 arrondi,
+ * saturation, troncature) ne dépend que de la valeur 5/6 bits du canal :
+ * on la précalcule une fois par jeu de gains. Le noyau se réduit alors à
+ * trois lectures de table par pixel, vectorisées en SSSE3 / NEON (builds
+ * host). L'ESP32-P4 n'a pas de chemin SIMD : il prend le chemin par mots,
+ * trois recherches scalaires par pixel, seuls les accès mémoire étant
+ * groupés par mots de 64 bits ; son coût réel est mesuré en cycles par
+ * frame (MipiDsiCam::dump_telemetry()). Tous les chemins sont bit-exact
+ * avec apply_scalar().
+ *
+ * Double buffer : update() (main loop, seul écrivain) remplit la table de
+ * réserve puis la publie par un échange d'index. Les lecteurs (baux 3A,
+ * encodeurs, DQBUF) tiennent la table publiée le temps d'une frame via un
+ * Lease ; tant qu'un Lease existe sur la réserve, la publication est
+ * différée à publish_pending(). Une frame ne mélange donc jamais deux jeux
+ * de gains, et ses métadonnées viennent de la table qui l'a corrigée.
+ */
+class WhiteBalanceLut {
+ public:
+  // Tables figées pour un jeu de gains
+  struct Table {
+    uint16_t red_gain{0};
+    uint16_t green_gain{0};
+    uint16_t blue_gain{0};
+    bool identity{true};
+    // Valeurs canal corrigées (5/6 bits) pour les tables SIMD
+    uint8_t r5[32];
+    uint8_t g6[64];
+    uint8_t b5[32];
+    // Mêmes valeurs déjà décalées à leur position RGB565 (chemin par mots)
+    uint16_t r_shifted[32];
+    uint16_t g_shifted[64];
+    uint16_t b_shifted[32];
+
+    // Applique les gains sur `size` octets RGB565 little-endian ; src == dst autorisé
+    void apply(const uint8_t *src, uint8_t *dst, size_t size) const;
+  };
+
+  // Table publiée retenue pour une frame : elle n'est pas réécrite avant la destruction du Lease
+  class Lease {
+   public:
+    Lease(Lease &&other) noexcept : lut_(other.lut_), index_(other.index_) { other.lut_ = nullptr; }
+    Lease(const Lease &) = delete;
+    Lease &operator=(const Lease &) = delete;
+    Lease &operator=(Lease &&) = delete;
+    ~Lease() {
+      if (this->lut_ != nullptr) {
+        this->lut_->readers_[this->index_].fetch_sub(1, std::memory_order_release);
+      }
+    }
+
+    const Table &table() const { return this->lut_->tables_[this->index_]; }
+    bool is_identity() const { return this->table().identity; }
+    uint16_t get_red_gain() const { return this->table().red_gain; }
+    uint16_t get_green_gain() const { return this->table().green_gain; }
+    uint16_t get_blue_gain() const { return this->table().blue_gain; }
+    void apply(const uint8_t *src, uint8_t *dst, size_t size) const { this->table().apply(src, dst, size); }
+
+   protected:
+    friend class WhiteBalanceLut;
+    Lease(const WhiteBalanceLut *lut, uint8_t index) : lut_(lut), index_(index) {}
+
+    const WhiteBalanceLut *lut_;
+    uint8_t index_;
+  };
+
+  WhiteBalanceLut();
+
+  // Main loop uniquement. Publie les tables des nouveaux gains ; renvoie true si publiées,
+  // false si inchangées ou différées (réserve encore tenue par un Lease)
+  bool update(uint16_t red_gain, uint16_t green_gain, uint16_t blue_gain);
+  // Reprend une publication différée ; à appeler à chaque tour de main loop
+  bool publish_pending();
+  bool has_pending() const { return this->pending_; }
+
+  // Un seul acquire() par frame : pixels et métadonnées viennent alors de la même table
+  Lease acquire() const;
+
+  bool is_identity() const { return this->acquire().is_identity(); }
+  uint16_t get_red_gain() const { return this->acquire().get_red_gain(); }
+  uint16_t get_green_gain() const { return this->acquire().get_green_gain(); }
+  uint16_t get_blue_gain() const { return this->acquire().get_blue_gain(); }
+  void apply(const uint8_t *src, uint8_t *dst, size_t size) const { this->acquire().apply(src, dst, size); }
+
+  // Noyau compilé pour cette cible : "ssse3", "neon" ou "words" (ESP32-P4)
+  static const char *get_kernel_name();
+
+  // Chemin de référence (un pixel par itération) des tests host tests/mipi_dsi_cam
+  static void apply_scalar(const uint8_t *src, uint8_t *dst, size_t size,
+                           uint16_t red_gain, uint16_t green_gain, uint16_t blue_gain);
+
+ protected:
+  static void build_(Table &table, uint16_t red_gain, uint16_t green_gain, uint16_t blue_gain);
+
+  Table tables_[2];
+  mutable std::atomic<uint32_t> readers_[2];
+  std::atomic<uint8_t> active_{0};
+
+  // Gains demandés, pas encore publiés (main loop uniquement)
+  uint16_t pending_red_gain_{256};
+  uint16_t pending_green_gain_{256};
+  uint16_t pending_blue_gain_{256};
+  bool pending_{false};
+};
+
+}  // namespace mipi_dsi_cam
+}  // namespace esphome
+
+#endif  // USE_ESP32_VARIANT_ESP32P4 || USE_HOST
@@ -0,0 +1,94 @@
+import esphome.codegen as cg
+import esphome.config_validation as cv
+from esphome.components import sensor
+from esphome.const import (
+    CONF_ID,
+    STATE_CLASS_MEASUREMENT,
+    STATE_CLASS_TOTAL_INCREASING,
+    UNIT_MILLISECOND,
+)
+
+from . import mipi_dsi_cam_ns, MipiDsiCam
+
+DEPENDENCIES = ["mipi_dsi_cam"]
+
+CONF_MIPI_DSI_CAM_ID = "mipi_dsi_cam_id"
+CONF_CONSUMER = "consumer"
+CONF_CAPTURE_LATENCY = "capture_latency"
+CONF_CAPTURE_LATENCY_P95 = "capture_latency_p95"
+CONF_HOLD_TIME = "hold_time"
+CONF_HOLD_TIME_P95 = "hold_time_p95"
+CONF_DROPPED_FRAMES = "dropped_frames"
+CONF_RING_OVERRUNS = "ring_overruns"
+CONF_RING_SKIPS = "ring_skips"
+CONF_AE_CONVERGENCE_TIME = "ae_convergence_time"
+CONF_BOOT_TO_FIRST_FRAME = "boot_to_first_frame"
+
+MipiDsiCamSensor = mipi_dsi_cam_ns.class_("MipiDsiCamSensor", cg.PollingComponent)
+
+latency_schema = sensor.sensor_schema(
+    unit_of_measurement=UNIT_MILLISECOND,
+    accuracy_decimals=2,
+    state_class=STATE_CLASS_MEASUREMENT,
+    icon="mdi:timer-outline",
+)
+
+counter_schema = sensor.sensor_schema(
+    accuracy_decimals=0,
+    state_class=STATE_CLASS_TOTAL_INCREASING,
+    icon="mdi:image-broken-variant",
+)
+
+CONFIG_SCHEMA = cv.Schema(
+    {
+        cv.GenerateID(): cv.declare_id(MipiDsiCamSensor),
+        cv.GenerateID(CONF_MIPI_DSI_CAM_ID): cv.use_id(MipiDsiCam),
+        # Nom du consommateur tel qu'enregistré (v4l2, jpeg, h264, legacy)
+        cv.Optional(CONF_CONSUMER, default="v4l2"): cv.string,
+        cv.Optional(CONF_CAPTURE_LATENCY): latency_schema,
+        cv.Optional(CONF_CAPTURE_LATENCY_P95): latency_schema,
+        cv.Optional(CONF_HOLD_TIME): latency_schema,
+        cv.Optional(CONF_HOLD_TIME_P95): latency_schema,
+        cv.Optional(CONF_DROPPED_FRAMES): counter_schema,
+        cv.Optional(CONF_RING_OVERRUNS): counter_schema,
+        cv.Optional(CONF_RING_SKIPS): counter_schema,
+        cv.Optional(CONF_AE_CONVERGENCE_TIME): sensor.sensor_schema(
+            unit_of_measurement=UNIT_MILLISECOND,
+            accuracy_decimals=0,
+            state_class=STATE_CLASS_MEASUREMENT,
+            icon="mdi:brightness-auto",
+        ),
+        cv.Optional(CONF_BOOT_TO_FIRST_FRAME): sensor.sensor_schema(
+            unit_of_measurement=UNIT_MILLISECOND,
+            accuracy_decimals=0,
+            state_class=STATE_CLASS_MEASUREMENT,
+            icon="mdi:timer-play-outline",
+        ),
+    }
+).extend(cv.polling_component_schema("10s"))
+
+SENSOR_SETTERS = {
+    CONF_CAPTURE_LATENCY: "set_capture_latency_sensor",
+    CONF_CAPTURE_LATENCY_P95: "set_capture_latency_p95_sensor",
+    CONF_HOLD_TIME: "set_hold_time_sensor",
+    CONF_HOLD_TIME_P95: "set_hold_time_p95_sensor",
+    CONF_DROPPED_FRAMES: "set_dropped_frames_sensor",
+    CONF_RING_OVERRUNS: "set_ring_overruns_sensor",
+    CONF_RING_SKIPS: "set_ring_skips_sensor",
+    CONF_AE_CONVERGENCE_TIME: "set_ae_convergence_time_sensor",
+    CONF_BOOT_TO_FIRST_FRAME: "set_boot_to_first_frame_sensor",
+}
+
+
+async def to_code(config):
+    var = cg.new_Pvariable(config[CONF_ID])
+    await cg.register_component(var, config)
+
+    camera = await cg.get_variable(config[CONF_MIPI_DSI_CAM_ID])
+    cg.add(var.set_camera(camera))
+    cg.add(var.set_consumer_name(config[CONF_CONSUMER]))
+
+    for key, setter in SENSOR_SETTERS.items():
+        if key in config:
+            sens = await sensor.new_sensor(config[key])
+            cg.add(getattr(var, setter)(sens))
@@ -22,6 +22,7 @@ REGISTERS = {
     'exposure_m': 0x3e01,
     'exposure_l': 0x3e02,
     'flip_mirror': 0x3221,
+    'group_hold': 0x3812,
 }
 
 INIT_SEQUENCE = [
@@ -242,6 +243,23 @@ GAIN_REGISTERS = [
     (0xf0, 0x01, 0x0f), (0xf4, 0x01, 0x0f), (0xf8, 0x01, 0x0f), (0xfc, 0x01, 0x0f),
 ]
 
+# Longueur maximale d'une rafale d'init (octets de données après l'adresse)
+INIT_BURST_MAX = 16
+
+
+def merge_init_bursts(sequence, max_length=INIT_BURST_MAX):
+    """Regroupe les registres consécutifs sans attente en rafales (addr, [valeurs], delay_ms)."""
+    bursts = []
+    for addr, value, delay in sequence:
+        if bursts and delay == 0:
+            start, values, _ = bursts[-1]
+            if addr == start + len(values) and len(values) < max_length:
+                values.append(value)
+                continue
+        bursts.append((addr, [value], delay))
+    return bursts
+
+
 def generate_driver_cpp():
     cpp_code = f'''
 namespace esphome {{
@@ -256,17 +274,34 @@ namespace {SENSOR_INFO['name']}_regs {{
     cpp_code += f'''
 }}
 
-struct {SENSOR_INFO['name'].upper()}InitRegister {{
+// Séquence d'init en rafales : registres consécutifs écrits en une transaction (auto-incrément)
+struct {SENSOR_INFO['name'].upper()}InitBurst {{
     uint16_t addr;
-    uint8_t value;
-    uint16_t delay_ms;
+    uint8_t length;
+    uint16_t delay_ms;  // Attente avant la rafale
+    uint16_t offset;    // Premier octet dans {SENSOR_INFO['name']}_init_values
+}};
+
+static constexpr size_t {SENSOR_INFO['name'].upper()}_INIT_BURST_MAX = {INIT_BURST_MAX};
+
+static const uint8_t {SENSOR_INFO['name']}_init_values[] = {{
+'''
+    
+    bursts = merge_init_bursts(INIT_SEQUENCE)
+    values = [v for _, burst_values, _ in bursts for v in burst_values]
+    for i in range(0, len(values), 12):
+        cpp_code += '    ' + ', '.join(f'0x{v:02X}' for v in values[i:i + 12]) + ',\n'
+    
+    cpp_code += f'''
 }};
 
-static const {SENSOR_INFO['name'].upper()}InitRegister {SENSOR_INFO['name']}_init_sequence[] = {{
+static const {SENSOR_INFO['name'].upper()}InitBurst {SENSOR_INFO['name']}_init_bursts[] = {{
 '''
     
-    for addr, value, delay in INIT_SEQUENCE:
-        cpp_code += f'    {{0x{addr:04X}, 0x{value:02X}, {delay}}},\n'
+    offset = 0
+    for addr, burst_values, delay in bursts:
+        cpp_code += f'    {{0x{addr:04X}, {len(burst_values)}, {delay}, {offset}}},\n'
+        offset += len(burst_values)
     
     cpp_code += f'''
 }};
@@ -286,6 +321,16 @@ static const {SENSOR_INFO['name'].upper()}GainRegisters {SENSOR_INFO['name']}_ga
     cpp_code += f'''
 }};
 
+// Gain total (x1000) de chaque entrée de {SENSOR_INFO['name']}_gain_map, croissant
+static const uint16_t {SENSOR_INFO['name']}_gain_values[] = {{
+'''
+    
+    for i in range(0, len(GAIN_VALUES), 8):
+        cpp_code += '    ' + ', '.join(str(v) for v in GAIN_VALUES[i:i + 8]) + ',\n'
+    
+    cpp_code += f'''
+}};
+
 class {SENSOR_INFO['name'].upper()}Driver {{
 public:
     {SENSOR_INFO['name'].upper()}Driver(esphome::i2c::I2CDevice* i2c) : i2c_(i2c) {{}}
@@ -293,21 +338,23 @@ public:
     esp_err_t init() {{
         ESP_LOGI(TAG, "Init {SENSOR_INFO['name'].upper()} - AWB matériel désactivé, correction logicielle uniquement");
         
-        for (size_t i = 0; i < sizeof({SENSOR_INFO['name']}_init_sequence) / sizeof({SENSOR_INFO['name'].upper()}InitRegister); i++) {{
-            const auto& reg = {SENSOR_INFO['name']}_init_sequence[i];
+        const size_t burst_count = sizeof({SENSOR_INFO['name']}_init_bursts) / sizeof({SENSOR_INFO['name'].upper()}InitBurst);
+        for (size_t i = 0; i < burst_count; i++) {{
+            const auto& burst = {SENSOR_INFO['name']}_init_bursts[i];
             
-            if (reg.delay_ms > 0) {{
-                vTaskDelay(pdMS_TO_TICKS(reg.delay_ms));
+            if (burst.delay_ms > 0) {{
+                vTaskDelay(pdMS_TO_TICKS(burst.delay_ms));
             }}
             
-            esp_err_t ret = write_register(reg.addr, reg.value);
+            esp_err_t ret = write_burst(burst.addr, &{SENSOR_INFO['name']}_init_values[burst.offset], burst.length);
             if (ret != ESP_OK) {{
-                ESP_LOGE(TAG, "Init failed at reg 0x%04X", reg.addr);
+                ESP_LOGE(TAG, "Init failed at reg 0x%04X (%u regs)", burst.addr, burst.length);
                 return ret;
             }}
         }}
         
-        ESP_LOGI(TAG, "✅ {SENSOR_INFO['name'].upper()} initialized");
+        ESP_LOGI(TAG, "✅ {SENSOR_INFO['name'].upper()} initialized (%u registers in %u I2C writes)",
+                 (unsigned) sizeof({SENSOR_INFO['name']}_init_values), (unsigned) burst_count);
         return ESP_OK;
     }}
     
@@ -332,36 +379,46 @@ public:
         return write_register({SENSOR_INFO['name']}_regs::STREAM_MODE, 0x00);
     }}
     
+    bool is_stream_active() {{
+        uint8_t mode = 0;
+        return read_register({SENSOR_INFO['name']}_regs::STREAM_MODE, &mode) == ESP_OK && (mode & 0x01);
+    }}
+    
     esp_err_t set_gain(uint32_t gain_index) {{
+        SensorRegister writes[SENSOR_MAX_SETTING_REGISTERS];
+        return write_registers(writes, get_gain_registers(gain_index, writes));
+    }}
+    
+    esp_err_t set_exposure(uint32_t exposure) {{
+        SensorRegister writes[SENSOR_MAX_SETTING_REGISTERS];
+        return write_registers(writes, get_exposure_registers(exposure, writes));
+    }}
+    
+    static size_t get_gain_registers(uint32_t gain_index, SensorRegister* out) {{
         if (gain_index >= sizeof({SENSOR_INFO['name']}_gain_map) / sizeof({SENSOR_INFO['name'].upper()}GainRegisters)) {{
             gain_index = (sizeof({SENSOR_INFO['name']}_gain_map) / sizeof({SENSOR_INFO['name'].upper()}GainRegisters)) - 1;
         }}
         
         const auto& gain = {SENSOR_INFO['name']}_gain_map[gain_index];
-        
-        esp_err_t ret = write_register({SENSOR_INFO['name']}_regs::GAIN_FINE, gain.dgain_fine);
-        if (ret != ESP_OK) return ret;
-        
-        ret = write_register({SENSOR_INFO['name']}_regs::GAIN_COARSE, gain.dgain_coarse);
-        if (ret != ESP_OK) return ret;
-        
-        ret = write_register({SENSOR_INFO['name']}_regs::GAIN_ANALOG, gain.analog_gain);
-        return ret;
+        out[0] = {{{SENSOR_INFO['name']}_regs::GAIN_FINE, gain.dgain_fine}};
+        out[1] = {{{SENSOR_INFO['name']}_regs::GAIN_COARSE, gain.dgain_coarse}};
+        out[2] = {{{SENSOR_INFO['name']}_regs::GAIN_ANALOG, gain.analog_gain}};
+        return 3;
     }}
     
-    esp_err_t set_exposure(uint32_t exposure) {{
-        uint8_t exp_h = (exposure >> 12) & 0x0F;
-        uint8_t exp_m = (exposure >> 4) & 0xFF;
-        uint8_t exp_l = (exposure & 0x0F) << 4;
-        
-        esp_err_t ret = write_register({SENSOR_INFO['name']}_regs::EXPOSURE_H, exp_h);
-        if (ret != ESP_OK) return ret;
-        
-        ret = write_register({SENSOR_INFO['name']}_regs::EXPOSURE_M, exp_m);
-        if (ret != ESP_OK) return ret;
-        
-        ret = write_register({SENSOR_INFO['name']}_regs::EXPOSURE_L, exp_l);
-        return ret;
+    static size_t get_exposure_registers(uint32_t exposure, SensorRegister* out) {{
+        out[0] = {{{SENSOR_INFO['name']}_regs::EXPOSURE_H, static_cast<uint8_t>((exposure >> 12) & 0x0F)}};
+        out[1] = {{{SENSOR_INFO['name']}_regs::EXPOSURE_M, static_cast<uint8_t>((exposure >> 4) & 0xFF)}};
+        out[2] = {{{SENSOR_INFO['name']}_regs::EXPOSURE_L, static_cast<uint8_t>((exposure & 0x0F) << 4)}};
+        return 3;
+    }}
+    
+    esp_err_t write_registers(const SensorRegister* writes, size_t count) {{
+        for (size_t i = 0; i < count; i++) {{
+            esp_err_t ret = write_register(writes[i].reg, writes[i].value);
+            if (ret != ESP_OK) return ret;
+        }}
+        return ESP_OK;
     }}
     
     esp_err_t write_register(uint16_t reg, uint8_t value) {{
@@ -379,6 +436,25 @@ public:
         return ESP_OK;
     }}
     
+    // Écriture auto-incrémentée : adresse de départ puis valeurs des registres consécutifs
+    esp_err_t write_burst(uint16_t reg, const uint8_t* values, size_t count) {{
+        if (count == 0 || count > {SENSOR_INFO['name'].upper()}_INIT_BURST_MAX) {{
+            return ESP_ERR_INVALID_ARG;
+        }}
+        
+        uint8_t data[2 + {SENSOR_INFO['name'].upper()}_INIT_BURST_MAX];
+        data[0] = static_cast<uint8_t>((reg >> 8) & 0xFF);
+        data[1] = static_cast<uint8_t>(reg & 0xFF);
+        std::memcpy(&data[2], values, count);
+        
+        auto err = i2c_->write_read(data, 2 + count, nullptr, 0);
+        if (err != esphome::i2c::ERROR_OK) {{
+            ESP_LOGE(TAG, "I2C burst write failed at reg 0x%04X", reg);
+            return ESP_FAIL;
+        }}
+        return ESP_OK;
+    }}
+    
     esp_err_t read_register(uint16_t reg, uint8_t* value) {{
         uint8_t addr[2] = {{
             static_cast<uint8_t>((reg >> 8) & 0xFF),
@@ -419,8 +495,28 @@ public:
     esp_err_t read_id(uint16_t* pid) override {{ return driver_.read_id(pid); }}
     esp_err_t start_stream() override {{ return driver_.start_stream(); }}
     esp_err_t stop_stream() override {{ return driver_.stop_stream(); }}
+    bool is_stream_active() override {{ return driver_.is_stream_active(); }}
     esp_err_t set_gain(uint32_t gain_index) override {{ return driver_.set_gain(gain_index); }}
     esp_err_t set_exposure(uint32_t exposure) override {{ return driver_.set_exposure(exposure); }}
+    uint16_t get_gain_count() const override {{
+        return sizeof({SENSOR_INFO['name']}_gain_values) / sizeof({SENSOR_INFO['name']}_gain_values[0]);
+    }}
+    float get_gain_multiplier(uint16_t gain_index) const override {{
+        if (gain_index >= get_gain_count()) gain_index = get_gain_count() - 1;
+        return {SENSOR_INFO['name']}_gain_values[gain_index] / 1000.0f;
+    }}
+    size_t get_exposure_registers(uint32_t exposure, SensorRegister* out) const override {{
+        return {SENSOR_INFO['name'].upper()}Driver::get_exposure_registers(exposure, out);
+    }}
+    size_t get_gain_registers(uint32_t gain_index, SensorRegister* out) const override {{
+        return {SENSOR_INFO['name'].upper()}Driver::get_gain_registers(gain_index, out);
+    }}
+    // Group hold : exposition et gain basculent ensemble à la frontière de frame suivante
+    bool get_group_hold(SensorRegister* begin, SensorRegister* end) const override {{
+        *begin = {{{SENSOR_INFO['name']}_regs::GROUP_HOLD, 0x00}};
+        *end = {{{SENSOR_INFO['name']}_regs::GROUP_HOLD, 0x30}};
+        return true;
+    }}
     esp_err_t write_register(uint16_t reg, uint8_t value) override {{ return driver_.write_register(reg, value); }}
     esp_err_t read_register(uint16_t reg, uint8_t* value) override {{ return driver_.read_register(reg, value); }}
     
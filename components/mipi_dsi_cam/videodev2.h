@@ -1498,6 +1498,7 @@ struct v4l2_streamparm {
 #define V4L2_CTRL_TYPE_STRING       7
 #define V4L2_CTRL_TYPE_BITMASK      8
 #define V4L2_CTRL_TYPE_INTEGER_MENU 9
+#define V4L2_CTRL_TYPE_U8           0x0100  /* Tableau d'octets : structures ISP (V4L2_CID_USER_ESP_ISP_*) */
 
 #define V4L2_CID_BASE               0x00980900
 #define V4L2_CID_BRIGHTNESS         (V4L2_CID_BASE + 0)
@@ -1604,6 +1605,11 @@ struct v4l2_ext_controls {
     struct v4l2_ext_control *controls;
 };
 
+#define V4L2_CTRL_ID2WHICH(id)      ((id) & 0x0fff0000UL)
+#define V4L2_CTRL_WHICH_CUR_VAL     0
+#define V4L2_CTRL_WHICH_DEF_VAL     0x0f000000
+#define V4L2_CTRL_WHICH_REQUEST_VAL 0x0f010000
+
 
 
 
@@ -1760,6 +1766,7 @@ struct v4l2_event_subscription {
 #define VIDIOC_REQBUFS               _IOWR('V',  8, struct v4l2_requestbuffers)
 #define VIDIOC_QUERYBUF              _IOWR('V',  9, struct v4l2_buffer)
 #define VIDIOC_QBUF                  _IOWR('V', 15, struct v4l2_buffer)
+#define VIDIOC_EXPBUF                _IOWR('V', 16, struct v4l2_exportbuffer)
 #define VIDIOC_DQBUF                 _IOWR('V', 17, struct v4l2_buffer)
 #define VIDIOC_STREAMON              _IOW ('V', 18, int)
 #define VIDIOC_STREAMOFF             _IOW ('V', 19, int)
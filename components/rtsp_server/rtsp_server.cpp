@@ -1,12 +1,48 @@
 #include "rtsp_server.h"
 #include "esphome/core/log.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
 #include <cstring>
+#include <strings.h>
 
 namespace esphome {
 namespace rtsp_server {
 
 static const char *TAG = "rtsp_server";
 
+// Horloge RTP vidéo (RFC 3551) : 90 kHz, dérivée de l'instant de capture
+static uint32_t rtp_timestamp_90khz(int64_t capture_us) {
+  return (uint32_t) ((capture_us * 9) / 100);
+}
+
+// Charge utile RTP max (MTU Ethernet - IP/TCP/RTP)
+static constexpr size_t RTP_MAX_PAYLOAD = 1400;
+// Délai d'inactivité de la connexion de contrôle (requêtes et envoi du flux)
+static constexpr int CLIENT_TIMEOUT_S = 5;
+
+// Valeur d'un en-tête de la requête (nom insensible à la casse, en début de ligne)
+static bool find_header(const char *request, const char *name, char *value, size_t value_len) {
+  const size_t name_len = strlen(name);
+  for (const char *line = request; line != nullptr && *line != '\0';) {
+    if (strncasecmp(line, name, name_len) == 0 && line[name_len] == ':') {
+      const char *start = line + name_len + 1;
+      while (*start == ' ' || *start == '\t') {
+        start++;
+      }
+      const size_t len = std::min(strcspn(start, "\r\n"), value_len - 1);
+      memcpy(value, start, len);
+      value[len] = '\0';
+      return true;
+    }
+    line = strchr(line, '\n');
+    if (line != nullptr) {
+      line++;
+    }
+  }
+  return false;
+}
+
 void RTSPServer::setup() {
   ESP_LOGI(TAG, "🎬 Starting RTSP server on port %u", this->port_);
   
@@ -67,6 +103,12 @@ void RTSPServer::loop() {
   
   if (client_sock >= 0) {
     ESP_LOGI(TAG, "📥 Client connected");
+    // Connexion de contrôle bloquante, bornée : les trames RTP entrelacées y passent aussi
+    fcntl(client_sock, F_SETFL, fcntl(client_sock, F_GETFL, 0) & ~O_NONBLOCK);
+    struct timeval timeout = {};
+    timeout.tv_sec = CLIENT_TIMEOUT_S;
+    setsockopt(client_sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(client_sock, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
     this->handle_client_(client_sock);
     close(client_sock);
   }
@@ -74,43 +116,116 @@ void RTSPServer::loop() {
 
 void RTSPServer::handle_client_(int sock) {
   char buffer[1024];
-  int n = recv(sock, buffer, sizeof(buffer) - 1, 0);
-  
-  if (n <= 0) return;
-  buffer[n] = '\0';
-  
-  // Parser la requête RTSP basique
-  if (strstr(buffer, "DESCRIBE")) {
-    const char *sdp = 
-      "v=0\r\n"
-      "s=ESPHome Camera Stream\r\n"
-      "m=video 0 RTP/AVP 96\r\n"
-      "a=rtpmap:96 H264/90000\r\n"
-      "a=control:track1\r\n";
+  bool transport_ready = false;
+  this->session_id_++;
+  
+  // Requêtes successives sur la même connexion jusqu'à PLAY (flux entrelacé) ou TEARDOWN
+  for (;;) {
+    int n = recv(sock, buffer, sizeof(buffer) - 1, 0);
+    if (n <= 0) return;
+    buffer[n] = '\0';
+    
+    char cseq[16] = "0";
+    find_header(buffer, "CSeq", cseq, sizeof(cseq));
+    
+    if (strncmp(buffer, "OPTIONS", 7) == 0) {
+      this->send_rtsp_response_(sock, cseq, "200 OK", "Public: OPTIONS, DESCRIBE, SETUP, PLAY, TEARDOWN\r\n", "");
     
-    this->send_rtsp_response_(sock, "200 OK", sdp);
+    } else if (strncmp(buffer, "DESCRIBE", 8) == 0) {
+      const char *sdp =
+        "v=0\r\n"
+        "s=ESPHome Camera Stream\r\n"
+        "m=video 0 RTP/AVP 96\r\n"
+        "a=rtpmap:96 H264/90000\r\n"
+        "a=control:track1\r\n";
+      
+      this->send_rtsp_response_(sock, cseq, "200 OK", "Content-Type: application/sdp\r\n", sdp);
+    
+    } else if (strncmp(buffer, "SETUP", 5) == 0) {
+      // Seul le transport TCP entrelacé est servi ; les canaux demandés par le client sont repris
+      char transport[128] = "";
+      find_header(buffer, "Transport", transport, sizeof(transport));
+      if (strstr(transport, "RTP/AVP/TCP") == nullptr) {
+        ESP_LOGW(TAG, "⚠️ Unsupported transport: '%s'", transport);
+        this->send_rtsp_response_(sock, cseq, "461 Unsupported Transport", "", "");
+        continue;
+      }
+      unsigned rtp_channel = 0;
+      unsigned rtcp_channel = 1;
+      const char *interleaved = strstr(transport, "interleaved=");
+      if (interleaved != nullptr && sscanf(interleaved, "interleaved=%u-%u", &rtp_channel, &rtcp_channel) < 1) {
+        this->send_rtsp_response_(sock, cseq, "400 Bad Request", "", "");
+        continue;
+      }
+      if (rtp_channel > 255 || rtcp_channel > 255) {
+        this->send_rtsp_response_(sock, cseq, "461 Unsupported Transport", "", "");
+        continue;
+      }
+      this->rtp_channel_ = rtp_channel;
+      
+      char headers[160];
+      snprintf(headers, sizeof(headers),
+               "Transport: RTP/AVP/TCP;unicast;interleaved=%u-%u\r\n"
+               "Session: %08X\r\n",
+               rtp_channel, rtcp_channel, (unsigned)this->session_id_);
+      transport_ready = this->send_rtsp_response_(sock, cseq, "200 OK", headers, "");
     
-  } else if (strstr(buffer, "SETUP")) {
-    const char *transport = "RTP/AVP;unicast;client_port=5000-5001\r\n";
-    this->send_rtsp_response_(sock, "200 OK", transport);
+    } else if (strncmp(buffer, "PLAY", 4) == 0) {
+      if (!transport_ready) {
+        this->send_rtsp_response_(sock, cseq, "455 Method Not Valid in This State", "", "");
+        continue;
+      }
+      char headers[32];
+      snprintf(headers, sizeof(headers), "Session: %08X\r\n", (unsigned)this->session_id_);
+      if (this->send_rtsp_response_(sock, cseq, "200 OK", headers, "")) {
+        this->stream_h264_(sock);
+      }
+      return;
     
-  } else if (strstr(buffer, "PLAY")) {
-    this->send_rtsp_response_(sock, "200 OK", "");
-    this->stream_h264_(sock);
+    } else if (strncmp(buffer, "TEARDOWN", 8) == 0) {
+      this->send_rtsp_response_(sock, cseq, "200 OK", "", "");
+      return;
+    
+    } else {
+      this->send_rtsp_response_(sock, cseq, "501 Not Implemented", "", "");
+    }
   }
 }
 
-void RTSPServer::send_rtsp_response_(int sock, const char *status, 
-                                      const char *content) {
+bool RTSPServer::send_all_(int sock, const void *data, size_t len) {
+  const uint8_t *bytes = (const uint8_t *) data;
+  while (len > 0) {
+    const ssize_t sent = send(sock, bytes, len, 0);
+    if (sent < 0 && errno == EINTR) {
+      continue;
+    }
+    if (sent <= 0) {
+      // Écriture partielle abandonnée : le flux entrelacé serait désynchronisé, la connexion est perdue
+      ESP_LOGW(TAG, "⚠️ send() failed (errno=%d), dropping client", errno);
+      return false;
+    }
+    bytes += sent;
+    len -= (size_t) sent;
+  }
+  return true;
+}
+
+bool RTSPServer::send_rtsp_response_(int sock, const char *cseq, const char *status, const char *headers,
+                                     const char *content) {
   char response[2048];
-  snprintf(response, sizeof(response),
-           "RTSP/1.0 %s\r\n"
-           "CSeq: 1\r\n"
-           "Content-Length: %d\r\n"
-           "\r\n%s",
-           status, (int)strlen(content), content);
-  
-  send(sock, response, strlen(response), 0);
+  const int len = snprintf(response, sizeof(response),
+                           "RTSP/1.0 %s\r\n"
+                           "CSeq: %s\r\n"
+                           "%s"
+                           "Content-Length: %d\r\n"
+                           "\r\n%s",
+                           status, cseq, headers, (int)strlen(content), content);
+  if (len < 0 || (size_t) len >= sizeof(response)) {
+    ESP_LOGE(TAG, "❌ RTSP response too large");
+    return false;
+  }
+  
+  return this->send_all_(sock, response, len);
 }
 
 void RTSPServer::stream_h264_(int sock) {
@@ -121,29 +236,121 @@ void RTSPServer::stream_h264_(int sock) {
   bool is_keyframe = false;
   
   for (int i = 0; i < 300; i++) {  // Stream 300 frames (~10s @ 30fps)
-    // Obtenir une frame RGB depuis la caméra
-    uint8_t *camera_data = /* obtenir depuis caméra */;
-    size_t camera_size = /* taille frame */;
-    
-    // Encoder en H.264
-    esp_err_t ret = this->encoder_->encode_frame(
-      camera_data, camera_size,
-      &h264_data, &h264_size, &is_keyframe
+    // Attendre la prochaine frame de la caméra (réveil par l'ISR CSI) puis l'encoder
+    esp_err_t ret = this->encoder_->encode_next_frame(
+      &h264_data, &h264_size, &is_keyframe, 100
     );
     
     if (ret == ESP_OK && h264_size > 0) {
-      // Envoyer via RTP (simplifié ici)
-      send(sock, h264_data, h264_size, 0);
+      // Horodatage de la frame : instant de capture, pas instant d'envoi
+      const uint32_t timestamp = rtp_timestamp_90khz(this->encoder_->get_last_frame_metadata().capture_us);
+      
+      if (!this->send_h264_access_unit_(sock, h264_data, h264_size, timestamp)) {
+        ESP_LOGW(TAG, "⚠️ Client disconnected, stopping stream");
+        return;
+      }
       
-      ESP_LOGD(TAG, "📤 Sent %s frame (%u bytes)", 
-               is_keyframe ? "I" : "P", (unsigned)h264_size);
+      ESP_LOGD(TAG, "📤 Sent %s frame (%u bytes, ts=%u)",
+               is_keyframe ? "I" : "P", (unsigned)h264_size, (unsigned)timestamp);
     }
-    
-    delay(33);  // ~30 FPS
   }
   
   ESP_LOGI(TAG, "✅ Stream finished");
 }
 
+bool RTSPServer::send_rtp_packet_(int sock, const uint8_t *header_ext, size_t ext_len,
+                                  const uint8_t *payload, size_t len, uint32_t timestamp, bool marker) {
+  // Trame RTSP entrelacée (RFC 2326 §10.12) : '$', canal négocié au SETUP, longueur 16 bits, puis paquet RTP
+  const size_t rtp_len = 12 + ext_len + len;
+  uint8_t hdr[4 + 12];
+  hdr[0] = '$';
+  hdr[1] = this->rtp_channel_;
+  hdr[2] = (rtp_len >> 8) & 0xFF;
+  hdr[3] = rtp_len & 0xFF;
+  
+  hdr[4] = 0x80;                          // V=2
+  hdr[5] = (marker ? 0x80 : 0x00) | 96;   // PT dynamique H.264
+  hdr[6] = (this->rtp_seq_ >> 8) & 0xFF;
+  hdr[7] = this->rtp_seq_ & 0xFF;
+  hdr[8] = (timestamp >> 24) & 0xFF;
+  hdr[9] = (timestamp >> 16) & 0xFF;
+  hdr[10] = (timestamp >> 8) & 0xFF;
+  hdr[11] = timestamp & 0xFF;
+  hdr[12] = (this->rtp_ssrc_ >> 24) & 0xFF;
+  hdr[13] = (this->rtp_ssrc_ >> 16) & 0xFF;
+  hdr[14] = (this->rtp_ssrc_ >> 8) & 0xFF;
+  hdr[15] = this->rtp_ssrc_ & 0xFF;
+  this->rtp_seq_++;
+  
+  return this->send_all_(sock, hdr, sizeof(hdr)) &&
+         (ext_len == 0 || this->send_all_(sock, header_ext, ext_len)) &&
+         this->send_all_(sock, payload, len);
+}
+
+bool RTSPServer::send_h264_access_unit_(int sock, const uint8_t *data, size_t size, uint32_t timestamp) {
+  // Découpage Annex-B : chaque NAL est précédé de 00 00 01 ou 00 00 00 01
+  auto find_start = [&](size_t from, size_t *code_len) -> size_t {
+    for (size_t i = from; i + 3 <= size; i++) {
+      if (data[i] == 0 && data[i + 1] == 0) {
+        if (data[i + 2] == 1) {
+          *code_len = 3;
+          return i;
+        }
+        if (i + 4 <= size && data[i + 2] == 0 && data[i + 3] == 1) {
+          *code_len = 4;
+          return i;
+        }
+      }
+    }
+    *code_len = 0;
+    return size;
+  };
+  
+  size_t code_len = 0;
+  size_t pos = find_start(0, &code_len);
+  while (pos < size) {
+    const size_t nal_start = pos + code_len;
+    size_t next = find_start(nal_start, &code_len);
+    const uint8_t *nal = data + nal_start;
+    const size_t nal_len = next - nal_start;
+    const bool last = (next >= size);
+    pos = next;
+    
+    if (nal_len == 0) {
+      continue;
+    }
+    
+    if (nal_len <= RTP_MAX_PAYLOAD) {
+      // Single NAL unit packet
+      if (!this->send_rtp_packet_(sock, nullptr, 0, nal, nal_len, timestamp, last)) {
+        return false;
+      }
+      continue;
+    }
+    
+    // FU-A (RFC 6184 §5.8) : l'en-tête NAL est remplacé par indicateur + en-tête FU
+    const uint8_t nal_header = nal[0];
+    size_t offset = 1;
+    while (offset < nal_len) {
+      const size_t chunk = std::min(RTP_MAX_PAYLOAD - 2, nal_len - offset);
+      uint8_t fu[2];
+      fu[0] = (nal_header & 0xE0) | 28;
+      fu[1] = nal_header & 0x1F;
+      if (offset == 1) {
+        fu[1] |= 0x80;  // Start
+      }
+      const bool end = (offset + chunk >= nal_len);
+      if (end) {
+        fu[1] |= 0x40;  // End
+      }
+      if (!this->send_rtp_packet_(sock, fu, sizeof(fu), nal + offset, chunk, timestamp, last && end)) {
+        return false;
+      }
+      offset += chunk;
+    }
+  }
+  return true;
+}
+
 } // namespace rtsp_server
 } // namespace esphome
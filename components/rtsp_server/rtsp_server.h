@@ -20,11 +20,20 @@ class RTSPServer : public Component {
   uint16_t port_{8554};
   std::string path_{"/stream"};
   int server_socket_{-1};
+  uint32_t session_id_{0};
+  uint8_t rtp_channel_{0};  // Canal entrelacé négocié au SETUP
+  uint16_t rtp_seq_{0};
+  uint32_t rtp_ssrc_{0x45535048};  // "ESPH"
   
   bool start_server_();
   void handle_client_(int client_sock);
-  void send_rtsp_response_(int sock, const char *status, const char *content);
+  bool send_all_(int sock, const void *data, size_t len);
+  bool send_rtsp_response_(int sock, const char *cseq, const char *status, const char *headers,
+                           const char *content);
   void stream_h264_(int sock);
+  bool send_rtp_packet_(int sock, const uint8_t *header_ext, size_t ext_len,
+                        const uint8_t *payload, size_t len, uint32_t timestamp, bool marker);
+  bool send_h264_access_unit_(int sock, const uint8_t *data, size_t size, uint32_t timestamp);
 };
 
 } // namespace rtsp_server
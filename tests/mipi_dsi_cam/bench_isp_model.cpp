@@ -0,0 +1,46 @@
+// Benchmark du modèle ISP sur l'hôte : ms/frame et Mpixels/s par nombre de threads
+//
+// bench_isp_model [largeur hauteur [frames]] (défaut : 1280 720 30)
+
+#include "mipi_dsi_cam_isp_model.h"
+#include "isp_scene.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+using namespace esphome::mipi_dsi_cam;
+
+int main(int argc, char **argv) {
+  const uint16_t width = argc > 2 ? static_cast<uint16_t>(std::atoi(argv[1])) : 1280;
+  const uint16_t height = argc > 2 ? static_cast<uint16_t>(std::atoi(argv[2])) : 720;
+  const uint32_t frames = argc > 3 ? static_cast<uint32_t>(std::atoi(argv[3])) : 30;
+
+  const std::vector<uint8_t> raw = isp_scene::bayer_scene(width, height, 0);
+  std::vector<uint8_t> out(static_cast<size_t>(width) * height * 2);
+
+  IspModel model;
+  model.configure(IspParams(), 0);
+
+  const uint32_t cores = std::max(1u, std::thread::hardware_concurrency());
+  std::printf("IspModel %ux%u, %u frames, %u cores\n", width, height, frames, cores);
+  for (uint32_t threads = 1; threads <= std::min<uint32_t>(cores, ISP_MODEL_MAX_THREADS); threads *= 2) {
+    model.set_thread_count(threads);
+    model.process(raw.data(), width, height, out.data());  // Mise en cache, tampons alloués
+
+    uint64_t total_us = 0;
+    uint32_t best_us = UINT32_MAX;
+    for (uint32_t i = 0; i < frames; i++) {
+      model.process(raw.data(), width, height, out.data());
+      total_us += model.get_last_process_us();
+      best_us = std::min(best_us, model.get_last_process_us());
+    }
+    const double mean_ms = total_us / 1000.0 / frames;
+    std::printf("  %u thread(s): %.2f ms/frame (best %.2f), %.1f Mpix/s\n", model.get_last_thread_count(), mean_ms,
+                best_us / 1000.0, width * height / (mean_ms * 1000.0));
+  }
+  return 0;
+}
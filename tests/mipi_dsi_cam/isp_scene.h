@@ -0,0 +1,49 @@
+#pragma once
+
+// Scène synthétique commune au test doré et au benchmark du modèle ISP
+
+#include <cstdint>
+#include <vector>
+
+namespace isp_scene {
+
+struct Rgb {
+  uint8_t r, g, b;
+};
+
+// Rampe grise à gauche, six aplats couleur à droite, bord diagonal net en bas
+inline Rgb scene_color(uint16_t x, uint16_t y, uint16_t width, uint16_t height) {
+  static const Rgb PATCHES[6] = {
+    {200, 60, 40}, {60, 180, 70}, {50, 70, 200}, {210, 200, 60}, {190, 70, 190}, {60, 190, 200},
+  };
+  if (y >= height * 3 / 4) {
+    const uint8_t v = (x + y) % 32 < 16 ? 230 : 25;
+    return {v, v, v};
+  }
+  if (x < width / 2) {
+    const uint8_t v = static_cast<uint8_t>(16 + (x * 224) / (width / 2));
+    return {v, v, v};
+  }
+  const uint16_t column = (x - width / 2) * 3 / (width - width / 2);
+  const uint16_t row = y * 2 / (height * 3 / 4);
+  return PATCHES[row * 3 + column];
+}
+
+// Mosaïque RAW8 de la scène ; rouge en (red_x, red_y) du quad, même convention que IspModel
+inline std::vector<uint8_t> bayer_scene(uint16_t width, uint16_t height, uint8_t bayer_pattern) {
+  static const uint8_t RED_POS[4][2] = {{1, 1}, {0, 1}, {1, 0}, {0, 0}};
+  const uint8_t red_x = RED_POS[bayer_pattern & 3][0];
+  const uint8_t red_y = RED_POS[bayer_pattern & 3][1];
+  std::vector<uint8_t> raw(static_cast<size_t>(width) * height);
+  for (uint16_t y = 0; y < height; y++) {
+    for (uint16_t x = 0; x < width; x++) {
+      const Rgb c = scene_color(x, y, width, height);
+      const bool red_col = (x & 1) == red_x;
+      const bool red_row = (y & 1) == red_y;
+      raw[static_cast<size_t>(y) * width + x] = red_col && red_row ? c.r : (!red_col && !red_row ? c.b : c.g);
+    }
+  }
+  return raw;
+}
+
+}  // namespace isp_scene
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdio>
+
+#define ESP_LOG_HOST_(level, tag, format, ...) std::printf("[%s][%s] " format "\n", level, tag, ##__VA_ARGS__)
+#define ESP_LOGE(tag, format, ...) ESP_LOG_HOST_("E", tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) ESP_LOG_HOST_("W", tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) ESP_LOG_HOST_("I", tag, format, ##__VA_ARGS__)
+#define ESP_LOGCONFIG(tag, format, ...) ESP_LOG_HOST_("C", tag, format, ##__VA_ARGS__)
+#ifdef MIPI_DSI_CAM_HOST_VERBOSE
+#define ESP_LOGD(tag, format, ...) ESP_LOG_HOST_("D", tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...) ESP_LOG_HOST_("V", tag, format, ##__VA_ARGS__)
+#else
+#define ESP_LOGD(tag, format, ...) do {} while (0)
+#define ESP_LOGV(tag, format, ...) do {} while (0)
+#endif
+#define LOG_UPDATE_INTERVAL(component) (void) (component)
@@ -0,0 +1,106 @@
+// Convergence AE en boucle fermée : capteur simulé (retard de deux frames), file de commandes et
+// statistiques CPU ; la scène change de ±1 à ±5 EV et la convergence rapportée doit tenir en 6 frames
+
+#include "mipi_dsi_cam.h"
+#include "mipi_dsi_cam_sim.h"
+#include "test_support.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+using namespace esphome::mipi_dsi_cam;
+
+static const uint16_t WIDTH = 160;
+static const uint16_t HEIGHT = 120;
+static const uint32_t MAX_CONVERGENCE_FRAMES = 6;
+
+struct Loop {
+  SimSensorDriver sensor{WIDTH, HEIGHT, 30};
+  SensorCommandQueue queue;
+  FrameStatsEngine engine;
+  AutoExposureController ae;
+  std::vector<uint8_t> frame = std::vector<uint8_t>(WIDTH * HEIGHT * 2);
+  FrameStats stats;
+  uint32_t sequence{0};
+  float scene_ev{0.0f};
+
+  Loop() {
+    this->sensor.init();
+    this->queue.set_sensor(&this->sensor);
+    this->queue.queue_exposure(SimSensorDriver::NOMINAL_EXPOSURE);
+    this->queue.queue_gain(0);
+    this->queue.flush();
+    this->engine.configure(4, 4, 2);
+    this->ae.configure(&this->sensor, AE_EXPOSURE_MIN, AE_EXPOSURE_MAX);
+    this->ae.reset(SimSensorDriver::NOMINAL_EXPOSURE, 0);
+  }
+
+  // Une frame : réglages effectifs du capteur, rendu de la scène, statistiques, AE, flush
+  void step() {
+    this->sensor.latch_frame();
+    const uint32_t exposure = this->sensor.get_frame_exposure();
+    const uint8_t gain_index = this->sensor.get_frame_gain_index();
+    const float scale = exposure * this->sensor.get_gain_multiplier(gain_index) /
+                        SimSensorDriver::NOMINAL_EXPOSURE * std::exp2(this->scene_ev);
+
+    // Rampe de gris 32..224 (moyenne 128 au réglage nominal) ; les colonnes claires saturent d'abord
+    for (uint16_t x = 0; x < WIDTH; x++) {
+      const uint8_t grey = static_cast<uint8_t>(std::min(255.0f, (32 + 192 * x / (WIDTH - 1)) * scale));
+      const uint16_t pixel = ((grey >> 3) << 11) | ((grey >> 2) << 5) | (grey >> 3);
+      for (uint16_t y = 0; y < HEIGHT; y++) {
+        this->frame[(y * WIDTH + x) * 2] = pixel & 0xFF;
+        this->frame[(y * WIDTH + x) * 2 + 1] = pixel >> 8;
+      }
+    }
+    CHECK(this->engine.compute(this->frame.data(), this->frame.size(), WIDTH, HEIGHT,
+                               PixelFormat::PIXEL_FORMAT_RGB565, 0, this->stats));
+    this->stats.sequence = ++this->sequence;
+
+    AutoExposureController::Decision decision;
+    if (this->ae.process(this->stats, exposure, gain_index, this->sequence * 33333LL, decision)) {
+      this->queue.queue_exposure(decision.exposure);
+      this->queue.queue_gain(decision.gain_index);
+      CHECK_EQ(this->queue.flush(), ESP_OK);
+    }
+  }
+
+  // Frames jusqu'à convergence (0 = jamais en `limit` frames)
+  uint32_t run_until_converged(uint32_t limit) {
+    for (uint32_t i = 1; i <= limit; i++) {
+      this->step();
+      if (this->ae.is_converged()) {
+        return i;
+      }
+    }
+    return 0;
+  }
+};
+
+int main() {
+  for (int ev = 1; ev <= 5; ev++) {
+    for (int sign = -1; sign <= 1; sign += 2) {
+      Loop loop;
+      // Point de départ convergé sur la scène de référence
+      CHECK(loop.run_until_converged(30) > 0);
+      for (int i = 0; i < 4; i++) {
+        loop.step();
+      }
+      CHECK(loop.ae.is_converged());
+
+      loop.scene_ev = static_cast<float>(sign * ev);
+      loop.step();
+      CHECK(!loop.ae.is_converged());
+      CHECK(loop.run_until_converged(30) > 0);
+
+      const uint32_t frames = loop.ae.get_last_convergence_frames();
+      std::printf("%+d EV: converged in %u frames, luma %u\n", sign * ev, (unsigned) frames,
+                  loop.stats.center_weighted_luma());
+      CHECK(frames > 0);
+      CHECK(frames <= MAX_CONVERGENCE_FRAMES);
+      CHECK(std::abs(loop.stats.center_weighted_luma() - loop.ae.get_target()) <= 16);
+    }
+  }
+  return 0;
+}
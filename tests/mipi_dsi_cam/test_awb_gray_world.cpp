@@ -0,0 +1,37 @@
+// AWB gray world sur le flux simulé, WB hors place : les zones sont mesurées avant les gains
+
+#include "mipi_dsi_cam.h"
+#include "test_support.h"
+
+#include <chrono>
+#include <thread>
+
+using namespace esphome::mipi_dsi_cam;
+
+int main() {
+  MipiDsiCam cam;
+  cam.set_resolution(320, 240);
+  cam.set_framerate(30);
+  cam.setup();
+  CHECK(cam.is_initialized());
+  CHECK(cam.start_streaming());
+
+  // Mire neutre en moyenne, gains de départ très déséquilibrés (rouge / bleu = 2.3)
+  cam.set_white_balance_gains(1.6f, 1.0f, 0.7f);
+  cam.set_auto_white_balance(true);
+
+  const auto end = std::chrono::steady_clock::now() + std::chrono::seconds(4);
+  while (std::chrono::steady_clock::now() < end) {
+    cam.loop();
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  cam.stop_streaming();
+
+  // Sans mise à l'échelle des moyennes par les gains courants, le rapport ne bouge pas
+  const ThreeAState state = cam.get_3a_state();
+  CHECK(state.awb_generation > 0);
+  CHECK(state.wb_red / state.wb_blue < 1.6f);
+  CHECK(state.wb_red > 0.5f && state.wb_red < 3.0f);
+  CHECK(state.wb_blue > 0.5f && state.wb_blue < 3.0f);
+  return 0;
+}
@@ -0,0 +1,173 @@
+// File de commandes capteur : fusion des demandes, cache miroir, encadrement group hold et rejeu après échec
+
+#include "mipi_dsi_cam.h"
+#include "mipi_dsi_cam_sim.h"
+#include "test_support.h"
+
+#include <vector>
+
+using namespace esphome::mipi_dsi_cam;
+
+// Capteur simulé qui journalise les écritures registres et peut en faire échouer une
+class RecordingSensor : public SimSensorDriver {
+ public:
+  RecordingSensor() : SimSensorDriver(64, 48, 30) {}
+
+  esp_err_t write_register(uint16_t reg, uint8_t value) override {
+    if (this->fail_in > 0 && --this->fail_in == 0) {
+      return ESP_FAIL;
+    }
+    this->log.push_back({reg, value});
+    return SimSensorDriver::write_register(reg, value);
+  }
+
+  std::vector<SensorRegister> log;
+  uint32_t fail_in{0};  // Rang (1 = prochaine) de l'écriture refusée, 0 = aucune
+};
+
+// Écritures attendues : group hold ouvert, registres dans l'ordre donné, group hold relâché
+static std::vector<SensorRegister> bracketed(const RecordingSensor &sensor, const std::vector<SensorRegister> &writes) {
+  SensorRegister begin, end;
+  CHECK(sensor.get_group_hold(&begin, &end));
+  std::vector<SensorRegister> out{begin};
+  out.insert(out.end(), writes.begin(), writes.end());
+  out.push_back(end);
+  return out;
+}
+
+static std::vector<SensorRegister> settings(const RecordingSensor &sensor, bool has_exposure, uint32_t exposure,
+                                            bool has_gain, uint32_t gain_index) {
+  SensorRegister regs[SENSOR_MAX_SETTING_REGISTERS];
+  std::vector<SensorRegister> out;
+  if (has_exposure) {
+    out.insert(out.end(), regs, regs + sensor.get_exposure_registers(exposure, regs));
+  }
+  if (has_gain) {
+    out.insert(out.end(), regs, regs + sensor.get_gain_registers(gain_index, regs));
+  }
+  return out;
+}
+
+// Écritures de `after` qui changent la valeur d'un registre de `before`
+static std::vector<SensorRegister> changes(const std::vector<SensorRegister> &before,
+                                           const std::vector<SensorRegister> &after) {
+  std::vector<SensorRegister> out;
+  for (const SensorRegister &write : after) {
+    bool same = false;
+    for (const SensorRegister &old : before) {
+      same |= old.reg == write.reg && old.value == write.value;
+    }
+    if (!same) {
+      out.push_back(write);
+    }
+  }
+  return out;
+}
+
+static void check_log(RecordingSensor &sensor, const std::vector<SensorRegister> &expected) {
+  CHECK_EQ(sensor.log.size(), expected.size());
+  for (size_t i = 0; i < expected.size(); i++) {
+    CHECK_EQ(sensor.log[i].reg, expected[i].reg);
+    CHECK_EQ(sensor.log[i].value, expected[i].value);
+  }
+  sensor.log.clear();
+}
+
+int main() {
+  RecordingSensor sensor;
+  CHECK_EQ(sensor.init(), ESP_OK);
+  SensorCommandQueue queue;
+  CHECK_EQ(queue.flush(), ESP_ERR_INVALID_STATE);
+  queue.set_sensor(&sensor);
+
+  // 1. Fusion : seule la dernière demande de chaque réglage part, dans un seul group hold
+  queue.queue_exposure(0x100);
+  queue.queue_gain(5);
+  queue.queue_exposure(0x234);
+  queue.queue_gain(40);
+  CHECK(queue.has_pending());
+  CHECK_EQ(queue.flush(), ESP_OK);
+  check_log(sensor, bracketed(sensor, settings(sensor, true, 0x234, true, 40)));
+  CHECK(!queue.has_pending());
+  CHECK_EQ(queue.get_flush_count(), 1);
+  CHECK_EQ(queue.get_write_count(), 6);
+  CHECK_EQ(queue.get_skipped_count(), 0);
+  CHECK_EQ(queue.get_exposure(), 0x234);
+  CHECK_EQ(queue.get_gain_index(), 40);
+  CHECK_EQ(sensor.get_exposure(), 0x234);
+  CHECK_EQ(sensor.get_gain_index(), 40);
+
+  // Rien en attente : aucun accès bus
+  CHECK_EQ(queue.flush(), ESP_OK);
+  CHECK(sensor.log.empty());
+  CHECK_EQ(queue.get_flush_count(), 1);
+
+  // 2. Cache miroir : 0x234 -> 0x254 ne change que l'octet du milieu, le gain identique ne part pas
+  queue.queue_exposure(0x254);
+  queue.queue_gain(40);
+  CHECK_EQ(queue.flush(), ESP_OK);
+  const std::vector<SensorRegister> changed =
+      changes(settings(sensor, true, 0x234, true, 40), settings(sensor, true, 0x254, true, 40));
+  CHECK_EQ(changed.size(), 1);
+  check_log(sensor, bracketed(sensor, changed));
+  CHECK_EQ(queue.get_write_count(), 7);
+  CHECK_EQ(queue.get_skipped_count(), 5);
+  CHECK_EQ(queue.get_flush_count(), 2);
+  CHECK_EQ(sensor.get_exposure(), 0x254);
+
+  // Valeurs déjà programmées : pas même le group hold
+  queue.queue_exposure(0x254);
+  queue.queue_gain(40);
+  CHECK_EQ(queue.flush(), ESP_OK);
+  CHECK(sensor.log.empty());
+  CHECK_EQ(queue.get_write_count(), 7);
+  CHECK_EQ(queue.get_skipped_count(), 11);
+  CHECK_EQ(queue.get_flush_count(), 3);
+
+  // 3. Échec de la deuxième écriture registre : le group hold est quand même relâché
+  queue.queue_exposure(0x800);
+  queue.queue_gain(70);
+  const std::vector<SensorRegister> wanted = settings(sensor, true, 0x800, true, 70);
+  const std::vector<SensorRegister> delta = changes(settings(sensor, true, 0x254, true, 40), wanted);
+  CHECK(delta.size() >= 2);
+  sensor.fail_in = 3;  // hold begin, premier registre modifié, puis échec
+  CHECK(queue.flush() != ESP_OK);
+  check_log(sensor, bracketed(sensor, {delta[0]}));
+  CHECK_EQ(queue.get_write_count(), 8);
+  CHECK_EQ(queue.get_skipped_count(), 11 + wanted.size() - delta.size());
+  CHECK_EQ(queue.get_flush_count(), 3);
+  CHECK_EQ(queue.get_exposure(), 0x254);
+  CHECK(queue.has_pending());
+
+  // Rejeu au flush suivant, miroir invalidé : tous les registres repartent, y compris ceux déjà écrits
+  CHECK_EQ(queue.flush(), ESP_OK);
+  check_log(sensor, bracketed(sensor, wanted));
+  CHECK_EQ(queue.get_write_count(), 8 + 6);
+  CHECK_EQ(queue.get_skipped_count(), 11 + wanted.size() - delta.size());
+  CHECK_EQ(queue.get_flush_count(), 4);
+  CHECK_EQ(sensor.get_exposure(), 0x800);
+  CHECK_EQ(sensor.get_gain_index(), 70);
+
+  // 4. Échec au relâchement du group hold, demande remplacée avant le rejeu : la nouvelle valeur gagne
+  queue.queue_exposure(0x900);
+  const std::vector<SensorRegister> held =
+      changes(settings(sensor, true, 0x800, false, 0), settings(sensor, true, 0x900, false, 0));
+  sensor.fail_in = 1 + held.size() + 1;
+  CHECK(queue.flush() != ESP_OK);
+  std::vector<SensorRegister> unreleased = bracketed(sensor, held);
+  unreleased.pop_back();
+  check_log(sensor, unreleased);
+  queue.queue_exposure(0xA00);
+  CHECK_EQ(queue.flush(), ESP_OK);
+  check_log(sensor, bracketed(sensor, settings(sensor, true, 0xA00, false, 0)));
+  CHECK_EQ(queue.get_exposure(), 0xA00);
+  CHECK_EQ(queue.get_gain_index(), 70);
+
+  // 5. Capteur écrit hors de la file : miroir invalidé, tout est réécrit
+  queue.invalidate_shadow();
+  queue.queue_exposure(0xA00);
+  queue.queue_gain(70);
+  CHECK_EQ(queue.flush(), ESP_OK);
+  check_log(sensor, bracketed(sensor, settings(sensor, true, 0xA00, true, 70)));
+  return 0;
+}
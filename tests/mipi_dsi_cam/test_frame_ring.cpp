@@ -0,0 +1,72 @@
+// Anneau de frames : un buffer V4L2 corrigé en place (WB) reste lié à son slot jusqu'au DQBUF
+
+#include "mipi_dsi_cam.h"
+#include "test_support.h"
+
+#include <vector>
+
+using namespace esphome::mipi_dsi_cam;
+
+static const size_t SLOT_SIZE = 64;
+
+static FrameMetadata meta_for(uint32_t sequence) {
+  FrameMetadata meta;
+  meta.sequence = sequence;
+  meta.pixel_format = static_cast<uint8_t>(PixelFormat::PIXEL_FORMAT_RGB565);
+  return meta;
+}
+
+// Capture complète dans `external` (nullptr = buffer du slot)
+static FrameSlot *capture(FrameRing &ring, uint8_t *external, uint32_t sequence) {
+  FrameSlot *slot = ring.claim_for_capture(external);
+  if (slot != nullptr) {
+    ring.commit_capture(slot, SLOT_SIZE, meta_for(sequence));
+  }
+  return slot;
+}
+
+int main() {
+  FrameRing ring;
+  CHECK(ring.allocate(2, SLOT_SIZE));
+  std::vector<uint8_t> v4l2_a(SLOT_SIZE), v4l2_b(SLOT_SIZE);
+
+  // 1. Le DMA remplit le buffer V4L2 A ; un bail (encodeur) corrige le slot en place
+  FrameSlot *a_slot = capture(ring, v4l2_a.data(), 1);
+  CHECK(a_slot != nullptr);
+  FrameSlot *lease = ring.pin_latest(0);
+  CHECK(lease == a_slot);
+  lease->wb_state.store(FrameSlot::WB_APPLIED, std::memory_order_release);
+  ring.unpin(lease);
+
+  // 2. Captures internes et V4L2 suivantes avant le DQBUF de A : le slot de A n'est pas recyclé
+  for (uint32_t sequence = 2; sequence < 8; sequence++) {
+    FrameSlot *slot = capture(ring, nullptr, sequence);
+    CHECK(slot != a_slot);
+  }
+  CHECK(capture(ring, v4l2_b.data(), 8) != a_slot);
+  CHECK(a_slot->buffer == v4l2_a.data());
+
+  // 3. DQBUF de A : le slot est retrouvé, déjà corrigé (complete_external_frame ne réapplique pas)
+  FrameSlot *dq = ring.pin_buffer(v4l2_a.data(), 1);
+  CHECK(dq == a_slot);
+  CHECK_EQ(dq->wb_state.load(), FrameSlot::WB_APPLIED);
+  ring.unpin(dq);
+
+  // 4. A remis en file : il reprend son slot pour la frame suivante
+  CHECK(capture(ring, v4l2_a.data(), 9) == a_slot);
+  CHECK_EQ(a_slot->wb_state.load(), FrameSlot::WB_RAW);
+
+  // Buffer prêté jamais corrigé : recyclable comme avant
+  FrameRing raw_ring;
+  CHECK(raw_ring.allocate(2, SLOT_SIZE));
+  FrameSlot *raw_slot = capture(raw_ring, v4l2_a.data(), 1);
+  CHECK(raw_slot != nullptr);
+  CHECK(capture(raw_ring, nullptr, 2) != nullptr);
+  CHECK(capture(raw_ring, nullptr, 3) == raw_slot);
+  CHECK(!raw_slot->is_external());
+
+  // Arrêt du DMA : le buffer corrigé est rendu malgré tout
+  CHECK(ring.release_external());
+  CHECK(!a_slot->is_external());
+  return 0;
+}
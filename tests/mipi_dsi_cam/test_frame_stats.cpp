@@ -0,0 +1,65 @@
+// Passe de statistiques CPU : alignement Bayer en RAW8 quel que soit le pas, RGB565 uniforme
+
+#include "mipi_dsi_cam.h"
+#include "test_support.h"
+
+#include <cstdlib>
+#include <vector>
+
+using namespace esphome::mipi_dsi_cam;
+
+static const uint16_t WIDTH = 64;
+static const uint16_t HEIGHT = 48;
+
+// Mosaïque d'une couleur uniforme ; rouge en (red_x, red_y) du quad, même convention que le moteur
+static std::vector<uint8_t> bayer_frame(uint8_t pattern, uint8_t r, uint8_t g, uint8_t b) {
+  static const uint8_t RED_POS[4][2] = {{1, 1}, {0, 1}, {1, 0}, {0, 0}};
+  const uint8_t red_x = RED_POS[pattern][0];
+  const uint8_t red_y = RED_POS[pattern][1];
+  std::vector<uint8_t> frame(WIDTH * HEIGHT);
+  for (uint16_t y = 0; y < HEIGHT; y++) {
+    for (uint16_t x = 0; x < WIDTH; x++) {
+      const bool red_col = (x & 1) == red_x;
+      const bool red_row = (y & 1) == red_y;
+      frame[y * WIDTH + x] = red_col && red_row ? r : (!red_col && !red_row ? b : g);
+    }
+  }
+  return frame;
+}
+
+int main() {
+  FrameStatsEngine engine;
+  FrameStats stats;
+
+  for (uint8_t stride = 1; stride <= 8; stride++) {
+    engine.configure(4, 4, stride);
+    for (uint8_t pattern = 0; pattern < 4; pattern++) {
+      const std::vector<uint8_t> frame = bayer_frame(pattern, 200, 100, 40);
+      CHECK(engine.compute(frame.data(), frame.size(), WIDTH, HEIGHT, PixelFormat::PIXEL_FORMAT_RAW8, pattern,
+                           stats));
+      CHECK(stats.valid);
+      CHECK(stats.samples > 0);
+      CHECK_EQ(stats.mean_r, 200);
+      CHECK_EQ(stats.mean_g, 100);
+      CHECK_EQ(stats.mean_b, 40);
+      CHECK(!stats.wb_after_gains);
+    }
+  }
+
+  // RGB565 : 0xF81F = magenta saturé, lu en mots de 16 bits little-endian
+  engine.configure(16, 16, 3);
+  std::vector<uint8_t> rgb(WIDTH * HEIGHT * 2);
+  for (size_t i = 0; i < rgb.size(); i += 2) {
+    rgb[i] = 0x1F;
+    rgb[i + 1] = 0xF8;
+  }
+  CHECK(engine.compute(rgb.data(), rgb.size(), WIDTH, HEIGHT, PixelFormat::PIXEL_FORMAT_RGB565, 0, stats));
+  CHECK_EQ(stats.mean_r, 255);
+  CHECK_EQ(stats.mean_g, 0);
+  CHECK_EQ(stats.mean_b, 255);
+
+  // Buffer plus court qu'une frame : refusé
+  CHECK(!engine.compute(rgb.data(), rgb.size() / 2, WIDTH, HEIGHT, PixelFormat::PIXEL_FORMAT_RGB565, 0, stats));
+  CHECK(!stats.valid);
+  return 0;
+}
@@ -0,0 +1,64 @@
+// Balance des blancs en place partagée : deux consommateurs du même slot voient la même frame corrigée une fois
+
+#include "mipi_dsi_cam.h"
+#include "test_support.h"
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <thread>
+
+using namespace esphome::mipi_dsi_cam;
+
+int main() {
+  MipiDsiCam cam;
+  cam.set_resolution(640, 480);
+  cam.set_framerate(60);
+  cam.set_frame_buffer_count(4);
+  cam.set_inplace_white_balance(true);
+  cam.setup();
+  CHECK(cam.is_initialized());
+  cam.set_white_balance_gains(1.5f, 1.0f, 0.5f);
+
+  const uint8_t first = cam.register_consumer("first");
+  const uint8_t second = cam.register_consumer("second");
+  CHECK(cam.start_streaming());
+
+  std::mutex mutex;
+  std::map<uint32_t, uint32_t> checksums;  // Séquence -> empreinte vue par le premier lecteur
+  uint32_t frames = 0, shared = 0, unbalanced = 0, mismatches = 0;
+  auto consume = [&](uint8_t consumer) {
+    const auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(800);
+    while (std::chrono::steady_clock::now() < end) {
+      FrameLease lease = cam.wait_and_acquire(consumer, 100);
+      if (!lease) {
+        continue;
+      }
+      uint32_t checksum = 0;
+      for (size_t i = 0; i < lease.size(); i += 7) {
+        checksum = checksum * 31 + lease.data()[i];
+      }
+      std::lock_guard<std::mutex> lock(mutex);
+      frames++;
+      unbalanced += lease.white_balanced() ? 0 : 1;
+      auto seen = checksums.find(lease.sequence());
+      if (seen == checksums.end()) {
+        checksums[lease.sequence()] = checksum;
+      } else {
+        shared++;
+        mismatches += seen->second == checksum ? 0 : 1;
+      }
+    }
+  };
+  std::thread a(consume, first);
+  std::thread b(consume, second);
+  a.join();
+  b.join();
+  cam.stop_streaming();
+
+  CHECK(frames >= 20);
+  CHECK(shared > 0);
+  CHECK_EQ(unbalanced, 0);
+  CHECK_EQ(mismatches, 0);
+  return 0;
+}
@@ -0,0 +1,173 @@
+// IspModel : images dorées (golden/*.ppm) et propriétés du pipeline sur une scène synthétique
+//
+// test_isp_model --update réécrit les images dorées après un changement volontaire du modèle.
+
+#include "mipi_dsi_cam_isp_model.h"
+#include "isp_scene.h"
+#include "test_support.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace esphome::mipi_dsi_cam;
+
+static const uint16_t WIDTH = 96;
+static const uint16_t HEIGHT = 64;
+static const uint8_t BGGR = 0;
+
+static isp_scene::Rgb pixel(const std::vector<uint8_t> &rgb565, uint16_t x, uint16_t y) {
+  const size_t i = (static_cast<size_t>(y) * WIDTH + x) * 2;
+  const uint16_t p = rgb565[i] | (rgb565[i + 1] << 8);
+  const uint8_t r5 = p >> 11;
+  const uint8_t g6 = (p >> 5) & 0x3F;
+  const uint8_t b5 = p & 0x1F;
+  return {static_cast<uint8_t>((r5 << 3) | (r5 >> 2)), static_cast<uint8_t>((g6 << 2) | (g6 >> 4)),
+          static_cast<uint8_t>((b5 << 3) | (b5 >> 2))};
+}
+
+static std::vector<uint8_t> run(const IspParams &params, uint8_t threads, uint8_t pattern = BGGR) {
+  IspModel model;
+  model.configure(params, pattern);
+  model.set_thread_count(threads);
+  std::vector<uint8_t> out(WIDTH * HEIGHT * 2);
+  CHECK(model.process(isp_scene::bayer_scene(WIDTH, HEIGHT, pattern).data(), WIDTH, HEIGHT, out.data()));
+  return out;
+}
+
+static std::string golden_path(const char *name) { return std::string(MIPI_DSI_CAM_GOLDEN_DIR "/") + name + ".ppm"; }
+
+static void write_golden(const char *name, const std::vector<uint8_t> &rgb565) {
+  std::ofstream file(golden_path(name), std::ios::binary);
+  CHECK(file.good());
+  file << "P6\n" << WIDTH << " " << HEIGHT << "\n255\n";
+  for (uint16_t y = 0; y < HEIGHT; y++) {
+    for (uint16_t x = 0; x < WIDTH; x++) {
+      const isp_scene::Rgb c = pixel(rgb565, x, y);
+      file.put(c.r).put(c.g).put(c.b);
+    }
+  }
+  std::printf("updated %s\n", golden_path(name).c_str());
+}
+
+// Tolérance : un pas RGB565 par canal (arrondis flottants de configure() selon la libm),
+// et au plus 1 % de pixels différents
+static void check_golden(const char *name, const std::vector<uint8_t> &rgb565) {
+  std::ifstream file(golden_path(name), std::ios::binary);
+  if (!file.good()) {
+    std::fprintf(stderr, "missing %s (run test_isp_model --update)\n", golden_path(name).c_str());
+    CHECK(false);
+  }
+  std::string magic;
+  int width = 0;
+  int height = 0;
+  int max = 0;
+  file >> magic >> width >> height >> max;
+  file.get();
+  CHECK(magic == "P6");
+  CHECK_EQ(width, WIDTH);
+  CHECK_EQ(height, HEIGHT);
+  CHECK_EQ(max, 255);
+
+  uint32_t differing = 0;
+  for (uint16_t y = 0; y < HEIGHT; y++) {
+    for (uint16_t x = 0; x < WIDTH; x++) {
+      uint8_t expected[3];
+      file.read(reinterpret_cast<char *>(expected), 3);
+      CHECK(file.good());
+      const isp_scene::Rgb c = pixel(rgb565, x, y);
+      const int dr = std::abs(c.r - expected[0]);
+      const int dg = std::abs(c.g - expected[1]);
+      const int db = std::abs(c.b - expected[2]);
+      if (dr > 8 || dg > 4 || db > 8) {
+        std::fprintf(stderr, "%s: (%u, %u) = %u/%u/%u, golden %u/%u/%u\n", name, x, y, c.r, c.g, c.b, expected[0],
+                     expected[1], expected[2]);
+        CHECK(false);
+      }
+      differing += (dr | dg | db) != 0;
+    }
+  }
+  CHECK(differing * 100 <= static_cast<uint32_t>(WIDTH) * HEIGHT);
+}
+
+static IspParams linear_params() {
+  IspParams params;
+  params.bf.enabled = false;
+  params.gamma.enabled = false;
+  params.sharpen.enabled = false;
+  return params;
+}
+
+static IspParams tuned_params() {
+  IspParams params;
+  params.bf.denoising_level = 12;
+  params.ccm.red_gain = 1.4f;
+  params.ccm.blue_gain = 0.8f;
+  params.gamma.gamma = 1.8f;
+  params.sharpen.h_coeff = 1.2f;
+  params.color.brightness = 10;
+  params.color.contrast = 150;
+  params.color.saturation = 160;
+  params.color.hue = 20;
+  return params;
+}
+
+int main(int argc, char **argv) {
+  const bool update = argc > 1 && std::strcmp(argv[1], "--update") == 0;
+
+  struct Case {
+    const char *name;
+    IspParams params;
+  };
+  const Case cases[] = {
+    {"isp_linear", linear_params()},
+    {"isp_default", IspParams()},
+    {"isp_tuned", tuned_params()},
+  };
+
+  for (const Case &c : cases) {
+    const std::vector<uint8_t> single = run(c.params, 1);
+    // Résultat indépendant du nombre de threads (bandes entrelacées)
+    CHECK(run(c.params, 4) == single);
+    if (update) {
+      write_golden(c.name, single);
+    } else {
+      check_golden(c.name, single);
+    }
+  }
+
+  // Chaîne linéaire : les aplats ressortent à leur couleur (au pas RGB565 près)
+  const std::vector<uint8_t> linear = run(linear_params(), 1);
+  const isp_scene::Rgb red_patch = pixel(linear, WIDTH * 5 / 8, HEIGHT / 8);
+  CHECK(std::abs(red_patch.r - 200) <= 8 && std::abs(red_patch.g - 60) <= 4 && std::abs(red_patch.b - 40) <= 8);
+
+  // Même scène dans les quatre motifs Bayer : même image
+  for (uint8_t pattern = 1; pattern < 4; pattern++) {
+    const std::vector<uint8_t> other = run(linear_params(), 1, pattern);
+    const isp_scene::Rgb p = pixel(other, WIDTH * 5 / 8, HEIGHT / 8);
+    CHECK(std::abs(p.r - red_patch.r) <= 8 && std::abs(p.g - red_patch.g) <= 4 && std::abs(p.b - red_patch.b) <= 8);
+  }
+
+  // Gain rouge de la CCM (WB repliée) : rouge divisé par deux, vert et bleu inchangés
+  IspParams half_red = linear_params();
+  half_red.ccm.red_gain = 0.5f;
+  const isp_scene::Rgb halved = pixel(run(half_red, 1), WIDTH * 5 / 8, HEIGHT / 8);
+  CHECK(std::abs(halved.r - 100) <= 8);
+  CHECK_EQ(halved.g, red_patch.g);
+
+  // Saturation nulle : gris
+  IspParams gray = linear_params();
+  gray.color.saturation = 0;
+  const isp_scene::Rgb desaturated = pixel(run(gray, 1), WIDTH * 5 / 8, HEIGHT / 8);
+  CHECK(std::abs(desaturated.r - desaturated.g) <= 8 && std::abs(desaturated.b - desaturated.g) <= 8);
+
+  // Image trop petite refusée
+  IspModel model;
+  model.configure(IspParams(), BGGR);
+  uint8_t tiny[3 * 3] = {};
+  uint8_t out[3 * 3 * 2];
+  CHECK(!model.process(tiny, 3, 3, out));
+  return 0;
+}
@@ -0,0 +1,40 @@
+// Flux simulé de bout en bout : SimFrameSource -> anneau -> baux consommateur -> wait_and_acquire()
+
+#include "mipi_dsi_cam.h"
+#include "test_support.h"
+
+#include <chrono>
+
+using namespace esphome::mipi_dsi_cam;
+
+int main() {
+  MipiDsiCam cam;
+  cam.set_resolution(640, 480);
+  cam.set_framerate(60);
+  cam.set_frame_buffer_count(3);
+  cam.setup();
+  CHECK(cam.is_initialized());
+
+  const uint8_t consumer = cam.register_consumer("test");
+  CHECK(cam.start_streaming());
+
+  uint32_t frames = 0;
+  uint32_t last_sequence = 0;
+  const auto end = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+  while (std::chrono::steady_clock::now() < end) {
+    FrameLease lease = cam.wait_and_acquire(consumer, 100);
+    if (!lease) {
+      continue;
+    }
+    CHECK(lease.sequence() > last_sequence);
+    CHECK_EQ(lease.size(), 640 * 480 * 2);
+    last_sequence = lease.sequence();
+    frames++;
+  }
+  cam.stop_streaming();
+
+  // 60 fps pendant 1 s : large marge pour une machine de CI chargée
+  CHECK(frames >= 20);
+  cam.dump_telemetry();
+  return 0;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+// Assertions minimales des tests host : le premier échec termine le test avec un code non nul
+
+#include <cstdio>
+#include <cstdlib>
+
+#define CHECK(cond) \
+  do { \
+    if (!(cond)) { \
+      std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+      std::exit(1); \
+    } \
+  } while (0)
+
+#define CHECK_EQ(a, b) \
+  do { \
+    const long long check_a_ = (long long) (a); \
+    const long long check_b_ = (long long) (b); \
+    if (check_a_ != check_b_) { \
+      std::fprintf(stderr, "%s:%d: CHECK_EQ(%s, %s) failed: %lld != %lld\n", __FILE__, __LINE__, #a, #b, check_a_, \
+                   check_b_); \
+      std::exit(1); \
+    } \
+  } while (0)
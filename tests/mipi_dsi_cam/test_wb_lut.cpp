@@ -0,0 +1,152 @@
+// WhiteBalanceLut : apply() (SSSE3 / NEON + chemin par mots) bit-exact avec apply_scalar(), double buffer
+
+#include "mipi_dsi_cam_wb.h"
+#include "test_support.h"
+
+#include <atomic>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace esphome::mipi_dsi_cam;
+
+static const uint8_t CANARY = 0xA5;
+
+// Compare apply() à apply_scalar() sur src[0, size), hors place et en place ; les octets au-delà
+// du dernier pixel complet (taille impaire) ne doivent pas être touchés
+static void check_apply(const WhiteBalanceLut &lut, const uint8_t *src, size_t size) {
+  const size_t even = size & ~static_cast<size_t>(1);
+  std::vector<uint8_t> expected(size + 1, CANARY);
+  std::vector<uint8_t> out(size + 1, CANARY);
+  WhiteBalanceLut::apply_scalar(src, expected.data(), size, lut.get_red_gain(), lut.get_green_gain(),
+                                lut.get_blue_gain());
+  lut.apply(src, out.data(), size);
+  CHECK(std::memcmp(expected.data(), out.data(), even) == 0);
+  for (size_t i = even; i <= size; i++) {
+    CHECK_EQ(out[i], CANARY);
+  }
+
+  std::vector<uint8_t> inplace(src, src + size);
+  lut.apply(inplace.data(), inplace.data(), size);
+  CHECK(std::memcmp(expected.data(), inplace.data(), even) == 0);
+  if (size != even) {
+    CHECK_EQ(inplace[even], src[even]);
+  }
+}
+
+// Double buffer : une table tenue n'est pas réécrite, la publication attend sa libération
+static void check_deferred_publish() {
+  WhiteBalanceLut lut;
+  CHECK(lut.update(300, 256, 200));
+  {
+    const WhiteBalanceLut::Lease held = lut.acquire();
+    CHECK(lut.update(400, 256, 100));  // réserve libre : publiée
+    CHECK(!lut.update(500, 256, 50));  // réserve = table tenue : différée
+    CHECK(lut.has_pending());
+    CHECK(!lut.publish_pending());
+    CHECK_EQ(held.get_red_gain(), 300);
+    CHECK_EQ(lut.get_red_gain(), 400);
+  }
+  CHECK(lut.publish_pending());
+  CHECK(!lut.has_pending());
+  CHECK_EQ(lut.get_red_gain(), 500);
+  CHECK_EQ(lut.get_blue_gain(), 50);
+}
+
+// Lecteurs concurrents d'update() : chaque frame est corrigée par un seul jeu de gains,
+// celui que portent ses métadonnées
+static void check_concurrent_readers() {
+  static const size_t FRAME_BYTES = 64 * 1024;
+  WhiteBalanceLut lut;
+  std::atomic<bool> stop{false};
+  std::atomic<uint32_t> frames{0};
+
+  std::vector<uint8_t> src(FRAME_BYTES);
+  std::mt19937 rng(7);
+  for (auto &b : src) {
+    b = static_cast<uint8_t>(rng());
+  }
+
+  auto reader = [&]() {
+    std::vector<uint8_t> out(FRAME_BYTES);
+    std::vector<uint8_t> expected(FRAME_BYTES);
+    while (!stop.load()) {
+      const WhiteBalanceLut::Lease wb = lut.acquire();
+      wb.apply(src.data(), out.data(), FRAME_BYTES);
+      WhiteBalanceLut::apply_scalar(src.data(), expected.data(), FRAME_BYTES, wb.get_red_gain(),
+                                    wb.get_green_gain(), wb.get_blue_gain());
+      CHECK(out == expected);
+      frames.fetch_add(1);
+    }
+  };
+  std::thread readers[3] = {std::thread(reader), std::thread(reader), std::thread(reader)};
+
+  uint32_t published = 0;
+  while (frames.load() < 300) {
+    if (lut.update(128 + rng() % 640, 128 + rng() % 640, 128 + rng() % 640)) {
+      published++;
+    }
+    lut.publish_pending();
+    std::this_thread::yield();
+  }
+  stop.store(true);
+  for (auto &t : readers) {
+    t.join();
+  }
+  CHECK(published > 0);
+}
+
+int main() {
+  // Les 65536 valeurs RGB565, suivies de quelques octets pour décaler les fins de buffer
+  std::vector<uint8_t> all(65536 * 2 + 64);
+  for (uint32_t v = 0; v < 65536; v++) {
+    all[v * 2] = static_cast<uint8_t>(v & 0xFF);
+    all[v * 2 + 1] = static_cast<uint8_t>(v >> 8);
+  }
+  std::mt19937 rng(0x565);
+  for (size_t i = 65536 * 2; i < all.size(); i++) {
+    all[i] = static_cast<uint8_t>(rng());
+  }
+
+  const uint16_t fixed[][3] = {
+    {256, 256, 256},  // identité : memcpy
+    {0, 0, 0},
+    {1024, 1024, 1024},
+    {128, 256, 768},  // bornes 0.5 / 3.0 de l'AWB
+    {257, 255, 256},
+  };
+
+  WhiteBalanceLut lut;
+  for (int round = 0; round < 200; round++) {
+    uint16_t r, g, b;
+    if (round < 5) {
+      r = fixed[round][0];
+      g = fixed[round][1];
+      b = fixed[round][2];
+    } else {
+      r = rng() % 1025;
+      g = rng() % 1025;
+      b = rng() % 1025;
+    }
+    lut.update(r, g, b);
+    CHECK_EQ(lut.get_red_gain(), r);
+    CHECK_EQ(lut.is_identity(), r == 256 && g == 256 && b == 256);
+
+    // Toutes les valeurs, plus une fin de buffer non multiple du bloc SIMD
+    check_apply(lut, all.data(), 65536 * 2);
+    check_apply(lut, all.data(), 65536 * 2 + 2 * (1 + rng() % 15));
+
+    // Petites tailles (impaires comprises) et débuts non alignés
+    for (size_t size = 0; size <= 70; size++) {
+      check_apply(lut, all.data() + 1 + rng() % 7, size);
+    }
+  }
+
+  // Un update() aux mêmes gains ne reconstruit pas les tables
+  CHECK(!lut.update(lut.get_red_gain(), lut.get_green_gain(), lut.get_blue_gain()));
+
+  check_deferred_publish();
+  check_concurrent_readers();
+  return 0;
+}